@@ -612,6 +612,14 @@ int Z7_FASTCALL LZMA_DECODE_REAL(CLzmaDec *p, SizeT limit, const Byte *bufLimit)
 #endif
 
 
+static LzmaDec_DecodeRealFunc g_LzmaDec_DecodeReal = LZMA_DECODE_REAL;
+
+void LzmaDec_SetDecodeReal(LzmaDec_DecodeRealFunc func)
+{
+  g_LzmaDec_DecodeReal = func ? func : LZMA_DECODE_REAL;
+}
+
+
 
 static void Z7_FASTCALL LzmaDec_WriteRem(CLzmaDec *p, SizeT limit)
 {
@@ -692,7 +700,7 @@ static int Z7_FASTCALL LzmaDec_DecodeReal2(CLzmaDec *p, SizeT limit, const Byte
       limit = p->dicPos + rem;
   }
   {
-    int res = LZMA_DECODE_REAL(p, limit, bufLimit);
+    int res = g_LzmaDec_DecodeReal(p, limit, bufLimit);
     if (p->checkDicSize == 0 && p->processedPos >= p->prop.dicSize)
       p->checkDicSize = p->prop.dicSize;
     return res;
@@ -232,6 +232,22 @@ SRes LzmaDecode(Byte *dest, SizeT *destLen, const Byte *src, SizeT *srcLen,
     const Byte *propData, unsigned propSize, ELzmaFinishMode finishMode,
     ELzmaStatus *status, ISzAllocPtr alloc);
 
+
+/* ---------- Main Loop ---------- */
+
+/* LzmaDec_SetDecodeReal
+
+Replaces the symbol decoding loop used by LzmaDec_DecodeToDic() (and so by
+every interface above and by Lzma2Dec) for all decoders. The function must
+keep the contract of LZMA_DECODE_REAL in LzmaDec.c and its CLzmaProb layout,
+like the external ASM loop does. NULL restores the built-in loop.
+The pointer is read without synchronization: set it while nothing decodes.
+*/
+
+typedef int (Z7_FASTCALL *LzmaDec_DecodeRealFunc)(CLzmaDec *p, SizeT limit, const Byte *bufLimit);
+
+void LzmaDec_SetDecodeReal(LzmaDec_DecodeRealFunc func);
+
 EXTERN_C_END
 
 #endif
@@ -0,0 +1,1137 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Synthetic 7z Fixture Generator
+**
+** Usage: ArchiveFixtures <output directory> [--scale <factor>] [--level <0-9>]
+**                        [--only <fixture>]
+**
+** Writes the archives ArchiveSuite measures. Content comes from seeded
+** generators and every time stamp is fixed, so the same arguments always
+** produce byte-identical files:
+**   tiny-files.7z        50,000 files of 0-2 KB in 500 folders, 16 MB solid blocks
+**   huge-solid.7z        256 MB in a single solid block, 16 MB dictionary
+**   deep-tree.7z         a 7-level tree of folders plus 32-level chains
+**   million-entries.7z   1,048,576 files of 0-64 bytes (LZMA-packed header)
+**   mixed-filters.7z     BCJ + LZMA, Delta + LZMA2, ARM + LZMA, ARM64 + LZMA2,
+**                        LZMA2 and Copy blocks, and a 64 MB file alone in
+**                        its block
+**   encrypted.7z         LZMA2, BCJ + LZMA and Copy blocks behind 7zAES,
+**                        password "SevenZipView", one block salted
+**   nested.7z            archives inside archives, two levels deep, in an
+**                        LZMA2 solid block and a Copy block
+** --scale multiplies file counts and sizes (0.1 for a quick run).
+**
+** The 7z container is written here; streams are packed with liblzma's raw
+** encoders, as the vendored SDK only decodes, and encrypted with the SDK's
+** portable AES-CBC.
+*/
+
+#include <lzma.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "7zCrc.h"
+#include "Aes.h"
+#include "Sha256.h"
+}
+
+// LZMA1EXT (LZMA without an end marker) and ARM64 arrived in 5.4
+#if LZMA_VERSION < 50040000
+#error "ArchiveFixtures needs liblzma 5.4 or later"
+#endif
+
+namespace {
+
+// Property IDs of the 7z header
+enum : unsigned char {
+    ID_END = 0x00,
+    ID_HEADER = 0x01,
+    ID_MAIN_STREAMS_INFO = 0x04,
+    ID_FILES_INFO = 0x05,
+    ID_PACK_INFO = 0x06,
+    ID_UNPACK_INFO = 0x07,
+    ID_SUBSTREAMS_INFO = 0x08,
+    ID_SIZE = 0x09,
+    ID_CRC = 0x0A,
+    ID_FOLDER = 0x0B,
+    ID_CODERS_UNPACK_SIZE = 0x0C,
+    ID_NUM_UNPACK_STREAM = 0x0D,
+    ID_EMPTY_STREAM = 0x0E,
+    ID_EMPTY_FILE = 0x0F,
+    ID_NAME = 0x11,
+    ID_MTIME = 0x14,
+    ID_WIN_ATTRIB = 0x15,
+    ID_ENCODED_HEADER = 0x17,
+};
+
+const uint32_t ATTRIB_DIRECTORY = 0x10;
+const uint32_t ATTRIB_ARCHIVE = 0x20;
+
+// 2024-01-01 00:00:00 UTC as a FILETIME
+const uint64_t FIXTURE_TIME = 133485408000000000ull;
+
+// Password of the encrypted fixture, and its key derivation cost: 2^19
+// SHA-256 rounds, what 7-Zip writes
+const char16_t FIXTURE_PASSWORD[] = u"SevenZipView";
+const unsigned FIXTURE_CYCLES_POWER = 19;
+
+enum class Method { Copy, Lzma, Lzma2 };
+enum class Filter { None, X86, Arm, Arm64, Delta };
+
+// How one solid block is packed
+struct BlockOptions {
+    Method Main = Method::Lzma2;
+    Filter Pre = Filter::None;
+    uint32_t DeltaDistance = 4;
+    uint32_t Level = 1;                 // liblzma preset
+    uint32_t DictionarySize = 0;        // 0 = the preset's
+    bool Encrypt = false;               // 7zAES over the packed stream
+    uint32_t SaltSize = 0;              // Key derivation salt, 0-16 bytes
+};
+
+// xorshift64*: fast, and the same sequence on every platform
+class Random {
+public:
+    explicit Random(uint64_t seed) : _State(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint64_t Next() {
+        _State ^= _State >> 12;
+        _State ^= _State << 25;
+        _State ^= _State >> 27;
+        return _State * 0x2545F4914F6CDD1Dull;
+    }
+
+    // Uniform in [low, high]
+    uint32_t Range(uint32_t low, uint32_t high) {
+        return low + (uint32_t)(Next() % ((uint64_t)high - low + 1));
+    }
+
+private:
+    uint64_t _State;
+};
+
+// Content generators, each roughly like a kind of file found in archives
+void FillText(Random& random, std::vector<unsigned char>& data, size_t size) {
+    static const char* const words[] = {
+        "archive", "block", "stream", "folder", "entry", "header", "decode", "window",
+        "shell", "index", "cache", "table", "path", "size", "the", "of", "and", "to",
+        "in", "is", "for", "with", "SevenZipView", "Explorer", "return", "const",
+        "UINT32", "std::vector", "buffer", "if", "else", "while", "namespace",
+    };
+    const size_t wordCount = sizeof(words) / sizeof(words[0]);
+
+    data.resize(size);
+    size_t pos = 0, column = 0;
+    while (pos < size) {
+        const char* word = words[random.Next() % wordCount];
+        for (const char* c = word; *c && pos < size; c++) data[pos++] = (unsigned char)*c;
+        column += strlen(word) + 1;
+        if (pos < size) data[pos++] = (column > 72) ? '\n' : ' ';
+        if (column > 72) column = 0;
+    }
+}
+
+void FillBinary(Random& random, std::vector<unsigned char>& data, size_t size) {
+    data.resize(size);
+    for (size_t i = 0; i < size; i++) data[i] = (unsigned char)random.Next();
+}
+
+// Byte soup with x86 CALL (E8) or ARM BL instructions to a small set of
+// targets, the case branch filters turn into repeats
+void FillCode(Random& random, std::vector<unsigned char>& data, size_t size, Filter filter) {
+    uint32_t targets[64];
+    for (uint32_t& t : targets) t = random.Range(0, (uint32_t)size) & ~3u;
+
+    data.resize(size);
+    size_t pos = 0;
+    while (pos + 8 <= size) {
+        uint32_t target = targets[random.Next() % 64];
+        uint32_t r = random.Range(0, 7);
+        if (filter == Filter::X86 && r < 2) {
+            uint32_t rel = target - (uint32_t)(pos + 5);
+            data[pos++] = 0xE8;
+            for (int i = 0; i < 4; i++) data[pos++] = (unsigned char)(rel >> (8 * i));
+        } else if (filter == Filter::Arm && r < 2) {
+            uint32_t offset = ((target - (uint32_t)(pos + 8)) >> 2) & 0xFFFFFF;
+            uint32_t insn = 0xEB000000 | offset;
+            for (int i = 0; i < 4; i++) data[pos++] = (unsigned char)(insn >> (8 * i));
+        } else if (filter == Filter::Arm64 && r < 2) {
+            uint32_t offset = ((target - (uint32_t)pos) >> 2) & 0x3FFFFFF;
+            uint32_t insn = 0x94000000 | offset;
+            for (int i = 0; i < 4; i++) data[pos++] = (unsigned char)(insn >> (8 * i));
+        } else {
+            // Common opcodes with small operands
+            static const unsigned char ops[] = { 0x48, 0x89, 0x8B, 0x83, 0xC3, 0x0F, 0x85, 0x74, 0x00, 0xFF };
+            for (int i = 0; i < 4; i++) data[pos++] = ops[random.Next() % sizeof(ops)];
+        }
+    }
+    while (pos < size) data[pos++] = 0x90;
+}
+
+// 16-bit stereo samples: a smooth wave plus a little noise, for Delta
+void FillAudio(Random& random, std::vector<unsigned char>& data, size_t size) {
+    data.resize(size);
+    int32_t left = 0, right = 0, velocity = 40;
+    for (size_t pos = 0; pos + 4 <= size; pos += 4) {
+        if ((pos & 0xFFF) == 0) velocity = (int32_t)random.Range(0, 160) - 80;
+        left = (left + velocity + (int32_t)random.Range(0, 6) - 3) & 0xFFFF;
+        right = (right + velocity / 2 + (int32_t)random.Range(0, 6) - 3) & 0xFFFF;
+        data[pos] = (unsigned char)left;
+        data[pos + 1] = (unsigned char)(left >> 8);
+        data[pos + 2] = (unsigned char)right;
+        data[pos + 3] = (unsigned char)(right >> 8);
+    }
+}
+
+// Header bytes in 7z encoding
+class HeaderBuffer {
+public:
+    void Byte(unsigned char b) { _Data.push_back(b); }
+
+    void Bytes(const void* data, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        _Data.insert(_Data.end(), p, p + size);
+    }
+
+    void UInt32(uint32_t value) {
+        for (int i = 0; i < 4; i++) Byte((unsigned char)(value >> (8 * i)));
+    }
+
+    void UInt64(uint64_t value) {
+        for (int i = 0; i < 8; i++) Byte((unsigned char)(value >> (8 * i)));
+    }
+
+    // 7z NUMBER: leading one bits of the first byte count the extra bytes
+    void Number(uint64_t value) {
+        unsigned char first = 0, mask = 0x80;
+        int extra;
+        for (extra = 0; extra < 8; extra++) {
+            if (value < (1ull << (7 * (extra + 1)))) {
+                first |= (unsigned char)(value >> (8 * extra));
+                break;
+            }
+            first |= mask;
+            mask >>= 1;
+        }
+        Byte(first);
+        for (int i = 0; i < extra; i++) Byte((unsigned char)(value >> (8 * i)));
+    }
+
+    // Bit vector, most significant bit first
+    void Bits(const std::vector<bool>& bits) {
+        unsigned char b = 0, mask = 0x80;
+        for (bool bit : bits) {
+            if (bit) b |= mask;
+            mask >>= 1;
+            if (!mask) {
+                Byte(b);
+                b = 0;
+                mask = 0x80;
+            }
+        }
+        if (mask != 0x80) Byte(b);
+    }
+
+    const std::vector<unsigned char>& Data() const { return _Data; }
+    size_t Size() const { return _Data.size(); }
+
+private:
+    std::vector<unsigned char> _Data;
+};
+
+// Minimal 7z writer: solid blocks of one main coder, at most one filter and
+// optionally 7zAES, packed sizes and CRCs, names, times and attributes,
+// LZMA-packed header
+class SevenZipWriter {
+public:
+    ~SevenZipWriter() {
+        lzma_end(&_Stream);
+        if (_File) fclose(_File);
+    }
+
+    bool Open(const std::filesystem::path& path) {
+        _File = fopen(path.string().c_str(), "wb");
+        if (!_File) return false;
+
+        // Signature header goes in last, once the header position is known
+        unsigned char placeholder[32] = {};
+        return fwrite(placeholder, 1, sizeof(placeholder), _File) == sizeof(placeholder);
+    }
+
+    bool BeginBlock(const BlockOptions& options) {
+        Block block;
+        block.Options = options;
+        _Blocks.push_back(block);
+        if (options.Encrypt && !StartCipher(_Blocks.back())) return false;
+        if (options.Main == Method::Copy) return options.Pre == Filter::None;
+        return StartEncoder(options, &_Blocks.back().Props);
+    }
+
+    // Append a file to the open block
+    bool AddFile(const std::u16string& name, const std::vector<unsigned char>& data) {
+        if (data.empty()) return AddEmptyFile(name);
+
+        Block& block = _Blocks.back();
+        Entry entry;
+        entry.Name = name;
+        entry.HasStream = true;
+        entry.Size = data.size();
+        entry.Crc = CrcCalc(data.data(), data.size());
+        _Entries.push_back(entry);
+
+        block.Files++;
+        block.Sizes.push_back(data.size());
+        block.Crcs.push_back(entry.Crc);
+        block.UnpackSize += data.size();
+        block.Crc = CrcUpdate(block.Crc, data.data(), data.size());
+        return Pack(data.data(), data.size());
+    }
+
+    bool EndBlock() {
+        Block& block = _Blocks.back();
+        block.Crc ^= 0xFFFFFFFF;
+        if (!Finish()) return false;
+        if (_Ciphering) {
+            if (!EncryptPending()) return false;
+            _Ciphering = false;
+            block.PlainPackSize = _PlainPacked;
+        }
+        block.PackSize = _Packed - _BlockStart;
+        _BlockStart = _Packed;
+
+        // A block without files would not be valid
+        if (block.Files == 0) _Blocks.pop_back();
+        return true;
+    }
+
+    bool AddEmptyFile(const std::u16string& name) {
+        Entry entry;
+        entry.Name = name;
+        _Entries.push_back(entry);
+        return true;
+    }
+
+    bool AddDirectory(const std::u16string& name) {
+        Entry entry;
+        entry.Name = name;
+        entry.IsDirectory = true;
+        _Entries.push_back(entry);
+        return true;
+    }
+
+    // Write the header, packed with LZMA, and the signature header
+    bool Close() {
+        HeaderBuffer header;
+        WriteHeader(header);
+
+        BlockOptions headerOptions;
+        headerOptions.Main = Method::Lzma;
+        headerOptions.Level = 5;
+        Block packed;
+        packed.Options = headerOptions;
+        packed.Files = 1;
+        packed.UnpackSize = header.Size();
+        packed.Crc = CrcCalc(header.Data().data(), header.Size());
+
+        uint64_t packPos = _Packed;
+        if (!StartEncoder(headerOptions, &packed.Props) ||
+            !Pack(header.Data().data(), header.Size()) || !Finish()) return false;
+        packed.PackSize = _Packed - packPos;
+
+        HeaderBuffer encoded;
+        encoded.Byte(ID_ENCODED_HEADER);
+        WriteStreamsInfo(encoded, packPos, std::vector<Block>(1, packed), false);
+
+        if (fwrite(encoded.Data().data(), 1, encoded.Size(), _File) != encoded.Size()) return false;
+
+        HeaderBuffer start;
+        start.UInt64(_Packed);
+        start.UInt64(encoded.Size());
+        start.UInt32(CrcCalc(encoded.Data().data(), encoded.Size()));
+
+        HeaderBuffer signature;
+        const unsigned char magic[] = { '7', 'z', 0xBC, 0xAF, 0x27, 0x1C, 0, 4 };
+        signature.Bytes(magic, sizeof(magic));
+        signature.UInt32(CrcCalc(start.Data().data(), start.Size()));
+        signature.Bytes(start.Data().data(), start.Size());
+
+        bool ok = fseek(_File, 0, SEEK_SET) == 0 &&
+            fwrite(signature.Data().data(), 1, signature.Size(), _File) == signature.Size();
+        ok = (fclose(_File) == 0) && ok;
+        _File = nullptr;
+        return ok;
+    }
+
+    size_t GetEntryCount() const { return _Entries.size(); }
+    uint64_t GetPackedSize() const { return _Packed; }
+
+private:
+    struct Entry {
+        std::u16string Name;
+        bool IsDirectory = false;
+        bool HasStream = false;
+        uint64_t Size = 0;
+        uint32_t Crc = 0;
+    };
+
+    struct Block {
+        BlockOptions Options;
+        std::vector<unsigned char> Props;
+        std::vector<unsigned char> CipherProps;
+        uint32_t Files = 0;
+        std::vector<uint64_t> Sizes;
+        std::vector<uint32_t> Crcs;
+        uint64_t UnpackSize = 0;
+        uint64_t PackSize = 0;
+        uint64_t PlainPackSize = 0;     // Main coder's input, before encryption
+        uint32_t Crc = 0xFFFFFFFF;      // Running until EndBlock
+    };
+
+    static std::vector<unsigned char> MethodId(Method method) {
+        switch (method) {
+        case Method::Copy:  return { 0x00 };
+        case Method::Lzma:  return { 0x03, 0x01, 0x01 };
+        default:            return { 0x21 };
+        }
+    }
+
+    static std::vector<unsigned char> FilterId(Filter filter) {
+        switch (filter) {
+        case Filter::X86:   return { 0x03, 0x03, 0x01, 0x03 };
+        case Filter::Arm:   return { 0x03, 0x03, 0x05, 0x01 };
+        case Filter::Arm64: return { 0x0A };
+        default:            return { 0x03 };
+        }
+    }
+
+    bool StartEncoder(const BlockOptions& options, std::vector<unsigned char>* props) {
+        if (lzma_lzma_preset(&_Lzma, options.Level)) return false;
+        if (options.DictionarySize) _Lzma.dict_size = options.DictionarySize;
+
+        lzma_filter filters[3];
+        size_t count = 0;
+        switch (options.Pre) {
+        case Filter::X86:   filters[count++] = { LZMA_FILTER_X86, nullptr }; break;
+        case Filter::Arm:   filters[count++] = { LZMA_FILTER_ARM, nullptr }; break;
+        case Filter::Arm64: filters[count++] = { LZMA_FILTER_ARM64, nullptr }; break;
+        case Filter::Delta:
+            _Delta.type = LZMA_DELTA_TYPE_BYTE;
+            _Delta.dist = options.DeltaDistance;
+            filters[count++] = { LZMA_FILTER_DELTA, &_Delta };
+            break;
+        default: break;
+        }
+
+        // 7z LZMA streams end at the stored size, without an end marker
+        filters[count++] = { options.Main == Method::Lzma ? LZMA_FILTER_LZMA1EXT : LZMA_FILTER_LZMA2, &_Lzma };
+        filters[count] = { LZMA_VLI_UNKNOWN, nullptr };
+        _Lzma.ext_flags = 0;
+        lzma_set_ext_size(_Lzma, UINT64_MAX);
+
+        if (options.Main == Method::Lzma) {
+            props->push_back((unsigned char)((_Lzma.pb * 5 + _Lzma.lp) * 9 + _Lzma.lc));
+            for (int i = 0; i < 4; i++) props->push_back((unsigned char)(_Lzma.dict_size >> (8 * i)));
+        } else {
+            // LZMA2 dictionary byte: the smallest (2 | (p & 1)) << (p / 2 + 11) that fits
+            unsigned char p = 0;
+            while (p < 40 && ((uint64_t)(2 | (p & 1)) << (p / 2 + 11)) < _Lzma.dict_size) p++;
+            props->push_back(p);
+        }
+
+        _Encoding = true;
+        return lzma_raw_encoder(&_Stream, filters) == LZMA_OK;
+    }
+
+    // 7zAES key: SHA-256 over salt, UTF-16LE password and a 64-bit counter,
+    // 2^FIXTURE_CYCLES_POWER times. Written out here instead of calling
+    // AesKeyCache, so the suite checks one against the other.
+    static void DeriveKey(const unsigned char* salt, uint32_t saltSize, unsigned char* key) {
+        std::vector<unsigned char> message(salt, salt + saltSize);
+        for (const char16_t* p = FIXTURE_PASSWORD; *p; p++) {
+            message.push_back((unsigned char)*p);
+            message.push_back((unsigned char)(*p >> 8));
+        }
+        size_t counter = message.size();
+        message.resize(counter + 8);
+
+        CSha256 sha;
+        Sha256_Init(&sha);
+        for (uint64_t round = 0; round < (1ull << FIXTURE_CYCLES_POWER); round++) {
+            for (int i = 0; i < 8; i++) message[counter + i] = (unsigned char)(round >> (8 * i));
+            Sha256_Update(&sha, message.data(), message.size());
+        }
+        Sha256_Final(&sha, key);
+    }
+
+    // Salt and IV come from a generator seeded by the block number, so
+    // encrypted archives are byte-identical between runs too
+    bool StartCipher(Block& block) {
+        uint32_t saltSize = block.Options.SaltSize;
+        if (saltSize > 16) return false;
+
+        Random random(_Blocks.size());
+        unsigned char salt[16], iv[AES_BLOCK_SIZE];
+        for (unsigned char& b : salt) b = (unsigned char)random.Next();
+        for (unsigned char& b : iv) b = (unsigned char)random.Next();
+
+        std::vector<unsigned char>& props = block.CipherProps;
+        props.push_back((unsigned char)(FIXTURE_CYCLES_POWER | 0x40 | (saltSize ? 0x80 : 0)));
+        props.push_back((unsigned char)((saltSize ? (saltSize - 1) << 4 : 0) | (AES_BLOCK_SIZE - 1)));
+        props.insert(props.end(), salt, salt + saltSize);
+        props.insert(props.end(), iv, iv + AES_BLOCK_SIZE);
+
+        unsigned char key[32];
+        DeriveKey(salt, saltSize, key);
+        Aes_SetKey_Enc(_Aes + 4, key, sizeof(key));
+        AesCbc_Init(_Aes, iv);
+        _Ciphering = true;
+        _PendingSize = 0;
+        _PlainPacked = 0;
+        return true;
+    }
+
+    // Packed bytes go to the file, through the cipher while one is on
+    bool Output(const unsigned char* data, size_t size) {
+        if (!_Ciphering) {
+            if (fwrite(data, 1, size, _File) != size) return false;
+            _Packed += size;
+            return true;
+        }
+
+        _PlainPacked += size;
+        while (size > 0) {
+            size_t part = (std::min)(size, sizeof(_Pending) - _PendingSize);
+            memcpy(_Pending + _PendingSize, data, part);
+            _PendingSize += part;
+            data += part;
+            size -= part;
+            if (_PendingSize == sizeof(_Pending) && !EncryptPending()) return false;
+        }
+        return true;
+    }
+
+    // Encrypt and write the pending bytes, zero-padded to whole AES blocks
+    bool EncryptPending() {
+        size_t size = (_PendingSize + AES_BLOCK_SIZE - 1) & ~(size_t)(AES_BLOCK_SIZE - 1);
+        memset(_Pending + _PendingSize, 0, size - _PendingSize);
+        AesCbc_Encode(_Aes, _Pending, size / AES_BLOCK_SIZE);
+        _PendingSize = 0;
+        if (fwrite(_Pending, 1, size, _File) != size) return false;
+        _Packed += size;
+        return true;
+    }
+
+    bool Pack(const unsigned char* data, size_t size) {
+        if (!_Encoding) return Output(data, size);
+
+        _Stream.next_in = data;
+        _Stream.avail_in = size;
+        while (_Stream.avail_in > 0) {
+            if (!Drain(LZMA_RUN)) return false;
+        }
+        return true;
+    }
+
+    bool Finish() {
+        if (!_Encoding) return true;
+        _Encoding = false;
+        for (;;) {
+            lzma_ret ret;
+            if (!Drain(LZMA_FINISH, &ret)) return false;
+            if (ret == LZMA_STREAM_END) return true;
+        }
+    }
+
+    bool Drain(lzma_action action, lzma_ret* result = nullptr) {
+        unsigned char out[1 << 16];
+        _Stream.next_out = out;
+        _Stream.avail_out = sizeof(out);
+        lzma_ret ret = lzma_code(&_Stream, action);
+        if (ret != LZMA_OK && ret != LZMA_STREAM_END) return false;
+
+        if (!Output(out, sizeof(out) - _Stream.avail_out)) return false;
+        if (result) *result = ret;
+        return true;
+    }
+
+    void WriteFolder(HeaderBuffer& h, const Block& block) {
+        // Main coder first; a filter takes its output (bond: in 1 <- out 0)
+        // and 7zAES, last, feeds its input from the pack stream
+        bool filtered = block.Options.Pre != Filter::None;
+        bool encrypted = block.Options.Encrypt;
+        unsigned coders = 1 + (filtered ? 1 : 0) + (encrypted ? 1 : 0);
+        h.Number(coders);
+
+        std::vector<unsigned char> id = MethodId(block.Options.Main);
+        h.Byte((unsigned char)(id.size() | (block.Props.empty() ? 0 : 0x20)));
+        h.Bytes(id.data(), id.size());
+        if (!block.Props.empty()) {
+            h.Number(block.Props.size());
+            h.Bytes(block.Props.data(), block.Props.size());
+        }
+
+        if (filtered) {
+            id = FilterId(block.Options.Pre);
+            bool delta = block.Options.Pre == Filter::Delta;
+            h.Byte((unsigned char)(id.size() | (delta ? 0x20 : 0)));
+            h.Bytes(id.data(), id.size());
+            if (delta) {
+                h.Number(1);
+                h.Byte((unsigned char)(block.Options.DeltaDistance - 1));
+            }
+        }
+
+        if (encrypted) {
+            const unsigned char aesId[] = { 0x06, 0xF1, 0x07, 0x01 };
+            h.Byte((unsigned char)(sizeof(aesId) | 0x20));
+            h.Bytes(aesId, sizeof(aesId));
+            h.Number(block.CipherProps.size());
+            h.Bytes(block.CipherProps.data(), block.CipherProps.size());
+        }
+
+        if (filtered) {
+            h.Number(1);
+            h.Number(0);
+        }
+        if (encrypted) {
+            h.Number(0);
+            h.Number(coders - 1);
+        }
+    }
+
+    void WriteStreamsInfo(HeaderBuffer& h, uint64_t packPos, const std::vector<Block>& blocks, bool substreams) {
+        h.Byte(ID_PACK_INFO);
+        h.Number(packPos);
+        h.Number(blocks.size());
+        h.Byte(ID_SIZE);
+        for (const Block& block : blocks) h.Number(block.PackSize);
+        h.Byte(ID_END);
+
+        h.Byte(ID_UNPACK_INFO);
+        h.Byte(ID_FOLDER);
+        h.Number(blocks.size());
+        h.Byte(0);
+        for (const Block& block : blocks) WriteFolder(h, block);
+        h.Byte(ID_CODERS_UNPACK_SIZE);
+        for (const Block& block : blocks) {
+            h.Number(block.UnpackSize);
+            if (block.Options.Pre != Filter::None) h.Number(block.UnpackSize);
+            if (block.Options.Encrypt) h.Number(block.PlainPackSize);
+        }
+        h.Byte(ID_CRC);
+        h.Byte(1);
+        for (const Block& block : blocks) h.UInt32(block.Crc);
+        h.Byte(ID_END);
+
+        if (substreams) {
+            // Blocks of one file are covered by the block CRC above
+            h.Byte(ID_SUBSTREAMS_INFO);
+            h.Byte(ID_NUM_UNPACK_STREAM);
+            for (const Block& block : blocks) h.Number(block.Files);
+            h.Byte(ID_SIZE);
+            for (const Block& block : blocks) {
+                for (uint32_t i = 0; i + 1 < block.Files; i++) h.Number(block.Sizes[i]);
+            }
+            h.Byte(ID_CRC);
+            h.Byte(1);
+            for (const Block& block : blocks) {
+                if (block.Files == 1) continue;
+                for (uint32_t crc : block.Crcs) h.UInt32(crc);
+            }
+            h.Byte(ID_END);
+        }
+
+        h.Byte(ID_END);
+    }
+
+    void WriteHeader(HeaderBuffer& h) {
+        h.Byte(ID_HEADER);
+        if (!_Blocks.empty()) {
+            h.Byte(ID_MAIN_STREAMS_INFO);
+            WriteStreamsInfo(h, 0, _Blocks, true);
+        }
+
+        size_t count = _Entries.size();
+        h.Byte(ID_FILES_INFO);
+        h.Number(count);
+
+        std::vector<bool> emptyStream, emptyFile;
+        bool anyEmpty = false, anyEmptyFile = false;
+        for (const Entry& e : _Entries) {
+            emptyStream.push_back(!e.HasStream);
+            if (!e.HasStream) {
+                anyEmpty = true;
+                emptyFile.push_back(!e.IsDirectory);
+                anyEmptyFile = anyEmptyFile || !e.IsDirectory;
+            }
+        }
+        if (anyEmpty) {
+            h.Byte(ID_EMPTY_STREAM);
+            h.Number((emptyStream.size() + 7) / 8);
+            h.Bits(emptyStream);
+            if (anyEmptyFile) {
+                h.Byte(ID_EMPTY_FILE);
+                h.Number((emptyFile.size() + 7) / 8);
+                h.Bits(emptyFile);
+            }
+        }
+
+        uint64_t namesSize = 1;
+        for (const Entry& e : _Entries) namesSize += (e.Name.size() + 1) * 2;
+        h.Byte(ID_NAME);
+        h.Number(namesSize);
+        h.Byte(0);
+        for (const Entry& e : _Entries) {
+            for (char16_t c : e.Name) {
+                h.Byte((unsigned char)c);
+                h.Byte((unsigned char)(c >> 8));
+            }
+            h.Byte(0);
+            h.Byte(0);
+        }
+
+        h.Byte(ID_MTIME);
+        h.Number(2 + 8 * (uint64_t)count);
+        h.Byte(1);
+        h.Byte(0);
+        for (size_t i = 0; i < count; i++) h.UInt64(FIXTURE_TIME + i * 10000000ull);
+
+        h.Byte(ID_WIN_ATTRIB);
+        h.Number(2 + 4 * (uint64_t)count);
+        h.Byte(1);
+        h.Byte(0);
+        for (const Entry& e : _Entries) h.UInt32(e.IsDirectory ? ATTRIB_DIRECTORY : ATTRIB_ARCHIVE);
+
+        h.Byte(ID_END);
+        h.Byte(ID_END);
+    }
+
+    FILE* _File = nullptr;
+    lzma_stream _Stream = LZMA_STREAM_INIT;
+    lzma_options_lzma _Lzma = {};
+    lzma_options_delta _Delta = {};
+    bool _Encoding = false;
+    bool _Ciphering = false;
+    alignas(16) UInt32 _Aes[AES_NUM_IVMRK_WORDS] = {};
+    alignas(16) unsigned char _Pending[1 << 16];
+    size_t _PendingSize = 0;
+    uint64_t _PlainPacked = 0;          // Bytes into the cipher this block
+    uint64_t _Packed = 0;               // Bytes after the signature header
+    uint64_t _BlockStart = 0;
+    std::vector<Block> _Blocks;
+    std::vector<Entry> _Entries;
+};
+
+std::u16string Name(const std::string& ascii) {
+    return std::u16string(ascii.begin(), ascii.end());
+}
+
+std::string Format(const char* format, unsigned value) {
+    char text[64];
+    snprintf(text, sizeof(text), format, value);
+    return text;
+}
+
+struct FixtureSettings {
+    double Scale = 1.0;
+    uint32_t Level = 1;
+
+    uint32_t Count(uint32_t count) const {
+        double scaled = count * Scale;
+        return scaled < 1.0 ? 1 : (uint32_t)scaled;
+    }
+};
+
+// Files are split into solid blocks of about blockSize bytes
+class BlockSplitter {
+public:
+    BlockSplitter(SevenZipWriter& writer, const BlockOptions& options, uint64_t blockSize)
+        : _Writer(writer), _Options(options), _BlockSize(blockSize) {}
+
+    bool Add(const std::u16string& name, const std::vector<unsigned char>& data) {
+        if (data.empty()) return _Writer.AddEmptyFile(name);
+        if (!_Open) {
+            if (!_Writer.BeginBlock(_Options)) return false;
+            _Open = true;
+            _Filled = 0;
+        }
+        if (!_Writer.AddFile(name, data)) return false;
+        _Filled += data.size();
+        return _Filled < _BlockSize || Close();
+    }
+
+    bool Close() {
+        if (!_Open) return true;
+        _Open = false;
+        return _Writer.EndBlock();
+    }
+
+private:
+    SevenZipWriter& _Writer;
+    BlockOptions _Options;
+    uint64_t _BlockSize;
+    uint64_t _Filled = 0;
+    bool _Open = false;
+};
+
+bool WriteTinyFiles(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(1);
+    BlockOptions options;
+    options.Level = settings.Level;
+    BlockSplitter blocks(writer, options, 16u << 20);
+
+    uint32_t folders = settings.Count(500), files = settings.Count(50000);
+    std::vector<unsigned char> data;
+    for (uint32_t f = 0; f < folders; f++) {
+        std::string folder = Format("docs/section-%03u", f / 25) + Format("/topic-%04u", f);
+        if (f % 25 == 0) writer.AddDirectory(Name(Format("docs/section-%03u", f / 25)));
+        writer.AddDirectory(Name(folder));
+
+        uint32_t begin = (uint32_t)((uint64_t)files * f / folders);
+        uint32_t end = (uint32_t)((uint64_t)files * (f + 1) / folders);
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t size = (random.Range(0, 19) == 0) ? 0 : random.Range(1, 2048);
+            FillText(random, data, size);
+            if (!blocks.Add(Name(folder + Format("/note-%06u.txt", i)), data)) return false;
+        }
+    }
+    if (!writer.AddDirectory(u"docs")) return false;
+    return blocks.Close();
+}
+
+bool WriteHugeSolid(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(2);
+    BlockOptions options;
+    options.Level = settings.Level;
+    options.DictionarySize = 16u << 20;
+    if (!writer.BeginBlock(options)) return false;
+
+    // 256 MB as 32 files of 8 MB, one in four incompressible
+    uint32_t fileSize = settings.Count(8u << 20);
+    std::vector<unsigned char> data;
+    for (uint32_t i = 0; i < 32; i++) {
+        if (i % 4 == 3) FillBinary(random, data, fileSize);
+        else FillText(random, data, fileSize);
+        if (!writer.AddFile(Name(Format("data/part-%02u.bin", i)), data)) return false;
+    }
+    return writer.AddDirectory(u"data") && writer.EndBlock();
+}
+
+bool AddTreeLevel(SevenZipWriter& writer, Random& random, std::vector<unsigned char>& data,
+                  const std::string& path, uint32_t depth, uint32_t fileSize) {
+    if (!writer.AddDirectory(Name(path))) return false;
+    for (uint32_t i = 0; i < 2; i++) {
+        FillText(random, data, random.Range(fileSize / 2, fileSize));
+        if (!writer.AddFile(Name(path + Format("/file-%u.txt", i)), data)) return false;
+    }
+    if (depth == 0) return true;
+    for (uint32_t i = 0; i < 3; i++) {
+        if (!AddTreeLevel(writer, random, data, path + Format("/branch-%u", i), depth - 1, fileSize)) return false;
+    }
+    return true;
+}
+
+bool WriteDeepTree(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(3);
+    BlockOptions options;
+    options.Level = settings.Level;
+    if (!writer.BeginBlock(options)) return false;
+
+    // Full 3-way tree of 1,093 folders, then chains of 32 levels whose
+    // paths stay under MAX_PATH once extracted
+    std::vector<unsigned char> data;
+    uint32_t fileSize = settings.Count(4096);
+    if (!AddTreeLevel(writer, random, data, "tree", 6, fileSize)) return false;
+
+    uint32_t chains = settings.Count(16);
+    for (uint32_t c = 0; c < chains; c++) {
+        std::string path = Format("chains/chain-%02u", c);
+        if (!writer.AddDirectory(Name(path))) return false;
+        for (uint32_t level = 0; level < 32; level++) {
+            path += Format("/d%02u", level);
+            if (!writer.AddDirectory(Name(path))) return false;
+            FillText(random, data, random.Range(1, fileSize));
+            if (!writer.AddFile(Name(path + "/leaf.txt"), data)) return false;
+        }
+    }
+
+    // A few names outside ASCII
+    const char16_t* names[] = { u"chains/résumé.txt", u"chains/文件.txt", u"chains/über.txt" };
+    for (const char16_t* name : names) {
+        FillText(random, data, 512);
+        if (!writer.AddFile(name, data)) return false;
+    }
+    return writer.AddDirectory(u"tree") && writer.AddDirectory(u"chains") && writer.EndBlock();
+}
+
+bool WriteMillionEntries(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(4);
+    BlockOptions options;
+    options.Level = settings.Level;
+    BlockSplitter blocks(writer, options, 16u << 20);
+
+    // 16 x 64 folders of 1,024 files
+    uint32_t files = settings.Count(1024);
+    std::vector<unsigned char> data;
+    for (uint32_t top = 0; top < 16; top++) {
+        std::string topPath = Format("set-%02u", top);
+        if (!writer.AddDirectory(Name(topPath))) return false;
+        for (uint32_t sub = 0; sub < 64; sub++) {
+            std::string subPath = topPath + Format("/group-%02u", sub);
+            if (!writer.AddDirectory(Name(subPath))) return false;
+            for (uint32_t i = 0; i < files; i++) {
+                FillText(random, data, random.Range(0, 64));
+                if (!blocks.Add(Name(subPath + Format("/item-%05u.txt", i)), data)) return false;
+            }
+        }
+    }
+    return blocks.Close();
+}
+
+bool WriteMixedFilters(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(5);
+    struct Kind {
+        const char* Folder;
+        Method Main;
+        Filter Pre;
+        uint32_t Files;
+        uint32_t FileSize;
+    };
+    const Kind kinds[] = {
+        { "x86",    Method::Lzma,  Filter::X86,   8,  1u << 20 },
+        { "audio",  Method::Lzma2, Filter::Delta, 4,  2u << 20 },
+        { "arm",    Method::Lzma,  Filter::Arm,   4,  1u << 20 },
+        { "arm64",  Method::Lzma2, Filter::Arm64, 4,  1u << 20 },
+        { "text",   Method::Lzma2, Filter::None,  16, 512u << 10 },
+        { "stored", Method::Copy,  Filter::None,  4,  1u << 20 },
+        { "log",    Method::Lzma2, Filter::None,  1,  64u << 20 },   // Non-solid, for previews
+    };
+
+    std::vector<unsigned char> data;
+    for (const Kind& kind : kinds) {
+        BlockOptions options;
+        options.Main = kind.Main;
+        options.Pre = kind.Pre;
+        options.Level = settings.Level;
+        if (!writer.BeginBlock(options)) return false;
+
+        uint32_t size = settings.Count(kind.FileSize);
+        for (uint32_t i = 0; i < kind.Files; i++) {
+            switch (kind.Pre) {
+            case Filter::X86:
+            case Filter::Arm:
+            case Filter::Arm64: FillCode(random, data, size, kind.Pre); break;
+            case Filter::Delta: FillAudio(random, data, size); break;
+            default:
+                if (kind.Main == Method::Copy) FillBinary(random, data, size);
+                else FillText(random, data, size);
+                break;
+            }
+            if (!writer.AddFile(Name(std::string(kind.Folder) + Format("/file-%02u.dat", i)), data)) return false;
+        }
+        if (!writer.AddDirectory(Name(kind.Folder)) || !writer.EndBlock()) return false;
+    }
+    return true;
+}
+
+bool WriteEncrypted(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(6);
+    struct Kind {
+        const char* Folder;
+        Method Main;
+        Filter Pre;
+        uint32_t SaltSize;
+        uint32_t Files;
+        uint32_t FileSize;
+    };
+    const Kind kinds[] = {
+        { "text",   Method::Lzma2, Filter::None, 0,  16, 256u << 10 },
+        { "x86",    Method::Lzma,  Filter::X86,  0,  4,  1u << 20 },
+        { "stored", Method::Copy,  Filter::None, 0,  4,  1u << 20 },
+        { "salted", Method::Lzma2, Filter::None, 16, 8,  256u << 10 },
+        { "single", Method::Lzma2, Filter::None, 0,  1,  8u << 20 },    // Non-solid
+    };
+
+    std::vector<unsigned char> data;
+    for (const Kind& kind : kinds) {
+        BlockOptions options;
+        options.Main = kind.Main;
+        options.Pre = kind.Pre;
+        options.Level = settings.Level;
+        options.Encrypt = true;
+        options.SaltSize = kind.SaltSize;
+        if (!writer.BeginBlock(options)) return false;
+
+        // Sizes one byte apart: the stored block is no whole number of AES
+        // blocks, so its last one carries padding
+        for (uint32_t i = 0; i < kind.Files; i++) {
+            uint32_t size = settings.Count(kind.FileSize) + i;
+            if (kind.Pre == Filter::X86) FillCode(random, data, size, kind.Pre);
+            else if (kind.Main == Method::Copy) FillBinary(random, data, size);
+            else FillText(random, data, size);
+            if (!writer.AddFile(Name(std::string(kind.Folder) + Format("/file-%02u.dat", i)), data)) return false;
+        }
+        if (!writer.AddDirectory(Name(kind.Folder)) || !writer.EndBlock()) return false;
+    }
+    return writer.AddEmptyFile(u"empty.txt");
+}
+
+// Whole archive made by write, to be stored in another one
+bool BuildArchive(bool (*write)(SevenZipWriter&, const FixtureSettings&), const FixtureSettings& settings,
+                  const char* name, std::vector<unsigned char>& bytes) {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::temp_directory_path(error) /
+        (std::string("ArchiveFixtures-") + name + ".7z");
+    SevenZipWriter writer;
+    bool ok = writer.Open(path) && write(writer, settings) && writer.Close();
+    if (ok) {
+        FILE* file = fopen(path.string().c_str(), "rb");
+        ok = file != nullptr;
+        if (ok) {
+            bytes.resize((size_t)std::filesystem::file_size(path, error));
+            ok = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+            fclose(file);
+        }
+    }
+    std::filesystem::remove(path, error);
+    return ok;
+}
+
+bool WriteNestedLeaf(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(8);
+    BlockOptions options;
+    options.Level = settings.Level;
+    if (!writer.BeginBlock(options)) return false;
+
+    std::vector<unsigned char> data;
+    for (uint32_t i = 0; i < 8; i++) {
+        FillText(random, data, settings.Count(64u << 10) + i);
+        if (!writer.AddFile(Name(Format("leaf/file-%02u.txt", i)), data)) return false;
+    }
+    return writer.AddDirectory(u"leaf") && writer.EndBlock();
+}
+
+bool WriteNestedMiddle(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(9);
+    std::vector<unsigned char> leaf, data;
+    if (!BuildArchive(WriteNestedLeaf, settings, "leaf", leaf)) return false;
+
+    BlockOptions options;
+    options.Level = settings.Level;
+    if (!writer.BeginBlock(options)) return false;
+    FillText(random, data, settings.Count(256u << 10));
+    if (!writer.AddFile(u"readme.txt", data) || !writer.AddFile(u"inner/leaf.7z", leaf)) return false;
+    return writer.AddDirectory(u"inner") && writer.EndBlock();
+}
+
+bool WriteNested(SevenZipWriter& writer, const FixtureSettings& settings) {
+    Random random(7);
+    std::vector<unsigned char> middle, leaf, data;
+    if (!BuildArchive(WriteNestedMiddle, settings, "middle", middle) ||
+        !BuildArchive(WriteNestedLeaf, settings, "leaf", leaf))
+        return false;
+
+    // The middle archive shares its solid block with other files; the
+    // stored leaf is read straight from the outer file's packed stream
+    BlockOptions options;
+    options.Level = settings.Level;
+    if (!writer.BeginBlock(options)) return false;
+    for (uint32_t i = 0; i < 4; i++) {
+        FillText(random, data, settings.Count(512u << 10));
+        if (!writer.AddFile(Name(Format("archives/notes-%02u.txt", i)), data)) return false;
+    }
+    if (!writer.AddFile(u"archives/middle.7z", middle)) return false;
+    if (!writer.AddDirectory(u"archives") || !writer.EndBlock()) return false;
+
+    options.Main = Method::Copy;
+    if (!writer.BeginBlock(options)) return false;
+    if (!writer.AddFile(u"stored/leaf.7z", leaf)) return false;
+    return writer.AddDirectory(u"stored") && writer.EndBlock();
+}
+
+struct Fixture {
+    const char* Name;
+    bool (*Write)(SevenZipWriter&, const FixtureSettings&);
+};
+
+const Fixture FIXTURES[] = {
+    { "tiny-files",      WriteTinyFiles },
+    { "huge-solid",      WriteHugeSolid },
+    { "deep-tree",       WriteDeepTree },
+    { "million-entries", WriteMillionEntries },
+    { "mixed-filters",   WriteMixedFilters },
+    { "encrypted",       WriteEncrypted },
+    { "nested",          WriteNested },
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* usage =
+        "Usage: ArchiveFixtures <output directory> [--scale <factor>] [--level <0-9>] [--only <fixture>]\n";
+    if (argc >= 2 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        printf("%s", usage);
+        return 0;
+    }
+
+    // An option in place of the directory would become a directory name
+    if (argc < 2 || argv[1][0] == '-') {
+        if (argc >= 2) fprintf(stderr, "Unknown option %s\n", argv[1]);
+        fprintf(stderr, "%s", usage);
+        return 2;
+    }
+
+    std::filesystem::path directory = argv[1];
+    FixtureSettings settings;
+    const char* only = nullptr;
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            fprintf(stderr, "Missing value for %s\n%s", argv[i], usage);
+            return 2;
+        }
+        if (strcmp(argv[i], "--scale") == 0) settings.Scale = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--level") == 0) settings.Level = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--only") == 0) only = argv[i + 1];
+        else {
+            fprintf(stderr, "Unknown option %s\n%s", argv[i], usage);
+            return 2;
+        }
+    }
+    if (settings.Scale <= 0.0 || settings.Level > 9) {
+        fprintf(stderr, "Invalid --scale or --level\n");
+        return 2;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    CrcGenerateTable();
+    AesGenTables();
+    Sha256Prepare();
+
+    bool ok = true;
+    for (const Fixture& fixture : FIXTURES) {
+        if (only && strcmp(only, fixture.Name) != 0) continue;
+
+        std::filesystem::path path = directory / (std::string(fixture.Name) + ".7z");
+        auto start = std::chrono::steady_clock::now();
+        SevenZipWriter writer;
+        if (!writer.Open(path) || !fixture.Write(writer, settings) || !writer.Close()) {
+            fprintf(stderr, "%s: failed to write %s\n", fixture.Name, path.string().c_str());
+            std::filesystem::remove(path, error);
+            ok = false;
+            continue;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%-16s %9zu entries %10.1f MB packed  %6.1f s  %s\n", fixture.Name, writer.GetEntryCount(),
+            writer.GetPackedSize() / (1024.0 * 1024.0), seconds, path.string().c_str());
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,768 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Archive Performance Suite
+**
+** Usage: ArchiveSuite <archive.7z | directory> [--samples n] [--threads n]
+**                     [--csv file] [--no-extract] [--lzma fast|reference]
+**                     [--password text]
+**
+** Runs the operations the shell performs on each archive (every *.7z of a
+** directory, e.g. the output of ArchiveFixtures) and reports latency
+** percentiles and throughput:
+**   open          Archive::Open, index cache off
+**   open cached   Archive::Open served from the index cache
+**   tree          first GetDirectoryIndex (builds the folder hierarchy)
+**   list          GetEntriesInFolder for every folder
+**   item ids      shell item IDs of every folder's children, as Explorer
+**                 enumeration builds them, each read back
+**   first ids     GetEntriesInFolder and the first 64 item IDs of every
+**                 folder, what a first IEnumIDList::Next costs
+**   subtree       FindFolder and GetDescendants of every folder, as
+**                 dragging the folder out expands it
+**   lookup        FindEntry on sampled paths
+**   read          ExtractToBuffer of random files, CRC checked
+**   hash          ExtractToSink of random files into a HashSink, nothing kept
+**   stream        EntryStream of random files read to the end in 64 KB
+**                 reads, as a drop target pulls CFSTR_FILECONTENTS
+**   stream seek   random Seek and Read on EntryStreams, compared with the
+**                 whole file
+**   prefix        ExtractPrefix of the first 16 KB of random files, as a
+**                 preview reads them (block cache emptied first)
+**   drag          ExtractCache::ExtractFiles of random files into a drop
+**                 folder, cache empty: decoded into the cache and linked
+**   drag cached   the same drags again, linked from the cache after its
+**                 checks, the last one after a cached file was altered;
+**                 every dropped file is read back each time
+**   extract       Extractor::Extract of everything to a temp directory,
+**                 every written file read back and CRC checked
+**   test          Extractor::TestArchive
+**   nested        ArchivePool::GetArchive of every archive stored in the
+**                 archive, at any depth, opened from memory as browsing
+**                 into it does
+**   nested read   ExtractToBuffer of every file of those, CRC checked
+**
+** Also printed: allocations per header parse (heap and arena), and how
+** many decoder buffers the BufferPool handed out against how many it had
+** to get from the system.
+**
+** LZMA decodes with the fast loop, as the shell extension does, unless
+** --lzma reference selects the SDK's.
+**
+** Archives with encrypted files are read with --password (ArchiveFixtures
+** uses "SevenZipView"), and skipped without one. For them the suite also
+** prints how many AES keys were derived and how many came from the cache.
+**
+** Exit code 0 when every step succeeded and every result matched.
+*/
+
+#include "EntryStream.h"
+#include "ExtractCache.h"
+#include "Extractor.h"
+#include "ItemId.h"
+#include "LzmaDecodeLoop.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <thread>
+
+using namespace SevenZipView;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::wstring ToWide(const std::filesystem::path& path) {
+#ifdef _WIN32
+    return path.wstring();
+#else
+    return Tootega::XStringConversion::Utf8ToWide(path.string().c_str());
+#endif
+}
+
+// Timings of one step, in seconds
+struct Sample {
+    std::vector<double> Times;
+    UINT64 Bytes = 0;
+    UINT64 Failures = 0;
+
+    double Percentile(double q) {
+        if (Times.empty()) return 0.0;
+        std::sort(Times.begin(), Times.end());
+        size_t i = (size_t)(q * (double)Times.size());
+        return Times[i < Times.size() ? i : Times.size() - 1];
+    }
+
+    double Total() const {
+        double total = 0.0;
+        for (double t : Times) total += t;
+        return total;
+    }
+};
+
+struct SuiteSettings {
+    UINT32 Samples = 5;                 // Opens per mode; reads and lookups scale from it
+    UINT32 Threads = 0;
+    bool Extract = true;
+    LzmaDecodeLoop Lzma = LzmaDecodeLoop::Fast;
+    std::wstring Password;              // For archives with encrypted files
+    FILE* Csv = nullptr;
+};
+
+class Report {
+public:
+    Report(const std::string& archive, FILE* csv) : _Archive(archive), _Csv(csv) {}
+
+    void Add(const char* step, Sample& sample) {
+        double p50 = sample.Percentile(0.50), p90 = sample.Percentile(0.90);
+        double p99 = sample.Percentile(0.99), max = sample.Percentile(1.0);
+        double total = sample.Total();
+        double mbs = (sample.Bytes && total > 0.0) ? sample.Bytes / (1024.0 * 1024.0) / total : 0.0;
+
+        printf("  %-12s %8zu  %10.3f %10.3f %10.3f %10.3f ms", step, sample.Times.size(),
+            p50 * 1e3, p90 * 1e3, p99 * 1e3, max * 1e3);
+        if (mbs > 0.0) printf("  %9.1f MB/s", mbs);
+        if (sample.Failures) printf("  %llu FAILED", (unsigned long long)sample.Failures);
+        printf("\n");
+
+        if (_Csv) {
+            fprintf(_Csv, "%s,%s,%zu,%.6f,%.6f,%.6f,%.6f,%llu,%.3f,%llu\n", _Archive.c_str(), step,
+                sample.Times.size(), p50 * 1e3, p90 * 1e3, p99 * 1e3, max * 1e3,
+                (unsigned long long)sample.Bytes, mbs, (unsigned long long)sample.Failures);
+        }
+        _Failures += sample.Failures;
+    }
+
+    UINT64 GetFailures() const { return _Failures; }
+
+private:
+    std::string _Archive;
+    FILE* _Csv;
+    UINT64 _Failures = 0;
+};
+
+// A file Extract should have written
+struct ExpectedFile {
+    std::filesystem::path Path;         // Relative to the extraction directory
+    UINT64 Size;
+    UINT32 CRC;                         // 0 = not recorded
+};
+
+// Read a written file back; true when its size and CRC match
+bool CheckWrittenFile(const std::filesystem::path& path, const ExpectedFile& expected) {
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file) return false;
+
+    std::vector<BYTE> buffer(256 * 1024);
+    UINT32 crc = CRC_INIT_VAL;
+    UINT64 size = 0;
+    size_t read;
+    while ((read = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        crc = CrcUpdate(crc, buffer.data(), read);
+        size += read;
+    }
+    fclose(file);
+
+    return size == expected.Size && (expected.CRC == 0 || CRC_GET_DIGEST(crc) == expected.CRC);
+}
+
+// Give an archive the suite's password, if it needs one
+void Unlock(Archive& archive, const SuiteSettings& settings) {
+    if (archive.HasEncryptedEntries() && !settings.Password.empty()) archive.SetPassword(settings.Password);
+}
+
+// Open each *.7z entry through the pool by its nested path, read all of
+// its files back, then do the same for the archives inside it
+void OpenNested(const std::wstring& path, const EntryTable& entries, const SuiteSettings& settings,
+                Sample& open, Sample& read) {
+    std::vector<BYTE> buffer;
+    for (UINT32 i = 0; i < entries.GetCount(); i++) {
+        std::wstring name(entries.GetPath(i));
+        if (entries.IsDirectory(i) || name.size() < 3) continue;
+        std::wstring extension = name.substr(name.size() - 3);
+        for (auto& ch : extension) ch = towlower(ch);
+        if (extension != L".7z") continue;
+        for (auto& ch : name) if (ch == L'/') ch = L'\\';
+
+        std::wstring nestedPath = path + L"\\" + name;
+        auto start = Clock::now();
+        std::shared_ptr<Archive> nested = ArchivePool::Instance().GetArchive(nestedPath);
+        open.Times.push_back(SecondsSince(start));
+        if (!nested) {
+            open.Failures++;
+            continue;
+        }
+        Unlock(*nested, settings);
+
+        const EntryTable& inner = nested->GetEntryTable();
+        for (UINT32 j = 0; j < inner.GetCount(); j++) {
+            if (inner.IsDirectory(j)) continue;
+            start = Clock::now();
+            bool ok = nested->ExtractToBuffer(j, buffer);
+            read.Times.push_back(SecondsSince(start));
+            if (!ok || buffer.size() != inner.GetSize(j) ||
+                (inner.GetCRC(j) != 0 && CrcCalc(buffer.data(), buffer.size()) != inner.GetCRC(j))) {
+                read.Failures++;
+                continue;
+            }
+            read.Bytes += buffer.size();
+        }
+        OpenNested(nestedPath, inner, settings, open, read);
+    }
+}
+
+Sample TimeOpen(const std::wstring& path, UINT32 samples) {
+    Sample sample;
+    for (UINT32 i = 0; i < samples; i++) {
+        Archive archive;
+        auto start = Clock::now();
+        bool ok = archive.Open(path);
+        sample.Times.push_back(SecondsSince(start));
+        if (!ok) sample.Failures++;
+    }
+    return sample;
+}
+
+bool RunArchive(const std::filesystem::path& file, const SuiteSettings& settings,
+                const std::filesystem::path& scratch, UINT64& failures) {
+    std::wstring path = ToWide(file);
+    std::string name = file.filename().string();
+    Report report(name, settings.Csv);
+    IndexCache& indexCache = IndexCache::Instance();
+    BlockCache::Instance().Clear();
+
+    // Open, parsing the header each time
+    indexCache.SetEnabled(false);
+    SdkAllocStats heapBefore = GetHeapAllocStats();
+    SdkAllocStats arenaBefore = SdkArena::GetTotalStats();
+    Sample open = TimeOpen(path, settings.Samples);
+    SdkAllocStats heapAfter = GetHeapAllocStats();
+    SdkAllocStats arenaAfter = SdkArena::GetTotalStats();
+
+    Archive archive;
+    if (!archive.Open(path)) {
+        fprintf(stderr, "%s: cannot open\n", name.c_str());
+        failures++;
+        return false;
+    }
+    if (archive.HasEncryptedEntries() && settings.Password.empty()) {
+        printf("%s: %u encrypted files, skipped without --password\n\n", name.c_str(),
+            archive.GetEntryTable().GetEncryptedCount());
+        return false;
+    }
+    Unlock(archive, settings);
+    const EntryTable& entries = archive.GetEntryTable();
+    printf("%s: %u entries, %u files, %.1f MB unpacked\n", name.c_str(), entries.GetCount(),
+        archive.GetFileCount(), archive.GetTotalUncompressedSize() / (1024.0 * 1024.0));
+    printf("  %-12s %8s  %10s %10s %10s %10s\n", "step", "count", "p50", "p90", "p99", "max");
+    report.Add("open", open);
+    if (!open.Times.empty()) {
+        double opens = (double)open.Times.size();
+        printf("  %-12s %.0f header allocations, %.0f temp allocations in %.0f arena blocks per open\n", "",
+            (heapAfter.Requests - heapBefore.Requests) / opens,
+            (arenaAfter.Requests - arenaBefore.Requests) / opens,
+            (arenaAfter.SystemAllocations - arenaBefore.SystemAllocations) / opens);
+    }
+    SdkAllocStats poolBefore = BufferPool::Instance().GetStats();
+
+    // Open, served from the index cache: the first open stores the entry
+    indexCache.SetDirectory(ToWide(scratch / "index-cache"));
+    indexCache.SetMinEntries(0);
+    indexCache.SetEnabled(true);
+    indexCache.Clear();
+    Sample cached = TimeOpen(path, settings.Samples + 1);
+    cached.Times.erase(cached.Times.begin());
+    report.Add("open cached", cached);
+    indexCache.Clear();
+    indexCache.SetEnabled(false);
+
+    // Folder hierarchy, built on first use
+    Sample tree;
+    auto start = Clock::now();
+    const DirectoryIndex& directory = archive.GetDirectoryIndex();
+    tree.Times.push_back(SecondsSince(start));
+    if (!directory.IsBuilt()) tree.Failures++;
+    report.Add("tree", tree);
+
+    // List every folder, as browsing the whole archive would
+    std::vector<std::wstring> folders(1);
+    std::vector<UINT32> files;
+    for (UINT32 i = 0; i < entries.GetCount(); i++) {
+        if (entries.IsDirectory(i)) folders.emplace_back(entries.GetPath(i));
+        else files.push_back(i);
+    }
+    Sample list;
+    for (const std::wstring& folder : folders) {
+        start = Clock::now();
+        DirectoryIndex::ChildRange children = archive.GetEntriesInFolder(folder);
+        list.Times.push_back(SecondsSince(start));
+        if (children.empty() && folder.empty() && entries.GetCount() > 0) list.Failures++;
+    }
+    report.Add("list", list);
+
+    // Item IDs of every folder's children, one allocation each as
+    // EnumIDList makes them, then decoded again
+    Sample itemIds;
+    UINT64 idCount = 0;
+    ItemIdFields fields, decoded;
+    for (const std::wstring& folder : folders) {
+        start = Clock::now();
+        for (UINT32 node : archive.GetEntriesInFolder(folder)) {
+            if (!ItemId::FromNode(directory, entries, node, fields)) {
+                itemIds.Failures++;
+                continue;
+            }
+            size_t size = ItemId::GetSize(fields.Name.size());
+            std::unique_ptr<BYTE[]> id(new BYTE[size + sizeof(USHORT)]);
+            ItemId::Write(id.get(), fields);
+            if (!ItemId::Read(id.get(), decoded) || decoded.Name != fields.Name ||
+                decoded.ArchiveIndex != fields.ArchiveIndex || decoded.Type != fields.Type)
+                itemIds.Failures++;
+            itemIds.Bytes += size;
+            idCount++;
+        }
+        itemIds.Times.push_back(SecondsSince(start));
+    }
+    report.Add("item ids", itemIds);
+    if (idCount) {
+        printf("  %-12s %llu ids, %.1f bytes each (version 1: %zu)\n", "", (unsigned long long)idCount,
+            (double)itemIds.Bytes / (double)idCount, sizeof(LegacyItemData));
+    }
+
+    // Enumeration builds IDs as Next asks, so this should not grow with
+    // the folder
+    Sample firstIds;
+    for (const std::wstring& folder : folders) {
+        start = Clock::now();
+        DirectoryIndex::ChildRange children = archive.GetEntriesInFolder(folder);
+        std::vector<std::unique_ptr<BYTE[]>> batch;
+        for (size_t i = 0; i < children.size() && batch.size() < 64; i++) {
+            if (!ItemId::FromNode(directory, entries, children[i], fields)) continue;
+            size_t size = ItemId::GetSize(fields.Name.size());
+            batch.emplace_back(new BYTE[size + sizeof(USHORT)]);
+            ItemId::Write(batch.back().get(), fields);
+        }
+        firstIds.Times.push_back(SecondsSince(start));
+        if (batch.size() != (std::min)(children.size(), (size_t)64)) firstIds.Failures++;
+    }
+    report.Add("first ids", firstIds);
+
+    // Every node below each folder; the root's subtree is the whole index
+    Sample subtree;
+    std::vector<UINT32> nodes;
+    for (const std::wstring& folder : folders) {
+        start = Clock::now();
+        UINT32 node = directory.FindFolder(folder);
+        nodes.clear();
+        directory.GetDescendants(node, nodes);
+        subtree.Times.push_back(SecondsSince(start));
+        if (node == DirectoryIndex::NOT_FOUND || (folder.empty() && nodes.size() != directory.GetNodeCount() - 1))
+            subtree.Failures++;
+    }
+    report.Add("subtree", subtree);
+
+    if (files.empty()) return true;
+    std::mt19937 random(1234u);
+    std::uniform_int_distribution<size_t> pick(0, files.size() - 1);
+
+    // Path lookups, with '\' separators as the shell passes them
+    Sample lookup;
+    UINT32 lookups = settings.Samples * 2000;
+    for (UINT32 i = 0; i < lookups; i++) {
+        UINT32 index = files[pick(random)];
+        std::wstring query(entries.GetPath(index));
+        for (auto& ch : query) if (ch == L'/') ch = L'\\';
+
+        start = Clock::now();
+        UINT32 found = archive.FindEntry(query);
+        lookup.Times.push_back(SecondsSince(start));
+        if (found == PathIndex::NOT_FOUND || entries.GetPath(found) != entries.GetPath(index)) lookup.Failures++;
+    }
+    report.Add("lookup", lookup);
+
+    // Random reads, each checked against the recorded size and CRC
+    Sample read;
+    std::vector<BYTE> buffer, whole;
+    UINT32 reads = settings.Samples * 40;
+    for (UINT32 i = 0; i < reads; i++) {
+        UINT32 index = files[pick(random)];
+        start = Clock::now();
+        bool ok = archive.ExtractToBuffer(index, buffer);
+        read.Times.push_back(SecondsSince(start));
+        if (!ok || buffer.size() != entries.GetSize(index) ||
+            (entries.GetCRC(index) != 0 && CrcCalc(buffer.data(), buffer.size()) != entries.GetCRC(index))) {
+            read.Failures++;
+            continue;
+        }
+        read.Bytes += buffer.size();
+    }
+    report.Add("read", read);
+
+    // The same reads hashed straight from the decoder, with no buffer
+    Sample hash;
+    for (UINT32 i = 0; i < reads; i++) {
+        UINT32 index = files[pick(random)];
+        HashSink sink;
+        start = Clock::now();
+        bool ok = archive.ExtractToSink(index, sink);
+        hash.Times.push_back(SecondsSince(start));
+        if (!ok || sink.GetSize() != entries.GetSize(index) ||
+            (entries.GetCRC(index) != 0 && sink.GetCrc() != entries.GetCRC(index))) {
+            hash.Failures++;
+            continue;
+        }
+        hash.Bytes += sink.GetSize();
+    }
+    report.Add("hash", hash);
+
+    // The same reads pulled through EntryStream, as Explorer copies a
+    // dragged file; blocks too large to cache are decoded ahead on a thread
+    Sample stream;
+    EntryStreamStats streamStats = {};
+    UINT32 streamedFiles = 0;
+    auto streamed = std::make_shared<Archive>();
+    if (streamed->Open(path)) {
+        Unlock(*streamed, settings);
+        std::vector<BYTE> chunk(64 * 1024);
+        for (UINT32 i = 0; i < reads; i++) {
+            UINT32 index = files[pick(random)];
+            EntryStream entry(streamed, index);
+            start = Clock::now();
+            bool ok = entry.Open();
+            UINT32 crc = CRC_INIT_VAL;
+            UINT64 total = 0;
+            size_t got = 0;
+            while (ok) {
+                ok = entry.Read(chunk.data(), chunk.size(), &got) == SZ_OK;
+                if (!ok || got == 0) break;
+                crc = CrcUpdate(crc, chunk.data(), got);
+                total += got;
+            }
+            stream.Times.push_back(SecondsSince(start));
+            if (!ok || total != entries.GetSize(index) ||
+                (entries.GetCRC(index) != 0 && CRC_GET_DIGEST(crc) != entries.GetCRC(index))) {
+                stream.Failures++;
+                continue;
+            }
+            stream.Bytes += total;
+            if (entry.IsStreamed()) {
+                EntryStreamStats stats = entry.GetStats();
+                streamStats.Windows += stats.Windows;
+                streamStats.Stalls += stats.Stalls;
+                streamedFiles++;
+            }
+        }
+    } else {
+        stream.Failures++;
+    }
+    report.Add("stream", stream);
+    if (streamedFiles) {
+        printf("  %-12s %u files decoded ahead, %u windows, %u reads waited\n", "", streamedFiles,
+            streamStats.Windows, streamStats.Stalls);
+    }
+
+    // Random seeks, as a target reading a file out of order would
+    Sample streamSeek;
+    std::vector<BYTE> part;
+    for (UINT32 i = 0; i < settings.Samples * 4 && streamed->IsOpen(); i++) {
+        UINT32 index = files[pick(random)];
+        if (entries.GetSize(index) == 0 || !streamed->ExtractToBuffer(index, whole)) continue;
+        EntryStream entry(streamed, index);
+        if (!entry.Open()) {
+            streamSeek.Failures++;
+            continue;
+        }
+        std::uniform_int_distribution<size_t> offsets(0, whole.size() - 1);
+        for (UINT32 s = 0; s < 16; s++) {
+            size_t offset = (s == 0) ? whole.size() - 1 : offsets(random);
+            size_t length = (std::min)(whole.size() - offset, (size_t)4096);
+            part.resize(length);
+            size_t got = 0;
+            start = Clock::now();
+            bool ok = entry.Seek(offset) == SZ_OK && entry.Read(part.data(), length, &got) == SZ_OK;
+            streamSeek.Times.push_back(SecondsSince(start));
+            if (!ok || got != length || memcmp(part.data(), whole.data() + offset, length) != 0) {
+                streamSeek.Failures++;
+                continue;
+            }
+            streamSeek.Bytes += got;
+        }
+    }
+    report.Add("stream seek", streamSeek);
+    streamed.reset();
+
+    // Preview prefixes, compared with the start of the whole file
+    BlockCache::Instance().Clear();
+    Sample prefix;
+    for (UINT32 i = 0; i < reads; i++) {
+        UINT32 index = files[pick(random)];
+        start = Clock::now();
+        bool ok = archive.ExtractPrefix(index, 16 * 1024, buffer);
+        prefix.Times.push_back(SecondsSince(start));
+        size_t expected = (size_t)(std::min)(entries.GetSize(index), (UINT64)16 * 1024);
+        if (!ok || buffer.size() != expected) {
+            prefix.Failures++;
+            continue;
+        }
+        prefix.Bytes += buffer.size();
+        if (i % 8 == 0 && (!archive.ExtractToBuffer(index, whole) ||
+                           memcmp(whole.data(), buffer.data(), expected) != 0)) {
+            prefix.Failures++;
+        }
+        BlockCache::Instance().Clear();
+    }
+    report.Add("prefix", prefix);
+
+    // Drags of the same random files: once into an empty extraction cache,
+    // then served by it. Then one cached file is altered, which the next
+    // drag has to notice and repair. Encrypted files bypass the cache and
+    // are decoded by every drag.
+    ExtractCache& extractCache = ExtractCache::Instance();
+    extractCache.SetDirectory(ToWide(scratch / "extract-cache"));
+    extractCache.Clear();
+    auto shared = std::make_shared<Archive>();
+    if (shared->Open(path)) {
+        Unlock(*shared, settings);
+        std::vector<std::pair<UINT32, std::wstring>> targets;
+        std::vector<ExpectedFile> dropped;
+        std::vector<UINT32> picked;
+        for (UINT32 i = 0; i < 64; i++) {
+            UINT32 index = files[pick(random)];
+            std::filesystem::path dest = scratch / "drop" / (std::to_string(i) + ".bin");
+            targets.push_back({ index, ToWide(dest) });
+            dropped.push_back({ dest, entries.GetSize(index), entries.GetCRC(index) });
+            if (!entries.IsEncrypted(index)) picked.push_back(index);
+        }
+        std::sort(picked.begin(), picked.end());
+        UINT32 unique = (UINT32)(std::unique(picked.begin(), picked.end()) - picked.begin());
+
+        Sample drag, dragCached;
+        ExtractCacheStats total;
+        for (UINT32 round = 0; round <= settings.Samples + 1; round++) {
+            std::error_code error;
+            std::filesystem::remove_all(scratch / "drop", error);
+
+            // Before the last round, damage a cached file the way an editor
+            // saving through a link would
+            std::vector<std::wstring> cachedFiles;
+            if (round == settings.Samples + 1 && extractCache.Materialize(shared, { targets[0].first }, cachedFiles) &&
+                !cachedFiles[0].empty()) {
+                std::string native = Tootega::XStringConversion::WideToUtf8(cachedFiles[0].c_str());
+                for (char& c : native) if (c == '\\') c = '/';
+                FILE* damaged = fopen(native.c_str(), "ab");
+                if (damaged) {
+                    fputc(0, damaged);
+                    fclose(damaged);
+                }
+            }
+
+            ExtractCacheStats stats;
+            start = Clock::now();
+            ExtractResult result = extractCache.ExtractFiles(shared, targets, &stats);
+            Sample& sample = (round == 0) ? drag : dragCached;
+            sample.Times.push_back(SecondsSince(start));
+            sample.Bytes += result.BytesExtracted;
+            if (!result.Success) sample.Failures++;
+            for (const ExpectedFile& drop : dropped) {
+                if (!CheckWrittenFile(drop.Path, drop)) sample.Failures++;
+            }
+
+            // Each round decodes exactly the files the cache does not hold
+            bool damaged = round == settings.Samples + 1 && !entries.IsEncrypted(targets[0].first);
+            UINT32 expectedDecoded = (round == 0) ? unique : (damaged ? 1 : 0);
+            if (stats.Extracted != expectedDecoded || stats.Hits + stats.Extracted != unique) sample.Failures++;
+            if (round != 0) {
+                total.Hits += stats.Hits;
+                total.Damaged += stats.Damaged;
+                total.BytesVerified += stats.BytesVerified;
+            }
+        }
+        report.Add("drag", drag);
+        report.Add("drag cached", dragCached);
+        printf("  %-12s %u files, %u hits, %.1f MB verified, %u repaired\n", "", unique, total.Hits,
+            total.BytesVerified / (1024.0 * 1024.0), total.Damaged);
+
+        std::error_code error;
+        std::filesystem::remove_all(scratch / "drop", error);
+    }
+    extractCache.Clear();
+    extractCache.SetDirectory(L"");
+
+    std::vector<ExpectedFile> expected;
+    if (settings.Extract) {
+        expected.reserve(files.size());
+        for (UINT32 index : files) {
+            std::string relative = Tootega::XStringConversion::WideToUtf8(std::wstring(entries.GetPath(index)).c_str());
+            for (char& c : relative) if (c == '\\') c = '/';
+            expected.push_back({ std::filesystem::path(relative), entries.GetSize(index), entries.GetCRC(index) });
+        }
+    }
+    if (archive.HasEncryptedEntries()) {
+        AesKeyCacheStats keys = archive.GetKeyCache().GetStats();
+        printf("  %-12s %llu AES keys derived, %llu served from the key cache\n", "",
+            (unsigned long long)keys.Derivations, (unsigned long long)keys.Hits);
+    }
+    archive.Close();
+    BlockCache::Instance().Clear();
+
+    Extractor extractor;
+    if (settings.Extract) {
+        ExtractOptions options;
+        options.DestinationPath = ToWide(scratch / "extract");
+        options.OverwriteExisting = true;
+        options.ThreadCount = settings.Threads;
+        options.Password = settings.Password;
+
+        Sample extract;
+        start = Clock::now();
+        ExtractResult result = extractor.Extract(path, options);
+        extract.Times.push_back(SecondsSince(start));
+        extract.Bytes = result.BytesExtracted;
+        extract.Failures = result.Success ? 0 : (result.FilesFailed ? result.FilesFailed : 1);
+        if (result.Success) {
+            for (const ExpectedFile& written : expected) {
+                if (!CheckWrittenFile(scratch / "extract" / written.Path, written)) extract.Failures++;
+            }
+        }
+        report.Add("extract", extract);
+
+        std::error_code error;
+        std::filesystem::remove_all(scratch / "extract", error);
+    }
+
+    auto pooled = ArchivePool::Instance().GetArchive(path);
+    if (pooled) Unlock(*pooled, settings);
+
+    Sample test;
+    start = Clock::now();
+    TestResult result = extractor.TestArchive(path, nullptr, settings.Threads);
+    test.Times.push_back(SecondsSince(start));
+    test.Bytes = result.BytesTested;
+    test.Failures = result.Success ? 0 : (result.FilesFailed ? result.FilesFailed : 1);
+    report.Add("test", test);
+
+    // Archives stored inside, opened without extracting them to disk; the
+    // second round is served by the pool
+    if (pooled) {
+        Sample nested, nestedRead;
+        for (UINT32 round = 0; round < 2; round++)
+            OpenNested(path, pooled->GetEntryTable(), settings, nested, nestedRead);
+        if (!nested.Times.empty()) {
+            report.Add("nested", nested);
+            report.Add("nested read", nestedRead);
+        }
+    }
+
+    // Dictionaries, windows and decoded blocks of every step since open
+    SdkAllocStats poolAfter = BufferPool::Instance().GetStats();
+    printf("  %-12s %llu decoder buffers, %llu from the system, %.1f MB idle\n", "",
+        (unsigned long long)(poolAfter.Requests - poolBefore.Requests),
+        (unsigned long long)(poolAfter.SystemAllocations - poolBefore.SystemAllocations),
+        poolAfter.IdleBytes / (1024.0 * 1024.0));
+
+    failures += report.GetFailures();
+    return true;
+}
+
+int Run(const std::filesystem::path& target, SuiteSettings& settings, const char* csvPath) {
+    std::vector<std::filesystem::path> archives;
+    std::error_code error;
+    if (std::filesystem::is_directory(target, error)) {
+        for (const auto& item : std::filesystem::directory_iterator(target, error)) {
+            if (item.path().extension() == ".7z") archives.push_back(item.path());
+        }
+        std::sort(archives.begin(), archives.end());
+    } else {
+        archives.push_back(target);
+    }
+    if (archives.empty()) {
+        fprintf(stderr, "No archives found\n");
+        return 2;
+    }
+
+    if (csvPath) {
+        settings.Csv = fopen(csvPath, "w");
+        if (!settings.Csv) {
+            fprintf(stderr, "Cannot create %s\n", csvPath);
+            return 2;
+        }
+        fprintf(settings.Csv, "archive,step,count,p50_ms,p90_ms,p99_ms,max_ms,bytes,mb_per_s,failures\n");
+    }
+
+    // Scratch space for the index cache and extraction
+    std::filesystem::path scratch = std::filesystem::temp_directory_path(error) /
+        ("ArchiveSuite-" + std::to_string((unsigned long long)GetCurrentProcessId()));
+    std::filesystem::create_directories(scratch, error);
+
+    UINT64 failures = 0;
+    for (const auto& archive : archives) {
+        if (!RunArchive(archive, settings, scratch, failures)) continue;
+        printf("\n");
+    }
+
+    IndexCache::Instance().SetDirectory(L"");
+    std::filesystem::remove_all(scratch, error);
+    if (settings.Csv) fclose(settings.Csv);
+
+    printf("%zu archives, %llu failures\n", archives.size(), (unsigned long long)failures);
+    return failures ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const char* usage =
+        "Usage: ArchiveSuite <archive.7z | directory> [--samples n] [--threads n] "
+        "[--csv file] [--no-extract] [--lzma fast|reference] [--password text]\n";
+    if (argc >= 2 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        printf("%s", usage);
+        return 0;
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        if (argc >= 2) fprintf(stderr, "Unknown option %s\n", argv[1]);
+        fprintf(stderr, "%s", usage);
+        return 2;
+    }
+
+    SuiteSettings settings;
+    const char* csvPath = nullptr;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--no-extract") == 0) {
+            settings.Extract = false;
+            continue;
+        }
+
+        bool known = strcmp(argv[i], "--samples") == 0 || strcmp(argv[i], "--threads") == 0 ||
+            strcmp(argv[i], "--csv") == 0 || strcmp(argv[i], "--password") == 0 || strcmp(argv[i], "--lzma") == 0;
+        if (!known) {
+            fprintf(stderr, "Unknown option %s\n%s", argv[i], usage);
+            return 2;
+        }
+        if (i + 1 == argc) {
+            fprintf(stderr, "Missing value for %s\n%s", argv[i], usage);
+            return 2;
+        }
+
+        const char* option = argv[i++];
+        if (strcmp(option, "--samples") == 0) settings.Samples = (UINT32)atoi(argv[i]);
+        else if (strcmp(option, "--threads") == 0) settings.Threads = (UINT32)atoi(argv[i]);
+        else if (strcmp(option, "--csv") == 0) csvPath = argv[i];
+        else if (strcmp(option, "--password") == 0) settings.Password = Tootega::XStringConversion::Utf8ToWide(argv[i]);
+        else if (strcmp(argv[i], "reference") == 0) settings.Lzma = LzmaDecodeLoop::Reference;
+        else if (strcmp(argv[i], "fast") == 0) settings.Lzma = LzmaDecodeLoop::Fast;
+        else {
+            fprintf(stderr, "Invalid --lzma %s\n%s", argv[i], usage);
+            return 2;
+        }
+    }
+    if (settings.Samples < 1) settings.Samples = 1;
+
+    CrcGenerateTable();
+    SetLzmaDecodeLoop(settings.Lzma);
+    return Run(std::filesystem::path(argv[1]), settings, csvPath);
+}
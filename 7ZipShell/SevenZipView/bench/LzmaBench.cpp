@@ -0,0 +1,402 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** LZMA Decode Loop Check and Benchmark
+**
+** Usage: LzmaBench [--cases n] [--size MB] [--rounds n] [--level 0-9]
+**                  [--seed n]
+**
+** First checks the fast loop against the SDK's reference loop on a fuzzed
+** corpus: --cases streams of seeded text, random, run-heavy, record and
+** mixed data, packed with liblzma at random lc/lp/pb, dictionary size and
+** level, with and without an end marker. Each stream is decoded whole and
+** in small random steps through a wrapping dictionary, then again after
+** random bytes were flipped or the stream cut short. Both loops must give
+** the same output, result, status and input consumed every time, and the
+** undamaged streams their original data.
+**
+** Then times one-call decoding of --size MB streams with each loop and
+** reports decode MB/s (median of --rounds).
+**
+** Exit code 0 when every comparison matched.
+*/
+
+#include "LzmaDecodeLoop.h"
+#include <lzma.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// LZMA1EXT (LZMA without an end marker) arrived in 5.4
+#if LZMA_VERSION < 50040000
+#error "LzmaBench needs liblzma 5.4 or later"
+#endif
+
+using namespace SevenZipView;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchSettings {
+    uint32_t Cases = 300;
+    uint32_t SizeMb = 32;
+    uint32_t Rounds = 5;
+    uint32_t Level = 6;
+    uint32_t Seed = 1;
+};
+
+enum class Content { Text, Random, Runs, Records, Mixed };
+
+const char* CONTENT_NAMES[] = { "text", "random", "runs", "records", "mixed" };
+
+struct StreamOptions {
+    uint32_t Lc = 3;
+    uint32_t Lp = 0;
+    uint32_t Pb = 2;
+    uint32_t DictionarySize = 1 << 20;
+    uint32_t Level = 6;
+    bool     EndMarker = true;
+};
+
+void* BenchAlloc(ISzAllocPtr, size_t size) { return malloc(size); }
+void BenchFree(ISzAllocPtr, void* address) { free(address); }
+const ISzAlloc g_Alloc = { BenchAlloc, BenchFree };
+
+void Generate(Content content, size_t size, std::mt19937_64& random, std::vector<Byte>& data) {
+    static const char* const WORDS[] = {
+        "archive", "folder", "the", "shell", "of", "extract", "stream", "and", "block", "to",
+        "decoder", "window", "a", "file", "index", "cache", "in", "path", "solid", "entry"
+    };
+    data.clear();
+    data.reserve(size);
+
+    switch (content) {
+    case Content::Text:
+        while (data.size() < size) {
+            const char* word = WORDS[random() % 20];
+            data.insert(data.end(), word, word + strlen(word));
+            data.push_back((random() % 12) ? ' ' : '\n');
+        }
+        break;
+
+    case Content::Random:
+        while (data.size() < size) data.push_back((Byte)random());
+        break;
+
+    case Content::Runs:
+        // Byte runs and repeats from near and far back
+        while (data.size() < size) {
+            uint64_t pick = random() % 4;
+            if (pick == 0 || data.size() < 64) {
+                data.insert(data.end(), 1 + random() % 300, (Byte)random());
+            } else if (pick == 1) {
+                for (size_t n = 1 + random() % 16; n > 0; n--) data.push_back((Byte)random());
+            } else {
+                size_t distance = 1 + random() % (pick == 2 ? 64 : data.size());
+                size_t length = 2 + random() % 400;
+                size_t from = data.size() - (std::min)(distance, data.size());
+                for (size_t n = 0; n < length; n++) data.push_back(data[from + n]);
+            }
+        }
+        break;
+
+    case Content::Records: {
+        // Little-endian records with counters and small deltas, the kind of
+        // data lp=2 suits
+        uint32_t id = (uint32_t)random();
+        uint32_t value = 0;
+        while (data.size() < size) {
+            uint32_t fields[4] = { id++, value += (uint32_t)(random() % 64), 0x00401000u + (uint32_t)(random() % 4096) * 4,
+                                   (uint32_t)(random() % 3) };
+            data.insert(data.end(), (const Byte*)fields, (const Byte*)fields + sizeof(fields));
+        }
+        break;
+    }
+
+    case Content::Mixed: {
+        std::vector<Byte> piece;
+        while (data.size() < size) {
+            Content part = (Content)(random() % 4);
+            Generate(part, 1024 + random() % 65536, random, piece);
+            data.insert(data.end(), piece.begin(), piece.end());
+        }
+        break;
+    }
+    }
+    data.resize(size);
+}
+
+bool Encode(const std::vector<Byte>& data, const StreamOptions& options, std::vector<Byte>& props,
+            std::vector<Byte>& packed) {
+    lzma_options_lzma lzma;
+    if (lzma_lzma_preset(&lzma, options.Level)) return false;
+    lzma.dict_size = options.DictionarySize;
+    lzma.lc = options.Lc;
+    lzma.lp = options.Lp;
+    lzma.pb = options.Pb;
+
+    // LZMA1 always ends with the marker; LZMA1EXT of a known size, as 7z
+    // packs, without it
+    lzma_filter filters[2] = {
+        { options.EndMarker ? LZMA_FILTER_LZMA1 : LZMA_FILTER_LZMA1EXT, &lzma },
+        { LZMA_VLI_UNKNOWN, nullptr }
+    };
+    if (!options.EndMarker) {
+        lzma.ext_flags = 0;
+        lzma_set_ext_size(lzma, data.size());
+    }
+
+    lzma_stream stream = LZMA_STREAM_INIT;
+    if (lzma_raw_encoder(&stream, filters) != LZMA_OK) return false;
+
+    packed.resize(data.size() + data.size() / 2 + 65536);
+    stream.next_in = data.data();
+    stream.avail_in = data.size();
+    stream.next_out = packed.data();
+    stream.avail_out = packed.size();
+    lzma_ret ret = lzma_code(&stream, LZMA_FINISH);
+    packed.resize(stream.total_out);
+    lzma_end(&stream);
+    if (ret != LZMA_STREAM_END) return false;
+
+    props.clear();
+    props.push_back((Byte)((options.Pb * 5 + options.Lp) * 9 + options.Lc));
+    for (int i = 0; i < 4; i++) props.push_back((Byte)(options.DictionarySize >> (8 * i)));
+    return true;
+}
+
+struct DecodeResult {
+    SRes                Result = SZ_OK;
+    ELzmaStatus         Status = LZMA_STATUS_NOT_SPECIFIED;
+    size_t              Consumed = 0;
+    std::vector<Byte>   Output;
+
+    bool operator==(const DecodeResult& other) const {
+        return Result == other.Result && Status == other.Status && Consumed == other.Consumed &&
+               Output == other.Output;
+    }
+};
+
+// One-call interface into a buffer of the expected size
+DecodeResult DecodeWhole(const std::vector<Byte>& props, const std::vector<Byte>& packed, size_t size) {
+    DecodeResult result;
+    result.Output.assign(size, 0);
+    SizeT destLen = size;
+    SizeT srcLen = packed.size();
+    result.Result = LzmaDecode(result.Output.data(), &destLen, packed.data(), &srcLen, props.data(),
+        (unsigned)props.size(), LZMA_FINISH_END, &result.Status, &g_Alloc);
+    result.Output.resize(destLen);
+    result.Consumed = srcLen;
+    return result;
+}
+
+// Buffer interface in small random steps, so the loop starts with little
+// input or output room and the dictionary (the stream's dictionary size)
+// wraps
+DecodeResult DecodeSteps(const std::vector<Byte>& props, const std::vector<Byte>& packed, size_t size,
+                         uint32_t seed) {
+    DecodeResult result;
+    CLzmaDec decoder;
+    LzmaDec_Construct(&decoder);
+    result.Result = LzmaDec_Allocate(&decoder, props.data(), (unsigned)props.size(), &g_Alloc);
+    if (result.Result != SZ_OK) return result;
+    LzmaDec_Init(&decoder);
+
+    std::mt19937 random(seed);
+    std::vector<Byte> out;
+    for (uint32_t idle = 0; idle < 4;) {
+        size_t inStep = (random() % 8) ? 1 + random() % 48 : 1 + random() % 8192;
+        size_t outStep = (random() % 8) ? 1 + random() % 320 : 1 + random() % 65536;
+        inStep = (std::min)(inStep, packed.size() - result.Consumed);
+        outStep = (std::min)(outStep, size - result.Output.size());
+
+        out.resize(outStep);
+        SizeT outLen = outStep;
+        SizeT inLen = inStep;
+        bool last = result.Output.size() + outStep == size;
+        result.Result = LzmaDec_DecodeToBuf(&decoder, out.data(), &outLen, packed.data() + result.Consumed, &inLen,
+            last ? LZMA_FINISH_END : LZMA_FINISH_ANY, &result.Status);
+        result.Output.insert(result.Output.end(), out.begin(), out.begin() + outLen);
+        result.Consumed += inLen;
+
+        if (result.Result != SZ_OK || result.Status == LZMA_STATUS_FINISHED_WITH_MARK) break;
+        if (result.Output.size() == size && last) break;
+        idle = (outLen == 0 && inLen == 0) ? idle + 1 : 0;
+    }
+
+    LzmaDec_Free(&decoder, &g_Alloc);
+    return result;
+}
+
+// Decode with both loops; true when they agree
+bool Compare(const std::vector<Byte>& props, const std::vector<Byte>& packed, size_t size, uint32_t seed,
+             DecodeResult& decoded) {
+    bool same = true;
+    SetLzmaDecodeLoop(LzmaDecodeLoop::Reference);
+    DecodeResult wholeRef = DecodeWhole(props, packed, size);
+    DecodeResult stepsRef = DecodeSteps(props, packed, size, seed);
+    SetLzmaDecodeLoop(LzmaDecodeLoop::Fast);
+    decoded = DecodeWhole(props, packed, size);
+    DecodeResult steps = DecodeSteps(props, packed, size, seed);
+
+    if (!(decoded == wholeRef)) same = false;
+    if (!(steps == stepsRef)) same = false;
+    return same;
+}
+
+bool CheckCorpus(const BenchSettings& settings) {
+    std::mt19937_64 random(settings.Seed);
+    std::vector<Byte> data, props, packed, damaged;
+    uint32_t streams = 0, variants = 0, mismatches = 0, skipped = 0;
+    UINT64 bytes = 0;
+
+    for (uint32_t i = 0; i < settings.Cases; i++) {
+        Content content = (Content)(random() % 5);
+        size_t size = (random() % 16) ? random() % (256 * 1024) : random() % (2 * 1024 * 1024);
+        if (random() % 32 == 0) size = random() % 16;
+        Generate(content, size, random, data);
+
+        StreamOptions options;
+        options.Lc = (uint32_t)(random() % 5);
+        options.Lp = (uint32_t)(random() % (5 - options.Lc));
+        options.Pb = (uint32_t)(random() % 5);
+        if (random() % 3 == 0) {
+            options.Lc = 3;
+            options.Lp = 0;
+            options.Pb = 2;
+        }
+        options.DictionarySize = 4096u << (random() % 9);
+        options.Level = (uint32_t)(random() % 10);
+        options.EndMarker = (random() % 2) != 0;
+        if (!Encode(data, options, props, packed)) {
+            skipped++;
+            continue;
+        }
+
+        DecodeResult decoded;
+        uint32_t seed = (uint32_t)random();
+        bool same = Compare(props, packed, size, seed, decoded);
+        bool intact = decoded.Result == SZ_OK && decoded.Output == data;
+        if (!same || !intact) {
+            mismatches++;
+            fprintf(stderr, "case %u (%s, %zu bytes, lc%u lp%u pb%u, %s): %s\n", i, CONTENT_NAMES[(int)content],
+                size, options.Lc, options.Lp, options.Pb, options.EndMarker ? "end marker" : "no end marker",
+                same ? "wrong output" : "loops differ");
+        }
+        streams++;
+        variants++;
+        bytes += size;
+
+        // Flipped bytes, then a cut: the loops must fail the same way
+        for (int round = 0; round < 3 && packed.size() > 8; round++) {
+            damaged = packed;
+            if (round < 2) {
+                for (uint64_t n = 1 + random() % 4; n > 0; n--)
+                    damaged[1 + random() % (damaged.size() - 1)] ^= (Byte)(1 + random() % 255);
+            } else {
+                damaged.resize(random() % damaged.size());
+            }
+            if (!Compare(props, damaged, size, seed, decoded)) {
+                mismatches++;
+                fprintf(stderr, "case %u damage %d: loops differ\n", i, round);
+            }
+            variants++;
+        }
+    }
+
+    printf("corpus: %u streams, %.1f MB, %u decodes per loop (with damaged variants), %u mismatches",
+        streams, bytes / (1024.0 * 1024.0), variants * 2, mismatches);
+    if (skipped) printf(", %u not encodable", skipped);
+    printf("\n");
+    return mismatches == 0;
+}
+
+double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+bool Measure(const BenchSettings& settings) {
+    struct BenchStream {
+        const char* Name;
+        Content     Data;
+        uint32_t    Lc, Lp, Pb;
+    };
+    // The specialized loops, then one on the generic path
+    static const BenchStream STREAMS[] = {
+        { "mixed lc3 lp0 pb2",   Content::Mixed,   3, 0, 2 },
+        { "text lc3 lp0 pb2",    Content::Text,    3, 0, 2 },
+        { "records lc0 lp2 pb2", Content::Records, 0, 2, 2 },
+        { "mixed lc4 lp0 pb0",   Content::Mixed,   4, 0, 0 },
+    };
+
+    std::mt19937_64 random(settings.Seed);
+    std::vector<Byte> data, props, packed;
+    size_t size = (size_t)settings.SizeMb << 20;
+    bool ok = true;
+
+    printf("\n%-20s %10s %10s %10s %8s\n", "stream", "packed MB", "reference", "fast", "speedup");
+    for (const BenchStream& stream : STREAMS) {
+        Generate(stream.Data, size, random, data);
+        StreamOptions options;
+        options.Lc = stream.Lc;
+        options.Lp = stream.Lp;
+        options.Pb = stream.Pb;
+        options.DictionarySize = 8 << 20;
+        options.Level = settings.Level;
+        options.EndMarker = false;
+        if (!Encode(data, options, props, packed)) {
+            fprintf(stderr, "%s: cannot encode\n", stream.Name);
+            ok = false;
+            continue;
+        }
+
+        // Loops alternate, so both see the same machine state
+        std::vector<double> rates[2];
+        for (uint32_t r = 0; r < settings.Rounds; r++) {
+            for (int loop = 0; loop < 2; loop++) {
+                SetLzmaDecodeLoop(loop ? LzmaDecodeLoop::Fast : LzmaDecodeLoop::Reference);
+                auto start = Clock::now();
+                DecodeResult decoded = DecodeWhole(props, packed, size);
+                double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                if (decoded.Result != SZ_OK || decoded.Output != data) {
+                    fprintf(stderr, "%s: %s loop decoded wrong data\n", stream.Name,
+                        GetLzmaDecodeLoopName(GetLzmaDecodeLoop()));
+                    ok = false;
+                }
+                rates[loop].push_back(size / (1024.0 * 1024.0) / seconds);
+            }
+        }
+        double mbs[2] = { Median(rates[0]), Median(rates[1]) };
+        printf("%-20s %10.1f %8.1f/s %8.1f/s %7.2fx\n", stream.Name, packed.size() / (1024.0 * 1024.0),
+            mbs[0], mbs[1], mbs[1] / mbs[0]);
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchSettings settings;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--cases") == 0) settings.Cases = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--size") == 0) settings.SizeMb = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rounds") == 0) settings.Rounds = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--level") == 0) settings.Level = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) settings.Seed = (uint32_t)atoi(argv[i + 1]);
+    }
+    if (settings.SizeMb == 0 || settings.Rounds == 0 || settings.Level > 9) {
+        fprintf(stderr, "Usage: LzmaBench [--cases n] [--size MB] [--rounds n] [--level 0-9] [--seed n]\n");
+        return 2;
+    }
+
+    bool ok = CheckCorpus(settings);
+    ok = Measure(settings) && ok;
+    SetLzmaDecodeLoop(LzmaDecodeLoop::Reference);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Path Index Microbenchmark
+**
+** Usage: PathIndexBench [entries]
+**
+** Lays out a synthetic name block the way 7zArcIn.c does (UTF-16LE names
+** with terminators, indexed by character offsets) and times:
+**   - PathIndex::Build
+**   - PathIndex::Find for every entry, queried with '\' and upper case
+**   - the old linear scan (normalize + _wcsicmp) on a small sample
+*/
+
+#include "PathIndex.h"
+#include <chrono>
+#include <cstdio>
+
+using namespace SevenZipView;
+
+namespace {
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// "dir0042/sub0007/file000123.txt" style paths, 100 files per directory
+std::wstring MakePath(UINT32 i) {
+    wchar_t buf[64];
+    swprintf(buf, 64, L"dir%04u/sub%04u/file%06u.txt", (i / 10000) % 10000, (i / 100) % 100, i);
+    return buf;
+}
+
+// Linear scan as Archive::GetEntry(path) did before the index
+UINT32 LinearFind(const std::vector<std::wstring>& paths, std::wstring query) {
+    for (auto& ch : query) if (ch == L'\\') ch = L'/';
+    while (!query.empty() && query.back() == L'/') query.pop_back();
+
+    for (UINT32 i = 0; i < paths.size(); i++) {
+        std::wstring entryPath = paths[i];
+        for (auto& ch : entryPath) if (ch == L'\\') ch = L'/';
+        while (!entryPath.empty() && entryPath.back() == L'/') entryPath.pop_back();
+        if (_wcsicmp(entryPath.c_str(), query.c_str()) == 0) return i;
+    }
+    return PathIndex::NOT_FOUND;
+}
+
+} // namespace
+
+int wmain(int argc, wchar_t* argv[]) {
+    UINT32 count = (argc > 1) ? (UINT32)_wtoi(argv[1]) : 1000000;
+    if (count == 0) count = 1;
+
+    // Name block in 7z layout
+    std::vector<std::wstring> paths(count);
+    std::vector<size_t> offsets(count + 1);
+    std::vector<Byte> names;
+    size_t chars = 0;
+    for (UINT32 i = 0; i < count; i++) {
+        paths[i] = MakePath(i);
+        offsets[i] = chars;
+        for (wchar_t c : paths[i]) {
+            names.push_back((Byte)(c & 0xFF));
+            names.push_back((Byte)(c >> 8));
+        }
+        names.push_back(0);
+        names.push_back(0);
+        chars += paths[i].size() + 1;
+    }
+    offsets[count] = chars;
+
+    // Queries use the other separator and case, as shell paths often do
+    std::vector<std::wstring> queries(count);
+    for (UINT32 i = 0; i < count; i++) {
+        queries[i] = paths[i];
+        for (auto& ch : queries[i]) {
+            if (ch == L'/') ch = L'\\';
+            else ch = (wchar_t)towupper(ch);
+        }
+    }
+
+    PathIndex index;
+    auto start = std::chrono::steady_clock::now();
+    index.Build(names.data(), offsets.data(), count);
+    double buildSeconds = SecondsSince(start);
+
+    UINT32 misses = 0;
+    start = std::chrono::steady_clock::now();
+    for (UINT32 i = 0; i < count; i++) {
+        if (index.Find(queries[i]) != i) misses++;
+    }
+    double findSeconds = SecondsSince(start);
+
+    UINT32 sample = (std::min)(count, 200u);
+    start = std::chrono::steady_clock::now();
+    for (UINT32 i = 0; i < sample; i++) {
+        UINT32 target = (UINT32)(((UINT64)i * count) / sample);
+        if (LinearFind(paths, queries[target]) != target) misses++;
+    }
+    double linearSeconds = SecondsSince(start);
+
+    double findNs = findSeconds * 1e9 / count;
+    double linearNs = linearSeconds * 1e9 / sample;
+
+    wprintf(L"entries        %u\n", count);
+    wprintf(L"build          %.1f ms (%.1f MB table)\n", buildSeconds * 1000.0,
+        index.GetMemoryUsage() / (1024.0 * 1024.0));
+    wprintf(L"indexed find   %.1f ns/lookup\n", findNs);
+    wprintf(L"linear scan    %.1f us/lookup (%u samples)\n", linearNs / 1000.0, sample);
+    wprintf(L"speedup        %.0fx\n", findNs > 0.0 ? linearNs / findNs : 0.0);
+
+    if (misses) {
+        fwprintf(stderr, L"%u lookups returned the wrong index\n", misses);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Stand-in for TootegaWinLib Shell/XShell.h in the POSIX benchmark build
+*/
+
+#include "../XPlatform.h"
+
+namespace Tootega {
+namespace Shell {
+
+// COM is not available; Common.h only names the type
+template<typename T>
+class XComPtr;
+
+} // namespace Shell
+} // namespace Tootega
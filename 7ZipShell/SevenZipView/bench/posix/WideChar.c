@@ -0,0 +1,219 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** 16-bit Wide Character Runtime for the POSIX Benchmark Build
+**
+** With -fshort-wchar, std::wstring and std::to_wstring still call the C
+** library's wide functions, which expect a 32-bit wchar_t. The functions
+** below take their place in the executable and work on UTF-16 units.
+**
+** Only what the core and the benchmarks reach is provided. vswprintf
+** follows Windows: %s and %c are wide, %hs is narrow.
+*/
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef unsigned short wchar16;
+
+size_t wcslen(const wchar16* s) {
+    const wchar16* p = s;
+    while (*p) p++;
+    return (size_t)(p - s);
+}
+
+size_t wcsnlen(const wchar16* s, size_t max) {
+    size_t length = 0;
+    while (length < max && s[length]) length++;
+    return length;
+}
+
+wchar16* wmemcpy(wchar16* dest, const wchar16* src, size_t count) {
+    return (wchar16*)memcpy(dest, src, count * sizeof(wchar16));
+}
+
+wchar16* wmemmove(wchar16* dest, const wchar16* src, size_t count) {
+    return (wchar16*)memmove(dest, src, count * sizeof(wchar16));
+}
+
+wchar16* wmemset(wchar16* dest, wchar16 c, size_t count) {
+    for (size_t i = 0; i < count; i++) dest[i] = c;
+    return dest;
+}
+
+int wmemcmp(const wchar16* a, const wchar16* b, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+wchar16* wmemchr(const wchar16* s, wchar16 c, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (s[i] == c) return (wchar16*)(s + i);
+    }
+    return NULL;
+}
+
+int wcscmp(const wchar16* a, const wchar16* b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (*a == *b) ? 0 : (*a < *b ? -1 : 1);
+}
+
+// Output of vswprintf, truncated to the destination
+typedef struct {
+    wchar16* Dest;
+    size_t Count;
+    size_t Length;
+} WideOutput;
+
+static void PutChar(WideOutput* out, wchar16 c) {
+    if (out->Length + 1 < out->Count) out->Dest[out->Length] = c;
+    out->Length++;
+}
+
+static void PutPadded(WideOutput* out, const wchar16* s, size_t length, int width, int left) {
+    size_t pad = (width > 0 && (size_t)width > length) ? (size_t)width - length : 0;
+    if (!left) while (pad) { PutChar(out, ' '); pad--; }
+    for (size_t i = 0; i < length; i++) PutChar(out, s[i]);
+    while (pad) { PutChar(out, ' '); pad--; }
+}
+
+int vswprintf(wchar16* dest, size_t count, const wchar16* format, va_list args) {
+    WideOutput out = { dest, count, 0 };
+
+    for (const wchar16* f = format; *f; f++) {
+        if (*f != '%') {
+            PutChar(&out, *f);
+            continue;
+        }
+        if (f[1] == '%') {
+            PutChar(&out, '%');
+            f++;
+            continue;
+        }
+
+        // Rebuild the conversion as a narrow spec for snprintf
+        char spec[48];
+        size_t n = 0;
+        int width = -1, precision = -1, left = 0;
+        spec[n++] = '%';
+        f++;
+
+        while (*f && strchr("-+ #0", (char)*f)) {
+            if (*f == '-') left = 1;
+            spec[n++] = (char)*f++;
+        }
+        if (*f == '*') {
+            width = va_arg(args, int);
+            if (width < 0) { left = 1; width = -width; }
+            n += (size_t)snprintf(spec + n, sizeof(spec) - n, "%d", width);
+            f++;
+        } else {
+            if (*f >= '0' && *f <= '9') width = 0;
+            while (*f >= '0' && *f <= '9') {
+                width = width * 10 + (*f - '0');
+                spec[n++] = (char)*f++;
+            }
+        }
+        if (*f == '.') {
+            spec[n++] = (char)*f++;
+            precision = 0;
+            if (*f == '*') {
+                precision = va_arg(args, int);
+                n += (size_t)snprintf(spec + n, sizeof(spec) - n, "%d", precision < 0 ? 0 : precision);
+                f++;
+            } else {
+                while (*f >= '0' && *f <= '9') {
+                    precision = precision * 10 + (*f - '0');
+                    spec[n++] = (char)*f++;
+                }
+            }
+        }
+
+        // Length modifier: 1 = h, 2 = hh, 3 = l, 4 = ll, 5 = z, 6 = j, 7 = t, 8 = L
+        int length = 0;
+        if (*f == 'h') { length = 1; f++; if (*f == 'h') { length = 2; f++; } }
+        else if (*f == 'l') { length = 3; f++; if (*f == 'l') { length = 4; f++; } }
+        else if (*f == 'z') { length = 5; f++; }
+        else if (*f == 'j') { length = 6; f++; }
+        else if (*f == 't') { length = 7; f++; }
+        else if (*f == 'L') { length = 8; f++; }
+        else if (*f == 'I' && f[1] == '6' && f[2] == '4') { length = 4; f += 3; }
+
+        wchar16 conversion = *f;
+        if (!conversion) break;
+
+        if (conversion == 's') {
+            if (length == 1) {
+                const char* s = va_arg(args, const char*);
+                if (!s) s = "(null)";
+                size_t len = strlen(s);
+                if (precision >= 0 && (size_t)precision < len) len = (size_t)precision;
+                size_t pad = (width > 0 && (size_t)width > len) ? (size_t)width - len : 0;
+                if (!left) while (pad) { PutChar(&out, ' '); pad--; }
+                for (size_t i = 0; i < len; i++) PutChar(&out, (unsigned char)s[i]);
+                while (pad) { PutChar(&out, ' '); pad--; }
+            } else {
+                static const wchar16 null[] = { '(', 'n', 'u', 'l', 'l', ')', 0 };
+                const wchar16* s = va_arg(args, const wchar16*);
+                if (!s) s = null;
+                size_t len = wcslen(s);
+                if (precision >= 0 && (size_t)precision < len) len = (size_t)precision;
+                PutPadded(&out, s, len, width, left);
+            }
+            continue;
+        }
+        if (conversion == 'c') {
+            wchar16 c = (wchar16)va_arg(args, int);
+            PutPadded(&out, &c, 1, width, left);
+            continue;
+        }
+
+        static const char* const modifiers[] = { "", "h", "hh", "l", "ll", "z", "j", "t", "L" };
+        n += (size_t)snprintf(spec + n, sizeof(spec) - n, "%s%c", modifiers[length], (char)conversion);
+
+        char text[512];
+        int written;
+        switch (conversion) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            switch (length) {
+            case 3:  written = snprintf(text, sizeof(text), spec, va_arg(args, long)); break;
+            case 4:  written = snprintf(text, sizeof(text), spec, va_arg(args, long long)); break;
+            case 5:  written = snprintf(text, sizeof(text), spec, va_arg(args, size_t)); break;
+            case 6:  written = snprintf(text, sizeof(text), spec, va_arg(args, long long)); break;
+            case 7:  written = snprintf(text, sizeof(text), spec, va_arg(args, ptrdiff_t)); break;
+            default: written = snprintf(text, sizeof(text), spec, va_arg(args, int)); break;
+            }
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            if (length == 8) written = snprintf(text, sizeof(text), spec, va_arg(args, long double));
+            else written = snprintf(text, sizeof(text), spec, va_arg(args, double));
+            break;
+        case 'p':
+            written = snprintf(text, sizeof(text), spec, va_arg(args, void*));
+            break;
+        default:
+            return -1;
+        }
+        if (written < 0) return -1;
+        if ((size_t)written >= sizeof(text)) written = (int)sizeof(text) - 1;
+        for (int i = 0; i < written; i++) PutChar(&out, (unsigned char)text[i]);
+    }
+
+    if (count == 0) return -1;
+    dest[out.Length < count ? out.Length : count - 1] = 0;
+    return (out.Length < count) ? (int)out.Length : -1;
+}
+
+int swprintf(wchar16* dest, size_t count, const wchar16* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vswprintf(dest, count, format, args);
+    va_end(args);
+    return result;
+}
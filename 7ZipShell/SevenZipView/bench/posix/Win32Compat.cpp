@@ -0,0 +1,664 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Win32 Stand-ins for the POSIX Benchmark Build - Implementation
+*/
+
+#include "Win32Compat.h"
+#include "XStringConversion.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace {
+
+// Seconds between 1601-01-01 (FILETIME) and 1970-01-01 (Unix time)
+const UINT64 FILETIME_UNIX_EPOCH = 11644473600ull;
+
+thread_local DWORD g_LastError = 0;
+
+enum class HandleKind { File, Mapping, Event, Find };
+
+// What a HANDLE points to
+struct CompatHandle {
+    HandleKind Kind;
+    int Fd = -1;                        // File, Mapping
+    UINT64 Size = 0;                    // Mapping
+    DIR* Dir = nullptr;                 // Find
+    std::string Directory;              // Find: with trailing '/'
+    std::string Pattern;                // Find: fnmatch pattern of names
+
+    explicit CompatHandle(HandleKind kind) : Kind(kind) {}
+};
+
+// Views from MapViewOfFile and their lengths, for UnmapViewOfFile
+std::mutex g_ViewsMutex;
+std::map<const void*, size_t> g_Views;
+
+BOOL Fail(int error) {
+    g_LastError = (DWORD)error;
+    return FALSE;
+}
+
+CompatHandle* AsHandle(HANDLE handle, HandleKind kind) {
+    if (!handle || handle == INVALID_HANDLE_VALUE) return nullptr;
+    CompatHandle* h = static_cast<CompatHandle*>(handle);
+    return (h->Kind == kind) ? h : nullptr;
+}
+
+// UTF-16 path to a UTF-8 one with '/' separators
+std::string NativePath(LPCWSTR path) {
+    std::string native = Tootega::XStringConversion::WideToUtf8(path);
+    for (char& c : native) {
+        if (c == '\\') c = '/';
+    }
+    return native;
+}
+
+FILETIME ToFileTime(const struct timespec& t) {
+    UINT64 ticks = ((UINT64)t.tv_sec + FILETIME_UNIX_EPOCH) * 10000000ull + (UINT64)t.tv_nsec / 100;
+    FILETIME ft;
+    ft.dwLowDateTime = (DWORD)ticks;
+    ft.dwHighDateTime = (DWORD)(ticks >> 32);
+    return ft;
+}
+
+struct timespec ToTimespec(const FILETIME& ft) {
+    UINT64 ticks = ((UINT64)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    struct timespec t;
+    t.tv_sec = (time_t)(ticks / 10000000ull) - (time_t)FILETIME_UNIX_EPOCH;
+    t.tv_nsec = (long)(ticks % 10000000ull) * 100;
+    return t;
+}
+
+DWORD ToAttributes(const struct stat& st) {
+    DWORD attributes = 0;
+    if (S_ISDIR(st.st_mode)) attributes |= FILE_ATTRIBUTE_DIRECTORY;
+    if (!(st.st_mode & S_IWUSR)) attributes |= FILE_ATTRIBUTE_READONLY;
+    return attributes ? attributes : FILE_ATTRIBUTE_NORMAL;
+}
+
+void FillFindData(const std::string& directory, const char* name, WIN32_FIND_DATAW* data) {
+    ZeroMemory(data, sizeof(*data));
+
+    struct stat st;
+    if (stat((directory + name).c_str(), &st) == 0) {
+        data->dwFileAttributes = ToAttributes(st);
+        data->ftLastAccessTime = ToFileTime(st.st_atim);
+        data->ftLastWriteTime = ToFileTime(st.st_mtim);
+        data->ftCreationTime = data->ftLastWriteTime;
+        data->nFileSizeHigh = (DWORD)((UINT64)st.st_size >> 32);
+        data->nFileSizeLow = (DWORD)st.st_size;
+    }
+
+    std::wstring wide = Tootega::XStringConversion::Utf8ToWide(name);
+    size_t length = (std::min)(wide.size(), (size_t)MAX_PATH - 1);
+    wmemcpy(data->cFileName, wide.data(), length);
+    data->cFileName[length] = 0;
+}
+
+// Next entry of a find handle matching its pattern, skipping "." and ".."
+bool NextMatch(CompatHandle* find, WIN32_FIND_DATAW* data) {
+    while (struct dirent* entry = readdir(find->Dir)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if (fnmatch(find->Pattern.c_str(), entry->d_name, 0) != 0) continue;
+        FillFindData(find->Directory, entry->d_name, data);
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// Errors
+DWORD GetLastError() {
+    return g_LastError;
+}
+
+void SetLastError(DWORD error) {
+    g_LastError = error;
+}
+
+// Files
+HANDLE CreateFileW(LPCWSTR path, DWORD access, DWORD share, LPSECURITY_ATTRIBUTES security,
+                   DWORD disposition, DWORD flags, HANDLE templateFile) {
+    int mode = O_CLOEXEC;
+    if ((access & GENERIC_READ) && (access & GENERIC_WRITE)) mode |= O_RDWR;
+    else if (access & GENERIC_WRITE) mode |= O_WRONLY;
+    else mode |= O_RDONLY;
+
+    switch (disposition) {
+    case CREATE_NEW:        mode |= O_CREAT | O_EXCL; break;
+    case CREATE_ALWAYS:     mode |= O_CREAT | O_TRUNC; break;
+    case OPEN_ALWAYS:       mode |= O_CREAT; break;
+    case TRUNCATE_EXISTING: mode |= O_TRUNC; break;
+    default: break;
+    }
+
+    int fd = open(NativePath(path).c_str(), mode, 0666);
+    if (fd < 0) {
+        Fail(errno);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    CompatHandle* h = new CompatHandle(HandleKind::File);
+    h->Fd = fd;
+    return h;
+}
+
+BOOL ReadFile(HANDLE file, void* buffer, DWORD size, LPDWORD read, LPOVERLAPPED overlapped) {
+    CompatHandle* h = AsHandle(file, HandleKind::File);
+    if (!h) return Fail(EBADF);
+
+    // Overlapped reads are positional and complete here; GetOverlappedResult
+    // reports them
+    UINT64 offset = overlapped ? (((UINT64)overlapped->OffsetHigh << 32) | overlapped->Offset) : 0;
+    DWORD total = 0;
+    while (total < size) {
+        ssize_t n = overlapped
+            ? pread(h->Fd, (BYTE*)buffer + total, size - total, (off_t)(offset + total))
+            : ::read(h->Fd, (BYTE*)buffer + total, size - total);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return Fail(errno);
+        }
+        if (n == 0) break;
+        total += (DWORD)n;
+    }
+
+    if (read) *read = total;
+    if (overlapped) {
+        overlapped->Internal = 0;
+        overlapped->InternalHigh = total;
+        if (total == 0 && size > 0) return Fail(ERROR_HANDLE_EOF);
+    }
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE file, LPCVOID buffer, DWORD size, LPDWORD written, LPOVERLAPPED overlapped) {
+    CompatHandle* h = AsHandle(file, HandleKind::File);
+    if (!h) return Fail(EBADF);
+
+    UINT64 offset = overlapped ? (((UINT64)overlapped->OffsetHigh << 32) | overlapped->Offset) : 0;
+    DWORD total = 0;
+    while (total < size) {
+        ssize_t n = overlapped
+            ? pwrite(h->Fd, (const BYTE*)buffer + total, size - total, (off_t)(offset + total))
+            : ::write(h->Fd, (const BYTE*)buffer + total, size - total);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (written) *written = total;
+            return Fail(errno);
+        }
+        total += (DWORD)n;
+    }
+
+    if (written) *written = total;
+    if (overlapped) {
+        overlapped->Internal = 0;
+        overlapped->InternalHigh = total;
+    }
+    return TRUE;
+}
+
+BOOL GetOverlappedResult(HANDLE file, LPOVERLAPPED overlapped, LPDWORD transferred, BOOL wait) {
+    *transferred = (DWORD)overlapped->InternalHigh;
+    return TRUE;
+}
+
+BOOL GetFileSizeEx(HANDLE file, PLARGE_INTEGER size) {
+    CompatHandle* h = AsHandle(file, HandleKind::File);
+    if (!h) return Fail(EBADF);
+
+    struct stat st;
+    if (fstat(h->Fd, &st) != 0) return Fail(errno);
+    size->QuadPart = (LONGLONG)st.st_size;
+    return TRUE;
+}
+
+BOOL SetFileTime(HANDLE file, const FILETIME* created, const FILETIME* accessed, const FILETIME* modified) {
+    CompatHandle* h = AsHandle(file, HandleKind::File);
+    if (!h) return Fail(EBADF);
+
+    // No creation time on POSIX file systems
+    struct timespec times[2];
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_nsec = UTIME_OMIT;
+    if (accessed) times[0] = ToTimespec(*accessed);
+    if (modified) times[1] = ToTimespec(*modified);
+    return futimens(h->Fd, times) == 0 ? TRUE : Fail(errno);
+}
+
+BOOL SetFileInformationByHandle(HANDLE file, FILE_INFO_BY_HANDLE_CLASS infoClass, void* info, DWORD size) {
+    CompatHandle* h = AsHandle(file, HandleKind::File);
+    if (!h) return Fail(EBADF);
+
+    if (infoClass == FileAllocationInfo && size >= sizeof(FILE_ALLOCATION_INFO)) {
+        const FILE_ALLOCATION_INFO* allocation = static_cast<const FILE_ALLOCATION_INFO*>(info);
+        if (allocation->AllocationSize.QuadPart <= 0) return TRUE;
+        int res = fallocate(h->Fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)allocation->AllocationSize.QuadPart);
+        return (res == 0 || errno == EOPNOTSUPP) ? TRUE : Fail(errno);
+    }
+
+    if (infoClass == FileBasicInfo && size >= sizeof(FILE_BASIC_INFO)) {
+        const FILE_BASIC_INFO* basic = static_cast<const FILE_BASIC_INFO*>(info);
+
+        // Zero leaves a time unchanged; there is no creation time here
+        struct timespec times[2];
+        times[0].tv_nsec = UTIME_OMIT;
+        times[1].tv_nsec = UTIME_OMIT;
+        FILETIME ft;
+        if (basic->LastAccessTime.QuadPart != 0) {
+            ft.dwLowDateTime = basic->LastAccessTime.LowPart;
+            ft.dwHighDateTime = (DWORD)basic->LastAccessTime.HighPart;
+            times[0] = ToTimespec(ft);
+        }
+        if (basic->LastWriteTime.QuadPart != 0) {
+            ft.dwLowDateTime = basic->LastWriteTime.LowPart;
+            ft.dwHighDateTime = (DWORD)basic->LastWriteTime.HighPart;
+            times[1] = ToTimespec(ft);
+        }
+        if (futimens(h->Fd, times) != 0) return Fail(errno);
+
+        if (basic->FileAttributes & FILE_ATTRIBUTE_READONLY) {
+            struct stat st;
+            if (fstat(h->Fd, &st) != 0) return Fail(errno);
+            if (fchmod(h->Fd, st.st_mode & 07777 & ~(mode_t)(S_IWUSR | S_IWGRP | S_IWOTH)) != 0) return Fail(errno);
+        }
+        return TRUE;
+    }
+
+    return Fail(EINVAL);
+}
+
+BOOL CloseHandle(HANDLE handle) {
+    if (!handle || handle == INVALID_HANDLE_VALUE) return Fail(EBADF);
+
+    CompatHandle* h = static_cast<CompatHandle*>(handle);
+    if (h->Fd >= 0) close(h->Fd);
+    if (h->Dir) closedir(h->Dir);
+    delete h;
+    return TRUE;
+}
+
+DWORD GetFileAttributesW(LPCWSTR path) {
+    struct stat st;
+    if (stat(NativePath(path).c_str(), &st) != 0) {
+        Fail(errno);
+        return INVALID_FILE_ATTRIBUTES;
+    }
+    return ToAttributes(st);
+}
+
+BOOL GetFileAttributesExW(LPCWSTR path, GET_FILEEX_INFO_LEVELS level, void* info) {
+    struct stat st;
+    if (stat(NativePath(path).c_str(), &st) != 0) return Fail(errno);
+
+    WIN32_FILE_ATTRIBUTE_DATA* data = static_cast<WIN32_FILE_ATTRIBUTE_DATA*>(info);
+    data->dwFileAttributes = ToAttributes(st);
+    data->ftLastAccessTime = ToFileTime(st.st_atim);
+    data->ftLastWriteTime = ToFileTime(st.st_mtim);
+    data->ftCreationTime = data->ftLastWriteTime;
+    data->nFileSizeHigh = (DWORD)((UINT64)st.st_size >> 32);
+    data->nFileSizeLow = (DWORD)st.st_size;
+    return TRUE;
+}
+
+BOOL SetFileAttributesW(LPCWSTR path, DWORD attributes) {
+    std::string native = NativePath(path);
+    struct stat st;
+    if (stat(native.c_str(), &st) != 0) return Fail(errno);
+
+    // Only the read-only bit maps onto POSIX permissions
+    mode_t mode = st.st_mode & 07777;
+    if (attributes & FILE_ATTRIBUTE_READONLY) mode &= ~(mode_t)(S_IWUSR | S_IWGRP | S_IWOTH);
+    else mode |= S_IWUSR;
+    return chmod(native.c_str(), mode) == 0 ? TRUE : Fail(errno);
+}
+
+BOOL DeleteFileW(LPCWSTR path) {
+    return unlink(NativePath(path).c_str()) == 0 ? TRUE : Fail(errno);
+}
+
+BOOL MoveFileExW(LPCWSTR from, LPCWSTR to, DWORD flags) {
+    std::string target = NativePath(to);
+    struct stat st;
+    if (!(flags & MOVEFILE_REPLACE_EXISTING) && stat(target.c_str(), &st) == 0) return Fail(EEXIST);
+    return rename(NativePath(from).c_str(), target.c_str()) == 0 ? TRUE : Fail(errno);
+}
+
+BOOL CreateHardLinkW(LPCWSTR link, LPCWSTR existing, LPSECURITY_ATTRIBUTES security) {
+    return ::link(NativePath(existing).c_str(), NativePath(link).c_str()) == 0 ? TRUE : Fail(errno);
+}
+
+BOOL CopyFileW(LPCWSTR from, LPCWSTR to, BOOL failIfExists) {
+    int in = open(NativePath(from).c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return Fail(errno);
+    struct stat st;
+    int out = -1;
+    if (fstat(in, &st) == 0) {
+        int mode = O_WRONLY | O_CREAT | O_CLOEXEC | (failIfExists ? O_EXCL : O_TRUNC);
+        out = open(NativePath(to).c_str(), mode, st.st_mode & 07777);
+    }
+    if (out < 0) {
+        int err = errno;
+        close(in);
+        return Fail(err);
+    }
+
+    char buffer[64 * 1024];
+    ssize_t n;
+    bool ok = true;
+    while (ok && (n = ::read(in, buffer, sizeof(buffer))) != 0) {
+        ok = n > 0 && ::write(out, buffer, (size_t)n) == n;
+    }
+    int err = errno;
+    close(in);
+    close(out);
+    return ok ? TRUE : Fail(err);
+}
+
+BOOL CreateDirectoryW(LPCWSTR path, LPSECURITY_ATTRIBUTES security) {
+    return mkdir(NativePath(path).c_str(), 0777) == 0 ? TRUE : Fail(errno);
+}
+
+BOOL RemoveDirectoryW(LPCWSTR path) {
+    return rmdir(NativePath(path).c_str()) == 0 ? TRUE : Fail(errno);
+}
+
+int SHCreateDirectoryExW(HWND window, LPCWSTR path, const SECURITY_ATTRIBUTES* security) {
+    std::string native = NativePath(path);
+    struct stat st;
+    if (stat(native.c_str(), &st) == 0) return ERROR_ALREADY_EXISTS;
+
+    // Create each missing parent in turn
+    for (size_t pos = native.find('/', 1); ; pos = native.find('/', pos + 1)) {
+        std::string part = native.substr(0, pos);
+        if (mkdir(part.c_str(), 0777) != 0 && errno != EEXIST) return errno;
+        if (pos == std::string::npos) break;
+    }
+    return ERROR_SUCCESS;
+}
+
+HANDLE FindFirstFileW(LPCWSTR pattern, WIN32_FIND_DATAW* data) {
+    std::string native = NativePath(pattern);
+    size_t slash = native.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "./" : native.substr(0, slash + 1);
+
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        Fail(errno);
+        return INVALID_HANDLE_VALUE;
+    }
+
+    CompatHandle* h = new CompatHandle(HandleKind::Find);
+    h->Dir = dir;
+    h->Directory = directory;
+    h->Pattern = (slash == std::string::npos) ? native : native.substr(slash + 1);
+    if (!NextMatch(h, data)) {
+        CloseHandle(h);
+        Fail(ERROR_FILE_NOT_FOUND);
+        return INVALID_HANDLE_VALUE;
+    }
+    return h;
+}
+
+BOOL FindNextFileW(HANDLE find, WIN32_FIND_DATAW* data) {
+    CompatHandle* h = AsHandle(find, HandleKind::Find);
+    if (!h) return Fail(EBADF);
+    return NextMatch(h, data) ? TRUE : Fail(ENOENT);
+}
+
+BOOL FindClose(HANDLE find) {
+    return CloseHandle(find);
+}
+
+BOOL GetVolumePathNameW(LPCWSTR path, LPWSTR volume, DWORD size) {
+    // Every file is treated as local; see GetDriveTypeW
+    return Fail(ENOSYS);
+}
+
+UINT GetDriveTypeW(LPCWSTR root) {
+    return DRIVE_FIXED;
+}
+
+DWORD GetTempPathW(DWORD size, LPWSTR buffer) {
+    const char* tmp = getenv("TMPDIR");
+    std::wstring path = Tootega::XStringConversion::Utf8ToWide((tmp && *tmp) ? tmp : "/tmp");
+    if (path.back() != L'/') path += L'/';
+    if (path.size() + 1 > size) return (DWORD)(path.size() + 1);
+    wmemcpy(buffer, path.c_str(), path.size() + 1);
+    return (DWORD)path.size();
+}
+
+// Mappings
+HANDLE CreateFileMappingW(HANDLE file, LPSECURITY_ATTRIBUTES security, DWORD protect,
+                          DWORD sizeHigh, DWORD sizeLow, LPCWSTR name) {
+    CompatHandle* source = AsHandle(file, HandleKind::File);
+    if (!source) {
+        Fail(EBADF);
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(source->Fd, &st) != 0) {
+        Fail(errno);
+        return nullptr;
+    }
+
+    // Like Windows, an empty file cannot be mapped
+    if (st.st_size == 0) {
+        Fail(EINVAL);
+        return nullptr;
+    }
+
+    // The mapping keeps the file open on its own
+    CompatHandle* h = new CompatHandle(HandleKind::Mapping);
+    h->Fd = dup(source->Fd);
+    h->Size = (UINT64)st.st_size;
+    return h;
+}
+
+void* MapViewOfFile(HANDLE mapping, DWORD access, DWORD offsetHigh, DWORD offsetLow, SIZE_T size) {
+    CompatHandle* h = AsHandle(mapping, HandleKind::Mapping);
+    if (!h) {
+        Fail(EBADF);
+        return nullptr;
+    }
+
+    UINT64 offset = ((UINT64)offsetHigh << 32) | offsetLow;
+    size_t length = size ? size : (size_t)(h->Size - offset);
+    void* view = mmap(nullptr, length, PROT_READ, MAP_SHARED, h->Fd, (off_t)offset);
+    if (view == MAP_FAILED) {
+        Fail(errno);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_ViewsMutex);
+    g_Views[view] = length;
+    return view;
+}
+
+BOOL UnmapViewOfFile(LPCVOID view) {
+    size_t length;
+    {
+        std::lock_guard<std::mutex> lock(g_ViewsMutex);
+        auto it = g_Views.find(view);
+        if (it == g_Views.end()) return Fail(EINVAL);
+        length = it->second;
+        g_Views.erase(it);
+    }
+    return munmap(const_cast<void*>(view), length) == 0 ? TRUE : Fail(errno);
+}
+
+// Events
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES security, BOOL manualReset, BOOL initialState, LPCWSTR name) {
+    return new CompatHandle(HandleKind::Event);
+}
+
+BOOL SetEvent(HANDLE event) {
+    return AsHandle(event, HandleKind::Event) ? TRUE : Fail(EBADF);
+}
+
+BOOL ResetEvent(HANDLE event) {
+    return AsHandle(event, HandleKind::Event) ? TRUE : Fail(EBADF);
+}
+
+// Process and time
+DWORD GetCurrentProcessId() {
+    return (DWORD)getpid();
+}
+
+DWORD GetCurrentThreadId() {
+    return (DWORD)syscall(SYS_gettid);
+}
+
+void GetSystemTimeAsFileTime(LPFILETIME time) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    *time = ToFileTime(now);
+}
+
+LONG CompareFileTime(const FILETIME* a, const FILETIME* b) {
+    UINT64 x = ((UINT64)a->dwHighDateTime << 32) | a->dwLowDateTime;
+    UINT64 y = ((UINT64)b->dwHighDateTime << 32) | b->dwLowDateTime;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+ULONGLONG GetTickCount64() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ULONGLONG)now.tv_sec * 1000 + (ULONGLONG)now.tv_nsec / 1000000;
+}
+
+void Sleep(DWORD milliseconds) {
+    struct timespec delay;
+    delay.tv_sec = milliseconds / 1000;
+    delay.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+    nanosleep(&delay, nullptr);
+}
+
+// Shell
+const KNOWNFOLDERID FOLDERID_LocalAppData =
+    { 0xF1B32785, 0x6FBA, 0x4FCF, { 0x9D, 0x55, 0x7B, 0x8E, 0x7F, 0x15, 0x70, 0x91 } };
+
+HRESULT SHGetKnownFolderPath(REFKNOWNFOLDERID id, DWORD flags, HANDLE token, PWSTR* path) {
+    *path = nullptr;
+    if (memcmp(&id, &FOLDERID_LocalAppData, sizeof(GUID)) != 0) return E_FAIL;
+
+    std::string directory;
+    const char* cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (cache && *cache) directory = cache;
+    else if (home && *home) directory = std::string(home) + "/.cache";
+    else return E_FAIL;
+    mkdir(directory.c_str(), 0777);
+
+    std::wstring wide = Tootega::XStringConversion::Utf8ToWide(directory.c_str());
+    *path = static_cast<PWSTR>(malloc((wide.size() + 1) * sizeof(WCHAR)));
+    if (!*path) return E_FAIL;
+    wmemcpy(*path, wide.c_str(), wide.size() + 1);
+    return S_OK;
+}
+
+void CoTaskMemFree(void* p) {
+    free(p);
+}
+
+// strsafe
+HRESULT StringCchPrintfW(LPWSTR dest, size_t count, LPCWSTR format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vswprintf(dest, count, format, args);
+    va_end(args);
+    return (written < 0) ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+// TootegaWinLib string conversion
+namespace Tootega {
+
+std::wstring XStringConversion::Utf8ToWide(const char* utf8) {
+    std::wstring wide;
+    if (!utf8) return wide;
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(utf8);
+    while (*p) {
+        UInt32 c = *p++;
+        int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : 0;
+        if (extra) c &= (0x3F >> extra);
+        for (; extra > 0 && (*p & 0xC0) == 0x80; extra--) c = (c << 6) | (*p++ & 0x3F);
+        if (extra) c = 0xFFFD;              // Truncated sequence
+
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            wide += (wchar_t)(0xD800 + (c >> 10));
+            wide += (wchar_t)(0xDC00 + (c & 0x3FF));
+        } else {
+            wide += (wchar_t)c;
+        }
+    }
+    return wide;
+}
+
+std::string XStringConversion::WideToUtf8(const wchar_t* wide) {
+    std::string utf8;
+    if (!wide) return utf8;
+
+    for (const wchar_t* p = wide; *p; p++) {
+        UInt32 c = (UInt16)*p;
+        if (c >= 0xD800 && c < 0xDC00 && p[1] >= 0xDC00 && p[1] < 0xE000) {
+            c = 0x10000 + ((c - 0xD800) << 10) + ((UInt16)p[1] - 0xDC00);
+            p++;
+        }
+
+        if (c < 0x80) {
+            utf8 += (char)c;
+        } else if (c < 0x800) {
+            utf8 += (char)(0xC0 | (c >> 6));
+            utf8 += (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            utf8 += (char)(0xE0 | (c >> 12));
+            utf8 += (char)(0x80 | ((c >> 6) & 0x3F));
+            utf8 += (char)(0x80 | (c & 0x3F));
+        } else {
+            utf8 += (char)(0xF0 | (c >> 18));
+            utf8 += (char)(0x80 | ((c >> 12) & 0x3F));
+            utf8 += (char)(0x80 | ((c >> 6) & 0x3F));
+            utf8 += (char)(0x80 | (c & 0x3F));
+        }
+    }
+    return utf8;
+}
+
+std::wstring XStringConversion::FormatFileSize(UINT64 size) {
+    static const wchar_t* const units[] = { L"bytes", L"KB", L"MB", L"GB", L"TB" };
+    double value = (double)size;
+    int unit = 0;
+    while (value >= 1024.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+
+    wchar_t text[64];
+    if (unit == 0) StringCchPrintfW(text, ARRAYSIZE(text), L"%llu %s", (unsigned long long)size, units[0]);
+    else StringCchPrintfW(text, ARRAYSIZE(text), L"%.1f %s", value, units[unit]);
+    return text;
+}
+
+std::wstring XStringConversion::FormatCompressionRatio(UINT64 compressed, UINT64 original) {
+    if (original == 0) return L"0%";
+
+    wchar_t text[32];
+    StringCchPrintfW(text, ARRAYSIZE(text), L"%.0f%%", 100.0 * (double)compressed / (double)original);
+    return text;
+}
+
+} // namespace Tootega
@@ -0,0 +1,273 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Win32 Stand-ins for the POSIX Benchmark Build
+**
+** The subset of the Win32 API that the core (src/Core and the extraction
+** engine) calls, implemented over POSIX in Win32Compat.cpp, so the benchmark
+** tools build and run on Linux without Explorer. The headers next to this
+** one stand in for the Windows and TootegaWinLib headers Common.h includes.
+**
+** The core views 7z names (UTF-16) as wchar_t, so this build uses a 16-bit
+** wchar_t (-fshort-wchar); WideChar.c supplies the matching C runtime.
+*/
+
+#ifndef SEVENZIPVIEW_WIN32COMPAT_H
+#define SEVENZIPVIEW_WIN32COMPAT_H
+
+#ifdef _WIN32
+#error "Win32Compat.h replaces the Windows headers on other platforms only"
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#ifdef __cplusplus
+static_assert(sizeof(wchar_t) == 2, "build with -fshort-wchar: the core views UTF-16 as wchar_t");
+#endif
+
+// The SDK's own non-Windows typedefs (DWORD, LONG, HRESULT...) and the errno
+// based ERROR_ codes, which GetLastError returns here
+#include "7zTypes.h"
+
+// Types
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned short USHORT;
+typedef int BOOL;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef uint64_t ULONGLONG;
+typedef int64_t LONGLONG;
+typedef UINT_PTR ULONG_PTR;
+typedef wchar_t WCHAR;
+typedef WCHAR* LPWSTR;
+typedef WCHAR* PWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef const void* LPCVOID;
+typedef DWORD* LPDWORD;
+typedef void* HANDLE;
+typedef HANDLE HMODULE;
+typedef HANDLE HWND;
+typedef UINT_PTR WPARAM;
+typedef LONG_PTR LPARAM;
+
+typedef struct _FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME, *LPFILETIME;
+
+typedef union _LARGE_INTEGER {
+    struct {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef struct _OVERLAPPED {
+    ULONG_PTR Internal;             // Status of the request
+    ULONG_PTR InternalHigh;         // Bytes transferred
+    union {
+        struct {
+            DWORD Offset;
+            DWORD OffsetHigh;
+        };
+        void* Pointer;
+    };
+    HANDLE hEvent;
+} OVERLAPPED, *LPOVERLAPPED;
+
+typedef struct _SECURITY_ATTRIBUTES {
+    DWORD nLength;
+    void* lpSecurityDescriptor;
+    BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+typedef enum _GET_FILEEX_INFO_LEVELS {
+    GetFileExInfoStandard
+} GET_FILEEX_INFO_LEVELS;
+
+typedef struct _WIN32_FILE_ATTRIBUTE_DATA {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+
+typedef enum _FILE_INFO_BY_HANDLE_CLASS {
+    FileBasicInfo = 0,
+    FileAllocationInfo = 5
+} FILE_INFO_BY_HANDLE_CLASS;
+
+typedef struct _FILE_BASIC_INFO {
+    LARGE_INTEGER CreationTime;
+    LARGE_INTEGER LastAccessTime;
+    LARGE_INTEGER LastWriteTime;
+    LARGE_INTEGER ChangeTime;
+    DWORD FileAttributes;
+} FILE_BASIC_INFO;
+
+typedef struct _FILE_ALLOCATION_INFO {
+    LARGE_INTEGER AllocationSize;
+} FILE_ALLOCATION_INFO;
+
+#define MAX_PATH 260
+
+typedef struct _WIN32_FIND_DATAW {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+    DWORD dwReserved0;
+    DWORD dwReserved1;
+    WCHAR cFileName[MAX_PATH];
+    WCHAR cAlternateFileName[14];
+} WIN32_FIND_DATAW;
+
+typedef struct _GUID {
+    DWORD Data1;
+    WORD Data2;
+    WORD Data3;
+    BYTE Data4[8];
+} GUID, IID, CLSID, KNOWNFOLDERID;
+
+typedef struct _PROPERTYKEY {
+    GUID fmtid;
+    DWORD pid;
+} PROPERTYKEY;
+
+#ifdef __cplusplus
+typedef const GUID& REFKNOWNFOLDERID;
+#endif
+
+// Constants
+#define TRUE 1
+#define FALSE 0
+#define WINAPI
+#define CALLBACK
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define INVALID_FILE_ATTRIBUTES ((DWORD)-1)
+
+#define GENERIC_READ 0x80000000u
+#define GENERIC_WRITE 0x40000000u
+#define FILE_WRITE_ATTRIBUTES 0x0100
+#define FILE_SHARE_READ 0x01
+#define FILE_SHARE_WRITE 0x02
+#define FILE_SHARE_DELETE 0x04
+
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define TRUNCATE_EXISTING 5
+
+#define FILE_FLAG_OVERLAPPED 0x40000000
+#define FILE_FLAG_RANDOM_ACCESS 0x10000000
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+
+#define PAGE_READONLY 0x02
+#define FILE_MAP_READ 0x04
+
+#define MOVEFILE_REPLACE_EXISTING 0x01
+
+#define DRIVE_FIXED 3
+#define DRIVE_REMOTE 4
+
+#define ERROR_SUCCESS 0
+#define ERROR_ACCESS_DENIED EACCES
+#define ERROR_SHARING_VIOLATION EBUSY
+#define ERROR_HANDLE_EOF 0x10026            // No errno equivalent
+#define ERROR_IO_PENDING 0x103E5
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007AL)
+
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define CopyMemory(d, s, n) memcpy((d), (s), (n))
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define UNREFERENCED_PARAMETER(x) (void)(x)
+
+#ifdef __cplusplus
+
+// Errors
+DWORD GetLastError();
+void SetLastError(DWORD error);
+
+// Files. Paths are UTF-16 with '\' or '/' separators.
+HANDLE CreateFileW(LPCWSTR path, DWORD access, DWORD share, LPSECURITY_ATTRIBUTES security,
+                   DWORD disposition, DWORD flags, HANDLE templateFile);
+BOOL ReadFile(HANDLE file, void* buffer, DWORD size, LPDWORD read, LPOVERLAPPED overlapped);
+BOOL WriteFile(HANDLE file, LPCVOID buffer, DWORD size, LPDWORD written, LPOVERLAPPED overlapped);
+BOOL GetOverlappedResult(HANDLE file, LPOVERLAPPED overlapped, LPDWORD transferred, BOOL wait);
+BOOL GetFileSizeEx(HANDLE file, PLARGE_INTEGER size);
+BOOL SetFileTime(HANDLE file, const FILETIME* created, const FILETIME* accessed, const FILETIME* modified);
+// FileBasicInfo (times, read-only bit) and FileAllocationInfo only
+BOOL SetFileInformationByHandle(HANDLE file, FILE_INFO_BY_HANDLE_CLASS infoClass, void* info, DWORD size);
+BOOL CloseHandle(HANDLE handle);
+
+DWORD GetFileAttributesW(LPCWSTR path);
+BOOL GetFileAttributesExW(LPCWSTR path, GET_FILEEX_INFO_LEVELS level, void* info);
+BOOL SetFileAttributesW(LPCWSTR path, DWORD attributes);
+BOOL DeleteFileW(LPCWSTR path);
+BOOL MoveFileExW(LPCWSTR from, LPCWSTR to, DWORD flags);
+BOOL CreateHardLinkW(LPCWSTR link, LPCWSTR existing, LPSECURITY_ATTRIBUTES security);
+BOOL CopyFileW(LPCWSTR from, LPCWSTR to, BOOL failIfExists);
+BOOL CreateDirectoryW(LPCWSTR path, LPSECURITY_ATTRIBUTES security);
+BOOL RemoveDirectoryW(LPCWSTR path);
+int SHCreateDirectoryExW(HWND window, LPCWSTR path, const SECURITY_ATTRIBUTES* security);
+
+HANDLE FindFirstFileW(LPCWSTR pattern, WIN32_FIND_DATAW* data);
+BOOL FindNextFileW(HANDLE find, WIN32_FIND_DATAW* data);
+BOOL FindClose(HANDLE find);
+
+BOOL GetVolumePathNameW(LPCWSTR path, LPWSTR volume, DWORD size);
+UINT GetDriveTypeW(LPCWSTR root);
+DWORD GetTempPathW(DWORD size, LPWSTR buffer);
+
+// Read-only mappings of a whole file
+HANDLE CreateFileMappingW(HANDLE file, LPSECURITY_ATTRIBUTES security, DWORD protect,
+                          DWORD sizeHigh, DWORD sizeLow, LPCWSTR name);
+void* MapViewOfFile(HANDLE mapping, DWORD access, DWORD offsetHigh, DWORD offsetLow, SIZE_T size);
+BOOL UnmapViewOfFile(LPCVOID view);
+
+// Reads complete before ReadFile returns, so events are never waited on
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES security, BOOL manualReset, BOOL initialState, LPCWSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+
+// Process and time
+DWORD GetCurrentProcessId();
+DWORD GetCurrentThreadId();
+void GetSystemTimeAsFileTime(LPFILETIME time);
+LONG CompareFileTime(const FILETIME* a, const FILETIME* b);
+ULONGLONG GetTickCount64();
+void Sleep(DWORD milliseconds);
+
+// Shell: FOLDERID_LocalAppData is $XDG_CACHE_HOME, else ~/.cache
+extern const KNOWNFOLDERID FOLDERID_LocalAppData;
+HRESULT SHGetKnownFolderPath(REFKNOWNFOLDERID id, DWORD flags, HANDLE token, PWSTR* path);
+void CoTaskMemFree(void* p);
+
+// strsafe
+HRESULT StringCchPrintfW(LPWSTR dest, size_t count, LPCWSTR format, ...);
+
+#endif // __cplusplus
+
+#endif // SEVENZIPVIEW_WIN32COMPAT_H
@@ -0,0 +1,20 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Stand-in for TootegaWinLib XPlatform.h in the POSIX benchmark build
+*/
+
+#include "Win32Compat.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <array>
+#include <algorithm>
+#include <type_traits>
@@ -0,0 +1,20 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Stand-in for TootegaWinLib XStringConversion.h in the POSIX benchmark build
+*/
+
+#include "XPlatform.h"
+
+namespace Tootega {
+
+// Implemented in Win32Compat.cpp
+class XStringConversion final {
+public:
+    static std::wstring Utf8ToWide(const char* utf8);
+    static std::string WideToUtf8(const wchar_t* wide);
+    static std::wstring FormatFileSize(UINT64 size);
+    static std::wstring FormatCompressionRatio(UINT64 compressed, UINT64 original);
+};
+
+} // namespace Tootega
@@ -0,0 +1,3 @@
+#pragma once
+// Stand-in for <strsafe.h> in the POSIX benchmark build
+#include "Win32Compat.h"
@@ -0,0 +1,111 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** 7zAES Coder Properties and Derived Key Cache
+*/
+
+#ifndef SEVENZIPVIEW_AESKEYCACHE_H
+#define SEVENZIPVIEW_AESKEYCACHE_H
+
+#include "Common.h"
+#include <array>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+extern "C" {
+#include "Aes.h"
+}
+
+namespace SevenZipView {
+
+// 7zAES coder method ID (AES-256 in CBC mode, SHA-256 key derivation)
+static const UInt32 METHOD_7Z_AES = 0x6F10701;
+
+// AES-256 key bytes
+static const unsigned AES_KEY_SIZE = 32;
+
+// Largest key derivation 7-Zip accepts: 2^24 SHA-256 rounds
+static const unsigned AES_MAX_CYCLES_POWER = 24;
+
+// Properties of a 7zAES coder: the key is SHA-256 over salt, password and
+// a round counter, repeated 2^NumCyclesPower times; the IV starts CBC
+struct AesCoderProps {
+    unsigned    NumCyclesPower;
+    unsigned    SaltSize;
+    Byte        Salt[16];
+    Byte        Iv[AES_BLOCK_SIZE];         // Zero-padded
+
+    // Parse the coder's property bytes
+    static SRes Parse(const Byte* props, unsigned size, AesCoderProps& result);
+};
+
+struct AesKeyCacheStats {
+    UINT64  Derivations;        // Keys computed, each 2^NumCyclesPower SHA-256 rounds
+    UINT64  Hits;               // Keys served without deriving
+};
+
+// Password of one archive and the keys derived from it. Every encrypted
+// folder names its salt and round count, and 7-Zip gives all folders of an
+// archive the same ones, so the key is derived once and each further folder,
+// reader or worker gets it from here. Thread-safe; a derivation runs
+// without the lock, and callers wanting the same key wait for it.
+class AesKeyCache {
+public:
+    AesKeyCache();
+    ~AesKeyCache();
+
+    AesKeyCache(const AesKeyCache&) = delete;
+    AesKeyCache& operator=(const AesKeyCache&) = delete;
+
+    // Keys of an earlier password stay cached; they are keyed by its hash.
+    // True if a different password was set before.
+    bool SetPassword(const std::wstring& password);
+    bool HasPassword() const;
+
+    // Key of a folder's 7zAES coder for the current password. Fails with
+    // SZ_ERROR_PARAM when no password is set and SZ_ERROR_UNSUPPORTED for a
+    // round count past AES_MAX_CYCLES_POWER.
+    SRes GetKey(const AesCoderProps& props, Byte* key);
+
+    // Forget the password and every key
+    void Clear();
+
+    AesKeyCacheStats GetStats() const;
+
+    // The 7zAES key derivation itself, uncached
+    static void DeriveKey(const std::wstring& password, const AesCoderProps& props, Byte* key);
+
+private:
+    typedef std::array<Byte, 32> Digest;
+
+    struct Key {
+        Digest          PasswordHash;       // Never the password itself
+        std::string     Salt;
+        unsigned        NumCyclesPower;
+
+        bool operator<(const Key& other) const;
+    };
+
+    // A key being derived (Ready false) or derived
+    struct Slot {
+        std::array<Byte, AES_KEY_SIZE>  Value;
+        bool                            Ready;
+    };
+
+    // SHA-256 over _HashSalt and the password
+    Digest HashPassword(const std::wstring& password) const;
+
+    mutable std::mutex  _Mutex;
+    std::condition_variable _Derived;       // A slot became ready, or Clear dropped it
+    std::wstring        _Password;
+    Digest              _PasswordHash;
+    bool                _HasPassword;
+    Byte                _HashSalt[16];      // Random per cache
+    std::map<Key, Slot> _Keys;
+    AesKeyCacheStats    _Stats;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_AESKEYCACHE_H
@@ -8,7 +8,19 @@
 #define SEVENZIPVIEW_ARCHIVE_H
 
 #include "Common.h"
+#include "AesKeyCache.h"
 #include "ArchiveEntry.h"
+#include "BlockCache.h"
+#include "FolderDecoder.h"
+#include "MappedInStream.h"
+#include "PathIndex.h"
+#include "SdkAlloc.h"
+#include "SharedInStream.h"
+#include "EntryTable.h"
+#include "ExtractSink.h"
+#include "DirectoryIndex.h"
+#include "IndexCache.h"
+#include <list>
 #include <memory>
 #include <mutex>
 
@@ -16,40 +28,138 @@ namespace SevenZipView {
 
 // Forward declaration
 class Archive;
+class ArchiveReader;
 
-// Archive pool for caching open archives
+// Readers an Archive keeps for reuse between extraction calls
+static const size_t ARCHIVE_MAX_IDLE_READERS = 4;
+
+// How Archive::Open reads the archive file
+enum class ArchiveStreamMode : BYTE {
+    Auto,           // Memory-mapped, buffered reads when mapping fails
+    Mapped,         // Memory-mapped only
+    Buffered        // Overlapped reads with a 256KB look-ahead buffer per stream
+};
+
+// How many released archives ArchivePool keeps open, and for how long
+struct ArchivePoolLimits {
+    size_t  MaxMemory;          // Estimated heap bytes of retained archives
+    UINT32  MaxArchives;        // Retained archives (each holds file handles)
+    DWORD   IdleTimeoutMs;      // Unused longer than this is closed
+    
+    ArchivePoolLimits()
+        : MaxMemory(256 * 1024 * 1024)
+        , MaxArchives(8)
+        , IdleTimeoutMs(60 * 1000) {}
+};
+
+struct ArchivePoolStats {
+    UINT64  Hits;               // Served an archive that was already open
+    UINT64  Misses;             // Had to open the archive
+    UINT64  Evictions;          // Released for a limit or the idle timeout
+    UINT64  Invalidations;      // Dropped because the file changed on disk
+    UINT32  Retained;           // Archives the pool currently keeps open
+    size_t  RetainedMemory;
+};
+
+// Archive pool for caching open archives. Besides sharing archives that are
+// in use, it keeps recently released ones open (least recently used first
+// out) within ArchivePoolLimits, so Explorer navigating back into an archive
+// does not reopen it. A file whose size or write time changed is reopened.
 class ArchivePool {
 public:
     static ArchivePool& Instance();
     
+    // Open or reuse the archive at path. A path that runs on past an archive
+    // file into its entries ("C:\a.7z\docs\b.7z") names a nested archive:
+    // it is opened from memory through the outer archive, at any depth, and
+    // reopened when the outer file changes on disk.
     std::shared_ptr<Archive> GetArchive(const std::wstring& path);
     void Remove(const std::wstring& path);
     void Clear();
     
+    void SetLimits(const ArchivePoolLimits& limits);
+    ArchivePoolLimits GetLimits() const;
+    ArchivePoolStats GetStats() const;
+    
+    // Release archives past the idle timeout or over the limits
+    void Trim();
+    
 private:
+    struct PoolEntry {
+        std::weak_ptr<Archive>      Open;           // Shared while anyone holds it
+        std::shared_ptr<Archive>    Retained;       // The pool's own reference
+        std::wstring                StampPath;      // File on disk the stamp is of: the path, or the outermost archive
+        UINT64                      FileSize;
+        UINT64                      FileTime;
+        ULONGLONG                   LastUsed;       // GetTickCount64
+        std::list<std::wstring>::iterator LruPos;   // In _Lru while retained
+    };
+    
     ArchivePool() = default;
     ~ArchivePool() = default;
     ArchivePool(const ArchivePool&) = delete;
     ArchivePool& operator=(const ArchivePool&) = delete;
     
-    std::mutex _Mutex;
-    std::unordered_map<std::wstring, std::weak_ptr<Archive>> _Archives;
+    static bool ReadFileStamp(const std::wstring& path, UINT64& size, UINT64& time);
+    
+    // Split a path that does not exist on disk at its rightmost prefix that
+    // is a file: "C:\a.7z\docs\b.7z" -> "C:\a.7z" and "docs\b.7z"
+    static bool SplitNestedPath(const std::wstring& path, std::wstring& filePath, std::wstring& entryPath);
+    std::shared_ptr<Archive> GetNestedArchive(const std::wstring& path, const std::wstring& filePath,
+                                              const std::wstring& entryPath);
+    
+    // Pool entry for path if it is open and stamped (size, time); a stale
+    // one is dropped. Insert keeps an entry another thread added meanwhile.
+    std::shared_ptr<Archive> FindLocked(const std::wstring& path, bool stamped, UINT64 size, UINT64 time);
+    std::shared_ptr<Archive> InsertLocked(const std::wstring& path, const std::wstring& stampPath,
+                                          std::shared_ptr<Archive> archive, UINT64 size, UINT64 time);
+    
+    // FindLocked with the stamp of the file the entry was opened from
+    std::shared_ptr<Archive> FindPooledLocked(const std::wstring& path);
+    void Retain(const std::wstring& path, PoolEntry& entry);
+    void Release(PoolEntry& entry);
+    void TrimLocked();
+    
+    mutable std::mutex _Mutex;
+    std::unordered_map<std::wstring, PoolEntry> _Archives;
+    std::list<std::wstring> _Lru;                   // Retained paths, most recent first
+    ArchivePoolLimits _Limits;
+    ArchivePoolStats _Stats = {};
 };
 
 // Main archive class - wraps 7z SDK
+//
+// Once Open has returned, any number of threads may query and extract
+// concurrently: metadata (entries, paths, directory index) is immutable and
+// read without a lock, and every extraction borrows an ArchiveReader with
+// its own stream position and decoder. Open and Close must not overlap
+// with other calls.
 class Archive : public std::enable_shared_from_this<Archive> {
 public:
     Archive();
     ~Archive();
     
     // Open an archive file
-    bool Open(const std::wstring& path);
+    bool Open(const std::wstring& path, ArchiveStreamMode mode = ArchiveStreamMode::Auto);
+    
+    // Open an archive held in memory, such as a view from another archive's
+    // OpenEntryView: a nested archive is then listed and read without a
+    // temp file. source.Path names it (outer path plus entry path); its
+    // size and time are the outer file's, so a rewritten file is never
+    // served stale blocks. The index cache is not used.
+    bool Open(std::shared_ptr<MappedFile> data, const BlockSource& source);
     void Close();
     bool IsOpen() const { return _IsOpen; }
     
     // Get archive file path
     const std::wstring& GetPath() const { return _Path; }
     
+    // Mapping of the archive file, nullptr when it is read through buffered I/O
+    std::shared_ptr<MappedFile> GetMappedFile() const { return _MappedFile; }
+    
+    // Overlapped file handle when the archive is not mapped
+    std::shared_ptr<SharedFile> GetSharedFile() const { return _SharedFile; }
+    
     // Get number of items
     UINT32 GetItemCount() const;
     
@@ -59,14 +169,24 @@ public:
     // Get entry by path
     ArchiveEntry GetEntry(const std::wstring& path) const;
     
+    // Index of the entry with this path (case-insensitive, '\' or '/'),
+    // PathIndex::NOT_FOUND if there is none
+    UINT32 FindEntry(const std::wstring& path) const;
+    
     // Get all entries
     std::vector<ArchiveEntry> GetAllEntries() const;
     
-    // Get entries in a specific folder path
-    std::vector<ArchiveEntry> GetEntriesInFolder(const std::wstring& folderPath) const;
+    // Compact metadata of every entry; prefer it over GetAllEntries for scans.
+    // Valid until Close.
+    const EntryTable& GetEntryTable() const { return _Entries; }
     
-    // Get root tree structure
-    const ArchiveNode& GetRootNode();
+    // Folder hierarchy, built on first use. Valid until Close.
+    const DirectoryIndex& GetDirectoryIndex() const;
+    
+    // Child nodes of a folder ('\' or '/', any case; empty = root), an empty
+    // range if there is no such folder. Fill entries through
+    // GetDirectoryIndex().GetEntry.
+    DirectoryIndex::ChildRange GetEntriesInFolder(const std::wstring& folderPath) const;
     
     // Extract a single file to a buffer (by index)
     bool ExtractToBuffer(UINT32 index, std::vector<BYTE>& buffer);
@@ -74,12 +194,50 @@ public:
     // Extract a single file to a buffer (by path)
     bool ExtractToBuffer(const std::wstring& entryPath, std::vector<uint8_t>& buffer);
     
+    // Hand a single file to a sink in borrowed chunks, without buffering it
+    bool ExtractToSink(UINT32 index, IExtractSink& sink);
+    
+    // First maxBytes of a file, for previews: decoding stops once they are
+    // produced, and the file's CRC is only checked if it fits entirely
+    bool ExtractPrefix(UINT32 index, size_t maxBytes, std::vector<BYTE>& buffer);
+    
     // Extract a single file to disk (by index)
     bool ExtractToFile(UINT32 index, const std::wstring& destPath);
     
+    // A file's bytes to read in place, e.g. to open it as a nested archive:
+    // a view into its decoded block in the BlockCache, which stays pinned
+    // while the view is held, or a buffer decoded for it alone when the
+    // block is too large to cache. nullptr on failure or a CRC mismatch.
+    std::shared_ptr<MappedFile> OpenEntryView(UINT32 index);
+    
     // Extract a single file to disk (by path)
     bool ExtractToFile(const std::wstring& entryPath, const std::wstring& destPath);
     
+    // Write already-decoded entry data to disk, applying attributes and times
+    bool WriteEntryFile(UINT32 index, const std::wstring& destPath, const BYTE* data, size_t size) const;
+    
+    // Streamed variant of WriteEntryFile: create the target, write chunks to
+    // the handle, then finish. Missing directories are created on demand and
+    // size, when known, is preallocated. Finishing sets the entry's times and
+    // attributes on the open handle; a failed entry (ok == false) is deleted.
+    HANDLE CreateEntryFile(const std::wstring& destPath, UINT64 size = 0) const;
+    bool FinishEntryFile(UINT32 index, const std::wstring& destPath, HANDLE hFile, bool ok) const;
+    
+    // Output window of the streaming decoder used for large solid blocks
+    void SetDecodeWindowSize(size_t size);
+    
+    // Password for entries encrypted with 7zAES. Kept until Close, with the
+    // keys derived from it; a wrong one fails extraction with a data or CRC
+    // error. Encrypted headers are not supported: such archives fail Open.
+    // Changing or clearing the password drops the archive's cached blocks.
+    void SetPassword(const std::wstring& password);
+    void ClearPassword();
+    bool HasPassword() const { return _Keys.HasPassword(); }
+    bool HasEncryptedEntries() const { return _IsOpen && _Entries.GetEncryptedCount() > 0; }
+    
+    // Password and derived keys, shared by every reader of the archive
+    AesKeyCache& GetKeyCache() { return _Keys; }
+    
     // Extract all files to a directory
     bool ExtractAll(const std::wstring& destDir, 
                     std::function<void(const std::wstring&, UINT64, UINT64)> progress = nullptr);
@@ -90,36 +248,85 @@ public:
     UINT32 GetFileCount() const;
     UINT32 GetFolderCount() const;
     
+    // Raw 7z database - immutable once loaded, safe to read from several threads.
+    // When Open was served from the index cache the header is parsed here,
+    // on first use; call EnsureDatabase first to learn whether that worked.
+    const CSzArEx& GetDatabase() const;
+    bool EnsureDatabase();
+    
+    // True when the entry table and directory index came from the index cache
+    bool IsFromIndexCache() const { return _IndexImage != nullptr; }
+    
+    // Identity read at Open, which keys the index and extraction caches;
+    // false when the file could not be read as a 7z archive then
+    bool GetIdentity(ArchiveIdentity& identity) const {
+        identity = _Identity;
+        return _HasIdentity;
+    }
+    
+    // Key of this archive's blocks in the BlockCache
+    const BlockSource& GetBlockSource() const { return _BlockSource; }
+    
+    // Estimated heap held by the open archive: tables, indexes and parsed
+    // header, and a nested archive's bytes. Mappings and blocks in the
+    // BlockCache are not counted.
+    size_t GetMemoryUsage() const { return _MemoryUsage.load(std::memory_order_relaxed); }
+    
 private:
-    // Build the tree structure from flat list
-    void BuildTree();
+    // Close with _Mutex already held, as both Opens do
+    void CloseLocked();
+    
+    // Parse the 7z header, or load the cached index, once _InStream is set
+    // up; common tail of both Opens (caller holds _Mutex)
+    bool OpenDatabase(const std::wstring& path, const BlockSource& source, const ArchiveIdentity& identity,
+                      bool identified, bool cacheable);
     
-    // Ensure tree is built
-    void EnsureTree();
+    // Parse the 7z header if it has not been yet (caller holds _Mutex)
+    bool LoadDatabase();
     
-    // Build folder cache for fast lookup
-    void BuildFolderCache();
+    // Refresh _MemoryUsage (caller holds _Mutex)
+    void UpdateMemoryUsage() const;
+    
+    // Index cache lookup and store around Open (caller holds _Mutex)
+    bool LoadIndexImage(const std::wstring& path, const ArchiveIdentity& identity);
+    void StoreIndexImage(const std::wstring& path, const ArchiveIdentity& identity);
+    
+    // Borrow an open reader (an idle one if there is one) and give it back
+    std::unique_ptr<ArchiveReader> AcquireReader();
+    void ReleaseReader(std::unique_ptr<ArchiveReader> reader);
     
     std::wstring        _Path;
     bool                _IsOpen;
     CSzArEx             _Archive;           // 7z archive structure
-    CLookToRead2        _LookStream;        // Input stream
-    ISzAlloc            _AllocImp;          // Memory allocator
-    ISzAlloc            _AllocTempImp;      // Temp allocator
-    CFileInStream       _FileStream;        // File stream
+    std::atomic<bool>   _DatabaseLoaded;    // _Archive parsed (always, unless served from the index cache)
+    std::shared_ptr<MappedFile> _MappedFile;
+    CMappedInStream     _MappedStream;      // Zero-copy stream over _MappedFile
+    std::shared_ptr<SharedFile> _SharedFile; // Overlapped handle when not mapped
+    CSharedInStream     _SharedStream;      // Header reads over _SharedFile
+    ILookInStreamPtr    _InStream;          // Header stream: _MappedStream or _SharedStream
+    std::shared_ptr<MappedFile> _IndexImage; // Cached index viewed by _Entries and _Directory
+    EntryTable          _Entries;           // Entry metadata, built at Open
+    PathIndex           _PathIndex;         // Path -> index, built at Open
+    ArchiveIdentity     _Identity;          // Read at Open
+    bool                _HasIdentity;
     
     mutable std::mutex  _Mutex;
-    ArchiveNode         _RootNode;
-    bool                _TreeBuilt;
+    mutable DirectoryIndex _Directory;      // Built by GetDirectoryIndex under _Mutex
+    mutable std::atomic<bool> _DirectoryReady;  // _Directory built, readable without _Mutex
+    
+    // Decoded solid blocks are shared through the BlockCache
+    BlockSource         _BlockSource;
+    
+    // Password of encrypted folders, one key derivation per salt
+    AesKeyCache         _Keys;
     
-    // Folder cache: maps folder path to list of entries in that folder
-    std::unordered_map<std::wstring, std::vector<ArchiveEntry>> _FolderCache;
-    bool                _FolderCacheBuilt;
+    // Readers of finished extraction calls, each with its own stream and decoder
+    std::mutex          _ReadersMutex;
+    std::vector<std::unique_ptr<ArchiveReader>> _IdleReaders;
+    size_t              _DecodeWindowSize;
     
-    // Extraction cache
-    UInt32              _BlockIndex;
-    Byte*               _OutBuffer;
-    size_t              _OutBufferSize;
+    // Read by ArchivePool without taking _Mutex
+    mutable std::atomic<size_t> _MemoryUsage;
 };
 
 } // namespace SevenZipView
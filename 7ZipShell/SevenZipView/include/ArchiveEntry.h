@@ -64,49 +64,6 @@ struct ArchiveEntry {
     }
 };
 
-// Tree node for hierarchical representation
-struct ArchiveNode {
-    ArchiveEntry                    Entry;
-    std::vector<ArchiveNode>        Children;
-    ArchiveNode*                    Parent;
-    
-    ArchiveNode() : Parent(nullptr) {}
-    
-    // Find child by name
-    ArchiveNode* FindChild(const std::wstring& name) {
-        for (auto& child : Children) {
-            if (_wcsicmp(child.Entry.Name.c_str(), name.c_str()) == 0)
-                return &child;
-        }
-        return nullptr;
-    }
-    
-    // Add child
-    ArchiveNode* AddChild(const ArchiveEntry& entry) {
-        Children.push_back({});
-        auto& child = Children.back();
-        child.Entry = entry;
-        child.Parent = this;
-        return &child;
-    }
-    
-    // Count files recursively
-    size_t CountFiles() const {
-        size_t count = (Entry.Type == ItemType::File) ? 1 : 0;
-        for (const auto& child : Children)
-            count += child.CountFiles();
-        return count;
-    }
-    
-    // Calculate total size recursively
-    UINT64 TotalSize() const {
-        UINT64 total = Entry.Size;
-        for (const auto& child : Children)
-            total += child.TotalSize();
-        return total;
-    }
-};
-
 } // namespace SevenZipView
 
 #endif // SEVENZIPVIEW_ARCHIVEENTRY_H
@@ -0,0 +1,107 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Independent Archive Reader (per-thread stream and decoder state)
+*/
+
+#ifndef SEVENZIPVIEW_ARCHIVEREADER_H
+#define SEVENZIPVIEW_ARCHIVEREADER_H
+
+#include "Common.h"
+#include "Archive.h"
+#include "ExtractPlan.h"
+#include "ExtractSink.h"
+#include "FolderDecoder.h"
+#include "SharedInStream.h"
+
+namespace SevenZipView {
+
+// Reader bound to an open Archive. It shares the parsed 7z database and the
+// archive's file (mapping or overlapped handle) but owns its stream position,
+// look-ahead buffer and streaming decoder, so several readers can decode
+// different folders of the same archive concurrently.
+// Decoded blocks come from the shared BlockCache; a reader pins the last
+// one it used.
+// A single reader must only be used by one thread at a time.
+class ArchiveReader {
+public:
+    explicit ArchiveReader(std::shared_ptr<Archive> archive);
+    ~ArchiveReader();
+
+    ArchiveReader(const ArchiveReader&) = delete;
+    ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+    // Open a private stream on the archive's file
+    bool Open();
+    void Close();
+    bool IsOpen() const { return _IsOpen; }
+
+    // Hand a single file to sink as spans of the decoder's window, or as one
+    // span of the cached block; nothing is copied on the way
+    bool ExtractToSink(UINT32 index, IExtractSink& sink);
+
+    // Extract a single file to a buffer (by index)
+    bool ExtractToBuffer(UINT32 index, std::vector<BYTE>& buffer);
+
+    // First maxBytes of a file (all of it if shorter), decoding no further
+    // than needed. A block already in the BlockCache is copied from instead.
+    bool ExtractPrefix(UINT32 index, size_t maxBytes, std::vector<BYTE>& buffer);
+
+    // Extract a single file to disk (by index)
+    bool ExtractToFile(UINT32 index, const std::wstring& destPath);
+
+    // A file's bytes to read in place, CRC checked: a view into its block
+    // in the BlockCache, pinned by the view, or for a block too large to
+    // cache, a pooled buffer decoded for it
+    bool ExtractView(UINT32 index, std::shared_ptr<MappedFile>& view);
+
+    // Streaming decoder positioned offset bytes into a file, for callers
+    // that pull the data themselves (EntryStream); nothing is checked
+    // against the CRC. Valid until the reader's next call, nullptr on failure.
+    FolderDecoder* SeekFile(UINT32 index, UINT64 offset);
+
+    // True when the entry's folder is too large to decode whole and cache
+    bool IsStreamedEntry(UINT32 index) const;
+
+    // Stream one planned folder a single time and hand its requested files to
+    // sink in unpack order, OnBegin to OnEnd per file
+    bool ExtractFolder(const FolderPlan& plan, IExtractSink& sink);
+
+    // Output window of the streaming decoder (default FOLDER_DECODER_DEFAULT_WINDOW)
+    void SetDecodeWindowSize(size_t size);
+
+    // Folder of the block currently pinned ((UInt32)-1 = none)
+    UInt32 GetCachedFolder() const { return _BlockIndex; }
+
+    // Unpin the last block and free the decoder's dictionary; the reader
+    // stays open
+    void ReleaseBuffers();
+
+private:
+    friend class Archive;
+
+    // Reader owned by the archive itself (see Archive::AcquireReader)
+    explicit ArchiveReader(Archive* archive);
+
+    void Construct();
+
+    std::shared_ptr<Archive> _Owner;        // null for the archive's own readers
+    Archive*            _Archive;
+    bool                _IsOpen;
+    std::shared_ptr<MappedFile> _MappedFile;    // Archive's mapping, if any
+    CMappedInStream     _MappedStream;      // Zero-copy stream over _MappedFile
+    std::shared_ptr<SharedFile> _SharedFile;    // Archive's handle otherwise
+    CSharedInStream     _SharedStream;      // Positional reads over _SharedFile
+    ILookInStreamPtr    _InStream;          // _MappedStream or _SharedStream
+
+    // Last decoded block, pinned in the BlockCache
+    UInt32              _BlockIndex;
+    BlockHandle         _Block;
+
+    // Streaming decoder for planned folders and large blocks
+    std::unique_ptr<FolderDecoder> _Decoder;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_ARCHIVEREADER_H
@@ -0,0 +1,134 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Shared Decoded Block Cache
+*/
+
+#ifndef SEVENZIPVIEW_BLOCKCACHE_H
+#define SEVENZIPVIEW_BLOCKCACHE_H
+
+#include "Common.h"
+#include "AesKeyCache.h"
+#include "SdkAlloc.h"
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace SevenZipView {
+
+// Default bytes of decoded blocks kept for reuse
+constexpr size_t BLOCK_CACHE_DEFAULT_BUDGET = 128ull * 1024 * 1024;
+
+// Which archive file a block was decoded from. Size and write time make a
+// rewritten archive a different source, so stale blocks are never served.
+struct BlockSource {
+    std::wstring    Path;
+    UINT64          Size = 0;
+    UINT64          ModifiedTime = 0;
+
+    // false if the file cannot be queried; such a source is never cached
+    static bool Read(const std::wstring& path, BlockSource& source);
+
+    bool IsValid() const { return !Path.empty(); }
+};
+
+// Fully decoded contents of one 7z folder (solid block), read-only once built.
+// Data comes from the BufferPool, so an evicted block's memory serves the
+// next one decoded.
+struct DecodedBlock {
+    std::unique_ptr<BYTE, BufferPoolDeleter> Data;
+    size_t                  Size = 0;
+};
+
+// Holding a handle pins the block: it stays valid, and is not evicted,
+// until the last handle is released
+typedef std::shared_ptr<const DecodedBlock> BlockHandle;
+
+struct BlockCacheStats {
+    UINT64  Hits;
+    UINT64  Misses;
+    UINT64  Evictions;
+    UINT32  Blocks;
+    size_t  Memory;
+};
+
+// Decoded folders shared by every consumer in the process (folder views,
+// preview and property handlers, drag and drop, readers of the extractor),
+// keyed by (archive source, folder index). Least recently used blocks are
+// dropped to stay within a byte budget; pinned blocks are skipped and go
+// once released. Concurrent misses on one block decode it only once.
+class BlockCache {
+public:
+    static BlockCache& Instance();
+
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const;
+
+    // Decoded folder of an archive. On a miss the folder is decoded from
+    // stream, which the caller must own for the duration of the call;
+    // encrypted folders take their key from keys.
+    SRes Acquire(const BlockSource& source, const CSzArEx& db, UInt32 folder,
+                 ILookInStreamPtr stream, ISzAllocPtr allocTemp, AesKeyCache* keys, BlockHandle& block);
+
+    // Decoded folder if it is already cached, else null; never decodes
+    BlockHandle Find(const BlockSource& source, UInt32 folder);
+
+    // One file's bytes inside its decoded folder, borrowed from block (valid
+    // while the handle is held), CRC checked unless checkCrc is false
+    static SRes GetEntry(const CSzArEx& db, const DecodedBlock& block, UINT32 index,
+                         const BYTE*& data, size_t& size, bool checkCrc = true);
+
+    // Copy one file, or its first maxBytes, out of its decoded folder. The
+    // CRC is checked when the whole file is copied.
+    static SRes CopyEntry(const CSzArEx& db, const DecodedBlock& block, UINT32 index, std::vector<BYTE>& buffer,
+                          size_t maxBytes = (size_t)-1);
+
+    // Drop the unpinned blocks of one archive, or of all
+    void Remove(const std::wstring& path);
+    void Clear();
+
+    BlockCacheStats GetStats() const;
+
+private:
+    BlockCache();
+    ~BlockCache() = default;
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    struct Key {
+        std::wstring    Path;
+        UINT64          Size;
+        UINT64          ModifiedTime;
+        UInt32          Folder;
+
+        bool operator<(const Key& other) const;
+    };
+
+    struct Entry {
+        std::shared_ptr<DecodedBlock>   Block;      // null while being decoded
+        std::list<Key>::iterator        LruPos;
+    };
+
+    static SRes Decode(const CSzArEx& db, UInt32 folder, ILookInStreamPtr stream,
+                       ISzAllocPtr allocTemp, AesKeyCache* keys, std::shared_ptr<DecodedBlock>& block);
+
+    // Evict from the LRU back until the budget holds (caller holds _Mutex)
+    void TrimLocked();
+
+    // Drop unpinned blocks of one archive path, or all (caller holds _Mutex)
+    void DropLocked(const std::wstring* path);
+
+    mutable std::mutex          _Mutex;
+    std::condition_variable     _Decoded;       // Signalled when a pending decode ends
+    std::map<Key, Entry>        _Blocks;
+    std::list<Key>              _Lru;           // Front = most recently used
+    size_t                      _Budget;
+    size_t                      _Memory;        // Bytes of decoded blocks in _Blocks
+    BlockCacheStats             _Stats = {};
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_BLOCKCACHE_H
@@ -0,0 +1,134 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Archive Directory Index
+*/
+
+#ifndef SEVENZIPVIEW_DIRECTORYINDEX_H
+#define SEVENZIPVIEW_DIRECTORYINDEX_H
+
+#include "Common.h"
+#include "ArchiveEntry.h"
+#include "EntryTable.h"
+#include "IndexImage.h"
+#include <string_view>
+
+namespace SevenZipView {
+
+// Folder hierarchy of an open archive, built in one pass over the entry table.
+// Every file, explicit folder and implied (synthetic) folder is a node. The
+// children of a node are one contiguous range of node ids (CSR layout), in
+// archive order. Children are found by name through a hash on
+// (parent, folded name), and names compare the way PathIndex does:
+// case-insensitive, with '\' and '/' treated the same.
+//
+// Paths are not copied. Each node views a prefix of an entry path in the
+// entry table; a synthetic folder views the path of the first entry below it.
+class DirectoryIndex {
+public:
+    static constexpr UINT32 NOT_FOUND = 0xFFFFFFFF;
+    static constexpr UINT32 ROOT = 0;
+
+    // Non-owning range of child node ids, valid until the index is cleared
+    class ChildRange {
+    public:
+        ChildRange() : _Begin(nullptr), _End(nullptr) {}
+        ChildRange(const UINT32* begin, const UINT32* end) : _Begin(begin), _End(end) {}
+
+        const UINT32* begin() const { return _Begin; }
+        const UINT32* end() const { return _End; }
+        size_t size() const { return (size_t)(_End - _Begin); }
+        bool empty() const { return _Begin == _End; }
+        UINT32 operator[](size_t i) const { return _Begin[i]; }
+
+    private:
+        const UINT32*   _Begin;
+        const UINT32*   _End;
+    };
+
+    DirectoryIndex();
+
+    // table must stay built (and unchanged) while the index is used
+    void Build(const EntryTable& table);
+    void Clear();
+
+    // Index cache image, viewed in place by Load like EntryTable::Load
+    void Save(IndexWriter& writer) const;
+    bool Load(IndexReader& reader, const EntryTable& table);
+
+    bool IsBuilt() const { return _Table != nullptr; }
+    UINT32 GetNodeCount() const { return (UINT32)_Nodes.Size(); }
+
+    // Folder node for a path ('\' or '/', any case, trailing separators
+    // ignored, empty = root), NOT_FOUND if there is no such folder
+    UINT32 FindFolder(const wchar_t* path, size_t length) const;
+    UINT32 FindFolder(const std::wstring& path) const { return FindFolder(path.c_str(), path.size()); }
+
+    // Child of a node with this name, NOT_FOUND if there is none
+    UINT32 FindChild(UINT32 node, const wchar_t* name, size_t length) const;
+    UINT32 FindChild(UINT32 node, const std::wstring& name) const { return FindChild(node, name.c_str(), name.size()); }
+
+    ChildRange GetChildren(UINT32 node) const {
+        if (node >= _Nodes.Size()) return ChildRange();
+        const UINT32* first = _Children.Data() + _Nodes[node].FirstChild;
+        return ChildRange(first, first + _Nodes[node].ChildCount);
+    }
+
+    // Append every node below a folder to nodes, depth first, each folder
+    // ahead of its contents. Only child ranges are walked; no path is
+    // compared, so a subtree costs its own size whatever the archive's.
+    void GetDescendants(UINT32 node, std::vector<UINT32>& nodes) const;
+
+    UINT32 GetParent(UINT32 node) const { return _Nodes[node].Parent; }
+    bool IsFolder(UINT32 node) const { return (_Nodes[node].Flags & FLAG_FOLDER) != 0; }
+    bool IsSynthetic(UINT32 node) const { return _Nodes[node].EntryIndex == ArchiveEntry::SYNTHETIC_FOLDER_INDEX; }
+
+    // Archive index, ArchiveEntry::SYNTHETIC_FOLDER_INDEX for synthetic folders and the root
+    UINT32 GetEntryIndex(UINT32 node) const { return _Nodes[node].EntryIndex; }
+
+    std::wstring_view GetPath(UINT32 node) const;
+    std::wstring_view GetName(UINT32 node) const { return GetPath(node).substr(_Nodes[node].NameStart); }
+
+    // Fill an ArchiveEntry for a node. Reusing one entry across calls keeps
+    // the string buffers.
+    bool GetEntry(UINT32 node, ArchiveEntry& entry) const;
+
+    // Bytes held by nodes, child ranges and the hash table
+    size_t GetMemoryUsage() const;
+
+private:
+    static const BYTE FLAG_FOLDER = 0x01;
+
+    struct Node {
+        UINT32  EntryIndex;
+        UINT32  PathSource;     // Entry whose path starts with this node's path
+        UINT32  PathLength;     // Characters, trailing separators dropped
+        UINT32  NameStart;      // Name start inside the path
+        UINT32  Parent;
+        UINT32  FirstChild;     // Range in _Children
+        UINT32  ChildCount;
+        BYTE    Flags;
+    };
+
+    struct Slot {
+        UINT32 Hash;
+        UINT32 Node;            // NOT_FOUND = empty
+    };
+
+    static UINT32 HashName(UINT32 parent, const wchar_t* name, size_t length);
+
+    bool NameEquals(UINT32 node, const wchar_t* name, size_t length) const;
+    UINT32 Lookup(UINT32 parent, UINT32 hash, const wchar_t* name, size_t length) const;
+    void Insert(UINT32 hash, UINT32 node);
+    void Grow();
+
+    const EntryTable*   _Table;
+    IndexColumn<Node>   _Nodes;         // Node 0 is the root
+    IndexColumn<UINT32> _Children;      // Child node ids grouped by parent
+    IndexColumn<Slot>   _Slots;         // Open addressing, load factor <= 0.5
+    UINT32              _Mask;          // Slot count - 1 (power of two)
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_DIRECTORYINDEX_H
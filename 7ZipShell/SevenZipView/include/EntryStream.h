@@ -0,0 +1,128 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** On-Demand Stream over One Archive Entry
+*/
+
+#ifndef SEVENZIPVIEW_ENTRYSTREAM_H
+#define SEVENZIPVIEW_ENTRYSTREAM_H
+
+#include "Common.h"
+#include "ArchiveReader.h"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace SevenZipView {
+
+// Read-ahead of a streamed entry: windows of this size, at most this many
+// decoded ahead of the reader
+static const size_t ENTRY_STREAM_DEFAULT_WINDOW = (1 << 20);
+static const UINT32 ENTRY_STREAM_DEFAULT_WINDOWS = 4;
+
+struct EntryStreamStats {
+    UINT64  BytesDecoded;       // Output of the decoder thread
+    UINT32  Windows;            // Windows it filled
+    UINT32  Restarts;           // Seeks that moved the decoder back
+    UINT32  Stalls;             // Reads that waited for a window
+};
+
+// Seekable read access to one file of an archive, decoded only as it is
+// read: the content stream Explorer pulls through CFSTR_FILECONTENTS, or a
+// BindToStorage IStream, without the file ever being written to disk.
+//
+// A file whose block the BlockCache may hold is read in place from the
+// cached block, decoded whole on the first Read (or shared with whoever
+// decoded it already). A file of a larger block is decoded by a thread of
+// its own into a few windows ahead of the reader, so decoding overlaps
+// with what the reader does with the data. Seeking within the decoded
+// windows or forward keeps the decoder going; seeking back restarts it.
+//
+// The CRC is checked when the file was decoded in one pass from its first
+// byte; a mismatch fails the Read that would return the last bytes.
+// A single EntryStream must only be used by one thread at a time.
+class EntryStream {
+public:
+    EntryStream(std::shared_ptr<Archive> archive, UINT32 index);
+    ~EntryStream();
+
+    EntryStream(const EntryStream&) = delete;
+    EntryStream& operator=(const EntryStream&) = delete;
+
+    // Check the entry and open a reader on the archive; nothing is decoded
+    // yet. False for folders and invalid indexes.
+    bool Open();
+    bool IsOpen() const { return _IsOpen; }
+
+    // Read-ahead of streamed entries (takes effect on the next decoder start)
+    void SetReadAhead(size_t windowSize, UINT32 windows);
+
+    UINT32 GetIndex() const { return _Index; }
+    UINT64 GetSize() const { return _Size; }
+    UINT64 GetPosition() const { return _Position; }
+
+    // True when the entry's block is too large to cache, so a decoder
+    // thread serves it
+    bool IsStreamed() const { return _Streamed; }
+
+    // Copy size bytes from the current position and advance; fewer only at
+    // the end of the file (*read == 0 there)
+    SRes Read(void* dest, size_t size, size_t* read);
+
+    // Move the read position; reads beyond the end return nothing
+    SRes Seek(UINT64 offset);
+
+    // Stop decoding and drop what was decoded; the stream stays open
+    void Release();
+
+    EntryStreamStats GetStats() const;
+
+private:
+    typedef std::unique_ptr<BYTE, BufferPoolDeleter> Buffer;
+
+    struct Window {
+        Buffer  Data;
+        size_t  Size;
+        UINT64  Offset;             // In the file
+    };
+
+    SRes ReadCached(BYTE* dest, size_t size, size_t* read);
+    SRes ReadStreamed(BYTE* dest, size_t size, size_t* read);
+
+    // Start the decoder thread at offset; stop it and reclaim its windows
+    void StartDecoder(UINT64 offset);
+    void StopDecoder();
+    void DecodeLoop(UINT64 offset);
+
+    std::shared_ptr<Archive>    _Archive;
+    std::unique_ptr<ArchiveReader> _Reader;
+    UINT32                      _Index;
+    UINT64                      _Size;
+    UINT64                      _Position;
+    bool                        _IsOpen;
+    bool                        _Streamed;
+    size_t                      _WindowSize;
+    UINT32                      _WindowCount;
+
+    // Cached-block entries: a view pinning the block
+    std::shared_ptr<MappedFile> _View;
+
+    // Streamed entries: windows passed from the decoder thread to Read
+    mutable std::mutex          _Mutex;
+    std::condition_variable     _Filled;        // A window was queued, or decoding ended
+    std::condition_variable     _Freed;         // A window was handed back, or stop
+    std::deque<Window>          _Ready;         // Decoded, in file order
+    std::vector<Buffer>         _Spare;
+    UINT32                      _Allocated;     // Windows taken from the BufferPool
+    UINT64                      _DecodeEnd;     // Offset the decoder thread reached
+    bool                        _Running;
+    bool                        _Done;          // Decoder thread finished or failed
+    bool                        _Stopping;
+    SRes                        _Error;
+    EntryStreamStats            _Stats;
+    std::thread                 _Thread;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_ENTRYSTREAM_H
@@ -0,0 +1,153 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Compact Archive Entry Table
+*/
+
+#ifndef SEVENZIPVIEW_ENTRYTABLE_H
+#define SEVENZIPVIEW_ENTRYTABLE_H
+
+#include "Common.h"
+#include "ArchiveEntry.h"
+#include "IndexImage.h"
+#include <string_view>
+
+namespace SevenZipView {
+
+class EntryTable;
+
+// Non-owning view of one table row; copy freely, valid while the table is
+class EntryView {
+public:
+    EntryView(const EntryTable& table, UINT32 index) : _Table(&table), _Index(index) {}
+
+    UINT32 GetIndex() const { return _Index; }
+
+    inline std::wstring_view GetPath() const;
+    inline std::wstring_view GetName() const;
+    inline bool IsDirectory() const;
+    inline bool IsEncrypted() const;
+    inline UINT64 GetSize() const;
+    inline UINT64 GetCompressedSize() const;
+    inline UINT32 GetCRC() const;
+    inline UINT32 GetAttributes() const;
+    inline FILETIME GetModifiedTime() const;
+    inline FILETIME GetCreatedTime() const;
+    inline UInt32 GetFolder() const;
+
+    // Materialize a full ArchiveEntry (allocates the strings)
+    ArchiveEntry ToEntry() const;
+
+private:
+    const EntryTable*   _Table;
+    UINT32              _Index;
+};
+
+// Per-entry metadata of an open archive, built once at Archive::Open.
+// Each field is its own array indexed by archive index, so scans touch only
+// the columns they need. Paths are not copied: the table views the 7z name
+// block (one contiguous UTF-16 arena, every path zero-terminated) in place,
+// and names are slices of their path. A table loaded from the index cache
+// views every column, the names included, in the cache file mapping.
+class EntryTable {
+public:
+    EntryTable();
+
+    // db must stay open (and unchanged) while the table is used
+    void Build(const CSzArEx& db);
+    void Clear();
+
+    // Index cache image. Load views the image in place; it must stay mapped
+    // while the table is used.
+    void Save(IndexWriter& writer) const;
+    bool Load(IndexReader& reader);
+
+    UINT32 GetCount() const { return _Count; }
+
+    std::wstring_view GetPath(UINT32 index) const {
+        size_t start = _PathOffsets[index];
+        return std::wstring_view(_Arena + start, _PathOffsets[(size_t)index + 1] - start - 1);
+    }
+    std::wstring_view GetName(UINT32 index) const {
+        return GetPath(index).substr(_NameOffsets[index]);
+    }
+    bool IsDirectory(UINT32 index) const { return (_Flags[index] & FLAG_DIRECTORY) != 0; }
+    bool IsEncrypted(UINT32 index) const { return (_Flags[index] & FLAG_ENCRYPTED) != 0; }
+    UINT64 GetSize(UINT32 index) const { return _Sizes[index]; }
+    UINT64 GetCompressedSize(UINT32 index) const { return _PackSizes[index]; }
+    UINT32 GetCRC(UINT32 index) const { return _CRCs[index]; }
+    UINT32 GetAttributes(UINT32 index) const { return _Attributes[index]; }
+    FILETIME GetModifiedTime(UINT32 index) const { return ToFileTime(_MTimes[index]); }
+    FILETIME GetCreatedTime(UINT32 index) const { return ToFileTime(_CTimes[index]); }
+    UInt32 GetFolder(UINT32 index) const { return _Folders[index]; }
+
+    EntryView GetView(UINT32 index) const { return EntryView(*this, index); }
+
+    // Names in the 7z name block layout, as PathIndex::Build takes them
+    const Byte* GetNameArena() const { return reinterpret_cast<const Byte*>(_Arena); }
+    const size_t* GetPathOffsets() const { return _PathOffsets; }
+
+    // Fill a full ArchiveEntry for one row
+    bool GetEntry(UINT32 index, ArchiveEntry& entry) const;
+
+    // Archive totals, computed while building
+    UINT32 GetFileCount() const { return _FileCount; }
+    UINT32 GetFolderCount() const { return _FolderCount; }
+    UINT32 GetEncryptedCount() const { return _EncryptedCount; }     // Files whose folder uses 7zAES
+    UINT64 GetTotalSize() const { return _TotalSize; }
+    UINT64 GetTotalPackSize() const { return _TotalPackSize; }
+
+    // Bytes held by the columns (the name arena belongs to the 7z database)
+    size_t GetMemoryUsage() const;
+
+private:
+    static const BYTE FLAG_DIRECTORY = 0x01;
+    static const BYTE FLAG_ENCRYPTED = 0x02;
+
+    static FILETIME ToFileTime(UINT64 value) {
+        FILETIME ft;
+        ft.dwLowDateTime = (DWORD)value;
+        ft.dwHighDateTime = (DWORD)(value >> 32);
+        return ft;
+    }
+
+    UINT32              _Count;
+    const wchar_t*      _Arena;         // CSzArEx::FileNames
+    const size_t*       _PathOffsets;   // CSzArEx::FileNameOffsets (characters)
+
+    IndexColumn<UINT32> _NameOffsets;   // Name start inside the path
+    IndexColumn<BYTE>   _Flags;
+    IndexColumn<UINT64> _Sizes;
+    IndexColumn<UINT64> _PackSizes;     // Estimated share of the folder's packed size
+    IndexColumn<UINT32> _CRCs;
+    IndexColumn<UINT32> _Attributes;
+    IndexColumn<UINT64> _MTimes;        // FILETIME as High:Low
+    IndexColumn<UINT64> _CTimes;
+    IndexColumn<UInt32> _Folders;       // Solid block, (UInt32)-1 = no data
+
+    // Stand-in arena for archives that store no names
+    std::vector<wchar_t> _EmptyArena;
+    std::vector<size_t> _EmptyOffsets;
+
+    UINT32              _FileCount;
+    UINT32              _FolderCount;
+    UINT32              _EncryptedCount;
+    UINT64              _TotalSize;
+    UINT64              _TotalPackSize;
+};
+
+inline std::wstring_view EntryView::GetPath() const { return _Table->GetPath(_Index); }
+inline std::wstring_view EntryView::GetName() const { return _Table->GetName(_Index); }
+inline bool EntryView::IsDirectory() const { return _Table->IsDirectory(_Index); }
+inline bool EntryView::IsEncrypted() const { return _Table->IsEncrypted(_Index); }
+inline UINT64 EntryView::GetSize() const { return _Table->GetSize(_Index); }
+inline UINT64 EntryView::GetCompressedSize() const { return _Table->GetCompressedSize(_Index); }
+inline UINT32 EntryView::GetCRC() const { return _Table->GetCRC(_Index); }
+inline UINT32 EntryView::GetAttributes() const { return _Table->GetAttributes(_Index); }
+inline FILETIME EntryView::GetModifiedTime() const { return _Table->GetModifiedTime(_Index); }
+inline FILETIME EntryView::GetCreatedTime() const { return _Table->GetCreatedTime(_Index); }
+inline UInt32 EntryView::GetFolder() const { return _Table->GetFolder(_Index); }
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_ENTRYTABLE_H
@@ -0,0 +1,107 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Persistent Extraction Cache
+*/
+
+#ifndef SEVENZIPVIEW_EXTRACTCACHE_H
+#define SEVENZIPVIEW_EXTRACTCACHE_H
+
+#include "Common.h"
+#include "Extractor.h"
+#include "IndexCache.h"
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace SevenZipView {
+
+// Default size of the cache directory before the least recently used files
+// are deleted
+constexpr UINT64 EXTRACT_CACHE_DEFAULT_BUDGET = 2048ull * 1024 * 1024;
+
+// Cached files up to this size are read back and checked against the
+// entry's CRC on every hit; larger ones only against size and write time
+constexpr UINT64 EXTRACT_CACHE_DEFAULT_VERIFY_LIMIT = 64ull * 1024 * 1024;
+
+struct ExtractCacheStats {
+    UINT32  Hits;               // Served from files already in the cache
+    UINT32  Extracted;          // Decoded into the cache
+    UINT32  Damaged;            // Cached files that failed verification
+    UINT32  Failed;             // Could not be extracted
+    UINT64  BytesVerified;      // Read back to check CRCs
+    UINT64  BytesExtracted;
+
+    ExtractCacheStats() : Hits(0), Extracted(0), Damaged(0), Failed(0), BytesVerified(0), BytesExtracted(0) {}
+};
+
+// Decoded entries kept on disk in %LOCALAPPDATA%\SevenZipView\ExtractCache,
+// one file per (archive identity, entry index, CRC, size), so opening or
+// dragging the same file again reuses it instead of decoding it again.
+// Cached files hold the entry's bytes only; callers give them their name by
+// hard-linking them into a drop or open layout. A hit is checked against
+// the entry's size and write time, and its CRC up to the verify limit, so a
+// file edited through a link or cut short is extracted again. Files are
+// written under a private name and renamed into place, and the directory is
+// trimmed to a byte budget by deleting the least recently used files.
+class ExtractCache {
+public:
+    static ExtractCache& Instance();
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+
+    // Cache directory; empty selects the default under %LOCALAPPDATA%
+    void SetDirectory(const std::wstring& directory);
+
+    void SetBudget(UINT64 bytes);
+    void SetVerifyLimit(UINT64 bytes);
+
+    // Cached files of entries, decoding only those that are missing or fail
+    // verification (in one Extractor::ExtractFiles call). files[i] receives
+    // the file of indices[i], empty for folders, encrypted entries (never
+    // cached) and entries that could not be extracted. false when the cache cannot be used at all: disabled,
+    // no directory, or an archive without an identity.
+    bool Materialize(std::shared_ptr<Archive> archive, const std::vector<UINT32>& indices,
+                     std::vector<std::wstring>& files, ExtractCacheStats* stats = nullptr);
+
+    // Place a cached file at destPath, replacing what is there: a hard link,
+    // or a copy when the two are on different volumes
+    static bool LinkFile(const std::wstring& cachedFile, const std::wstring& destPath);
+
+    // Write entries to the paths of targets (archive index, file path),
+    // linking cached files and decoding only what the cache lacks. Entries
+    // it cannot or must not hold, like encrypted ones, are extracted
+    // straight to their paths. FilesExtracted
+    // and BytesExtracted count linked files too.
+    ExtractResult ExtractFiles(std::shared_ptr<Archive> archive,
+                               const std::vector<std::pair<UINT32, std::wstring>>& targets,
+                               ExtractCacheStats* stats = nullptr);
+
+    // Delete every cached file
+    void Clear();
+
+private:
+    ExtractCache();
+    ~ExtractCache() = default;
+    ExtractCache(const ExtractCache&) = delete;
+    ExtractCache& operator=(const ExtractCache&) = delete;
+
+    std::wstring GetDirectoryLocked();
+    std::wstring GetEntryPath(const std::wstring& directory, const ArchiveIdentity& identity,
+                              UINT32 index, UINT32 crc, UINT64 size) const;
+    bool Verify(const std::wstring& path, UINT64 size, UINT32 crc, const FILETIME& modifiedTime,
+                ExtractCacheStats& stats) const;
+    void Touch(const std::wstring& path) const;
+    void Trim(const std::wstring& directory, const std::unordered_set<std::wstring>& keep);
+
+    mutable std::mutex  _Mutex;
+    bool                _Enabled;
+    std::wstring        _Directory;
+    UINT64              _Budget;
+    UINT64              _VerifyLimit;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_EXTRACTCACHE_H
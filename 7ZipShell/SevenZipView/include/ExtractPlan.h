@@ -0,0 +1,75 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Solid-Block Aware Extraction Planner
+*/
+
+#ifndef SEVENZIPVIEW_EXTRACTPLAN_H
+#define SEVENZIPVIEW_EXTRACTPLAN_H
+
+#include "Common.h"
+
+namespace SevenZipView {
+
+// One requested file inside a planned folder
+struct PlannedEntry {
+    UINT32 ArchiveIndex;
+    UINT64 Offset;                      // Unpack offset inside the folder
+    UINT64 Size;
+};
+
+// Work for a single folder (solid block), decoded exactly once
+struct FolderPlan {
+    UInt32 Folder;
+    UINT64 UnpackSize;                  // Size of the whole folder
+    UINT64 DecodeLimit;                 // End of the last requested file
+    bool CanStopEarly;                  // Decoding may stop at DecodeLimit
+    std::vector<PlannedEntry> Entries;  // Sorted by unpack offset
+
+    FolderPlan() : Folder(0), UnpackSize(0), DecodeLimit(0), CanStopEarly(false) {}
+
+    // Bytes the decoder actually produces for this folder
+    UINT64 GetBytesToDecode() const { return CanStopEarly ? DecodeLimit : UnpackSize; }
+};
+
+// Plan statistics
+struct ExtractPlanStats {
+    UINT32 BlocksTouched;               // Folders that need decoding
+    UINT32 FilesPlanned;
+    UINT64 BytesNeeded;                 // Sum of requested file sizes
+    UINT64 BytesDecoded;                // Sum of bytes the decoders produce
+
+    ExtractPlanStats() : BlocksTouched(0), FilesPlanned(0), BytesNeeded(0), BytesDecoded(0) {}
+};
+
+// Orders requested archive indices by folder and unpack offset so every
+// folder is decoded once, front to back, and no further than needed
+class ExtractPlan {
+public:
+    ExtractPlan();
+
+    // Build a plan; directories are ignored and duplicate indices merged
+    void Build(const CSzArEx& db, const std::vector<UINT32>& indices);
+    void Clear();
+
+    // Folders in archive order
+    const std::vector<FolderPlan>& GetFolders() const { return _Folders; }
+
+    // Requested files with no data (they belong to no folder)
+    const std::vector<UINT32>& GetEmptyFiles() const { return _EmptyFiles; }
+
+    const ExtractPlanStats& GetStats() const { return _Stats; }
+
+    // True when the folder can be streamed, so decoding may stop after the
+    // last requested file (everything but BCJ2)
+    static bool CanDecodePrefix(const CSzArEx& db, UInt32 folder);
+
+private:
+    std::vector<FolderPlan> _Folders;
+    std::vector<UINT32>     _EmptyFiles;
+    ExtractPlanStats        _Stats;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_EXTRACTPLAN_H
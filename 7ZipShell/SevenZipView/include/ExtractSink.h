@@ -0,0 +1,106 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Chunked Extraction Sinks
+*/
+
+#ifndef SEVENZIPVIEW_EXTRACTSINK_H
+#define SEVENZIPVIEW_EXTRACTSINK_H
+
+#include "Common.h"
+
+namespace SevenZipView {
+
+class Archive;
+
+// Destination of extracted entries. The reader calls OnBegin, then OnChunk
+// with spans borrowed from the decoder's output window or a cached block
+// (valid only during the call), then OnEnd. Folder extraction repeats this
+// per entry. A false return from OnBegin or OnChunk stops extraction with
+// no further calls; the sink then cleans up the unfinished entry itself.
+class IExtractSink {
+public:
+    virtual ~IExtractSink() = default;
+
+    virtual bool OnBegin(UINT32 index, UINT64 size) = 0;
+    virtual bool OnChunk(const BYTE* data, size_t size) = 0;
+
+    // ok tells whether the entry decoded whole and matched its CRC; the
+    // result is whether the sink completed the entry
+    virtual bool OnEnd(bool ok) = 0;
+};
+
+// Collects an entry in a caller's buffer, reserved once to its size
+class MemorySink : public IExtractSink {
+public:
+    explicit MemorySink(std::vector<BYTE>& buffer) : _Buffer(buffer) {}
+
+    bool OnBegin(UINT32 index, UINT64 size) override;
+    bool OnChunk(const BYTE* data, size_t size) override;
+    bool OnEnd(bool ok) override { return ok; }
+
+private:
+    std::vector<BYTE>& _Buffer;
+};
+
+// Writes an entry straight to disk through Archive::CreateEntryFile and
+// FinishEntryFile. SetPath before OnBegin to reuse it for several entries;
+// a file left unfinished is deleted when the sink is destroyed.
+class FileSink : public IExtractSink {
+public:
+    FileSink(const Archive& archive, const std::wstring& destPath = std::wstring());
+    ~FileSink() override;
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    void SetPath(const std::wstring& destPath) { _Path = destPath; }
+    const std::wstring& GetPath() const { return _Path; }
+
+    bool OnBegin(UINT32 index, UINT64 size) override;
+    bool OnChunk(const BYTE* data, size_t size) override;
+    bool OnEnd(bool ok) override;
+
+private:
+    const Archive&  _Archive;
+    std::wstring    _Path;
+    UINT32          _Index;
+    HANDLE          _File;
+    bool            _WriteOk;
+};
+
+// Running CRC32 and length of an entry, without keeping its data
+class HashSink : public IExtractSink {
+public:
+    HashSink() : _Crc(CRC_INIT_VAL), _Size(0) {}
+
+    UINT32 GetCrc() const { return CRC_GET_DIGEST(_Crc); }
+    UINT64 GetSize() const { return _Size; }
+
+    bool OnBegin(UINT32 index, UINT64 size) override;
+    bool OnChunk(const BYTE* data, size_t size) override;
+    bool OnEnd(bool ok) override { return ok; }
+
+private:
+    UINT32  _Crc;           // Running value, finalized by GetCrc
+    UINT64  _Size;
+};
+
+// Hands every call to two sinks, e.g. a FileSink and a HashSink. Stops as
+// soon as either one does.
+class TeeSink : public IExtractSink {
+public:
+    TeeSink(IExtractSink& first, IExtractSink& second) : _First(first), _Second(second) {}
+
+    bool OnBegin(UINT32 index, UINT64 size) override;
+    bool OnChunk(const BYTE* data, size_t size) override;
+    bool OnEnd(bool ok) override;
+
+private:
+    IExtractSink&   _First;
+    IExtractSink&   _Second;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_EXTRACTSINK_H
@@ -9,10 +9,14 @@
 
 #include "Common.h"
 #include "Archive.h"
+#include "ExtractPlan.h"
+#include "FileWriter.h"
 
 namespace SevenZipView {
 
 // Progress callback interface
+// Callbacks are always invoked on the thread that called Extractor::Extract,
+// even when decoding runs on worker threads.
 class IExtractProgress {
 public:
     virtual ~IExtractProgress() = default;
@@ -38,8 +42,27 @@ struct ExtractOptions {
     bool OverwriteExisting;              // Overwrite files
     std::vector<UINT32> ItemIndices;     // Items to extract (empty = all)
     std::wstring Password;               // Password for encrypted archives
+    UINT32 ThreadCount;                  // Decoder workers (0 = auto, 1 = serial)
+    size_t DecodeWindowSize;             // Streaming decoder window (0 = default)
+    UINT32 WriterThreads;                // File writer threads (0 = default)
     
-    ExtractOptions() : PreservePaths(true), OverwriteExisting(false) {}
+    ExtractOptions() : PreservePaths(true), OverwriteExisting(false), ThreadCount(0), DecodeWindowSize(0),
+                       WriterThreads(0) {}
+};
+
+// Throughput report for one extraction worker
+struct ExtractWorkerStats {
+    UINT32 WorkerId;
+    UINT32 FoldersDecoded;               // Solid blocks handled by this worker
+    UINT32 FilesExtracted;               // Decoded and written, or queued for a writer
+    UINT64 BytesExtracted;
+    double Seconds;                      // Wall time spent working
+    
+    ExtractWorkerStats() : WorkerId(0), FoldersDecoded(0), FilesExtracted(0), BytesExtracted(0), Seconds(0.0) {}
+    
+    double GetThroughputMBps() const {
+        return Seconds > 0.0 ? (BytesExtracted / (1024.0 * 1024.0)) / Seconds : 0.0;
+    }
 };
 
 // Extraction result
@@ -50,8 +73,35 @@ struct ExtractResult {
     UINT64 BytesExtracted;
     std::wstring ErrorMessage;
     std::vector<std::wstring> FailedFiles;
+    std::vector<UINT32> FailedIndices;   // Archive index of each of FailedFiles
+    UINT32 ThreadCount;                  // Workers actually used
+    double ElapsedSeconds;
+    std::vector<ExtractWorkerStats> WorkerStats;
+    ExtractPlanStats Plan;               // Blocks touched, bytes needed vs decoded
+    FileWriterStats Writer;              // Write stage, including time decoders waited on it
     
-    ExtractResult() : Success(false), FilesExtracted(0), FilesFailed(0), BytesExtracted(0) {}
+    ExtractResult() : Success(false), FilesExtracted(0), FilesFailed(0), BytesExtracted(0),
+                      ThreadCount(0), ElapsedSeconds(0.0) {}
+};
+
+// Archive test result
+struct TestResult {
+    bool Success;
+    UINT32 FilesTested;
+    UINT32 FilesFailed;
+    UINT64 BytesTested;                  // Unpacked bytes checked
+    std::wstring ErrorMessage;
+    std::vector<std::wstring> FailedFiles;   // Archive paths, in archive order
+    std::vector<UINT32> FailedIndices;       // Their archive indices
+    UINT32 ThreadCount;
+    double ElapsedSeconds;
+    
+    TestResult() : Success(false), FilesTested(0), FilesFailed(0), BytesTested(0),
+                   ThreadCount(0), ElapsedSeconds(0.0) {}
+    
+    double GetThroughputMBps() const {
+        return ElapsedSeconds > 0.0 ? (BytesTested / (1024.0 * 1024.0)) / ElapsedSeconds : 0.0;
+    }
 };
 
 // Main extraction class
@@ -65,6 +115,15 @@ public:
                          const ExtractOptions& options,
                          IExtractProgress* progress = nullptr);
     
+    // Extract entries of an open archive to explicit destinations (archive
+    // index, file path), planned by folder and decoded in parallel like
+    // Extract. Directory entries are skipped; DestinationPath, PreservePaths
+    // and ItemIndices of options are not used.
+    ExtractResult ExtractFiles(std::shared_ptr<Archive> archive,
+                               const std::vector<std::pair<UINT32, std::wstring>>& targets,
+                               const ExtractOptions& options,
+                               IExtractProgress* progress = nullptr);
+    
     // Extract single item to buffer
     bool ExtractToBuffer(const std::wstring& archivePath, 
                         UINT32 itemIndex,
@@ -75,11 +134,55 @@ public:
                       UINT32 itemIndex,
                       const std::wstring& destPath);
     
-    // Test archive integrity
-    bool TestArchive(const std::wstring& archivePath,
-                    IExtractProgress* progress = nullptr);
+    // Test archive integrity: every file is decoded and checked against its
+    // stored CRC as it streams out, without being written or buffered. Each
+    // solid block is decoded once; blocks are checked on up to threadCount
+    // workers (0 = auto).
+    TestResult TestArchive(const std::wstring& archivePath,
+                           IExtractProgress* progress = nullptr,
+                           UINT32 threadCount = 0);
 
 private:
+    // One requested entry, resolved to its destination path
+    struct PlannedFile {
+        ArchiveEntry Entry;
+        std::wstring DestPath;
+    };
+    
+    // Workers for decoding the folders of these archive indices
+    static UINT32 ResolveThreadCount(const CSzArEx& db,
+                                     const std::vector<UINT32>& indices,
+                                     UINT32 requested,
+                                     size_t windowSize);
+    
+    // Common part of Extract and ExtractFiles once destinations are known
+    void ExtractResolved(std::shared_ptr<Archive> archive,
+                         const std::vector<PlannedFile>& files,
+                         const ExtractOptions& options,
+                         UINT64 totalSize,
+                         IExtractProgress* progress,
+                         ExtractResult& result);
+    
+    // Fallback: one file at a time through the archive's own stream
+    void ExtractSerial(std::shared_ptr<Archive> archive,
+                       const std::vector<PlannedFile>& files,
+                       bool overwriteExisting,
+                       UINT64 totalSize,
+                       IExtractProgress* progress,
+                       ExtractResult& result);
+    
+    // Plan by folder, decode each folder once on up to threadCount readers,
+    // and write the files on writerThreads behind a bounded queue
+    void ExtractPlanned(std::shared_ptr<Archive> archive,
+                        const std::vector<PlannedFile>& files,
+                        bool overwriteExisting,
+                        UINT32 threadCount,
+                        size_t decodeWindowSize,
+                        UINT32 writerThreads,
+                        UINT64 totalSize,
+                        IExtractProgress* progress,
+                        ExtractResult& result);
+    
     bool EnsureDirectoryExists(const std::wstring& path);
     std::wstring MakeValidPath(const std::wstring& basePath, const std::wstring& itemPath);
 };
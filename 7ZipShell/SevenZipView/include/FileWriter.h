@@ -0,0 +1,139 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Pipelined File Writer for Extraction
+*/
+
+#ifndef SEVENZIPVIEW_FILEWRITER_H
+#define SEVENZIPVIEW_FILEWRITER_H
+
+#include "Common.h"
+#include "ExtractSink.h"
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace SevenZipView {
+
+class Archive;
+
+// Most writer threads when FileWriter is given 0 (fewer on fewer cores)
+static const UINT32 FILE_WRITER_DEFAULT_THREADS = 4;
+
+// Decoded bytes and files waiting for a writer before Submit blocks
+static const size_t FILE_WRITER_DEFAULT_QUEUE = 64 * 1024 * 1024;
+static const size_t FILE_WRITER_MAX_QUEUED_FILES = 4096;
+
+// Entries above this size are written by the decoding thread itself: their
+// cost is bandwidth, which a queue does not hide, and buffering them whole
+// would take most of the queue
+static const UINT64 FILE_WRITER_DIRECT_LIMIT = 4 * 1024 * 1024;
+
+struct FileWriterStats {
+    UINT32  FilesWritten;
+    UINT32  FilesFailed;
+    UINT64  BytesWritten;
+    UINT32  Stalls;             // Submit calls that waited for room
+    double  StallSeconds;       // Time decoders spent waiting on the disk
+
+    FileWriterStats() : FilesWritten(0), FilesFailed(0), BytesWritten(0), Stalls(0), StallSeconds(0.0) {}
+};
+
+// Write stage of extraction, decoupled from decoding by a bounded queue.
+// Decoder threads submit whole decoded files; writer threads create, write
+// and close them through Archive::CreateEntryFile and FinishEntryFile. When
+// the queue is full, Submit blocks, so a disk slower than the decoders
+// holds them back instead of growing memory. Buffers of written files are
+// recycled for the next ones.
+// onDone reports every submitted file once, on a writer thread.
+class FileWriter {
+public:
+    typedef std::function<void(UINT32 index, bool ok)> DoneFunc;
+
+    FileWriter(const Archive& archive, DoneFunc onDone, UINT32 threads = 0,
+               size_t maxQueued = FILE_WRITER_DEFAULT_QUEUE);
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    const Archive& GetArchive() const { return _Archive; }
+
+    // Empty buffer for an entry of size bytes, from a written file if any
+    std::vector<BYTE> AcquireBuffer(size_t size);
+
+    // Queue a decoded file; blocks while the queue is full
+    void Submit(UINT32 index, const std::wstring& destPath, std::vector<BYTE>&& data);
+
+    // Report a file that never reached the queue (failed decode, direct write)
+    void Report(UINT32 index, bool ok, UINT64 bytes);
+
+    // True once every submitted file has been written
+    bool IsIdle() const;
+
+    // Drop queued files, reporting them as failed
+    void Cancel();
+
+    // Write what is queued and stop the threads
+    void Finish();
+
+    FileWriterStats GetStats() const;
+
+private:
+    struct Job {
+        UINT32              Index;
+        std::wstring        Path;
+        std::vector<BYTE>   Data;
+    };
+
+    void WriterLoop();
+    bool Write(Job& job);
+    void Recycle(std::vector<BYTE>&& buffer);
+
+    const Archive&              _Archive;
+    DoneFunc                    _OnDone;
+    size_t                      _MaxQueued;
+
+    mutable std::mutex          _Mutex;
+    std::condition_variable     _HasWork;
+    std::condition_variable     _HasRoom;
+    std::deque<Job>             _Queue;
+    size_t                      _QueuedBytes;   // Data of queued and in-flight jobs
+    size_t                      _InFlight;      // Jobs taken by writers
+    bool                        _Stopping;
+    std::vector<std::vector<BYTE>> _FreeBuffers;
+    size_t                      _FreeBytes;     // Capacity held in _FreeBuffers
+    FileWriterStats             _Stats;
+    std::vector<std::thread>    _Threads;
+};
+
+// Decoder-side sink feeding a FileWriter: each entry is collected into a
+// recycled buffer and queued once it has decoded and passed its CRC.
+// Entries above FILE_WRITER_DIRECT_LIMIT go straight to disk through a
+// FileSink. SetPath before each entry, as with FileSink.
+class WriterSink : public IExtractSink {
+public:
+    explicit WriterSink(FileWriter& writer);
+
+    void SetPath(const std::wstring& destPath) { _Path = destPath; }
+
+    bool OnBegin(UINT32 index, UINT64 size) override;
+    bool OnChunk(const BYTE* data, size_t size) override;
+
+    // True when the entry was written or queued; the final result comes
+    // through the writer's DoneFunc
+    bool OnEnd(bool ok) override;
+
+private:
+    FileWriter&         _Writer;
+    FileSink            _Direct;
+    std::wstring        _Path;
+    UINT32              _Index;
+    UINT64              _Size;
+    bool                _IsDirect;
+    std::vector<BYTE>   _Buffer;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_FILEWRITER_H
@@ -0,0 +1,173 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Bounded-Memory Streaming Folder Decoder
+*/
+
+#ifndef SEVENZIPVIEW_FOLDERDECODER_H
+#define SEVENZIPVIEW_FOLDERDECODER_H
+
+#include "Common.h"
+#include "AesKeyCache.h"
+
+extern "C" {
+#include "LzmaDec.h"
+#include "Lzma2Dec.h"
+}
+
+namespace SevenZipView {
+
+// Default output window: bytes produced per decoder step and filter pass
+static const size_t FOLDER_DECODER_DEFAULT_WINDOW = (1 << 20);
+
+// Smallest accepted window, leaves room for branch filter look-ahead
+static const size_t FOLDER_DECODER_MIN_WINDOW = (1 << 16);
+
+// Folders up to this size may still be decoded whole and cached, since the
+// shell reads files of a small block in random order
+static const UINT64 FOLDER_DECODER_BLOCK_CACHE_LIMIT = (64ull << 20);
+
+// Pull decoder for one folder (solid block). Output is produced in chunks of
+// at most the window size; memory is the LZMA dictionary (capped by the
+// folder size) plus the window, however large the folder is.
+//
+// Folders encrypted with 7zAES are decrypted on the way in, a look-ahead at
+// a time, with the key the archive's AesKeyCache holds for their salt.
+//
+// The decoder needs exclusive use of the stream it is given: it seeks it on
+// Open and expects nobody else to move it until Close.
+class FolderDecoder {
+public:
+    // keys: password and derived keys of the archive, nullptr if it has none
+    FolderDecoder(const CSzArEx& db, ILookInStreamPtr stream, ISzAllocPtr alloc, AesKeyCache* keys = nullptr);
+    ~FolderDecoder();
+
+    FolderDecoder(const FolderDecoder&) = delete;
+    FolderDecoder& operator=(const FolderDecoder&) = delete;
+
+    // Output window size (takes effect on the next Open)
+    void SetWindowSize(size_t size);
+    size_t GetWindowSize() const { return _WindowSize; }
+
+    // True when the folder can be streamed; BCJ2 folders are decoded whole
+    static bool CanStream(const CSzArEx& db, UInt32 folder);
+
+    // True when a 7zAES coder is part of the folder
+    static bool IsEncrypted(const CSzArEx& db, UInt32 folder);
+
+    // Peak bytes the decoder holds for the folder with the given window
+    static UINT64 EstimateMemory(const CSzArEx& db, UInt32 folder, size_t windowSize);
+
+    // Start decoding a folder from its first byte
+    SRes Open(UInt32 folder);
+    void Close();
+    bool IsOpen() const { return _IsOpen; }
+
+    // Move to an unpack offset; forward moves resume, backward ones restart
+    SRes Seek(UINT64 offset);
+
+    // Position on the first byte of a file of the open (or any) folder
+    SRes SeekToFile(UINT32 fileIndex);
+
+    // Next chunk of output, at most maxSize bytes. The returned span is owned
+    // by the decoder and valid until the next call. size == 0 means end.
+    SRes Read(const Byte** data, size_t* size, size_t maxSize);
+
+    // Copy exactly 'size' bytes into dest
+    SRes ReadInto(Byte* dest, size_t size);
+
+    // Discard 'size' bytes of output
+    SRes Skip(UINT64 size);
+
+    // Receives decoded file data in window-sized chunks; return false to stop
+    typedef std::function<bool(const Byte* data, size_t size)> ChunkCallback;
+
+    // Stream one file through onChunk and check its CRC. Files later in the
+    // open folder resume from the current position instead of restarting.
+    SRes ExtractFile(UINT32 fileIndex, const ChunkCallback& onChunk);
+
+    // Stream at most the first maxBytes of a file, then stop decoding. The
+    // CRC is only checked when that covers the whole file. In a solid folder
+    // the files before it are still decoded; a file with a folder of its own
+    // starts decoding at its pack stream.
+    SRes ExtractPrefix(UINT32 fileIndex, UINT64 maxBytes, const ChunkCallback& onChunk);
+
+    UInt32 GetFolder() const { return _Folder; }
+    UINT64 GetPosition() const { return _Position; }
+    UINT64 GetUnpackSize() const { return _UnpackSize; }
+
+private:
+    enum class Coder : BYTE { Copy, Lzma, Lzma2, Whole };
+    enum class Filter : BYTE { None, Delta, X86, PPC, IA64, ARM, ARMT, SPARC, ARM64, RISCV };
+
+    SRes ParseFolder(UInt32 folder);
+    SRes OpenDecryption();
+    SRes OpenMain();
+    SRes ReadMain(const Byte** data, size_t* size, size_t maxSize);
+    SRes DecodeStep(size_t maxSize);
+    SRes LookInput(const void** buf, size_t* size);
+    SRes SkipInput(size_t size);
+    SRes Decrypt();
+    size_t RunFilter(Byte* data, size_t size);
+    void FreeBuffers();
+
+    const CSzArEx&      _Db;
+    ILookInStreamPtr    _Stream;
+    ISzAllocPtr         _Alloc;
+    AesKeyCache*        _Keys;
+    size_t              _WindowSize;
+
+    bool                _IsOpen;
+    UInt32              _Folder;
+    UINT64              _Position;          // Output offset inside the folder
+    UINT64              _UnpackSize;        // Folder output size
+    UINT32              _Crc;               // Running folder CRC
+    bool                _CrcValid;
+
+    // Main coder
+    Coder               _Coder;
+    const Byte*         _Props;
+    unsigned            _PropsSize;
+    UINT64              _PackPos;           // Absolute position of the pack stream
+    UINT64              _PackSize;
+    UINT64              _InputSize;         // Main coder input: the pack stream, or its decryption
+    UINT64              _PackRemaining;     // Main coder input not consumed yet
+    UINT64              _MainSize;          // Main coder output size
+    UINT64              _MainDecoded;
+    size_t              _PendingSkip;       // Copy: look-ahead bytes handed out
+    CLzmaDec            _Lzma;
+    CLzma2Dec           _Lzma2;
+    Byte*               _Dic;
+    size_t              _DicSize;
+    size_t              _DicEmitPos;        // Dictionary bytes already handed out
+
+    // Decryption stage (7zAES between the pack stream and the main coder)
+    bool                _Encrypted;
+    AesCoderProps       _Aes;
+    Byte*               _AesBuffer;         // From _Alloc: state and look-ahead, aligned inside
+    UInt32*             _AesState;          // IV, key mode and round keys
+    Byte*               _Plain;             // Decrypted look-ahead
+    size_t              _PlainPos;
+    size_t              _PlainFill;
+    UINT64              _PlainLeft;         // Main coder input not decrypted yet
+    UINT64              _CipherLeft;        // Pack stream bytes not read yet
+
+    // Whole-folder fallback (BCJ2)
+    Byte*               _Whole;
+
+    // Filter stage
+    Filter              _Filter;
+    UInt32              _FilterStartPc;
+    UInt32              _FilterPc;
+    UInt32              _X86State;
+    unsigned            _Delta;
+    Byte                _DeltaState[256];
+    Byte*               _Window;
+    size_t              _WindowFill;
+    size_t              _WindowReady;       // Filtered bytes at the window start
+    size_t              _WindowEmitted;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_FOLDERDECODER_H
@@ -0,0 +1,95 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Persistent Archive Index Cache
+*/
+
+#ifndef SEVENZIPVIEW_INDEXCACHE_H
+#define SEVENZIPVIEW_INDEXCACHE_H
+
+#include "Common.h"
+#include "IndexImage.h"
+#include "MappedInStream.h"
+#include <memory>
+#include <mutex>
+
+namespace SevenZipView {
+
+// Default size of the cache directory before the least recently used
+// entries are deleted
+constexpr UINT64 INDEX_CACHE_DEFAULT_BUDGET = 256ull * 1024 * 1024;
+
+// Archives with fewer entries parse fast enough without a cache
+constexpr UINT32 INDEX_CACHE_DEFAULT_MIN_ENTRIES = 4096;
+
+// What a cached index is checked against before use: the file's size and
+// write time, plus the 7z start header, which locates and checksums the
+// archive header the index was parsed from
+struct ArchiveIdentity {
+    UINT64  Size;
+    UINT64  ModifiedTime;       // FILETIME as High:Low
+    UINT64  NextHeaderOffset;
+    UINT64  NextHeaderSize;
+    UINT32  NextHeaderCRC;
+    UINT32  Reserved;
+
+    // false if the file cannot be read or is not a 7z archive
+    static bool Read(const std::wstring& path, ArchiveIdentity& identity);
+
+    // Identity of an archive held in memory: its size, the write time of
+    // the file it was decoded from, and its start header
+    static bool FromMemory(const Byte* data, UINT64 size, UINT64 modifiedTime, ArchiveIdentity& identity);
+};
+
+// Parsed archive indexes (entry table and directory index) kept on disk in
+// %LOCALAPPDATA%\SevenZipView\IndexCache, one file per archive. A hit is
+// mapped read-only and used in place. Entries are written atomically, and
+// the directory is trimmed to a byte budget by deleting the least recently
+// used entries.
+class IndexCache {
+public:
+    static IndexCache& Instance();
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+
+    // Cache directory; empty selects the default under %LOCALAPPDATA%
+    void SetDirectory(const std::wstring& directory);
+
+    void SetBudget(UINT64 bytes);
+    void SetMinEntries(UINT32 count);
+    UINT32 GetMinEntries() const;
+
+    // Map the cached index of an archive. nullptr on a miss, or when the
+    // entry is stale, damaged or was written by another build. On success
+    // payload reads the image stored by Store.
+    std::shared_ptr<MappedFile> Load(const std::wstring& archivePath, const ArchiveIdentity& identity,
+                                     IndexReader& payload);
+
+    // Store an index image, then trim the directory to the budget
+    bool Store(const std::wstring& archivePath, const ArchiveIdentity& identity, const IndexWriter& payload);
+
+    // Delete every cached index
+    void Clear();
+
+private:
+    IndexCache();
+    ~IndexCache() = default;
+    IndexCache(const IndexCache&) = delete;
+    IndexCache& operator=(const IndexCache&) = delete;
+
+    std::wstring GetDirectoryLocked();
+    std::wstring GetEntryPath(const std::wstring& directory, const std::wstring& archivePath) const;
+    void Touch(const std::wstring& entryPath) const;
+    void Trim(const std::wstring& directory);
+
+    mutable std::mutex  _Mutex;
+    bool                _Enabled;
+    std::wstring        _Directory;
+    UINT64              _Budget;
+    UINT32              _MinEntries;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_INDEXCACHE_H
@@ -0,0 +1,146 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Binary Index Image Reader/Writer
+*/
+
+#ifndef SEVENZIPVIEW_INDEXIMAGE_H
+#define SEVENZIPVIEW_INDEXIMAGE_H
+
+#include "Common.h"
+#include <type_traits>
+
+namespace SevenZipView {
+
+// Array that either owns its elements (built in memory) or views them in
+// place inside a loaded index image. Build through Storage(); a View drops
+// the storage.
+template <typename T>
+class IndexColumn {
+public:
+    IndexColumn() : _View(nullptr), _ViewSize(0) {}
+
+    std::vector<T>& Storage() { return _Storage; }
+
+    void View(const T* data, size_t size) {
+        std::vector<T>().swap(_Storage);
+        _View = data;
+        _ViewSize = size;
+    }
+
+    void Clear() {
+        std::vector<T>().swap(_Storage);
+        _View = nullptr;
+        _ViewSize = 0;
+    }
+
+    const T* Data() const { return _View ? _View : _Storage.data(); }
+    size_t Size() const { return _View ? _ViewSize : _Storage.size(); }
+    const T& operator[](size_t i) const { return Data()[i]; }
+
+    // Heap bytes; a view costs nothing
+    size_t GetMemoryUsage() const { return _Storage.capacity() * sizeof(T); }
+
+private:
+    std::vector<T>  _Storage;
+    const T*        _View;
+    size_t          _ViewSize;
+};
+
+// Appends values and arrays to a byte image. Every item starts on an
+// 8-byte boundary so a reader can view arrays in a mapping without copying.
+class IndexWriter {
+public:
+    template <typename T>
+    void WriteValue(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "index values are copied as bytes");
+        Append(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void WriteArray(const T* data, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "index arrays are copied as bytes");
+        WriteValue((UINT64)count);
+        Append(data, count * sizeof(T));
+    }
+
+    template <typename T>
+    void WriteArray(const IndexColumn<T>& column) { WriteArray(column.Data(), column.Size()); }
+
+    const std::vector<BYTE>& GetData() const { return _Data; }
+
+private:
+    void Append(const void* data, size_t size) {
+        size_t pos = _Data.size();
+        _Data.resize(pos + ((size + 7) & ~(size_t)7), 0);
+        if (size) memcpy(_Data.data() + pos, data, size);
+    }
+
+    std::vector<BYTE>   _Data;
+};
+
+// Reads what IndexWriter wrote. Arrays are returned as views into the
+// image, which must be 8-byte aligned and outlive them. Every read is
+// bounds checked; after a failed read the reader stays failed.
+class IndexReader {
+public:
+    IndexReader() : _Data(nullptr), _Size(0), _Pos(0), _Failed(true) {}
+    IndexReader(const BYTE* data, size_t size) : _Data(data), _Size(size), _Pos(0), _Failed(data == nullptr) {}
+
+    bool Failed() const { return _Failed; }
+
+    template <typename T>
+    bool ReadValue(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "index values are copied as bytes");
+        const void* data = Take(sizeof(T));
+        if (!data) return false;
+        memcpy(&value, data, sizeof(T));
+        return true;
+    }
+
+    // count is checked against expectedCount unless that is SIZE_MAX
+    template <typename T>
+    bool ReadArray(const T*& data, size_t& count, size_t expectedCount = SIZE_MAX) {
+        static_assert(std::is_trivially_copyable<T>::value, "index arrays are copied as bytes");
+        UINT64 stored = 0;
+        if (!ReadValue(stored)) return false;
+        if (stored > (UINT64)(_Size / sizeof(T)) ||
+            (expectedCount != SIZE_MAX && stored != (UINT64)expectedCount)) {
+            _Failed = true;
+            return false;
+        }
+        count = (size_t)stored;
+        data = static_cast<const T*>(Take(count * sizeof(T)));
+        return data != nullptr;
+    }
+
+    template <typename T>
+    bool ReadArray(IndexColumn<T>& column, size_t expectedCount = SIZE_MAX) {
+        const T* data = nullptr;
+        size_t count = 0;
+        if (!ReadArray(data, count, expectedCount)) return false;
+        column.View(data, count);
+        return true;
+    }
+
+private:
+    const void* Take(size_t size) {
+        size_t padded = (size + 7) & ~(size_t)7;
+        if (_Failed || padded < size || padded > _Size - _Pos) {
+            _Failed = true;
+            return nullptr;
+        }
+        const void* data = _Data + _Pos;
+        _Pos += padded;
+        return data;
+    }
+
+    const BYTE*     _Data;
+    size_t          _Size;
+    size_t          _Pos;
+    bool            _Failed;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_INDEXIMAGE_H
@@ -0,0 +1,109 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Shell Item ID Encoding
+*/
+
+#ifndef SEVENZIPVIEW_ITEMID_H
+#define SEVENZIPVIEW_ITEMID_H
+
+#include "Common.h"
+#include "DirectoryIndex.h"
+#include "EntryTable.h"
+
+namespace SevenZipView {
+
+// Longest name an item ID holds; longer names are cut, as version 1 cut
+// them at 259 characters
+static const size_t ITEM_ID_MAX_NAME_LENGTH = 32000;
+
+#pragma pack(push, 1)
+
+// Version 1 item ID, written by earlier releases. Still read, so shortcuts,
+// saved views and jump lists pointing into archives keep working.
+struct LegacyItemData {
+    USHORT cb;              // Total size including cb
+    USHORT signature;       // 0x375A ('7Z' for 7-Zip)
+    ItemType type;
+    WCHAR name[260];        // File/folder name
+    WCHAR path[512];        // Full path inside archive
+    UINT64 size;            // Uncompressed size
+    UINT64 compressedSize;  // Compressed size
+    UINT32 archiveIndex;    // Index in archive
+    UINT32 crc;             // CRC32
+    UINT32 attributes;      // File attributes
+    FILETIME modifiedTime;  // Modification time
+    BYTE reserved[16];
+
+    static const USHORT SIGNATURE = 0x375A; // '7Z'
+};
+
+// Current item ID: fixed columns followed by the name, length-prefixed and
+// terminated. The path inside the archive is not stored; it comes from the
+// archive index, or from the parent folder for synthetic folders.
+struct ItemIdHeader {
+    USHORT cb;              // Total size including cb
+    USHORT signature;       // 0x7A37 ('7z')
+    BYTE version;           // ITEM_ID_VERSION
+    ItemType type;
+    UINT32 archiveIndex;    // SYNTHETIC_FOLDER_INDEX for synthetic folders
+    UINT64 size;
+    UINT64 compressedSize;
+    UINT32 attributes;
+    FILETIME modifiedTime;
+    USHORT nameLength;      // Characters, without the terminator
+    // WCHAR name[nameLength + 1]
+
+    static const USHORT SIGNATURE = 0x7A37; // '7z'
+    static const BYTE VERSION = 2;
+};
+
+#pragma pack(pop)
+
+// Columns of an item ID, whichever version it was read from
+struct ItemIdFields {
+    ItemType            Type;
+    UINT32              ArchiveIndex;
+    UINT64              Size;
+    UINT64              CompressedSize;
+    UINT32              Attributes;
+    FILETIME            ModifiedTime;
+    std::wstring_view   Name;       // Points into the ID, terminated, when read
+    const WCHAR*        Path;       // Stored path of version 1 IDs, else nullptr
+    BYTE                Version;
+
+    ItemIdFields()
+        : Type(ItemType::Unknown)
+        , ArchiveIndex(0)
+        , Size(0)
+        , CompressedSize(0)
+        , Attributes(0)
+        , Path(nullptr)
+        , Version(ItemIdHeader::VERSION) {
+        ZeroMemory(&ModifiedTime, sizeof(ModifiedTime));
+    }
+};
+
+// Encoding of the SHITEMIDs ShellFolder hands to Explorer. Works on raw
+// bytes; callers allocate the ID list and its terminator.
+class ItemId {
+public:
+    // Bytes of an ID (cb included, list terminator excluded) for a name
+    static size_t GetSize(size_t nameLength);
+
+    // Write an ID of GetSize(fields.Name.size()) bytes at dest
+    static void Write(BYTE* dest, const ItemIdFields& fields);
+
+    // Decode an ID of either version; false when it is not one of ours.
+    // fields views the ID and is valid as long as it is.
+    static bool Read(const BYTE* id, ItemIdFields& fields);
+
+    // Columns of a directory node, read from the index and table without
+    // building an ArchiveEntry. fields.Name views the directory index.
+    static bool FromNode(const DirectoryIndex& directory, const EntryTable& table,
+                         UINT32 node, ItemIdFields& fields);
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_ITEMID_H
@@ -0,0 +1,36 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Selectable LZMA Symbol Decoding Loop
+*/
+
+#ifndef SEVENZIPVIEW_LZMADECODELOOP_H
+#define SEVENZIPVIEW_LZMADECODELOOP_H
+
+#include "Common.h"
+
+extern "C" {
+#include "LzmaDec.h"
+}
+
+namespace SevenZipView {
+
+enum class LzmaDecodeLoop {
+    Reference,      // The SDK's generic C loop
+    Fast            // Specialized for the usual lc/lp/pb, branch-reduced bit decoding
+};
+
+// Select the loop every LZMA and LZMA2 decoder of the process runs. Both
+// produce the same output, status and state for any input, damaged input
+// included (LzmaBench checks this). Call while nothing decodes.
+void SetLzmaDecodeLoop(LzmaDecodeLoop loop);
+LzmaDecodeLoop GetLzmaDecodeLoop();
+
+const char* GetLzmaDecodeLoopName(LzmaDecodeLoop loop);
+
+// The fast loop itself, with the contract of the SDK's LZMA_DECODE_REAL
+int Z7_FASTCALL LzmaFastDecodeReal(CLzmaDec* p, SizeT limit, const Byte* bufLimit);
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_LZMADECODELOOP_H
@@ -0,0 +1,68 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Memory-Mapped Archive Input Stream
+*/
+
+#ifndef SEVENZIPVIEW_MAPPEDINSTREAM_H
+#define SEVENZIPVIEW_MAPPEDINSTREAM_H
+
+#include "Common.h"
+#include <memory>
+
+namespace SevenZipView {
+
+// Read-only mapping of a whole archive file, or archive bytes already in
+// memory (a nested archive decoded from its outer one). Shared by every
+// stream that reads the archive; the view stays valid while any of them
+// holds it.
+class MappedFile {
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file; nullptr when it cannot be mapped (empty, remote, too large
+    // for the address space, or any API failure) so callers can fall back
+    static std::shared_ptr<MappedFile> Open(const std::wstring& path);
+
+    // View size bytes at data, kept alive by owner (a pinned block or a
+    // buffer) for as long as the view is held
+    static std::shared_ptr<MappedFile> FromMemory(const Byte* data, UINT64 size, std::shared_ptr<const void> owner);
+
+    // True for a view from FromMemory
+    bool IsMemory() const { return _Owner != nullptr; }
+
+    const Byte* GetData() const { return _View; }
+    UINT64 GetSize() const { return _Size; }
+
+private:
+    MappedFile();
+
+    HANDLE              _File;
+    HANDLE              _Mapping;
+    const Byte*         _View;
+    UINT64              _Size;
+    std::shared_ptr<const void> _Owner;     // Memory behind _View, when not mapped
+};
+
+// ILookInStream over a mapped file, used in place of CFileInStream plus
+// CLookToRead2. Look returns views straight into the mapping, so decoders
+// read archive bytes without a copy into a look-ahead buffer.
+// Each stream has its own position; a stream is used by one thread at a time.
+struct CMappedInStream {
+    ILookInStream vt;
+    const Byte* data;
+    UInt64 size;
+    UInt64 pos;
+};
+
+void MappedInStream_CreateVTable(CMappedInStream* p);
+
+// Point the stream at the start of a mapping (nullptr detaches it)
+void MappedInStream_Init(CMappedInStream* p, const MappedFile* file);
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_MAPPEDINSTREAM_H
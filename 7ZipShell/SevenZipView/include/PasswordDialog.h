@@ -8,6 +8,7 @@
 #define SEVENZIPVIEW_PASSWORDDIALOG_H
 
 #include "Common.h"
+#include "Archive.h"
 
 namespace SevenZipView {
 
@@ -33,6 +34,21 @@ public:
     // Static helper to show dialog
     static PasswordResult Prompt(HWND parent, const std::wstring& archivePath);
     
+    // Give an archive with encrypted entries a password before its files
+    // are read: the one it holds, one remembered for its path this session,
+    // or one the user enters. False if the user cancelled.
+    static bool Unlock(HWND parent, Archive& archive);
+    
+    // After a failed read of an encrypted archive: drop its password, so
+    // the next attempt asks again
+    static void Forget(Archive& archive);
+    
+    // After entries failed to extract: Forget, but only if an encrypted one
+    // among them also fails to decode on its own, and so does an encrypted
+    // file of another block if there is one. A locked target, a full disk
+    // or a damaged entry, encrypted or not, keeps the password.
+    static void ForgetIfRejected(Archive& archive, const std::vector<UINT32>& failedIndices);
+    
 private:
     static INT_PTR CALLBACK DialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
     INT_PTR HandleMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
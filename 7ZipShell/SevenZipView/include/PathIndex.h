@@ -0,0 +1,70 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Case-Insensitive Archive Path Index
+*/
+
+#ifndef SEVENZIPVIEW_PATHINDEX_H
+#define SEVENZIPVIEW_PATHINDEX_H
+
+#include "Common.h"
+
+namespace SevenZipView {
+
+// Separator and case folding shared by the path and directory indexes
+inline wchar_t FoldPathChar(wchar_t c) {
+    if (c == L'\\') return L'/';
+    if (c < 0x80) return (c >= L'A' && c <= L'Z') ? (wchar_t)(c + (L'a' - L'A')) : c;
+    return (wchar_t)towlower(c);
+}
+
+inline bool IsPathSeparator(wchar_t c) {
+    return c == L'/' || c == L'\\';
+}
+
+// Hash index from archive path to file index, built once when an archive is
+// opened. Paths are compared the way Archive::GetEntry always did: '\' and
+// '/' are the same, trailing separators are ignored, case is folded with
+// towlower. Lookups allocate nothing.
+//
+// Names are read in place from the 7z name block: UTF-16LE characters with
+// a terminating zero, where name i starts at character offsets[i]
+// (CSzArEx::FileNames / FileNameOffsets).
+class PathIndex {
+public:
+    static constexpr UINT32 NOT_FOUND = 0xFFFFFFFF;
+
+    PathIndex();
+
+    void Build(const Byte* names, const size_t* offsets, UINT32 count);
+    void Clear();
+
+    // Lowest file index whose path matches, or NOT_FOUND
+    UINT32 Find(const wchar_t* path, size_t length) const;
+    UINT32 Find(const std::wstring& path) const { return Find(path.c_str(), path.size()); }
+
+    UINT32 GetCount() const { return _Count; }
+
+    // Bytes held by the hash table
+    size_t GetMemoryUsage() const { return _Slots.capacity() * sizeof(Slot); }
+
+private:
+    struct Slot {
+        UINT32 Hash;
+        UINT32 Index;                   // NOT_FOUND = empty
+    };
+
+    // Length of a name once trailing separators are dropped
+    size_t GetNameLength(UINT32 index) const;
+    bool NameEquals(UINT32 index, const wchar_t* path, size_t length) const;
+
+    const Byte*         _Names;
+    const size_t*       _Offsets;
+    UINT32              _Count;
+    UINT32              _Mask;          // Slot count - 1 (power of two)
+    std::vector<Slot>   _Slots;
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_PATHINDEX_H
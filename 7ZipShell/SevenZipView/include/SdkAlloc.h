@@ -0,0 +1,128 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Allocators for the 7z SDK
+*/
+
+#ifndef SEVENZIPVIEW_SDKALLOC_H
+#define SEVENZIPVIEW_SDKALLOC_H
+
+#include "Common.h"
+#include <mutex>
+
+namespace SevenZipView {
+
+// Arena blocks; larger requests get a block of their own
+static const size_t SDK_ARENA_BLOCK_SIZE = 256 * 1024;
+
+// Requests below this go to malloc; the pool is for dictionaries, decode
+// windows, decoded blocks and LZMA probability tables (about 28 KB for the
+// usual lc=3, lp=0)
+static const size_t BUFFER_POOL_MIN_SIZE = 16 * 1024;
+
+// Default bytes of freed buffers the pool keeps for reuse
+static const size_t BUFFER_POOL_DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+// Counters of an allocator. Requests that the allocator served without the
+// system allocator are Requests - SystemAllocations.
+struct SdkAllocStats {
+    UINT64  Requests;           // Alloc calls
+    UINT64  SystemAllocations;  // Of those, or of arena blocks, that reached malloc
+    UINT64  BytesRequested;
+    size_t  IdleBytes;          // Freed memory kept for reuse
+
+    SdkAllocStats() : Requests(0), SystemAllocations(0), BytesRequested(0), IdleBytes(0) {}
+};
+
+// malloc and free, counted. For what lives as long as an archive: the
+// parsed header of SzArEx_Open.
+ISzAllocPtr GetHeapAlloc();
+SdkAllocStats GetHeapAllocStats();
+
+// Monotonic arena for temporary allocations of one call, such as the temp
+// allocator of SzArEx_Open: Alloc bumps a pointer through large blocks,
+// Free does nothing, and everything is released at once by Reset or the
+// destructor. Not thread-safe.
+class SdkArena {
+public:
+    explicit SdkArena(size_t blockSize = SDK_ARENA_BLOCK_SIZE);
+    ~SdkArena();
+
+    SdkArena(const SdkArena&) = delete;
+    SdkArena& operator=(const SdkArena&) = delete;
+
+    ISzAllocPtr Get() const { return &_Vt.vt; }
+
+    // Release every block
+    void Reset();
+
+    const SdkAllocStats& GetStats() const { return _Stats; }
+
+    // Arena requests of every SdkArena since the process started
+    static SdkAllocStats GetTotalStats();
+
+private:
+    struct Vtable {
+        ISzAlloc    vt;
+        SdkArena*   Owner;
+    };
+
+    static void* AllocImpl(ISzAllocPtr p, size_t size);
+    static void FreeImpl(ISzAllocPtr p, void* address);
+    void* Allocate(size_t size);
+
+    Vtable              _Vt;
+    size_t              _BlockSize;
+    std::vector<BYTE*>  _Blocks;
+    BYTE*               _Next;          // Free space of the current block
+    size_t              _Left;
+    SdkAllocStats       _Stats;
+};
+
+// Process-wide recycling pool for large decoder buffers: LZMA dictionaries,
+// streaming windows, whole decoded folders. Sizes are rounded up to one of
+// four classes per power of two (at most a quarter unused), and freed
+// buffers go on the free list of their class, so the next folder, reader
+// or archive that needs one of that class gets it back without the system
+// allocator. Freed memory past the budget goes back to the system. Small
+// requests pass through to malloc. Thread-safe.
+class BufferPool {
+public:
+    static BufferPool& Instance();
+
+    // ISzAlloc over Instance(), for the SDK and FolderDecoder
+    static ISzAllocPtr GetAlloc();
+
+    void* Allocate(size_t size);
+    void Free(void* address);
+
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const;
+
+    // Return every idle buffer to the system
+    void Clear();
+
+    SdkAllocStats GetStats() const;
+
+private:
+    BufferPool();
+    ~BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    void TrimLocked();
+
+    mutable std::mutex  _Mutex;
+    std::unordered_map<size_t, std::vector<void*>> _Idle;  // Class size -> freed buffers
+    size_t              _Budget;
+    SdkAllocStats       _Stats;
+};
+
+// Deleter for buffers taken from the BufferPool
+struct BufferPoolDeleter {
+    void operator()(void* address) const { BufferPool::Instance().Free(address); }
+};
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_SDKALLOC_H
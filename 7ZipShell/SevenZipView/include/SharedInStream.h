@@ -0,0 +1,70 @@
+#pragma once
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Positional-Read Archive Input Stream
+*/
+
+#ifndef SEVENZIPVIEW_SHAREDINSTREAM_H
+#define SEVENZIPVIEW_SHAREDINSTREAM_H
+
+#include "Common.h"
+#include <memory>
+
+namespace SevenZipView {
+
+// Default look-ahead buffer of a CSharedInStream
+static const size_t SHARED_IN_STREAM_BUFFER = (1 << 18);
+
+// Archive file opened once for overlapped I/O. Each read carries its own
+// offset (pread-style), so any number of streams can read through the one
+// handle from different threads without sharing a file position.
+class SharedFile {
+public:
+    ~SharedFile();
+
+    SharedFile(const SharedFile&) = delete;
+    SharedFile& operator=(const SharedFile&) = delete;
+
+    // nullptr when the file cannot be opened
+    static std::shared_ptr<SharedFile> Open(const std::wstring& path);
+
+    UINT64 GetSize() const { return _Size; }
+
+    // Read up to size bytes at offset and wait for them. event is a manual
+    // reset event owned by the calling stream. read is 0 at end of file.
+    bool Read(UINT64 offset, void* buffer, DWORD size, HANDLE event, DWORD& read) const;
+
+private:
+    SharedFile();
+
+    HANDLE              _File;
+    UINT64              _Size;
+};
+
+// ILookInStream over a SharedFile with its own position, look-ahead buffer
+// and completion event; used in place of CFileInStream plus CLookToRead2.
+// A stream is used by one thread at a time.
+struct CSharedInStream {
+    ILookInStream vt;
+    const SharedFile* file;
+    HANDLE event;
+    Byte* buf;
+    size_t bufSize;
+    UInt64 bufStart;        // File offset of buf[0]
+    size_t bufFilled;
+    UInt64 pos;
+};
+
+// Set up the vtable with no file, buffer or event; call once before Init
+void SharedInStream_Construct(CSharedInStream* p);
+
+// Point the stream at the start of a file, allocating its buffer and event
+// on first use. false if either cannot be allocated.
+bool SharedInStream_Init(CSharedInStream* p, const SharedFile* file, size_t bufSize = SHARED_IN_STREAM_BUFFER);
+
+// Release the buffer and event; the stream can be initialized again
+void SharedInStream_Free(CSharedInStream* p);
+
+} // namespace SevenZipView
+
+#endif // SEVENZIPVIEW_SHAREDINSTREAM_H
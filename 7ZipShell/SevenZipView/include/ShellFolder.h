@@ -9,33 +9,11 @@
 
 #include "Common.h"
 #include "Archive.h"
+#include "EntryStream.h"
+#include "ItemId.h"
 
 namespace SevenZipView {
 
-// PIDL item data structure
-#pragma pack(push, 1)
-struct ItemData {
-    USHORT cb;              // Total size including cb
-    USHORT signature;       // 0x375A ('7Z' for 7-Zip)
-    ItemType type;
-    WCHAR name[260];        // File/folder name
-    WCHAR path[512];        // Full path inside archive
-    UINT64 size;            // Uncompressed size
-    UINT64 compressedSize;  // Compressed size
-    UINT32 archiveIndex;    // Index in archive
-    UINT32 crc;             // CRC32
-    UINT32 attributes;      // File attributes
-    FILETIME modifiedTime;  // Modification time
-    BYTE reserved[16];
-    
-    static const USHORT SIGNATURE = 0x375A; // '7Z'
-    
-    static UINT GetSize(const WCHAR* name) {
-        return sizeof(ItemData) - sizeof(WCHAR) * (260 - (UINT)wcslen(name) - 1);
-    }
-};
-#pragma pack(pop)
-
 // Forward declarations
 class ShellFolder;
 class EnumIDList;
@@ -136,6 +114,10 @@ public:
     void SetArchive(std::shared_ptr<Archive> archive) { _Archive = archive; }
     bool IsSubfolder() const { return !_CurrentFolder.empty(); }
     
+    // Single-item ID list of a child (CoTaskMemAlloc, list terminator included)
+    static PITEMID_CHILD CreateItemID(const ItemIdFields& fields);
+    static PITEMID_CHILD CreateItemID(const ArchiveEntry& entry);
+    
     // Friend for internal access
     friend class EnumIDList;
 
@@ -147,16 +129,26 @@ private:
     std::shared_ptr<Archive> _Archive;
     ComPtr<IUnknown> _Site;
 
-    static const ItemData* GetItemData(PCUITEMID_CHILD pidl);
-    PITEMID_CHILD CreateItemID(const ArchiveEntry& entry);
-    PITEMID_CHILD CreateItemID(const std::wstring& name, ItemType type, 
-                                const std::wstring& path, UINT64 size, 
-                                UINT64 compressedSize, UINT32 index,
-                                UINT32 crc, UINT32 attrs, FILETIME mtime);
+    // Fields of one of our item IDs, version 1 or current; false for others
+    static bool GetItemData(PCUIDLIST_RELATIVE pidl, ItemIdFields& item);
+
+    // Archive index of a child of this folder. An ID kept across a rewrite
+    // of the archive (shortcut, jump list, saved view) may carry another
+    // entry's index: when the entry there has another name, the index is
+    // looked up by path instead, SYNTHETIC_FOLDER_INDEX if nothing has it.
+    UINT32 GetItemIndex(const ItemIdFields& item) const;
+
+    // Path of a child of this folder inside the archive: the stored path of
+    // a version 1 ID, else the path of its archive index, else (synthetic
+    // folders) the current folder joined with its name
+    std::wstring GetItemPath(const ItemIdFields& item) const;
+    
     bool OpenArchive();
 };
 
-// Item enumerator
+// Item enumerator. Item IDs are built in Next from a view of the folder's
+// children, so the first ones come back without walking the whole folder;
+// clones share the view and only copy the position.
 class EnumIDList : public IEnumIDList {
 public:
     EnumIDList(ShellFolder* folder, SHCONTF flags);
@@ -174,17 +166,69 @@ public:
     STDMETHODIMP Clone(IEnumIDList** ppenum) override;
 
 private:
+    // Children of the enumerated folder. Immutable once built; holding the
+    // archive keeps the index and table it points into alive.
+    struct FolderView {
+        std::shared_ptr<Archive>    Source;
+        const DirectoryIndex*       Directory;
+        const EntryTable*           Table;
+        DirectoryIndex::ChildRange  Children;
+    };
+
     LONG _RefCount;
     ShellFolder* _Folder;
     SHCONTF _Flags;
-    std::vector<PITEMID_CHILD> _Items;
-    size_t _CurrentIndex;
+    std::shared_ptr<const FolderView> _View;    // Shared with clones
+    size_t _Position;                           // Next child of _View to look at
     bool _Initialized;
 
     void Initialize();
+    bool IsIncluded(UINT32 node) const;
+};
+
+// IStream over one archive file, decoded as it is read (see EntryStream).
+// Given to drop targets through CFSTR_FILECONTENTS and by BindToStorage.
+class ArchiveEntryStream : public IStream {
+public:
+    // Stream of an archive file; nothing is decoded until the first Read
+    static HRESULT Create(std::shared_ptr<Archive> archive, UINT32 index, IStream** stream);
+
+    // IUnknown
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv) override;
+    STDMETHODIMP_(ULONG) AddRef() override;
+    STDMETHODIMP_(ULONG) Release() override;
+
+    // ISequentialStream
+    STDMETHODIMP Read(void* pv, ULONG cb, ULONG* pcbRead) override;
+    STDMETHODIMP Write(const void* pv, ULONG cb, ULONG* pcbWritten) override;
+
+    // IStream
+    STDMETHODIMP Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition) override;
+    STDMETHODIMP SetSize(ULARGE_INTEGER libNewSize) override;
+    STDMETHODIMP CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead, ULARGE_INTEGER* pcbWritten) override;
+    STDMETHODIMP Commit(DWORD grfCommitFlags) override;
+    STDMETHODIMP Revert() override;
+    STDMETHODIMP LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) override;
+    STDMETHODIMP UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) override;
+    STDMETHODIMP Stat(STATSTG* pstatstg, DWORD grfStatFlag) override;
+    STDMETHODIMP Clone(IStream** ppstm) override;
+
+private:
+    ArchiveEntryStream(std::shared_ptr<Archive> archive, UINT32 index);
+    virtual ~ArchiveEntryStream() = default;
+
+    LONG _RefCount;
+    std::shared_ptr<Archive> _Archive;
+    std::mutex _Mutex;              // Callers may come from several threads
+    EntryStream _Entry;
 };
 
-// Data object for drag-drop and clipboard operations
+// Data object for drag-drop and clipboard operations. Dragged files and
+// the contents of dragged folders are offered as virtual files
+// (CFSTR_FILEDESCRIPTORW), each decoded only when the target pulls its
+// CFSTR_FILECONTENTS stream. CF_HDROP, which needs every file extracted to
+// a temp folder first, is offered instead only when a relative path is too
+// long for a file descriptor.
 class ArchiveDataObject : public IDataObject {
 public:
     ArchiveDataObject();
@@ -211,16 +255,37 @@ public:
                     std::vector<std::pair<UINT32, std::wstring>>&& items);
 
 private:
+    // One virtual file or folder of the drop
+    struct VirtualFile {
+        UINT32          Index;      // Archive index, SYNTHETIC_FOLDER_INDEX for folders without an entry
+        std::wstring    Path;       // Relative to the drop target, backslashes
+        bool            IsFolder;
+    };
+
     LONG _RefCount;
     std::wstring _ArchivePath;
     std::shared_ptr<Archive> _Archive;
     std::vector<std::pair<UINT32, std::wstring>> _Items;  // archiveIndex, path
+    std::vector<VirtualFile> _Files;
+    bool _Described;
+    bool _DescriptorsFit;   // Every path fits FILEDESCRIPTORW::cFileName
+    bool _UnlockAsked;
+    bool _Unlocked;
     std::wstring _TempFolder;
     std::vector<std::wstring> _ExtractedFiles;
     bool _Extracted;
 
     bool ExtractToTemp();
     HGLOBAL CreateHDrop();
+
+    // Virtual files of the dragged items, folders expanded (built once)
+    void DescribeFiles();
+    bool OffersVirtualFiles();
+    HGLOBAL CreateFileDescriptors();
+    HRESULT CreateFileContents(LONG index, IStream** stream);
+
+    // Ask for the password of an encrypted archive, once per data object
+    bool Unlock();
 };
 
 } // namespace SevenZipView
@@ -0,0 +1,209 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** 7zAES Coder Properties and Derived Key Cache Implementation
+*/
+
+#include "AesKeyCache.h"
+#include <random>
+
+extern "C" {
+#include "Sha256.h"
+}
+
+namespace SevenZipView {
+
+// NumCyclesPower that stores salt and password as the key, unhashed
+static const unsigned AES_CYCLES_POWER_RAW = 0x3F;
+
+// Overwrite key material before the memory is released
+static void Wipe(void* data, size_t size) {
+    volatile Byte* p = static_cast<volatile Byte*>(data);
+    while (size--) *p++ = 0;
+}
+
+static void InitCryptoTables() {
+    // AES tables and the AES-NI / VAES and SHA-NI selection, once
+    static std::once_flag once;
+    std::call_once(once, []() {
+        AesGenTables();
+        Sha256Prepare();
+    });
+}
+
+//==============================================================================
+// AesCoderProps
+//==============================================================================
+
+SRes AesCoderProps::Parse(const Byte* props, unsigned size, AesCoderProps& result) {
+    result = AesCoderProps();
+    if (size == 0) return SZ_ERROR_UNSUPPORTED;
+
+    // First byte: round count, and whether salt and IV follow; the second
+    // holds the rest of their sizes (see 7zAes.cpp)
+    unsigned b0 = props[0];
+    result.NumCyclesPower = b0 & 0x3F;
+    if ((b0 & 0xC0) == 0) return size == 1 ? SZ_OK : SZ_ERROR_UNSUPPORTED;
+    if (size < 2) return SZ_ERROR_UNSUPPORTED;
+
+    unsigned b1 = props[1];
+    unsigned saltSize = ((b0 >> 7) & 1) + (b1 >> 4);
+    unsigned ivSize = ((b0 >> 6) & 1) + (b1 & 0x0F);
+    if (size != 2 + saltSize + ivSize) return SZ_ERROR_UNSUPPORTED;
+
+    result.SaltSize = saltSize;
+    memcpy(result.Salt, props + 2, saltSize);
+    memcpy(result.Iv, props + 2 + saltSize, ivSize);
+    return SZ_OK;
+}
+
+//==============================================================================
+// AesKeyCache
+//==============================================================================
+
+bool AesKeyCache::Key::operator<(const Key& other) const {
+    if (NumCyclesPower != other.NumCyclesPower) return NumCyclesPower < other.NumCyclesPower;
+    if (Salt != other.Salt) return Salt < other.Salt;
+    return PasswordHash < other.PasswordHash;
+}
+
+AesKeyCache::AesKeyCache()
+    : _PasswordHash()
+    , _HasPassword(false)
+    , _Stats() {
+    InitCryptoTables();
+
+    std::random_device random;
+    for (Byte& b : _HashSalt) b = (Byte)random();
+}
+
+AesKeyCache::~AesKeyCache() {
+    Clear();
+    Wipe(_HashSalt, sizeof(_HashSalt));
+}
+
+AesKeyCache::Digest AesKeyCache::HashPassword(const std::wstring& password) const {
+    CSha256 sha;
+    Sha256_Init(&sha);
+    Sha256_Update(&sha, _HashSalt, sizeof(_HashSalt));
+    if (!password.empty()) Sha256_Update(&sha, (const Byte*)password.data(), password.size() * sizeof(wchar_t));
+
+    Digest digest;
+    Sha256_Final(&sha, digest.data());
+    Wipe(&sha, sizeof(sha));
+    return digest;
+}
+
+bool AesKeyCache::SetPassword(const std::wstring& password) {
+    Digest hash = HashPassword(password);
+
+    std::lock_guard<std::mutex> lock(_Mutex);
+    bool changed = _HasPassword && hash != _PasswordHash;
+    if (!_Password.empty()) Wipe(&_Password[0], _Password.size() * sizeof(wchar_t));
+    _Password = password;
+    _PasswordHash = hash;
+    _HasPassword = true;
+    return changed;
+}
+
+bool AesKeyCache::HasPassword() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _HasPassword;
+}
+
+SRes AesKeyCache::GetKey(const AesCoderProps& props, Byte* key) {
+    if (props.NumCyclesPower > AES_MAX_CYCLES_POWER && props.NumCyclesPower != AES_CYCLES_POWER_RAW)
+        return SZ_ERROR_UNSUPPORTED;
+
+    // Workers starting on the archive's folders at once all want the same
+    // key: the first derives it, the others wait for its slot
+    std::unique_lock<std::mutex> lock(_Mutex);
+    std::string salt((const char*)props.Salt, props.SaltSize);
+    Key id;
+    for (;;) {
+        if (!_HasPassword) return SZ_ERROR_PARAM;
+
+        id = Key{ _PasswordHash, salt, props.NumCyclesPower };
+        auto it = _Keys.find(id);
+        if (it == _Keys.end()) break;
+        if (it->second.Ready) {
+            _Stats.Hits++;
+            memcpy(key, it->second.Value.data(), AES_KEY_SIZE);
+            return SZ_OK;
+        }
+        _Derived.wait(lock);
+    }
+
+    _Keys.emplace(id, Slot{ {}, false });
+    std::wstring password = _Password;
+    lock.unlock();
+
+    std::array<Byte, AES_KEY_SIZE> derived;
+    DeriveKey(password, props, derived.data());
+    if (!password.empty()) Wipe(&password[0], password.size() * sizeof(wchar_t));
+    memcpy(key, derived.data(), AES_KEY_SIZE);
+
+    // Clear may have dropped the slot meanwhile; its waiters look again
+    lock.lock();
+    _Stats.Derivations++;
+    auto it = _Keys.find(id);
+    if (it != _Keys.end()) {
+        it->second.Value = derived;
+        it->second.Ready = true;
+    }
+    Wipe(derived.data(), derived.size());
+    _Derived.notify_all();
+    return SZ_OK;
+}
+
+void AesKeyCache::Clear() {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    for (auto& entry : _Keys)
+        Wipe(entry.second.Value.data(), entry.second.Value.size());
+    _Keys.clear();
+    if (!_Password.empty()) Wipe(&_Password[0], _Password.size() * sizeof(wchar_t));
+    _Password.clear();
+    Wipe(_PasswordHash.data(), _PasswordHash.size());
+    _HasPassword = false;
+    _Derived.notify_all();
+}
+
+AesKeyCacheStats AesKeyCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Stats;
+}
+
+void AesKeyCache::DeriveKey(const std::wstring& password, const AesCoderProps& props, Byte* key) {
+    InitCryptoTables();
+
+    // Salt, UTF-16LE password and a 64-bit round counter, hashed as one
+    // message per round
+    std::vector<Byte> buffer(props.Salt, props.Salt + props.SaltSize);
+    for (wchar_t c : password) {
+        buffer.push_back((Byte)c);
+        buffer.push_back((Byte)((UInt16)c >> 8));
+    }
+
+    if (props.NumCyclesPower == AES_CYCLES_POWER_RAW) {
+        memset(key, 0, AES_KEY_SIZE);
+        memcpy(key, buffer.data(), (std::min)(buffer.size(), (size_t)AES_KEY_SIZE));
+        Wipe(buffer.data(), buffer.size());
+        return;
+    }
+
+    size_t counterPos = buffer.size();
+    buffer.resize(counterPos + 8, 0);
+
+    CSha256 sha;
+    Sha256_Init(&sha);
+    UINT64 rounds = (UINT64)1 << props.NumCyclesPower;
+    for (UINT64 round = 0; round < rounds; round++) {
+        Sha256_Update(&sha, buffer.data(), buffer.size());
+        for (size_t i = counterPos; i < buffer.size() && ++buffer[i] == 0; i++) {}
+    }
+    Sha256_Final(&sha, key);
+
+    Wipe(buffer.data(), buffer.size());
+    Wipe(&sha, sizeof(sha));
+}
+
+} // namespace SevenZipView
@@ -4,27 +4,28 @@
 */
 
 #include "Archive.h"
-#include <set>
+#include "ArchiveReader.h"
 #include <shlobj.h>
 
 namespace SevenZipView {
 
-// Case-insensitive string comparator for std::set
-struct CaseInsensitiveCompare {
-    bool operator()(const std::wstring& a, const std::wstring& b) const {
-        return _wcsicmp(a.c_str(), b.c_str()) < 0;
-    }
-};
+// Entries at least this large get their disk space reserved at creation
+static const UINT64 ENTRY_PREALLOCATE_MIN = 64 * 1024;
+
+// Attributes an extracted file may carry over from the archive
+static const DWORD ENTRY_FILE_ATTRIBUTES = FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN |
+    FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE;
 
-// Memory allocation callbacks for 7z SDK
-static void* SzAlloc(ISzAllocPtr p, size_t size) {
-    (void)p;
-    return malloc(size);
+static HANDLE CreateTargetFile(const std::wstring& destPath) {
+    return CreateFileW(destPath.c_str(), GENERIC_WRITE | FILE_WRITE_ATTRIBUTES, 0, nullptr,
+                       CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
 }
 
-static void SzFree(ISzAllocPtr p, void* address) {
-    (void)p;
-    free(address);
+static LARGE_INTEGER ToLargeInteger(const FILETIME& ft) {
+    LARGE_INTEGER value;
+    value.LowPart = ft.dwLowDateTime;
+    value.HighPart = (LONG)ft.dwHighDateTime;
+    return value;
 }
 
 // Archive Pool Implementation
@@ -33,48 +34,273 @@ ArchivePool& ArchivePool::Instance() {
     return instance;
 }
 
+bool ArchivePool::ReadFileStamp(const std::wstring& path, UINT64& size, UINT64& time) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info)) return false;
+    size = ((UINT64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    time = ((UINT64)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
 std::shared_ptr<Archive> ArchivePool::GetArchive(const std::wstring& path) {
+    // A pooled archive costs one stamp query of its file; the path is only
+    // split into the file on disk and its entries on a miss
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (auto ptr = FindPooledLocked(path))
+            return ptr;
+    }
+    
+    // Outer archives are resolved first, without holding the pool lock
+    std::wstring filePath;
+    std::wstring entryPath;
+    if (SplitNestedPath(path, filePath, entryPath))
+        return GetNestedArchive(path, filePath, entryPath);
+    
     std::lock_guard<std::mutex> lock(_Mutex);
     
-    auto it = _Archives.find(path);
-    if (it != _Archives.end()) {
-        auto ptr = it->second.lock();
-        if (ptr) return ptr;
-    }
+    UINT64 fileSize = 0;
+    UINT64 fileTime = 0;
+    bool stamped = ReadFileStamp(path, fileSize, fileTime);
     
+    if (auto ptr = FindLocked(path, stamped, fileSize, fileTime))
+        return ptr;
+    
+    _Stats.Misses++;
     auto archive = std::make_shared<Archive>();
-    if (archive->Open(path)) {
-        _Archives[path] = archive;
-        return archive;
+    if (!archive->Open(path)) {
+        TrimLocked();
+        return nullptr;
+    }
+    return InsertLocked(path, path, std::move(archive), fileSize, fileTime);
+}
+
+bool ArchivePool::SplitNestedPath(const std::wstring& path, std::wstring& filePath, std::wstring& entryPath) {
+    if (GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES) return false;
+    
+    size_t split = path.find_last_of(L"\\/");
+    while (split != std::wstring::npos && split > 0) {
+        std::wstring prefix = path.substr(0, split);
+        DWORD attributes = GetFileAttributesW(prefix.c_str());
+        if (attributes != INVALID_FILE_ATTRIBUTES) {
+            if (attributes & FILE_ATTRIBUTE_DIRECTORY) return false;
+            filePath = std::move(prefix);
+            entryPath = path.substr(split + 1);
+            return !entryPath.empty();
+        }
+        split = path.find_last_of(L"\\/", split - 1);
     }
+    return false;
+}
+
+std::shared_ptr<Archive> ArchivePool::GetNestedArchive(const std::wstring& path, const std::wstring& filePath,
+                                                       const std::wstring& entryPath) {
+    // A nested archive is as current as the file on disk that holds it
+    UINT64 fileSize = 0;
+    UINT64 fileTime = 0;
+    if (!ReadFileStamp(filePath, fileSize, fileTime)) return nullptr;
+    
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (auto ptr = FindLocked(path, true, fileSize, fileTime))
+            return ptr;
+    }
+    
+    std::shared_ptr<Archive> outer = GetArchive(filePath);
+    if (!outer) return nullptr;
+    
+    // The first file entry along the path is the next archive down; while it
+    // is not the whole remainder, the rest lies in a deeper archive
+    std::wstring rest = entryPath;
+    size_t base = filePath.size() + 1;
+    UINT32 index = PathIndex::NOT_FOUND;
+    for (;;) {
+        size_t split = 0;
+        index = PathIndex::NOT_FOUND;
+        while (split != std::wstring::npos) {
+            split = rest.find_first_of(L"\\/", split + 1);
+            UINT32 found = outer->FindEntry(rest.substr(0, split));
+            if (found != PathIndex::NOT_FOUND && !outer->GetEntryTable().IsDirectory(found)) {
+                index = found;
+                break;
+            }
+        }
+        if (index == PathIndex::NOT_FOUND) return nullptr;
+        if (split == std::wstring::npos) break;
+        
+        outer = GetArchive(path.substr(0, base + split));
+        if (!outer) return nullptr;
+        base += split + 1;
+        rest = rest.substr(split + 1);
+    }
+    
+    std::shared_ptr<MappedFile> view = outer->OpenEntryView(index);
+    if (!view) return nullptr;
+    
+    BlockSource source;
+    source.Path = path;
+    source.Size = fileSize;
+    source.ModifiedTime = fileTime;
+    
+    auto archive = std::make_shared<Archive>();
+    if (!archive->Open(std::move(view), source)) return nullptr;
+    
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Stats.Misses++;
+    return InsertLocked(path, filePath, std::move(archive), fileSize, fileTime);
+}
+
+std::shared_ptr<Archive> ArchivePool::FindPooledLocked(const std::wstring& path) {
+    auto it = _Archives.find(path);
+    if (it == _Archives.end()) return nullptr;
     
+    UINT64 fileSize = 0;
+    UINT64 fileTime = 0;
+    bool stamped = ReadFileStamp(it->second.StampPath, fileSize, fileTime);
+    return FindLocked(path, stamped, fileSize, fileTime);
+}
+
+std::shared_ptr<Archive> ArchivePool::FindLocked(const std::wstring& path, bool stamped, UINT64 size, UINT64 time) {
+    auto it = _Archives.find(path);
+    if (it == _Archives.end()) return nullptr;
+    
+    PoolEntry& entry = it->second;
+    auto ptr = entry.Open.lock();
+    if (ptr && stamped && entry.FileSize == size && entry.FileTime == time) {
+        _Stats.Hits++;
+        entry.LastUsed = GetTickCount64();
+        Retain(path, entry);
+        TrimLocked();
+        return ptr;
+    }
+    
+    // Holders of the old instance keep it; new callers get the new file
+    if (ptr) {
+        _Stats.Invalidations++;
+        BlockCache::Instance().Remove(path);
+        SEVENZIPVIEW_LOG(L"ArchivePool: '%s' changed on disk, reopening", path.c_str());
+    }
+    Release(entry);
+    _Archives.erase(it);
     return nullptr;
 }
 
+std::shared_ptr<Archive> ArchivePool::InsertLocked(const std::wstring& path, const std::wstring& stampPath,
+                                                   std::shared_ptr<Archive> archive, UINT64 size, UINT64 time) {
+    PoolEntry& entry = _Archives[path];
+    if (auto ptr = entry.Open.lock()) {
+        if (entry.FileSize == size && entry.FileTime == time) archive = std::move(ptr);
+        else Release(entry);
+    }
+    
+    entry.Open = archive;
+    entry.StampPath = stampPath;
+    entry.FileSize = size;
+    entry.FileTime = time;
+    entry.LastUsed = GetTickCount64();
+    if (!entry.Retained) entry.LruPos = _Lru.end();
+    Retain(path, entry);
+    TrimLocked();
+    
+    return archive;
+}
+
+void ArchivePool::Retain(const std::wstring& path, PoolEntry& entry) {
+    if (entry.Retained) {
+        _Lru.splice(_Lru.begin(), _Lru, entry.LruPos);
+        return;
+    }
+    entry.Retained = entry.Open.lock();
+    if (!entry.Retained) return;
+    _Lru.push_front(path);
+    entry.LruPos = _Lru.begin();
+}
+
+void ArchivePool::Release(PoolEntry& entry) {
+    if (!entry.Retained) return;
+    _Lru.erase(entry.LruPos);
+    entry.LruPos = _Lru.end();
+    entry.Retained.reset();
+}
+
+void ArchivePool::TrimLocked() {
+    ULONGLONG now = GetTickCount64();
+    
+    size_t memory = 0;
+    for (const auto& path : _Lru)
+        memory += _Archives[path].Retained->GetMemoryUsage();
+    
+    // _Lru is ordered by last use, so idle archives sit at the back
+    while (!_Lru.empty()) {
+        PoolEntry& entry = _Archives[_Lru.back()];
+        bool idle = now - entry.LastUsed > _Limits.IdleTimeoutMs;
+        bool over = _Lru.size() > _Limits.MaxArchives || memory > _Limits.MaxMemory;
+        if (!idle && !over) break;
+        
+        memory -= entry.Retained->GetMemoryUsage();
+        _Stats.Evictions++;
+        Release(entry);
+    }
+    
+    // Forget archives nobody holds any more
+    for (auto it = _Archives.begin(); it != _Archives.end();) {
+        if (!it->second.Retained && it->second.Open.expired()) {
+            it = _Archives.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    _Stats.Retained = (UINT32)_Lru.size();
+    _Stats.RetainedMemory = memory;
+}
+
+void ArchivePool::Trim() {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    TrimLocked();
+}
+
 void ArchivePool::Remove(const std::wstring& path) {
     std::lock_guard<std::mutex> lock(_Mutex);
-    _Archives.erase(path);
+    auto it = _Archives.find(path);
+    if (it == _Archives.end()) return;
+    Release(it->second);
+    _Archives.erase(it);
+    _Stats.Retained = (UINT32)_Lru.size();
 }
 
 void ArchivePool::Clear() {
     std::lock_guard<std::mutex> lock(_Mutex);
+    _Lru.clear();
     _Archives.clear();
+    _Stats.Retained = 0;
+    _Stats.RetainedMemory = 0;
+}
+
+void ArchivePool::SetLimits(const ArchivePoolLimits& limits) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Limits = limits;
+    TrimLocked();
+}
+
+ArchivePoolLimits ArchivePool::GetLimits() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Limits;
+}
+
+ArchivePoolStats ArchivePool::GetStats() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Stats;
 }
 
 // Archive Implementation
 Archive::Archive()
     : _IsOpen(false)
-    , _TreeBuilt(false)
-    , _FolderCacheBuilt(false)
-    , _BlockIndex(0xFFFFFFFF)
-    , _OutBuffer(nullptr)
-    , _OutBufferSize(0) {
-    
-    // Initialize allocators
-    _AllocImp.Alloc = SzAlloc;
-    _AllocImp.Free = SzFree;
-    _AllocTempImp.Alloc = SzAlloc;
-    _AllocTempImp.Free = SzFree;
+    , _DatabaseLoaded(false)
+    , _HasIdentity(false)
+    , _DirectoryReady(false)
+    , _DecodeWindowSize(FOLDER_DECODER_DEFAULT_WINDOW)
+    , _MemoryUsage(0) {
     
     // Initialize CRC table (must be done once)
     static bool crcInitialized = false;
@@ -84,658 +310,506 @@ Archive::Archive()
     }
     
     SzArEx_Init(&_Archive);
+    
+    SharedInStream_Construct(&_SharedStream);
+    _InStream = &_SharedStream.vt;
 }
 
 Archive::~Archive() {
     Close();
+    SharedInStream_Free(&_SharedStream);
 }
 
-bool Archive::Open(const std::wstring& path) {
+bool Archive::Open(const std::wstring& path, ArchiveStreamMode mode) {
     std::lock_guard<std::mutex> lock(_Mutex);
     
-    if (_IsOpen) Close();
+    if (_IsOpen) CloseLocked();
     
     SEVENZIPVIEW_LOG(L"Opening archive: %s", path.c_str());
     
-    // Open file
-    WRes wres = InFile_OpenW(&_FileStream.file, path.c_str());
-    if (wres != 0) {
-        SEVENZIPVIEW_LOG(L"  Failed to open file: error=%d", wres);
-        return false;
+    // Prefer a read-only mapping: headers and packed data are then read in place
+    if (mode != ArchiveStreamMode::Buffered)
+        _MappedFile = MappedFile::Open(path);
+    
+    if (_MappedFile) {
+        MappedInStream_CreateVTable(&_MappedStream);
+        MappedInStream_Init(&_MappedStream, _MappedFile.get());
+        _InStream = &_MappedStream.vt;
+    } else {
+        if (mode == ArchiveStreamMode::Mapped) {
+            SEVENZIPVIEW_LOG(L"  Failed to map file");
+            return false;
+        }
+        
+        // One overlapped handle, read at explicit offsets by every stream
+        _SharedFile = SharedFile::Open(path);
+        if (!_SharedFile) {
+            SEVENZIPVIEW_LOG(L"  Failed to open file");
+            return false;
+        }
+        
+        if (!SharedInStream_Init(&_SharedStream, _SharedFile.get())) {
+            _SharedFile.reset();
+            SEVENZIPVIEW_LOG(L"  Failed to allocate buffer");
+            return false;
+        }
+        _InStream = &_SharedStream.vt;
     }
     
-    // Setup stream wrappers
-    FileInStream_CreateVTable(&_FileStream);
-    LookToRead2_CreateVTable(&_LookStream, False);
+    // Without a stamp, blocks are still decoded but never shared
+    BlockSource source;
+    if (!BlockSource::Read(path, source))
+        SEVENZIPVIEW_LOG(L"  Block cache disabled: cannot query file (error=%u)", GetLastError());
     
-    _LookStream.buf = nullptr;
-    _LookStream.bufSize = (1 << 18); // 256KB buffer
-    _LookStream.buf = (Byte*)ISzAlloc_Alloc(&_AllocImp, _LookStream.bufSize);
-    if (!_LookStream.buf) {
-        File_Close(&_FileStream.file);
-        SEVENZIPVIEW_LOG(L"  Failed to allocate buffer");
-        return false;
-    }
+    // A cached index skips the header parse; the header is read on first extraction
+    ArchiveIdentity identity;
+    bool identified = ArchiveIdentity::Read(path, identity);
+    bool cacheable = identified && IndexCache::Instance().IsEnabled();
+    return OpenDatabase(path, source, identity, identified, cacheable);
+}
+
+bool Archive::Open(std::shared_ptr<MappedFile> data, const BlockSource& source) {
+    std::lock_guard<std::mutex> lock(_Mutex);
     
-    _LookStream.realStream = &_FileStream.vt;
-    LookToRead2_INIT(&_LookStream);
+    if (_IsOpen) CloseLocked();
+    if (!data || !source.IsValid()) return false;
     
-    // Open archive
-    SRes res = SzArEx_Open(&_Archive, &_LookStream.vt, &_AllocImp, &_AllocTempImp);
-    if (res != SZ_OK) {
-        SEVENZIPVIEW_LOG(L"  Failed to open archive: error=%d", res);
-        ISzAlloc_Free(&_AllocImp, _LookStream.buf);
-        _LookStream.buf = nullptr;
-        File_Close(&_FileStream.file);
-        return false;
+    SEVENZIPVIEW_LOG(L"Opening archive from memory: %s (%llu bytes)", source.Path.c_str(),
+        (unsigned long long)data->GetSize());
+    
+    _MappedFile = std::move(data);
+    MappedInStream_CreateVTable(&_MappedStream);
+    MappedInStream_Init(&_MappedStream, _MappedFile.get());
+    _InStream = &_MappedStream.vt;
+    
+    ArchiveIdentity identity;
+    bool identified = ArchiveIdentity::FromMemory(_MappedFile->GetData(), _MappedFile->GetSize(),
+        source.ModifiedTime, identity);
+    return OpenDatabase(source.Path, source, identity, identified, false);
+}
+
+bool Archive::OpenDatabase(const std::wstring& path, const BlockSource& source, const ArchiveIdentity& identity,
+                           bool identified, bool cacheable) {
+    if (!cacheable || !LoadIndexImage(path, identity)) {
+        SdkArena arena;
+        SRes res = SzArEx_Open(&_Archive, _InStream, GetHeapAlloc(), arena.Get());
+        if (res != SZ_OK) {
+            SEVENZIPVIEW_LOG(L"  Failed to open archive: error=%d", res);
+            _SharedFile.reset();
+            _MappedFile.reset();
+            return false;
+        }
+        _DatabaseLoaded = true;
+        
+        _Entries.Build(_Archive);
+        if (cacheable && _Entries.GetCount() >= IndexCache::Instance().GetMinEntries())
+            StoreIndexImage(path, identity);
     }
     
+    // Names are read in place from the database or the cached arena
+    _PathIndex.Build(_Entries.GetNameArena(), _Entries.GetPathOffsets(), _Entries.GetCount());
+    
+    _BlockSource = source;
+    _Identity = identity;
+    _HasIdentity = identified;
     _Path = path;
     _IsOpen = true;
-    _TreeBuilt = false;
+    _DirectoryReady = _Directory.IsBuilt();     // Loaded or built for the index cache
+    UpdateMemoryUsage();
     
-    SEVENZIPVIEW_LOG(L"  Archive opened successfully: %u files", _Archive.NumFiles);
+    SEVENZIPVIEW_LOG(L"  Archive opened successfully: %u files (%s%s)", _Entries.GetCount(),
+        !_MappedFile ? L"buffered" : _MappedFile->IsMemory() ? L"memory" : L"mapped",
+        _IndexImage ? L", cached index" : L"");
     
     return true;
 }
 
-void Archive::Close() {
-    std::lock_guard<std::mutex> lock(_Mutex);
+bool Archive::LoadIndexImage(const std::wstring& path, const ArchiveIdentity& identity) {
+    IndexReader reader;
+    std::shared_ptr<MappedFile> image = IndexCache::Instance().Load(path, identity, reader);
+    if (!image) return false;
     
-    if (!_IsOpen) return;
+    if (!_Entries.Load(reader) || !_Directory.Load(reader, _Entries)) {
+        SEVENZIPVIEW_LOG(L"  Cached index rejected");
+        _Directory.Clear();
+        _Entries.Clear();
+        return false;
+    }
     
-    SzArEx_Free(&_Archive, &_AllocImp);
+    _IndexImage = std::move(image);
+    return true;
+}
+
+void Archive::StoreIndexImage(const std::wstring& path, const ArchiveIdentity& identity) {
+    // The directory index is needed by every Explorer listing anyway
+    _Directory.Build(_Entries);
     
-    if (_OutBuffer) {
-        ISzAlloc_Free(&_AllocImp, _OutBuffer);
-        _OutBuffer = nullptr;
-        _OutBufferSize = 0;
+    IndexWriter writer;
+    _Entries.Save(writer);
+    _Directory.Save(writer);
+    IndexCache::Instance().Store(path, identity, writer);
+}
+
+bool Archive::LoadDatabase() {
+    if (!_IsOpen) return false;
+    if (_DatabaseLoaded) return true;
+    
+    SdkArena arena;
+    SRes res = SzArEx_Open(&_Archive, _InStream, GetHeapAlloc(), arena.Get());
+    if (res != SZ_OK || _Archive.NumFiles != _Entries.GetCount()) {
+        SEVENZIPVIEW_LOG(L"Archive::LoadDatabase: failed: error=%d files=%u expected=%u",
+            res, _Archive.NumFiles, _Entries.GetCount());
+        SzArEx_Free(&_Archive, GetHeapAlloc());
+        return false;
     }
     
-    if (_LookStream.buf) {
-        ISzAlloc_Free(&_AllocImp, _LookStream.buf);
-        _LookStream.buf = nullptr;
+    _DatabaseLoaded = true;
+    UpdateMemoryUsage();
+    return true;
+}
+
+void Archive::UpdateMemoryUsage() const {
+    size_t usage = _Entries.GetMemoryUsage() + _PathIndex.GetMemoryUsage() +
+        _Directory.GetMemoryUsage();
+    
+    // Parsed header: names plus roughly 32 bytes per file and 64 per folder
+    if (_DatabaseLoaded) {
+        if (_Archive.FileNameOffsets)
+            usage += _Archive.FileNameOffsets[_Archive.NumFiles] * 2;
+        usage += (size_t)_Archive.NumFiles * 32 + (size_t)_Archive.db.NumFolders * 64;
     }
     
-    File_Close(&_FileStream.file);
+    // A nested archive keeps its bytes in memory for as long as it is open
+    if (_MappedFile && _MappedFile->IsMemory())
+        usage += (size_t)_MappedFile->GetSize();
     
-    _Path.clear();
-    _IsOpen = false;
-    _TreeBuilt = false;
-    _FolderCacheBuilt = false;
-    _FolderCache.clear();
-    _RootNode = ArchiveNode();
+    _MemoryUsage.store(usage, std::memory_order_relaxed);
+}
+
+bool Archive::EnsureDatabase() {
+    if (_DatabaseLoaded.load(std::memory_order_acquire)) return true;
     
-    SEVENZIPVIEW_LOG(L"Archive closed");
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return LoadDatabase();
 }
 
-UINT32 Archive::GetItemCount() const {
-    if (!_IsOpen) return 0;
-    return _Archive.NumFiles;
+const CSzArEx& Archive::GetDatabase() const {
+    const_cast<Archive*>(this)->EnsureDatabase();
+    return _Archive;
 }
 
-bool Archive::GetEntry(UINT32 index, ArchiveEntry& entry) const {
-    if (!_IsOpen || index >= _Archive.NumFiles) return false;
-    
-    // Get file name
-    size_t nameLen = SzArEx_GetFileNameUtf16(&_Archive, index, nullptr);
-    if (nameLen > 0) {
-        std::vector<UInt16> nameBuf(nameLen);
-        SzArEx_GetFileNameUtf16(&_Archive, index, nameBuf.data());
-        entry.FullPath = reinterpret_cast<const wchar_t*>(nameBuf.data());
-        
-        // Extract just the name from path
-        size_t pos = entry.FullPath.find_last_of(L"\\/");
-        if (pos != std::wstring::npos)
-            entry.Name = entry.FullPath.substr(pos + 1);
-        else
-            entry.Name = entry.FullPath;
-    }
-    
-    // Is directory?
-    entry.Type = SzArEx_IsDir(&_Archive, index) ? ItemType::Folder : ItemType::File;
-    
-    // Size
-    entry.Size = SzArEx_GetFileSize(&_Archive, index);
-    
-    // CRC
-    if (SzBitWithVals_Check(&_Archive.CRCs, index)) {
-        entry.CRC = _Archive.CRCs.Vals[index];
-    }
-    
-    // Attributes
-    if (SzBitWithVals_Check(&_Archive.Attribs, index)) {
-        entry.Attributes = _Archive.Attribs.Vals[index];
-    }
+void Archive::Close() {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    CloseLocked();
+}
+
+void Archive::CloseLocked() {
+    if (!_IsOpen) return;
     
-    // Modified time
-    if (SzBitWithVals_Check(&_Archive.MTime, index)) {
-        entry.ModifiedTime.dwLowDateTime = _Archive.MTime.Vals[index].Low;
-        entry.ModifiedTime.dwHighDateTime = _Archive.MTime.Vals[index].High;
+    {
+        std::lock_guard<std::mutex> readersLock(_ReadersMutex);
+        _IdleReaders.clear();
     }
     
-    // Created time
-    if (SzBitWithVals_Check(&_Archive.CTime, index)) {
-        entry.CreatedTime.dwLowDateTime = _Archive.CTime.Vals[index].Low;
-        entry.CreatedTime.dwHighDateTime = _Archive.CTime.Vals[index].High;
-    }
+    _DirectoryReady = false;
+    _Directory.Clear();
+    _PathIndex.Clear();
+    _Entries.Clear();
+    _IndexImage.reset();
+    SzArEx_Free(&_Archive, GetHeapAlloc());
+    _DatabaseLoaded = false;
+    _BlockSource = BlockSource();
+    _HasIdentity = false;
+    _Keys.Clear();
     
-    entry.ArchiveIndex = index;
+    SharedInStream_Free(&_SharedStream);
+    _SharedFile.reset();
+    _MappedFile.reset();
     
-    // Compressed size is harder to calculate accurately for solid archives
-    // We'll estimate based on archive structure
-    if (_Archive.db.NumFolders > 0 && entry.Type == ItemType::File) {
-        UInt32 folderIndex = _Archive.FileToFolder[index];
-        if (folderIndex != (UInt32)-1 && folderIndex < _Archive.db.NumFolders) {
-            // Calculate pack size for folder using pack positions
-            UInt32 packStreamStart = _Archive.db.FoStartPackStreamIndex[folderIndex];
-            UInt32 packStreamEnd = _Archive.db.FoStartPackStreamIndex[folderIndex + 1];
-            
-            if (packStreamStart < packStreamEnd && packStreamEnd <= _Archive.db.NumPackStreams) {
-                UInt64 packSize = _Archive.db.PackPositions[packStreamEnd] - _Archive.db.PackPositions[packStreamStart];
-                
-                // Estimate compressed size proportionally
-                UInt64 folderUnpackSize = SzAr_GetFolderUnpackSize(&_Archive.db, folderIndex);
-                if (folderUnpackSize > 0) {
-                    entry.CompressedSize = (UInt64)((double)entry.Size * packSize / folderUnpackSize);
-                }
-            }
-        }
-    }
+    _Path.clear();
+    _IsOpen = false;
+    _MemoryUsage.store(0, std::memory_order_relaxed);
     
-    return true;
+    SEVENZIPVIEW_LOG(L"Archive closed");
+}
+
+UINT32 Archive::GetItemCount() const {
+    if (!_IsOpen) return 0;
+    return _Entries.GetCount();
+}
+
+bool Archive::GetEntry(UINT32 index, ArchiveEntry& entry) const {
+    if (!_IsOpen) return false;
+    return _Entries.GetEntry(index, entry);
 }
 
 ArchiveEntry Archive::GetEntry(const std::wstring& path) const {
     ArchiveEntry result;
     result.Type = ItemType::Unknown;
     
-    if (!_IsOpen) return result;
-    
-    // Normalize path
-    std::wstring normalizedPath = path;
-    for (auto& ch : normalizedPath) {
-        if (ch == L'\\') ch = L'/';
-    }
-    
-    // Remove trailing slash
-    while (!normalizedPath.empty() && normalizedPath.back() == L'/') {
-        normalizedPath.pop_back();
-    }
-    
-    // Search for entry
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        ArchiveEntry entry;
-        if (GetEntry(i, entry)) {
-            std::wstring entryPath = entry.FullPath;
-            for (auto& ch : entryPath) {
-                if (ch == L'\\') ch = L'/';
-            }
-            while (!entryPath.empty() && entryPath.back() == L'/') {
-                entryPath.pop_back();
-            }
-            
-            if (_wcsicmp(entryPath.c_str(), normalizedPath.c_str()) == 0) {
-                return entry;
-            }
-        }
-    }
+    UINT32 index = FindEntry(path);
+    if (index != PathIndex::NOT_FOUND)
+        GetEntry(index, result);
     
     return result;
 }
 
+UINT32 Archive::FindEntry(const std::wstring& path) const {
+    if (!_IsOpen) return PathIndex::NOT_FOUND;
+    return _PathIndex.Find(path);
+}
+
 std::vector<ArchiveEntry> Archive::GetAllEntries() const {
     std::vector<ArchiveEntry> entries;
     if (!_IsOpen) return entries;
     
-    entries.reserve(_Archive.NumFiles);
-    
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        ArchiveEntry entry;
-        if (GetEntry(i, entry)) {
-            entries.push_back(std::move(entry));
-        }
+    entries.resize(_Entries.GetCount());
+    for (UINT32 i = 0; i < _Entries.GetCount(); i++) {
+        _Entries.GetEntry(i, entries[i]);
     }
     
     return entries;
 }
 
-std::vector<ArchiveEntry> Archive::GetEntriesInFolder(const std::wstring& folderPath) const {
-    std::vector<ArchiveEntry> entries;
-    if (!_IsOpen) return entries;
+const DirectoryIndex& Archive::GetDirectoryIndex() const {
+    if (_DirectoryReady.load(std::memory_order_acquire)) return _Directory;
     
-    std::wstring normalizedPath = folderPath;
-    // Remove trailing slash
-    while (!normalizedPath.empty() && 
-           (normalizedPath.back() == L'/' || normalizedPath.back() == L'\\')) {
-        normalizedPath.pop_back();
-    }
-    
-    // Convert to forward slashes for comparison
-    for (auto& c : normalizedPath) {
-        if (c == L'\\') c = L'/';
-    }
-    
-    // Check cache first (need to cast away const for cache access)
-    Archive* mutableThis = const_cast<Archive*>(this);
-    if (_FolderCacheBuilt) {
-        auto it = _FolderCache.find(normalizedPath);
-        if (it != _FolderCache.end()) {
-            return it->second;
-        }
-        // Path not in cache means empty folder
-        return entries;
-    }
-    
-    // Build the cache on first access
-    mutableThis->BuildFolderCache();
+    std::lock_guard<std::mutex> lock(_Mutex);
     
-    // Return from cache
-    auto it = _FolderCache.find(normalizedPath);
-    if (it != _FolderCache.end()) {
-        return it->second;
+    // Built on first use: opening an archive for a preview or a property
+    // query never needs the hierarchy
+    if (_IsOpen && !_Directory.IsBuilt()) {
+        _Directory.Build(_Entries);
+        UpdateMemoryUsage();
+        SEVENZIPVIEW_LOG(L"Directory index built: %u nodes for %u files",
+            _Directory.GetNodeCount(), _Entries.GetCount());
     }
-    
-    return entries;
+    _DirectoryReady.store(_Directory.IsBuilt(), std::memory_order_release);
+    return _Directory;
 }
 
-void Archive::BuildFolderCache() {
-    std::lock_guard<std::mutex> lock(_Mutex);
-    
-    if (_FolderCacheBuilt || !_IsOpen) return;
-    
-    SEVENZIPVIEW_LOG(L"Building folder cache for %u files", _Archive.NumFiles);
+DirectoryIndex::ChildRange Archive::GetEntriesInFolder(const std::wstring& folderPath) const {
+    if (!_IsOpen) return DirectoryIndex::ChildRange();
     
-    // Track which folder paths we've added synthetic entries for (case-insensitive)
-    std::set<std::wstring, CaseInsensitiveCompare> syntheticFolders;
-    
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        ArchiveEntry entry;
-        if (!GetEntry(i, entry)) continue;
-        
-        // Normalize entry path
-        std::wstring entryPath = entry.FullPath;
-        for (auto& c : entryPath) {
-            if (c == L'\\') c = L'/';
-        }
-        while (!entryPath.empty() && entryPath.back() == L'/') {
-            entryPath.pop_back();
-        }
-        
-        // Find parent folder path
-        std::wstring parentPath;
-        size_t lastSlash = entryPath.find_last_of(L'/');
-        if (lastSlash != std::wstring::npos) {
-            parentPath = entryPath.substr(0, lastSlash);
-            entry.Name = entryPath.substr(lastSlash + 1);
-        } else {
-            // Root level item
-            parentPath = L"";
-            entry.Name = entryPath;
-        }
-        
-        // Add entry to its parent folder
-        _FolderCache[parentPath].push_back(entry);
-        
-        // Create synthetic folder entries for all ancestor folders
-        std::wstring ancestorPath;
-        size_t pos = 0;
-        while ((pos = entryPath.find(L'/', pos)) != std::wstring::npos) {
-            std::wstring folderName = entryPath.substr(ancestorPath.empty() ? 0 : ancestorPath.length() + 1, 
-                                                       pos - (ancestorPath.empty() ? 0 : ancestorPath.length() + 1));
-            std::wstring fullFolderPath = ancestorPath.empty() ? folderName : ancestorPath + L"/" + folderName;
-            
-            if (syntheticFolders.find(fullFolderPath) == syntheticFolders.end()) {
-                syntheticFolders.insert(fullFolderPath);
-                
-                // Add synthetic folder to its parent
-                ArchiveEntry folderEntry;
-                folderEntry.Name = folderName;
-                folderEntry.FullPath = fullFolderPath;
-                folderEntry.Type = ItemType::Folder;
-                folderEntry.ArchiveIndex = ArchiveEntry::SYNTHETIC_FOLDER_INDEX;
-                folderEntry.Attributes = FILE_ATTRIBUTE_DIRECTORY;
-                
-                _FolderCache[ancestorPath].push_back(folderEntry);
-            }
-            
-            ancestorPath = fullFolderPath;
-            pos++;
-        }
-    }
-    
-    // Remove duplicate entries (folders that exist both as synthetic and real)
-    for (auto& pair : _FolderCache) {
-        auto& vec = pair.second;
-        std::set<std::wstring, CaseInsensitiveCompare> seenNames;
-        vec.erase(std::remove_if(vec.begin(), vec.end(), [&seenNames](const ArchiveEntry& e) {
-            if (seenNames.find(e.Name) != seenNames.end()) {
-                return true;  // Remove duplicate
-            }
-            seenNames.insert(e.Name);
-            return false;
-        }), vec.end());
-    }
-    
-    _FolderCacheBuilt = true;
-    SEVENZIPVIEW_LOG(L"Folder cache built: %zu folders", _FolderCache.size());
+    const DirectoryIndex& directory = GetDirectoryIndex();
+    return directory.GetChildren(directory.FindFolder(folderPath));
 }
 
-// Legacy implementation kept for reference - now uses cache
-/*
-std::vector<ArchiveEntry> Archive::GetEntriesInFolder_Legacy(const std::wstring& folderPath) const {
-    std::vector<ArchiveEntry> entries;
-    if (!_IsOpen) return entries;
-    
-    std::wstring normalizedPath = folderPath;
-    // Remove trailing slash
-    while (!normalizedPath.empty() && 
-           (normalizedPath.back() == L'/' || normalizedPath.back() == L'\\')) {
-        normalizedPath.pop_back();
-    }
+bool Archive::ExtractToBuffer(UINT32 index, std::vector<BYTE>& buffer) {
+    SEVENZIPVIEW_LOG(L"Archive::ExtractToBuffer: index=%u _IsOpen=%d NumFiles=%u", index, _IsOpen ? 1 : 0, _Entries.GetCount());
     
-    // Convert to forward slashes for comparison
-    for (auto& c : normalizedPath) {
-        if (c == L'\\') c = L'/';
+    if (!EnsureDatabase() || index >= _Archive.NumFiles) {
+        SEVENZIPVIEW_LOG(L"Archive::ExtractToBuffer: FAILED - not open or index out of range");
+        return false;
     }
     
-    // Use a set to track which names we've already added (case-insensitive)
-    std::set<std::wstring, CaseInsensitiveCompare> addedNames;
-    
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        ArchiveEntry entry;
-        if (!GetEntry(i, entry)) continue;
-        
-        // Normalize entry path - remove trailing slash
-        std::wstring entryPath = entry.FullPath;
-        for (auto& c : entryPath) {
-            if (c == L'\\') c = L'/';
-        }
-        while (!entryPath.empty() && entryPath.back() == L'/') {
-            entryPath.pop_back();
-        }
-        
-        // Check if entry is in the requested folder
-        if (normalizedPath.empty()) {
-            // Root folder - only items with no path separator (or just the name)
-            size_t slashPos = entryPath.find(L'/');
-            if (slashPos == std::wstring::npos) {
-                // Direct child in root - could be file or explicit folder
-                if (addedNames.find(entry.Name) == addedNames.end()) {
-                    addedNames.insert(entry.Name);
-                    entries.push_back(std::move(entry));
-                }
-            } else {
-                // Has path separator - extract top-level folder
-                std::wstring firstPart = entryPath.substr(0, slashPos);
-                
-                // Add as synthetic folder if not already present
-                if (addedNames.find(firstPart) == addedNames.end()) {
-                    addedNames.insert(firstPart);
-                    ArchiveEntry folderEntry;
-                    folderEntry.Name = firstPart;
-                    folderEntry.FullPath = firstPart;
-                    folderEntry.Type = ItemType::Folder;
-                    folderEntry.ArchiveIndex = ArchiveEntry::SYNTHETIC_FOLDER_INDEX;
-                    folderEntry.Attributes = FILE_ATTRIBUTE_DIRECTORY;
-                    entries.push_back(std::move(folderEntry));
-                }
-            }
-        } else {
-            // Check if entry is directly inside the folder
-            if (entryPath.length() > normalizedPath.length() &&
-                _wcsnicmp(entryPath.c_str(), normalizedPath.c_str(), normalizedPath.length()) == 0 &&
-                entryPath[normalizedPath.length()] == L'/') {
-                
-                // Get the remaining path after the folder
-                std::wstring remaining = entryPath.substr(normalizedPath.length() + 1);
-                
-                // Remove any trailing slash from remaining
-                while (!remaining.empty() && remaining.back() == L'/') {
-                    remaining.pop_back();
-                }
-                if (remaining.empty()) continue;
-                
-                size_t nextSlash = remaining.find(L'/');
-                if (nextSlash == std::wstring::npos) {
-                    // Direct child - use the name from remaining
-                    if (addedNames.find(remaining) == addedNames.end()) {
-                        addedNames.insert(remaining);
-                        entry.Name = remaining;  // Use the clean name
-                        entries.push_back(std::move(entry));
-                    }
-                } else {
-                    // It's a subfolder - add synthetic folder entry if not present
-                    std::wstring subfolderName = remaining.substr(0, nextSlash);
-                    
-                    if (addedNames.find(subfolderName) == addedNames.end()) {
-                        addedNames.insert(subfolderName);
-                        ArchiveEntry folderEntry;
-                        folderEntry.Name = subfolderName;
-                        folderEntry.FullPath = normalizedPath + L"/" + subfolderName;
-                        folderEntry.Type = ItemType::Folder;
-                        folderEntry.ArchiveIndex = ArchiveEntry::SYNTHETIC_FOLDER_INDEX;
-                        folderEntry.Attributes = FILE_ATTRIBUTE_DIRECTORY;
-                        entries.push_back(std::move(folderEntry));
-                    }
-                }
-            }
-        }
-    }
+    // No lock from here: each call reads through a reader of its own
+    std::unique_ptr<ArchiveReader> reader = AcquireReader();
+    if (!reader) return false;
     
-    return entries;
+    bool ok = reader->ExtractToBuffer(index, buffer);
+    ReleaseReader(std::move(reader));
+    return ok;
 }
-*/
 
-const ArchiveNode& Archive::GetRootNode() {
-    EnsureTree();
-    return _RootNode;
+bool Archive::ExtractToSink(UINT32 index, IExtractSink& sink) {
+    if (!EnsureDatabase() || index >= _Archive.NumFiles) return false;
+    
+    std::unique_ptr<ArchiveReader> reader = AcquireReader();
+    if (!reader) return false;
+    
+    bool ok = reader->ExtractToSink(index, sink);
+    ReleaseReader(std::move(reader));
+    return ok;
 }
 
-void Archive::EnsureTree() {
-    if (_TreeBuilt) return;
-    BuildTree();
+bool Archive::ExtractPrefix(UINT32 index, size_t maxBytes, std::vector<BYTE>& buffer) {
+    if (!EnsureDatabase() || index >= _Archive.NumFiles) return false;
+    
+    std::unique_ptr<ArchiveReader> reader = AcquireReader();
+    if (!reader) return false;
+    
+    bool ok = reader->ExtractPrefix(index, maxBytes, buffer);
+    ReleaseReader(std::move(reader));
+    return ok;
 }
 
-void Archive::BuildTree() {
-    std::lock_guard<std::mutex> lock(_Mutex);
+bool Archive::ExtractToFile(UINT32 index, const std::wstring& destPath) {
+    SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: index=%u dest='%s'", index, destPath.c_str());
     
-    if (_TreeBuilt || !_IsOpen) return;
+    if (!EnsureDatabase() || index >= _Archive.NumFiles) return false;
     
-    _RootNode = ArchiveNode();
-    _RootNode.Entry.Name = L"";
-    _RootNode.Entry.Type = ItemType::Root;
+    std::unique_ptr<ArchiveReader> reader = AcquireReader();
+    if (!reader) return false;
     
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        ArchiveEntry entry;
-        if (!GetEntry(i, entry)) continue;
-        
-        // Parse path and create tree nodes
-        std::wstring path = entry.FullPath;
-        ArchiveNode* currentNode = &_RootNode;
-        
-        size_t start = 0;
-        size_t end;
-        
-        while ((end = path.find_first_of(L"\\/", start)) != std::wstring::npos) {
-            std::wstring part = path.substr(start, end - start);
-            if (!part.empty()) {
-                ArchiveNode* child = currentNode->FindChild(part);
-                if (!child) {
-                    ArchiveEntry folderEntry;
-                    folderEntry.Name = part;
-                    folderEntry.FullPath = path.substr(0, end);
-                    folderEntry.Type = ItemType::Folder;
-                    child = currentNode->AddChild(folderEntry);
-                }
-                currentNode = child;
-            }
-            start = end + 1;
-        }
-        
-        // Add the file/final folder
-        if (start < path.length()) {
-            entry.Name = path.substr(start);
-            currentNode->AddChild(entry);
-        }
-    }
+    bool ok = reader->ExtractToFile(index, destPath);
+    ReleaseReader(std::move(reader));
     
-    _TreeBuilt = true;
+    if (!ok) SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: FAILED");
+    return ok;
 }
 
-bool Archive::ExtractToBuffer(UINT32 index, std::vector<BYTE>& buffer) {
-    SEVENZIPVIEW_LOG(L"Archive::ExtractToBuffer: index=%u _IsOpen=%d NumFiles=%u", index, _IsOpen ? 1 : 0, _Archive.NumFiles);
+std::shared_ptr<MappedFile> Archive::OpenEntryView(UINT32 index) {
+    if (!EnsureDatabase() || index >= _Archive.NumFiles) return nullptr;
     
-    std::lock_guard<std::mutex> lock(_Mutex);
+    std::unique_ptr<ArchiveReader> reader = AcquireReader();
+    if (!reader) return nullptr;
     
-    if (!_IsOpen || index >= _Archive.NumFiles) {
-        SEVENZIPVIEW_LOG(L"Archive::ExtractToBuffer: FAILED - not open or index out of range");
-        return false;
-    }
-    
-    // Don't extract directories
-    if (SzArEx_IsDir(&_Archive, index)) {
-        SEVENZIPVIEW_LOG(L"Archive::ExtractToBuffer: FAILED - index is a directory");
-        return false;
+    std::shared_ptr<MappedFile> view;
+    reader->ExtractView(index, view);
+    ReleaseReader(std::move(reader));
+    return view;
+}
+
+std::unique_ptr<ArchiveReader> Archive::AcquireReader() {
+    std::unique_ptr<ArchiveReader> reader;
+    size_t windowSize;
+    {
+        std::lock_guard<std::mutex> lock(_ReadersMutex);
+        windowSize = _DecodeWindowSize;
+        if (!_IdleReaders.empty()) {
+            reader = std::move(_IdleReaders.back());
+            _IdleReaders.pop_back();
+        }
     }
     
-    size_t offset = 0;
-    size_t outSizeProcessed = 0;
-    
-    SRes res = SzArEx_Extract(
-        &_Archive,
-        &_LookStream.vt,
-        index,
-        &_BlockIndex,
-        &_OutBuffer,
-        &_OutBufferSize,
-        &offset,
-        &outSizeProcessed,
-        &_AllocImp,
-        &_AllocTempImp
-    );
-    
-    if (res != SZ_OK) {
-        SEVENZIPVIEW_LOG(L"ExtractToBuffer failed: index=%u error=%d", index, res);
-        return false;
+    if (!reader) {
+        reader.reset(new ArchiveReader(this));
+        if (!reader->Open()) {
+            SEVENZIPVIEW_LOG(L"Archive::AcquireReader: FAILED to open a reader");
+            return nullptr;
+        }
     }
     
-    buffer.resize(outSizeProcessed);
-    if (outSizeProcessed > 0) {
-        memcpy(buffer.data(), _OutBuffer + offset, outSizeProcessed);
-    }
+    reader->SetDecodeWindowSize(windowSize);
+    return reader;
+}
+
+void Archive::ReleaseReader(std::unique_ptr<ArchiveReader> reader) {
+    // Idle readers keep their stream buffer, not a decoded block
+    reader->ReleaseBuffers();
     
-    return true;
+    std::lock_guard<std::mutex> lock(_ReadersMutex);
+    if (_IdleReaders.size() < ARCHIVE_MAX_IDLE_READERS)
+        _IdleReaders.push_back(std::move(reader));
 }
 
-bool Archive::ExtractToFile(UINT32 index, const std::wstring& destPath) {
-    SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: index=%u dest='%s'", index, destPath.c_str());
+bool Archive::WriteEntryFile(UINT32 index, const std::wstring& destPath, const BYTE* data, size_t size) const {
+    HANDLE hFile = CreateEntryFile(destPath, size);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
     
-    std::vector<BYTE> buffer;
-    if (!ExtractToBuffer(index, buffer)) {
-        SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: ExtractToBuffer FAILED");
-        return false;
-    }
+    DWORD written;
+    BOOL success = WriteFile(hFile, data, (DWORD)size, &written, nullptr);
     
-    SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: buffer size=%zu", buffer.size());
+    return FinishEntryFile(index, destPath, hFile, success && written == size);
+}
+
+HANDLE Archive::CreateEntryFile(const std::wstring& destPath, UINT64 size) const {
+    // One CreateFileW in the common case; the parent directory and an older
+    // read-only or hidden file are only dealt with when it fails
+    HANDLE hFile = CreateTargetFile(destPath);
     
-    // Create directory if needed - using SHCreateDirectoryExW for robust nested creation
-    size_t lastSlash = destPath.find_last_of(L"\\/");
-    if (lastSlash != std::wstring::npos) {
-        std::wstring dir = destPath.substr(0, lastSlash);
-        DWORD attr = GetFileAttributesW(dir.c_str());
-        if (attr == INVALID_FILE_ATTRIBUTES) {
+    if (hFile == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PATH_NOT_FOUND) {
+        size_t lastSlash = destPath.find_last_of(L"\\/");
+        if (lastSlash != std::wstring::npos) {
+            std::wstring dir = destPath.substr(0, lastSlash);
             int shRes = SHCreateDirectoryExW(nullptr, dir.c_str(), nullptr);
-            SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: SHCreateDirectoryExW('%s') = %d", dir.c_str(), shRes);
             if (shRes != ERROR_SUCCESS && shRes != ERROR_ALREADY_EXISTS && shRes != ERROR_FILE_EXISTS) {
-                SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: FAILED to create directory");
-                return false;
+                SEVENZIPVIEW_LOG(L"Archive::CreateEntryFile: SHCreateDirectoryExW('%s') = %d", dir.c_str(), shRes);
+                return INVALID_HANDLE_VALUE;
             }
+            hFile = CreateTargetFile(destPath);
         }
     }
     
-    // If file exists, try to delete it first (it may be from a previous extraction)
-    DWORD existingAttr = GetFileAttributesW(destPath.c_str());
-    if (existingAttr != INVALID_FILE_ATTRIBUTES) {
-        // Remove read-only attribute if present
-        if (existingAttr & FILE_ATTRIBUTE_READONLY) {
-            SetFileAttributesW(destPath.c_str(), existingAttr & ~FILE_ATTRIBUTE_READONLY);
+    if (hFile == INVALID_HANDLE_VALUE && GetLastError() == ERROR_ACCESS_DENIED) {
+        DWORD attr = GetFileAttributesW(destPath.c_str());
+        if (attr != INVALID_FILE_ATTRIBUTES && !(attr & FILE_ATTRIBUTE_DIRECTORY) &&
+            (attr & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM))) {
+            SetFileAttributesW(destPath.c_str(), FILE_ATTRIBUTE_NORMAL);
+            hFile = CreateTargetFile(destPath);
         }
-        DeleteFileW(destPath.c_str());
-        SEVENZIPVIEW_LOG(L"Archive::ExtractToFile: deleted existing file");
     }
     
-    // Write file with retry logic
-    HANDLE hFile = INVALID_HANDLE_VALUE;
-    for (int retry = 0; retry < 3 && hFile == INVALID_HANDLE_VALUE; retry++) {
-        if (retry > 0) Sleep(50);
-        hFile = CreateFileW(
-            destPath.c_str(),
-            GENERIC_WRITE,
-            0,
-            nullptr,
-            CREATE_ALWAYS,
-            FILE_ATTRIBUTE_NORMAL,
-            nullptr
-        );
+    // Another process (an indexer, a scanner) may still hold an older file
+    for (int retry = 0; retry < 3 && hFile == INVALID_HANDLE_VALUE &&
+                        GetLastError() == ERROR_SHARING_VIOLATION; retry++) {
+        Sleep(50);
+        hFile = CreateTargetFile(destPath);
     }
     
     if (hFile == INVALID_HANDLE_VALUE) {
         DWORD err = GetLastError();
         SEVENZIPVIEW_LOG(L"Failed to create file: %s (error=%u)", destPath.c_str(), err);
-        return false;
+        return INVALID_HANDLE_VALUE;
     }
     
-    DWORD written;
-    BOOL success = WriteFile(hFile, buffer.data(), (DWORD)buffer.size(), &written, nullptr);
-    CloseHandle(hFile);
+    // Reserving the space up front keeps large files from fragmenting
+    if (size >= ENTRY_PREALLOCATE_MIN) {
+        FILE_ALLOCATION_INFO allocation;
+        allocation.AllocationSize.QuadPart = (LONGLONG)size;
+        SetFileInformationByHandle(hFile, FileAllocationInfo, &allocation, sizeof(allocation));
+    }
     
-    if (!success || written != buffer.size()) {
+    return hFile;
+}
+
+bool Archive::FinishEntryFile(UINT32 index, const std::wstring& destPath, HANDLE hFile, bool ok) const {
+    if (!ok) {
+        CloseHandle(hFile);
         DeleteFileW(destPath.c_str());
         return false;
     }
     
-    // Set file attributes
-    ArchiveEntry entry;
-    if (GetEntry(index, entry) && entry.Attributes != 0) {
-        SetFileAttributesW(destPath.c_str(), entry.Attributes);
-    }
-    
-    // Set file time
-    if (entry.ModifiedTime.dwLowDateTime != 0 || entry.ModifiedTime.dwHighDateTime != 0) {
-        hFile = CreateFileW(destPath.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
-                           nullptr, OPEN_EXISTING, 0, nullptr);
-        if (hFile != INVALID_HANDLE_VALUE) {
-            SetFileTime(hFile, &entry.CreatedTime, nullptr, &entry.ModifiedTime);
-            CloseHandle(hFile);
-        }
+    // Times and attributes go on the handle that wrote the data. Zero
+    // fields are left as they are.
+    if (index < _Entries.GetCount()) {
+        FILE_BASIC_INFO basic = {};
+        basic.CreationTime = ToLargeInteger(_Entries.GetCreatedTime(index));
+        basic.LastWriteTime = ToLargeInteger(_Entries.GetModifiedTime(index));
+        basic.FileAttributes = _Entries.GetAttributes(index) & ENTRY_FILE_ATTRIBUTES;
+        if (!SetFileInformationByHandle(hFile, FileBasicInfo, &basic, sizeof(basic)))
+            SEVENZIPVIEW_LOG(L"Archive::FinishEntryFile: could not set times of '%s' (error=%u)",
+                destPath.c_str(), GetLastError());
     }
     
+    CloseHandle(hFile);
     return true;
 }
 
+void Archive::SetDecodeWindowSize(size_t size) {
+    std::lock_guard<std::mutex> lock(_ReadersMutex);
+    _DecodeWindowSize = size;
+}
+
+void Archive::SetPassword(const std::wstring& password) {
+    // A folder without a CRC decodes to garbage under a wrong password and
+    // would be served from the BlockCache under the right one
+    if (_Keys.SetPassword(password) && _BlockSource.IsValid())
+        BlockCache::Instance().Remove(_BlockSource.Path);
+}
+
+void Archive::ClearPassword() {
+    _Keys.Clear();
+    if (_BlockSource.IsValid()) BlockCache::Instance().Remove(_BlockSource.Path);
+}
+
 bool Archive::ExtractToBuffer(const std::wstring& entryPath, std::vector<uint8_t>& buffer) {
-    ArchiveEntry entry = GetEntry(entryPath);
-    if (entry.Type == ItemType::Unknown || entry.Type == ItemType::Folder) {
+    UINT32 index = FindEntry(entryPath);
+    if (index == PathIndex::NOT_FOUND || _Entries.IsDirectory(index)) {
         return false;
     }
     
-    std::vector<BYTE> tempBuffer;
-    if (!ExtractToBuffer(entry.ArchiveIndex, tempBuffer)) {
-        return false;
-    }
-    
-    buffer.assign(tempBuffer.begin(), tempBuffer.end());
-    return true;
+    return ExtractToBuffer(index, buffer);
 }
 
 bool Archive::ExtractToFile(const std::wstring& entryPath, const std::wstring& destPath) {
-    ArchiveEntry entry = GetEntry(entryPath);
-    if (entry.Type == ItemType::Unknown || entry.Type == ItemType::Folder) {
+    UINT32 index = FindEntry(entryPath);
+    if (index == PathIndex::NOT_FOUND || _Entries.IsDirectory(index)) {
         return false;
     }
     
-    return ExtractToFile(entry.ArchiveIndex, destPath);
+    return ExtractToFile(index, destPath);
 }
 
 bool Archive::ExtractAll(const std::wstring& destDir,
@@ -745,7 +819,7 @@ bool Archive::ExtractAll(const std::wstring& destDir,
     UINT64 totalSize = GetTotalUncompressedSize();
     UINT64 processedSize = 0;
     
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
+    for (UINT32 i = 0; i < _Entries.GetCount(); i++) {
         ArchiveEntry entry;
         if (!GetEntry(i, entry)) continue;
         
@@ -784,45 +858,22 @@ bool Archive::ExtractAll(const std::wstring& destDir,
 
 UINT64 Archive::GetTotalUncompressedSize() const {
     if (!_IsOpen) return 0;
-    
-    UINT64 total = 0;
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        total += SzArEx_GetFileSize(&_Archive, i);
-    }
-    return total;
+    return _Entries.GetTotalSize();
 }
 
 UINT64 Archive::GetTotalCompressedSize() const {
     if (!_IsOpen) return 0;
-    
-    // Calculate total packed size
-    UINT64 total = 0;
-    for (UINT32 i = 0; i < _Archive.db.NumPackStreams; i++) {
-        if (_Archive.db.PackPositions) {
-            total += _Archive.db.PackPositions[i + 1] - _Archive.db.PackPositions[i];
-        }
-    }
-    return total;
+    return _Entries.GetTotalPackSize();
 }
 
 UINT32 Archive::GetFileCount() const {
     if (!_IsOpen) return 0;
-    
-    UINT32 count = 0;
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        if (!SzArEx_IsDir(&_Archive, i)) count++;
-    }
-    return count;
+    return _Entries.GetFileCount();
 }
 
 UINT32 Archive::GetFolderCount() const {
     if (!_IsOpen) return 0;
-    
-    UINT32 count = 0;
-    for (UINT32 i = 0; i < _Archive.NumFiles; i++) {
-        if (SzArEx_IsDir(&_Archive, i)) count++;
-    }
-    return count;
+    return _Entries.GetFolderCount();
 }
 
 } // namespace SevenZipView
@@ -0,0 +1,303 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Independent Archive Reader Implementation
+*/
+
+#include "ArchiveReader.h"
+#include "SdkAlloc.h"
+
+namespace SevenZipView {
+
+ArchiveReader::ArchiveReader(std::shared_ptr<Archive> archive)
+    : _Owner(std::move(archive))
+    , _Archive(_Owner.get())
+    , _IsOpen(false)
+    , _BlockIndex(0xFFFFFFFF) {
+    Construct();
+}
+
+ArchiveReader::ArchiveReader(Archive* archive)
+    : _Archive(archive)
+    , _IsOpen(false)
+    , _BlockIndex(0xFFFFFFFF) {
+    Construct();
+}
+
+void ArchiveReader::Construct() {
+    SharedInStream_Construct(&_SharedStream);
+
+    // Share the archive's mapping or file handle, each reader with its own position
+    if (_Archive) {
+        _MappedFile = _Archive->GetMappedFile();
+        if (!_MappedFile) _SharedFile = _Archive->GetSharedFile();
+    }
+    _InStream = _MappedFile ? &_MappedStream.vt : &_SharedStream.vt;
+
+    if (_Archive)
+        _Decoder = std::make_unique<FolderDecoder>(_Archive->GetDatabase(), _InStream, BufferPool::GetAlloc(),
+            &_Archive->GetKeyCache());
+}
+
+ArchiveReader::~ArchiveReader() {
+    Close();
+    SharedInStream_Free(&_SharedStream);
+}
+
+bool ArchiveReader::Open() {
+    if (_IsOpen) return true;
+    if (!_Archive || !_Archive->IsOpen() || !_Archive->EnsureDatabase()) return false;
+
+    if (_MappedFile) {
+        MappedInStream_CreateVTable(&_MappedStream);
+        MappedInStream_Init(&_MappedStream, _MappedFile.get());
+        _IsOpen = true;
+        return true;
+    }
+
+    if (!_SharedFile || !SharedInStream_Init(&_SharedStream, _SharedFile.get())) {
+        SEVENZIPVIEW_LOG(L"ArchiveReader::Open: no stream over the archive file");
+        return false;
+    }
+
+    _IsOpen = true;
+    return true;
+}
+
+void ArchiveReader::Close() {
+    if (!_IsOpen) return;
+
+    ReleaseBuffers();
+    _IsOpen = false;
+}
+
+void ArchiveReader::ReleaseBuffers() {
+    if (_Decoder) _Decoder->Close();
+    _Block.reset();
+    _BlockIndex = 0xFFFFFFFF;
+}
+
+bool ArchiveReader::ExtractToSink(UINT32 index, IExtractSink& sink) {
+    if (!_IsOpen) return false;
+
+    const CSzArEx& db = _Archive->GetDatabase();
+    if (index >= db.NumFiles || SzArEx_IsDir(&db, index)) return false;
+
+    UINT64 size = db.UnpackPositions[(size_t)index + 1] - db.UnpackPositions[index];
+    if (!sink.OnBegin(index, size)) return false;
+
+    // Large blocks are streamed, the sink getting spans of the decoder's window
+    if (IsStreamedEntry(index)) {
+        bool stopped = false;
+        SRes res = _Decoder->ExtractFile(index, [&](const Byte* data, size_t got) {
+            stopped = !sink.OnChunk(data, got);
+            return !stopped;
+        });
+        if (res != SZ_OK) {
+            _Decoder->Close();
+            if (stopped) return false;
+            SEVENZIPVIEW_LOG(L"ArchiveReader::ExtractToSink failed: index=%u error=%d (streamed)", index, res);
+        }
+        return sink.OnEnd(res == SZ_OK) && res == SZ_OK;
+    }
+
+    // A block cache miss moves the stream under the decoder
+    _Decoder->Close();
+
+    UInt32 folder = db.FileToFolder[index];
+    if (folder == (UInt32)-1) return sink.OnEnd(true);
+
+    SRes res = SZ_OK;
+    if (!_Block || _BlockIndex != folder) {
+        // Unpin the previous block first so the cache may evict it
+        _Block.reset();
+        _BlockIndex = 0xFFFFFFFF;
+        res = BlockCache::Instance().Acquire(_Archive->GetBlockSource(), db, folder, _InStream, BufferPool::GetAlloc(),
+            &_Archive->GetKeyCache(), _Block);
+        if (res == SZ_OK) _BlockIndex = folder;
+    }
+
+    // The whole entry is handed out in place, from the pinned block
+    const BYTE* data = nullptr;
+    size_t length = 0;
+    if (res == SZ_OK)
+        res = BlockCache::GetEntry(db, *_Block, index, data, length);
+    if (res == SZ_OK && length > 0 && !sink.OnChunk(data, length)) return false;
+
+    if (res != SZ_OK)
+        SEVENZIPVIEW_LOG(L"ArchiveReader::ExtractToSink failed: index=%u error=%d", index, res);
+    return sink.OnEnd(res == SZ_OK) && res == SZ_OK;
+}
+
+bool ArchiveReader::ExtractToBuffer(UINT32 index, std::vector<BYTE>& buffer) {
+    MemorySink sink(buffer);
+    return ExtractToSink(index, sink);
+}
+
+bool ArchiveReader::ExtractPrefix(UINT32 index, size_t maxBytes, std::vector<BYTE>& buffer) {
+    if (!_IsOpen) return false;
+
+    const CSzArEx& db = _Archive->GetDatabase();
+    if (index >= db.NumFiles || SzArEx_IsDir(&db, index)) return false;
+
+    UInt32 folder = db.FileToFolder[index];
+    if (folder == (UInt32)-1) {
+        buffer.clear();
+        return true;
+    }
+
+    // Browsing may have decoded the block already
+    BlockHandle block = (_Block && _BlockIndex == folder) ? _Block
+        : BlockCache::Instance().Find(_Archive->GetBlockSource(), folder);
+    if (block) return BlockCache::CopyEntry(db, *block, index, buffer, maxBytes) == SZ_OK;
+
+    UINT64 size = db.UnpackPositions[(size_t)index + 1] - db.UnpackPositions[index];
+    buffer.clear();
+    buffer.reserve((size_t)(std::min)(size, (UINT64)maxBytes));
+
+    SRes res = _Decoder->ExtractPrefix(index, maxBytes, [&buffer](const Byte* data, size_t got) {
+        buffer.insert(buffer.end(), data, data + got);
+        return true;
+    });
+    if (res != SZ_OK) {
+        SEVENZIPVIEW_LOG(L"ArchiveReader::ExtractPrefix failed: index=%u error=%d", index, res);
+        _Decoder->Close();
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveReader::ExtractToFile(UINT32 index, const std::wstring& destPath) {
+    FileSink sink(*_Archive, destPath);
+    return ExtractToSink(index, sink);
+}
+
+bool ArchiveReader::ExtractView(UINT32 index, std::shared_ptr<MappedFile>& view) {
+    view.reset();
+    if (!_IsOpen) return false;
+
+    const CSzArEx& db = _Archive->GetDatabase();
+    if (index >= db.NumFiles || SzArEx_IsDir(&db, index)) return false;
+
+    UINT64 size = db.UnpackPositions[(size_t)index + 1] - db.UnpackPositions[index];
+    UInt32 folder = db.FileToFolder[index];
+    if (size == 0 || folder == (UInt32)-1 || (size_t)size != size) return false;
+
+    SRes res = SZ_OK;
+    if (!IsStreamedEntry(index)) {
+        _Decoder->Close();
+        if (!_Block || _BlockIndex != folder) {
+            _Block.reset();
+            _BlockIndex = 0xFFFFFFFF;
+            res = BlockCache::Instance().Acquire(_Archive->GetBlockSource(), db, folder, _InStream,
+                BufferPool::GetAlloc(), &_Archive->GetKeyCache(), _Block);
+            if (res == SZ_OK) _BlockIndex = folder;
+        }
+
+        const BYTE* data = nullptr;
+        size_t length = 0;
+        if (res == SZ_OK) res = BlockCache::GetEntry(db, *_Block, index, data, length);
+        if (res == SZ_OK) view = MappedFile::FromMemory(data, length, _Block);
+    } else {
+        // Decoded once into a block of its own, as the cache would hold it
+        auto decoded = std::make_shared<DecodedBlock>();
+        decoded->Size = (size_t)size;
+        decoded->Data.reset(static_cast<BYTE*>(BufferPool::Instance().Allocate(decoded->Size)));
+        if (!decoded->Data) return false;
+
+        size_t filled = 0;
+        res = _Decoder->ExtractFile(index, [&](const Byte* chunk, size_t chunkSize) {
+            if (chunkSize > decoded->Size - filled) return false;
+            memcpy(decoded->Data.get() + filled, chunk, chunkSize);
+            filled += chunkSize;
+            return true;
+        });
+        if (res != SZ_OK || filled != decoded->Size) {
+            _Decoder->Close();
+            if (res == SZ_OK) res = SZ_ERROR_DATA;
+        } else {
+            const Byte* data = decoded->Data.get();
+            view = MappedFile::FromMemory(data, size, std::move(decoded));
+        }
+    }
+
+    if (res != SZ_OK)
+        SEVENZIPVIEW_LOG(L"ArchiveReader::ExtractView failed: index=%u error=%d", index, res);
+    return view != nullptr;
+}
+
+FolderDecoder* ArchiveReader::SeekFile(UINT32 index, UINT64 offset) {
+    if (!_IsOpen) return nullptr;
+
+    const CSzArEx& db = _Archive->GetDatabase();
+    if (index >= db.NumFiles) return nullptr;
+    UInt32 folder = db.FileToFolder[index];
+    if (folder == (UInt32)-1) return nullptr;
+
+    // One seek inside the folder, so a forward move resumes the decoder
+    SRes res = SZ_OK;
+    if (!_Decoder->IsOpen() || _Decoder->GetFolder() != folder) res = _Decoder->Open(folder);
+    UINT64 start = db.UnpackPositions[index] - db.UnpackPositions[db.FolderToFile[folder]];
+    if (res == SZ_OK) res = _Decoder->Seek(start + offset);
+    if (res != SZ_OK) {
+        SEVENZIPVIEW_LOG(L"ArchiveReader::SeekFile failed: index=%u offset=%llu error=%d", index,
+            (unsigned long long)offset, res);
+        _Decoder->Close();
+        return nullptr;
+    }
+    return _Decoder.get();
+}
+
+bool ArchiveReader::ExtractFolder(const FolderPlan& plan, IExtractSink& sink) {
+    if (!_IsOpen) {
+        for (const auto& entry : plan.Entries) {
+            if (!sink.OnBegin(entry.ArchiveIndex, entry.Size)) break;
+            sink.OnEnd(false);
+        }
+        return false;
+    }
+
+    // Entries are sorted by offset, so the decoder only ever moves forward
+    // and stops after the last requested file
+    bool allOk = true;
+    bool folderFailed = false;
+    bool stopped = false;
+    for (const auto& entry : plan.Entries) {
+        if (!sink.OnBegin(entry.ArchiveIndex, entry.Size)) {
+            stopped = true;
+            break;
+        }
+
+        SRes res = SZ_ERROR_DATA;
+        if (!folderFailed) {
+            res = _Decoder->ExtractFile(entry.ArchiveIndex, [&](const Byte* data, size_t size) {
+                stopped = !sink.OnChunk(data, size);
+                return !stopped;
+            });
+            if (stopped) break;
+            if (res != SZ_OK && res != SZ_ERROR_CRC) {
+                SEVENZIPVIEW_LOG(L"ArchiveReader::ExtractFolder: decode failed: folder=%u error=%d", plan.Folder, res);
+                folderFailed = true;
+            }
+        }
+
+        bool ok = sink.OnEnd(res == SZ_OK) && res == SZ_OK;
+        allOk = allOk && ok;
+    }
+
+    // Release the dictionary and window between folders
+    _Decoder->Close();
+    return allOk && !stopped;
+}
+
+void ArchiveReader::SetDecodeWindowSize(size_t size) {
+    if (_Decoder) _Decoder->SetWindowSize(size);
+}
+
+bool ArchiveReader::IsStreamedEntry(UINT32 index) const {
+    const CSzArEx& db = _Archive->GetDatabase();
+    UInt32 folder = db.FileToFolder[index];
+    return folder != (UInt32)-1 &&
+        SzAr_GetFolderUnpackSize(&db.db, folder) > FOLDER_DECODER_BLOCK_CACHE_LIMIT;
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,237 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Shared Decoded Block Cache Implementation
+*/
+
+#include "BlockCache.h"
+#include "FolderDecoder.h"
+
+namespace SevenZipView {
+
+// BlockSource Implementation
+bool BlockSource::Read(const std::wstring& path, BlockSource& source) {
+    source = BlockSource();
+
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info)) return false;
+    source.Path = path;
+    source.Size = ((UINT64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    source.ModifiedTime = ((UINT64)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+// BlockCache Implementation
+bool BlockCache::Key::operator<(const Key& other) const {
+    if (Folder != other.Folder) return Folder < other.Folder;
+    if (Size != other.Size) return Size < other.Size;
+    if (ModifiedTime != other.ModifiedTime) return ModifiedTime < other.ModifiedTime;
+    return Path < other.Path;
+}
+
+BlockCache& BlockCache::Instance() {
+    static BlockCache instance;
+    return instance;
+}
+
+BlockCache::BlockCache()
+    : _Budget(BLOCK_CACHE_DEFAULT_BUDGET)
+    , _Memory(0) {
+}
+
+void BlockCache::SetBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Budget = bytes;
+    TrimLocked();
+}
+
+size_t BlockCache::GetBudget() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Budget;
+}
+
+SRes BlockCache::Decode(const CSzArEx& db, UInt32 folder, ILookInStreamPtr stream,
+                        ISzAllocPtr allocTemp, AesKeyCache* keys, std::shared_ptr<DecodedBlock>& block) {
+    UInt64 unpackSize = SzAr_GetFolderUnpackSize(&db.db, folder);
+    if ((size_t)unpackSize != unpackSize) return SZ_ERROR_MEM;
+
+    auto decoded = std::make_shared<DecodedBlock>();
+    decoded->Size = (size_t)unpackSize;
+    if (decoded->Size) {
+        decoded->Data.reset(static_cast<BYTE*>(BufferPool::Instance().Allocate(decoded->Size)));
+        if (!decoded->Data) return SZ_ERROR_MEM;
+    }
+
+    // Both check the folder CRC, if the archive stores one. The SDK has no
+    // 7zAES coder: encrypted folders go through the streaming decoder.
+    SRes res;
+    if (FolderDecoder::IsEncrypted(db, folder)) {
+        FolderDecoder decoder(db, stream, allocTemp, keys);
+        res = decoder.Open(folder);
+        if (res == SZ_OK) res = decoder.ReadInto(decoded->Data.get(), decoded->Size);
+    } else {
+        res = SzAr_DecodeFolder(&db.db, folder, stream, db.dataPos, decoded->Data.get(), decoded->Size, allocTemp);
+    }
+    if (res != SZ_OK) return res;
+
+    block = std::move(decoded);
+    return SZ_OK;
+}
+
+SRes BlockCache::Acquire(const BlockSource& source, const CSzArEx& db, UInt32 folder,
+                         ILookInStreamPtr stream, ISzAllocPtr allocTemp, AesKeyCache* keys, BlockHandle& block) {
+    block.reset();
+    if (folder >= db.db.NumFolders) return SZ_ERROR_PARAM;
+
+    std::shared_ptr<DecodedBlock> decoded;
+    if (!source.IsValid()) {
+        SRes res = Decode(db, folder, stream, allocTemp, keys, decoded);
+        block = decoded;
+        return res;
+    }
+
+    Key key{ source.Path, source.Size, source.ModifiedTime, folder };
+
+    std::unique_lock<std::mutex> lock(_Mutex);
+    for (;;) {
+        auto it = _Blocks.find(key);
+        if (it == _Blocks.end()) break;
+
+        if (it->second.Block) {
+            _Stats.Hits++;
+            _Lru.splice(_Lru.begin(), _Lru, it->second.LruPos);
+            block = it->second.Block;
+            return SZ_OK;
+        }
+
+        // Another thread is decoding this block; use its result
+        _Decoded.wait(lock);
+    }
+
+    _Stats.Misses++;
+    _Blocks[key].LruPos = _Lru.end();
+    lock.unlock();
+
+    SRes res = Decode(db, folder, stream, allocTemp, keys, decoded);
+
+    lock.lock();
+    auto it = _Blocks.find(key);
+    if (res != SZ_OK || decoded->Size > _Budget) {
+        // Waiters retry and decode themselves; a block over budget is
+        // handed to this caller only
+        _Blocks.erase(it);
+    } else {
+        it->second.Block = decoded;
+        _Lru.push_front(key);
+        it->second.LruPos = _Lru.begin();
+        _Memory += decoded->Size;
+        TrimLocked();
+    }
+    _Stats.Blocks = (UINT32)_Lru.size();
+    _Stats.Memory = _Memory;
+    lock.unlock();
+    _Decoded.notify_all();
+
+    block = decoded;
+    return res;
+}
+
+BlockHandle BlockCache::Find(const BlockSource& source, UInt32 folder) {
+    if (!source.IsValid()) return nullptr;
+
+    Key key{ source.Path, source.Size, source.ModifiedTime, folder };
+
+    std::lock_guard<std::mutex> lock(_Mutex);
+    auto it = _Blocks.find(key);
+    if (it == _Blocks.end() || !it->second.Block) return nullptr;
+
+    _Stats.Hits++;
+    _Lru.splice(_Lru.begin(), _Lru, it->second.LruPos);
+    return it->second.Block;
+}
+
+SRes BlockCache::GetEntry(const CSzArEx& db, const DecodedBlock& block, UINT32 index,
+                          const BYTE*& data, size_t& size, bool checkCrc) {
+    data = nullptr;
+    size = 0;
+    UInt32 folder = db.FileToFolder[index];
+    if (folder == (UInt32)-1) return SZ_OK;
+
+    UInt64 unpackPos = db.UnpackPositions[index];
+    size_t offset = (size_t)(unpackPos - db.UnpackPositions[db.FolderToFile[folder]]);
+    size_t length = (size_t)(db.UnpackPositions[(size_t)index + 1] - unpackPos);
+    if (offset > block.Size || length > block.Size - offset) return SZ_ERROR_FAIL;
+
+    const BYTE* start = block.Data.get() + offset;
+    if (checkCrc && SzBitWithVals_Check(&db.CRCs, index) && CrcCalc(start, length) != db.CRCs.Vals[index])
+        return SZ_ERROR_CRC;
+
+    data = start;
+    size = length;
+    return SZ_OK;
+}
+
+SRes BlockCache::CopyEntry(const CSzArEx& db, const DecodedBlock& block, UINT32 index, std::vector<BYTE>& buffer,
+                           size_t maxBytes) {
+    UInt32 folder = db.FileToFolder[index];
+    size_t fullSize = folder == (UInt32)-1 ? 0
+        : (size_t)(db.UnpackPositions[(size_t)index + 1] - db.UnpackPositions[index]);
+
+    const BYTE* data = nullptr;
+    size_t size = 0;
+    SRes res = GetEntry(db, block, index, data, size, maxBytes >= fullSize);
+    if (res != SZ_OK) return res;
+
+    buffer.assign(data, data + (std::min)(size, maxBytes));
+    return SZ_OK;
+}
+
+void BlockCache::TrimLocked() {
+    // Walk from the least recently used end, skipping pinned blocks
+    auto pos = _Lru.end();
+    while (_Memory > _Budget && pos != _Lru.begin()) {
+        --pos;
+        auto it = _Blocks.find(*pos);
+        if (it->second.Block.use_count() > 1) continue;
+
+        _Memory -= it->second.Block->Size;
+        _Stats.Evictions++;
+        _Blocks.erase(it);
+        pos = _Lru.erase(pos);
+    }
+
+    _Stats.Blocks = (UINT32)_Lru.size();
+    _Stats.Memory = _Memory;
+}
+
+void BlockCache::Remove(const std::wstring& path) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    DropLocked(&path);
+}
+
+void BlockCache::Clear() {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    DropLocked(nullptr);
+}
+
+void BlockCache::DropLocked(const std::wstring* path) {
+    for (auto pos = _Lru.begin(); pos != _Lru.end();) {
+        auto it = _Blocks.find(*pos);
+        if ((path && pos->Path != *path) || it->second.Block.use_count() > 1) {
+            ++pos;
+            continue;
+        }
+        _Memory -= it->second.Block->Size;
+        _Blocks.erase(it);
+        pos = _Lru.erase(pos);
+    }
+
+    _Stats.Blocks = (UINT32)_Lru.size();
+    _Stats.Memory = _Memory;
+}
+
+BlockCacheStats BlockCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Stats;
+}
+
+} // namespace SevenZipView
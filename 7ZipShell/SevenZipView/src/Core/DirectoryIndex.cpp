@@ -0,0 +1,286 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Archive Directory Index Implementation
+*/
+
+#include "DirectoryIndex.h"
+#include "PathIndex.h"
+
+namespace SevenZipView {
+
+// FNV-1a over the parent id and the folded name
+static const UINT32 HASH_SEED = 2166136261u;
+static const UINT32 HASH_PRIME = 16777619u;
+
+DirectoryIndex::DirectoryIndex()
+    : _Table(nullptr)
+    , _Mask(0) {
+}
+
+void DirectoryIndex::Clear() {
+    _Table = nullptr;
+    _Mask = 0;
+    _Nodes.Clear();
+    _Children.Clear();
+    _Slots.Clear();
+}
+
+UINT32 DirectoryIndex::HashName(UINT32 parent, const wchar_t* name, size_t length) {
+    UINT32 hash = HASH_SEED;
+    for (int b = 0; b < 4; b++)
+        hash = (hash ^ ((parent >> (b * 8)) & 0xFF)) * HASH_PRIME;
+    for (size_t c = 0; c < length; c++)
+        hash = (hash ^ (UINT32)FoldPathChar(name[c])) * HASH_PRIME;
+    return hash;
+}
+
+std::wstring_view DirectoryIndex::GetPath(UINT32 node) const {
+    const Node& n = _Nodes[node];
+    if (n.PathSource == NOT_FOUND) return std::wstring_view();
+    return _Table->GetPath(n.PathSource).substr(0, n.PathLength);
+}
+
+bool DirectoryIndex::NameEquals(UINT32 node, const wchar_t* name, size_t length) const {
+    std::wstring_view nodeName = GetName(node);
+    if (nodeName.size() != length) return false;
+    for (size_t c = 0; c < length; c++) {
+        if (FoldPathChar(nodeName[c]) != FoldPathChar(name[c]))
+            return false;
+    }
+    return true;
+}
+
+UINT32 DirectoryIndex::Lookup(UINT32 parent, UINT32 hash, const wchar_t* name, size_t length) const {
+    if (_Slots.Size() == 0) return NOT_FOUND;
+    for (UINT32 pos = hash & _Mask; _Slots[pos].Node != NOT_FOUND; pos = (pos + 1) & _Mask) {
+        const Slot& slot = _Slots[pos];
+        if (slot.Hash == hash && _Nodes[slot.Node].Parent == parent && NameEquals(slot.Node, name, length))
+            return slot.Node;
+    }
+    return NOT_FOUND;
+}
+
+void DirectoryIndex::Insert(UINT32 hash, UINT32 node) {
+    std::vector<Slot>& slots = _Slots.Storage();
+    UINT32 pos = hash & _Mask;
+    while (slots[pos].Node != NOT_FOUND)
+        pos = (pos + 1) & _Mask;
+    slots[pos] = Slot{ hash, node };
+}
+
+void DirectoryIndex::Grow() {
+    std::vector<Slot> old;
+    old.swap(_Slots.Storage());
+    _Slots.Storage().assign(old.size() * 2, Slot{ 0, NOT_FOUND });
+    _Mask = (UINT32)(old.size() * 2 - 1);
+    for (const Slot& slot : old) {
+        if (slot.Node != NOT_FOUND) Insert(slot.Hash, slot.Node);
+    }
+}
+
+void DirectoryIndex::Build(const EntryTable& table) {
+    Clear();
+    _Table = &table;
+
+    UINT32 count = table.GetCount();
+
+    std::vector<Node>& nodes = _Nodes.Storage();
+
+    // Every entry is one node; synthetic folders add a few more
+    nodes.reserve((size_t)count + 1);
+    nodes.push_back(Node{ ArchiveEntry::SYNTHETIC_FOLDER_INDEX, NOT_FOUND, 0, 0, NOT_FOUND, 0, 0, FLAG_FOLDER });
+
+    size_t slotCount = 16;
+    while (slotCount < ((size_t)count + 1) * 2) slotCount <<= 1;
+    _Slots.Storage().assign(slotCount, Slot{ 0, NOT_FOUND });
+    _Mask = (UINT32)(slotCount - 1);
+
+    // One pass: walk each path component by component, finding or creating
+    // the node of every prefix
+    for (UINT32 i = 0; i < count; i++) {
+        std::wstring_view path = table.GetPath(i);
+        size_t length = path.size();
+        while (length > 0 && IsPathSeparator(path[length - 1]))
+            length--;
+
+        UINT32 parent = ROOT;
+        size_t start = 0;
+        while (start < length) {
+            if (IsPathSeparator(path[start])) {
+                start++;
+                continue;
+            }
+
+            size_t end = start;
+            while (end < length && !IsPathSeparator(path[end]))
+                end++;
+            bool last = (end == length);
+
+            const wchar_t* name = path.data() + start;
+            UINT32 hash = HashName(parent, name, end - start);
+            UINT32 node = Lookup(parent, hash, name, end - start);
+
+            if (node == NOT_FOUND) {
+                node = (UINT32)nodes.size();
+                bool isFolder = !last || table.IsDirectory(i);
+                nodes.push_back(Node{
+                    last ? i : ArchiveEntry::SYNTHETIC_FOLDER_INDEX,
+                    i, (UINT32)end, (UINT32)start, parent, 0, 0,
+                    (BYTE)(isFolder ? FLAG_FOLDER : 0) });
+
+                if ((nodes.size() - 1) * 2 > _Slots.Size()) Grow();
+                Insert(hash, node);
+            } else if (last && IsSynthetic(node) && table.IsDirectory(i)) {
+                // Explicit folder entry listed after its contents
+                nodes[node].EntryIndex = i;
+                nodes[node].PathSource = i;
+                nodes[node].PathLength = (UINT32)end;
+                nodes[node].NameStart = (UINT32)start;
+            }
+            // Any other match is a duplicate path; the first entry wins
+
+            parent = node;
+            start = end;
+        }
+    }
+
+    // Group children by parent (stable, so each range keeps archive order)
+    for (size_t n = 1; n < nodes.size(); n++)
+        nodes[nodes[n].Parent].ChildCount++;
+
+    UINT32 offset = 0;
+    for (Node& node : nodes) {
+        node.FirstChild = offset;
+        offset += node.ChildCount;
+        node.ChildCount = 0;
+    }
+
+    std::vector<UINT32>& children = _Children.Storage();
+    children.resize(offset);
+    for (size_t n = 1; n < nodes.size(); n++) {
+        Node& parent = nodes[nodes[n].Parent];
+        children[parent.FirstChild + parent.ChildCount++] = (UINT32)n;
+    }
+}
+
+void DirectoryIndex::Save(IndexWriter& writer) const {
+    writer.WriteValue(_Mask);
+    writer.WriteArray(_Nodes);
+    writer.WriteArray(_Children);
+    writer.WriteArray(_Slots);
+}
+
+bool DirectoryIndex::Load(IndexReader& reader, const EntryTable& table) {
+    Clear();
+
+    UINT32 mask = 0;
+    bool ok = reader.ReadValue(mask) &&
+        reader.ReadArray(_Nodes) &&
+        reader.ReadArray(_Children, _Nodes.Size() ? _Nodes.Size() - 1 : 0) &&
+        reader.ReadArray(_Slots, (size_t)mask + 1);
+
+    // Ids and ranges must stay inside their arrays, paths inside the table
+    UINT32 count = (UINT32)_Nodes.Size();
+    ok = ok && count > 0 && (((size_t)mask + 1) & mask) == 0;
+    for (UINT32 n = 0; ok && n < count; n++) {
+        const Node& node = _Nodes[n];
+        ok = (n == ROOT || node.Parent < count) &&
+            (size_t)node.FirstChild + node.ChildCount <= _Children.Size() &&
+            (node.PathSource == NOT_FOUND ||
+                (node.PathSource < table.GetCount() &&
+                 node.NameStart <= node.PathLength &&
+                 node.PathLength <= table.GetPath(node.PathSource).size()));
+    }
+    for (size_t c = 0; ok && c < _Children.Size(); c++)
+        ok = _Children[c] != ROOT && _Children[c] < count;
+    for (size_t s = 0; ok && s < _Slots.Size(); s++)
+        ok = _Slots[s].Node == NOT_FOUND || _Slots[s].Node < count;
+
+    if (!ok) {
+        Clear();
+        return false;
+    }
+
+    _Table = &table;
+    _Mask = mask;
+    return true;
+}
+
+UINT32 DirectoryIndex::FindChild(UINT32 node, const wchar_t* name, size_t length) const {
+    if (node >= _Nodes.Size()) return NOT_FOUND;
+    return Lookup(node, HashName(node, name, length), name, length);
+}
+
+void DirectoryIndex::GetDescendants(UINT32 node, std::vector<UINT32>& nodes) const {
+    if (node >= _Nodes.Size()) return;
+
+    // Children are pushed in reverse so they come off in archive order
+    std::vector<UINT32> pending;
+    ChildRange children = GetChildren(node);
+    for (size_t i = children.size(); i-- > 0;)
+        pending.push_back(children[i]);
+
+    while (!pending.empty()) {
+        UINT32 current = pending.back();
+        pending.pop_back();
+        nodes.push_back(current);
+
+        children = GetChildren(current);
+        for (size_t i = children.size(); i-- > 0;)
+            pending.push_back(children[i]);
+    }
+}
+
+UINT32 DirectoryIndex::FindFolder(const wchar_t* path, size_t length) const {
+    if (_Nodes.Size() == 0) return NOT_FOUND;
+
+    UINT32 node = ROOT;
+    size_t start = 0;
+    while (start < length) {
+        if (IsPathSeparator(path[start])) {
+            start++;
+            continue;
+        }
+
+        size_t end = start;
+        while (end < length && !IsPathSeparator(path[end]))
+            end++;
+
+        node = FindChild(node, path + start, end - start);
+        if (node == NOT_FOUND || !IsFolder(node)) return NOT_FOUND;
+        start = end;
+    }
+    return node;
+}
+
+bool DirectoryIndex::GetEntry(UINT32 node, ArchiveEntry& entry) const {
+    if (node >= _Nodes.Size()) return false;
+
+    const Node& n = _Nodes[node];
+    if (n.EntryIndex != ArchiveEntry::SYNTHETIC_FOLDER_INDEX) {
+        if (!_Table->GetEntry(n.EntryIndex, entry)) return false;
+        entry.Name.assign(GetName(node));   // Without a trailing separator
+        return true;
+    }
+
+    std::wstring_view path = GetPath(node);
+    entry.FullPath.assign(path);
+    entry.Name.assign(path.substr(n.NameStart));
+    entry.Type = (node == ROOT) ? ItemType::Root : ItemType::Folder;
+    entry.Size = 0;
+    entry.CompressedSize = 0;
+    entry.CRC = 0;
+    entry.Attributes = FILE_ATTRIBUTE_DIRECTORY;
+    ZeroMemory(&entry.ModifiedTime, sizeof(entry.ModifiedTime));
+    ZeroMemory(&entry.CreatedTime, sizeof(entry.CreatedTime));
+    entry.ArchiveIndex = ArchiveEntry::SYNTHETIC_FOLDER_INDEX;
+    return true;
+}
+
+size_t DirectoryIndex::GetMemoryUsage() const {
+    return _Nodes.GetMemoryUsage() +
+        _Children.GetMemoryUsage() +
+        _Slots.GetMemoryUsage();
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,247 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** On-Demand Stream over One Archive Entry Implementation
+*/
+
+#include "EntryStream.h"
+
+namespace SevenZipView {
+
+EntryStream::EntryStream(std::shared_ptr<Archive> archive, UINT32 index)
+    : _Archive(std::move(archive))
+    , _Index(index)
+    , _Size(0)
+    , _Position(0)
+    , _IsOpen(false)
+    , _Streamed(false)
+    , _WindowSize(ENTRY_STREAM_DEFAULT_WINDOW)
+    , _WindowCount(ENTRY_STREAM_DEFAULT_WINDOWS)
+    , _Allocated(0)
+    , _DecodeEnd(0)
+    , _Running(false)
+    , _Done(false)
+    , _Stopping(false)
+    , _Error(SZ_OK)
+    , _Stats() {
+}
+
+EntryStream::~EntryStream() {
+    StopDecoder();
+}
+
+bool EntryStream::Open() {
+    if (_IsOpen) return true;
+    if (!_Archive || !_Archive->IsOpen() || !_Archive->EnsureDatabase()) return false;
+
+    const CSzArEx& db = _Archive->GetDatabase();
+    if (_Index >= db.NumFiles || SzArEx_IsDir(&db, _Index)) return false;
+
+    _Reader = std::make_unique<ArchiveReader>(_Archive);
+    if (!_Reader->Open()) {
+        _Reader.reset();
+        return false;
+    }
+
+    _Size = db.UnpackPositions[(size_t)_Index + 1] - db.UnpackPositions[_Index];
+    _Streamed = _Reader->IsStreamedEntry(_Index);
+    _Position = 0;
+    _IsOpen = true;
+    return true;
+}
+
+void EntryStream::SetReadAhead(size_t windowSize, UINT32 windows) {
+    Release();
+    _WindowSize = (std::max)(windowSize, FOLDER_DECODER_MIN_WINDOW);
+    _WindowCount = (std::max)(windows, 1u);
+}
+
+SRes EntryStream::Read(void* dest, size_t size, size_t* read) {
+    *read = 0;
+    if (!_IsOpen) return SZ_ERROR_FAIL;
+    if (_Position >= _Size || size == 0) return SZ_OK;
+
+    size = (size_t)(std::min)((UINT64)size, _Size - _Position);
+    BYTE* out = static_cast<BYTE*>(dest);
+    return _Streamed ? ReadStreamed(out, size, read) : ReadCached(out, size, read);
+}
+
+SRes EntryStream::ReadCached(BYTE* dest, size_t size, size_t* read) {
+    // The first read decodes the block, or finds it in the BlockCache
+    if (!_View && !_Reader->ExtractView(_Index, _View)) return SZ_ERROR_DATA;
+
+    memcpy(dest, _View->GetData() + _Position, size);
+    _Position += size;
+    *read = size;
+    return SZ_OK;
+}
+
+SRes EntryStream::ReadStreamed(BYTE* dest, size_t size, size_t* read) {
+    size_t copied = 0;
+    std::unique_lock<std::mutex> lock(_Mutex);
+    while (copied < size) {
+        // Windows wholly behind the position go back to the decoder
+        while (!_Ready.empty() && _Ready.front().Offset + _Ready.front().Size <= _Position) {
+            _Spare.push_back(std::move(_Ready.front().Data));
+            _Ready.pop_front();
+            _Freed.notify_one();
+        }
+
+        if (!_Ready.empty()) {
+            const Window& window = _Ready.front();
+            size_t at = (size_t)(_Position - window.Offset);
+            size_t count = (std::min)(window.Size - at, size - copied);
+            memcpy(dest + copied, window.Data.get() + at, count);
+            copied += count;
+            _Position += count;
+            continue;
+        }
+
+        // First read, after a seek, or after the decoder stopped early
+        if (!_Running || (_Done && _Error == SZ_OK)) {
+            lock.unlock();
+            StartDecoder(_Position);
+            lock.lock();
+            continue;
+        }
+        if (_Done) break;
+
+        _Stats.Stalls++;
+        _Filled.wait(lock, [this] { return !_Ready.empty() || _Done; });
+    }
+
+    *read = copied;
+    return copied == size ? SZ_OK : _Error;
+}
+
+SRes EntryStream::Seek(UINT64 offset) {
+    if (!_IsOpen) return SZ_ERROR_FAIL;
+
+    // The decoder keeps going when its windows or its next one cover the
+    // new position
+    if (_Streamed) {
+        std::unique_lock<std::mutex> lock(_Mutex);
+        if (_Running) {
+            UINT64 readyStart = _Ready.empty() ? _DecodeEnd : _Ready.front().Offset;
+            bool covered = offset >= readyStart && offset <= _DecodeEnd && !(_Done && _Error != SZ_OK);
+            if (!covered) {
+                lock.unlock();
+                StopDecoder();
+            }
+        }
+    }
+
+    _Position = offset;
+    return SZ_OK;
+}
+
+void EntryStream::Release() {
+    StopDecoder();
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        _Spare.clear();
+        _Allocated = 0;
+    }
+    _View.reset();
+    if (_Reader) _Reader->ReleaseBuffers();
+}
+
+EntryStreamStats EntryStream::GetStats() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Stats;
+}
+
+void EntryStream::StartDecoder(UINT64 offset) {
+    StopDecoder();
+
+    std::lock_guard<std::mutex> lock(_Mutex);
+    if (offset < _DecodeEnd) _Stats.Restarts++;
+    _DecodeEnd = offset;
+    _Done = false;
+    _Stopping = false;
+    _Error = SZ_OK;
+    _Running = true;
+    _Thread = std::thread(&EntryStream::DecodeLoop, this, offset);
+}
+
+void EntryStream::StopDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (!_Running) return;
+        _Stopping = true;
+    }
+    _Freed.notify_all();
+    _Thread.join();
+
+    std::lock_guard<std::mutex> lock(_Mutex);
+    for (Window& window : _Ready) _Spare.push_back(std::move(window.Data));
+    _Ready.clear();
+    _Running = false;
+}
+
+void EntryStream::DecodeLoop(UINT64 offset) {
+    const CSzArEx& db = _Archive->GetDatabase();
+    FolderDecoder* decoder = _Reader->SeekFile(_Index, offset);
+    SRes res = decoder ? SZ_OK : SZ_ERROR_DATA;
+
+    // Only a pass from the first byte sees the whole file
+    bool checkCrc = offset == 0 && SzBitWithVals_Check(&db.CRCs, _Index);
+    UINT32 crc = CRC_INIT_VAL;
+    UINT64 position = offset;
+
+    while (res == SZ_OK && position < _Size) {
+        Buffer buffer;
+        {
+            std::unique_lock<std::mutex> lock(_Mutex);
+            _Freed.wait(lock, [this] { return _Stopping || !_Spare.empty() || _Allocated < _WindowCount; });
+            if (_Stopping) break;
+            if (!_Spare.empty()) {
+                buffer = std::move(_Spare.back());
+                _Spare.pop_back();
+            } else {
+                _Allocated++;
+            }
+        }
+        if (!buffer) {
+            buffer.reset(static_cast<BYTE*>(BufferPool::Instance().Allocate(_WindowSize)));
+            if (!buffer) {
+                std::lock_guard<std::mutex> lock(_Mutex);
+                _Allocated--;
+                res = SZ_ERROR_MEM;
+                break;
+            }
+        }
+
+        size_t size = (size_t)(std::min)((UINT64)_WindowSize, _Size - position);
+        res = decoder->ReadInto(buffer.get(), size);
+        if (res == SZ_OK && checkCrc) {
+            crc = CrcUpdate(crc, buffer.get(), size);
+            if (position + size == _Size && CRC_GET_DIGEST(crc) != db.CRCs.Vals[_Index]) res = SZ_ERROR_CRC;
+        }
+
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (res != SZ_OK) {
+            _Spare.push_back(std::move(buffer));
+            break;
+        }
+        _Ready.push_back({ std::move(buffer), size, position });
+        position += size;
+        _DecodeEnd = position;
+        _Stats.Windows++;
+        _Stats.BytesDecoded += size;
+        _Filled.notify_one();
+    }
+
+    // A failed decoder restarts from its folder's first byte next time
+    if (res != SZ_OK) {
+        SEVENZIPVIEW_LOG(L"EntryStream: decoding index=%u failed at %llu (error=%d)", _Index,
+            (unsigned long long)position, res);
+        _Reader->ReleaseBuffers();
+    }
+
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Error = res;
+    _Done = true;
+    _Filled.notify_all();
+}
+
+} // namespace SevenZipView
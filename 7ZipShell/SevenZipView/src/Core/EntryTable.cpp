@@ -0,0 +1,248 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Compact Archive Entry Table Implementation
+*/
+
+#include "EntryTable.h"
+#include "FolderDecoder.h"
+
+namespace SevenZipView {
+
+// 7z names are UTF-16LE, which is what wchar_t holds on Windows
+static_assert(sizeof(wchar_t) == sizeof(UInt16), "name arena is viewed as wchar_t");
+
+ArchiveEntry EntryView::ToEntry() const {
+    ArchiveEntry entry;
+    _Table->GetEntry(_Index, entry);
+    return entry;
+}
+
+EntryTable::EntryTable()
+    : _Count(0)
+    , _Arena(nullptr)
+    , _PathOffsets(nullptr)
+    , _FileCount(0)
+    , _FolderCount(0)
+    , _EncryptedCount(0)
+    , _TotalSize(0)
+    , _TotalPackSize(0) {
+}
+
+void EntryTable::Clear() {
+    _Count = 0;
+    _Arena = nullptr;
+    _PathOffsets = nullptr;
+
+    _NameOffsets.Clear();
+    _Flags.Clear();
+    _Sizes.Clear();
+    _PackSizes.Clear();
+    _CRCs.Clear();
+    _Attributes.Clear();
+    _MTimes.Clear();
+    _CTimes.Clear();
+    _Folders.Clear();
+    std::vector<wchar_t>().swap(_EmptyArena);
+    std::vector<size_t>().swap(_EmptyOffsets);
+
+    _FileCount = 0;
+    _FolderCount = 0;
+    _EncryptedCount = 0;
+    _TotalSize = 0;
+    _TotalPackSize = 0;
+}
+
+void EntryTable::Build(const CSzArEx& db) {
+    Clear();
+
+    _Count = db.NumFiles;
+
+    if (db.FileNames && db.FileNameOffsets) {
+        _Arena = reinterpret_cast<const wchar_t*>(db.FileNames);
+        _PathOffsets = db.FileNameOffsets;
+    } else {
+        // Archive without a names property: every path is empty
+        _EmptyArena.assign((size_t)_Count + 1, L'\0');
+        _EmptyOffsets.resize((size_t)_Count + 1);
+        for (size_t i = 0; i <= _Count; i++) _EmptyOffsets[i] = i;
+        _Arena = _EmptyArena.data();
+        _PathOffsets = _EmptyOffsets.data();
+    }
+
+    std::vector<UINT32>& nameOffsets = _NameOffsets.Storage();
+    std::vector<BYTE>& flags = _Flags.Storage();
+    std::vector<UINT64>& sizes = _Sizes.Storage();
+    std::vector<UINT64>& packSizes = _PackSizes.Storage();
+    std::vector<UINT32>& crcs = _CRCs.Storage();
+    std::vector<UINT32>& attributes = _Attributes.Storage();
+    std::vector<UINT64>& mtimes = _MTimes.Storage();
+    std::vector<UINT64>& ctimes = _CTimes.Storage();
+    std::vector<UInt32>& folders = _Folders.Storage();
+
+    nameOffsets.resize(_Count);
+    flags.resize(_Count);
+    sizes.resize(_Count);
+    packSizes.resize(_Count);
+    crcs.resize(_Count);
+    attributes.resize(_Count);
+    mtimes.resize(_Count);
+    ctimes.resize(_Count);
+    folders.resize(_Count);
+
+    // Packed and unpacked size per folder, for the compressed size estimate,
+    // and which folders are encrypted
+    std::vector<UINT64> folderPack(db.db.NumFolders, 0);
+    std::vector<UINT64> folderUnpack(db.db.NumFolders, 0);
+    std::vector<bool> folderEncrypted(db.db.NumFolders, false);
+    for (UInt32 f = 0; f < db.db.NumFolders; f++) {
+        UInt32 packStreamStart = db.db.FoStartPackStreamIndex[f];
+        UInt32 packStreamEnd = db.db.FoStartPackStreamIndex[f + 1];
+        if (packStreamStart < packStreamEnd && packStreamEnd <= db.db.NumPackStreams)
+            folderPack[f] = db.db.PackPositions[packStreamEnd] - db.db.PackPositions[packStreamStart];
+        folderUnpack[f] = SzAr_GetFolderUnpackSize(&db.db, f);
+        folderEncrypted[f] = FolderDecoder::IsEncrypted(db, f);
+    }
+
+    for (UINT32 i = 0; i < _Count; i++) {
+        std::wstring_view path = GetPath(i);
+        size_t slash = path.find_last_of(L"\\/");
+        nameOffsets[i] = (slash == std::wstring_view::npos) ? 0 : (UINT32)(slash + 1);
+
+        bool isDir = SzArEx_IsDir(&db, i) != 0;
+        flags[i] = isDir ? FLAG_DIRECTORY : 0;
+
+        sizes[i] = SzArEx_GetFileSize(&db, i);
+        crcs[i] = SzBitWithVals_Check(&db.CRCs, i) ? db.CRCs.Vals[i] : 0;
+        attributes[i] = SzBitWithVals_Check(&db.Attribs, i) ? db.Attribs.Vals[i] : 0;
+        mtimes[i] = SzBitWithVals_Check(&db.MTime, i)
+            ? ((UINT64)db.MTime.Vals[i].High << 32) | db.MTime.Vals[i].Low : 0;
+        ctimes[i] = SzBitWithVals_Check(&db.CTime, i)
+            ? ((UINT64)db.CTime.Vals[i].High << 32) | db.CTime.Vals[i].Low : 0;
+
+        UInt32 folder = db.FileToFolder ? db.FileToFolder[i] : (UInt32)-1;
+        folders[i] = folder;
+
+        // Compressed size is an estimate for solid archives: the file's
+        // share of its folder's packed size
+        packSizes[i] = 0;
+        if (!isDir && folder != (UInt32)-1 && folder < db.db.NumFolders && folderUnpack[folder] > 0)
+            packSizes[i] = (UINT64)((double)sizes[i] * folderPack[folder] / folderUnpack[folder]);
+
+        if (folder != (UInt32)-1 && folder < db.db.NumFolders && folderEncrypted[folder]) {
+            flags[i] |= FLAG_ENCRYPTED;
+            _EncryptedCount++;
+        }
+
+        if (isDir) {
+            _FolderCount++;
+        } else {
+            _FileCount++;
+        }
+        _TotalSize += sizes[i];
+    }
+
+    if (db.db.PackPositions) {
+        for (UInt32 i = 0; i < db.db.NumPackStreams; i++)
+            _TotalPackSize += db.db.PackPositions[i + 1] - db.db.PackPositions[i];
+    }
+}
+
+bool EntryTable::GetEntry(UINT32 index, ArchiveEntry& entry) const {
+    if (index >= _Count) return false;
+
+    entry.FullPath.assign(GetPath(index));
+    entry.Name.assign(GetName(index));
+    entry.Type = IsDirectory(index) ? ItemType::Folder : ItemType::File;
+    entry.IsEncrypted = IsEncrypted(index);
+    entry.Size = _Sizes[index];
+    entry.CompressedSize = _PackSizes[index];
+    entry.CRC = _CRCs[index];
+    entry.Attributes = _Attributes[index];
+    entry.ModifiedTime = GetModifiedTime(index);
+    entry.CreatedTime = GetCreatedTime(index);
+    entry.ArchiveIndex = index;
+    return true;
+}
+
+void EntryTable::Save(IndexWriter& writer) const {
+    writer.WriteValue(_Count);
+    writer.WriteValue(_FileCount);
+    writer.WriteValue(_FolderCount);
+    writer.WriteValue(_EncryptedCount);
+    writer.WriteValue(_TotalSize);
+    writer.WriteValue(_TotalPackSize);
+
+    writer.WriteArray(_Arena, _PathOffsets[_Count]);
+    writer.WriteArray(_PathOffsets, (size_t)_Count + 1);
+    writer.WriteArray(_NameOffsets);
+    writer.WriteArray(_Flags);
+    writer.WriteArray(_Sizes);
+    writer.WriteArray(_PackSizes);
+    writer.WriteArray(_CRCs);
+    writer.WriteArray(_Attributes);
+    writer.WriteArray(_MTimes);
+    writer.WriteArray(_CTimes);
+    writer.WriteArray(_Folders);
+}
+
+bool EntryTable::Load(IndexReader& reader) {
+    Clear();
+
+    UINT32 count = 0;
+    if (!reader.ReadValue(count) ||
+        !reader.ReadValue(_FileCount) ||
+        !reader.ReadValue(_FolderCount) ||
+        !reader.ReadValue(_EncryptedCount) ||
+        !reader.ReadValue(_TotalSize) ||
+        !reader.ReadValue(_TotalPackSize)) {
+        Clear();
+        return false;
+    }
+
+    const wchar_t* arena = nullptr;
+    const size_t* offsets = nullptr;
+    size_t arenaLength = 0;
+    size_t offsetCount = 0;
+    bool ok = reader.ReadArray(arena, arenaLength) &&
+        reader.ReadArray(offsets, offsetCount, (size_t)count + 1) &&
+        reader.ReadArray(_NameOffsets, count) &&
+        reader.ReadArray(_Flags, count) &&
+        reader.ReadArray(_Sizes, count) &&
+        reader.ReadArray(_PackSizes, count) &&
+        reader.ReadArray(_CRCs, count) &&
+        reader.ReadArray(_Attributes, count) &&
+        reader.ReadArray(_MTimes, count) &&
+        reader.ReadArray(_CTimes, count) &&
+        reader.ReadArray(_Folders, count);
+
+    // Paths must stay inside the arena
+    if (ok && (offsets[0] != 0 || offsets[count] != arenaLength))
+        ok = false;
+    for (UINT32 i = 0; ok && i < count; i++) {
+        if (offsets[i + 1] <= offsets[i]) ok = false;
+    }
+
+    if (!ok) {
+        Clear();
+        return false;
+    }
+
+    _Count = count;
+    _Arena = arena;
+    _PathOffsets = offsets;
+    return true;
+}
+
+size_t EntryTable::GetMemoryUsage() const {
+    return _NameOffsets.GetMemoryUsage() +
+        _Flags.GetMemoryUsage() +
+        _Sizes.GetMemoryUsage() +
+        _PackSizes.GetMemoryUsage() +
+        _CRCs.GetMemoryUsage() +
+        _Attributes.GetMemoryUsage() +
+        _MTimes.GetMemoryUsage() +
+        _CTimes.GetMemoryUsage() +
+        _Folders.GetMemoryUsage();
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,85 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Solid-Block Aware Extraction Planner Implementation
+*/
+
+#include "ExtractPlan.h"
+#include "FolderDecoder.h"
+
+namespace SevenZipView {
+
+ExtractPlan::ExtractPlan() {
+}
+
+void ExtractPlan::Clear() {
+    _Folders.clear();
+    _EmptyFiles.clear();
+    _Stats = ExtractPlanStats();
+}
+
+bool ExtractPlan::CanDecodePrefix(const CSzArEx& db, UInt32 folder) {
+    return FolderDecoder::CanStream(db, folder);
+}
+
+void ExtractPlan::Build(const CSzArEx& db, const std::vector<UINT32>& indices) {
+    Clear();
+
+    std::vector<UINT32> sorted;
+    sorted.reserve(indices.size());
+    for (UINT32 idx : indices) {
+        if (idx < db.NumFiles && !SzArEx_IsDir(&db, idx))
+            sorted.push_back(idx);
+    }
+
+    // Folder first, then position inside the folder's unpacked stream.
+    // Empty files between a folder's streams share the next file's
+    // position; archive order keeps them ahead of it, as a decoder that
+    // had to step back would restart the folder.
+    std::sort(sorted.begin(), sorted.end(), [&db](UINT32 a, UINT32 b) {
+        UInt32 folderA = db.FileToFolder[a];
+        UInt32 folderB = db.FileToFolder[b];
+        if (folderA != folderB) return folderA < folderB;
+        if (db.UnpackPositions[a] != db.UnpackPositions[b])
+            return db.UnpackPositions[a] < db.UnpackPositions[b];
+        return a < b;
+    });
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    for (UINT32 idx : sorted) {
+        UInt32 folder = db.FileToFolder[idx];
+        if (folder == (UInt32)-1) {
+            _EmptyFiles.push_back(idx);
+            continue;
+        }
+
+        if (_Folders.empty() || _Folders.back().Folder != folder) {
+            FolderPlan plan;
+            plan.Folder = folder;
+            plan.UnpackSize = SzAr_GetFolderUnpackSize(&db.db, folder);
+            plan.CanStopEarly = CanDecodePrefix(db, folder);
+            _Folders.push_back(std::move(plan));
+        }
+
+        FolderPlan& plan = _Folders.back();
+        UINT64 folderStart = db.UnpackPositions[db.FolderToFile[folder]];
+
+        PlannedEntry entry;
+        entry.ArchiveIndex = idx;
+        entry.Offset = db.UnpackPositions[idx] - folderStart;
+        entry.Size = db.UnpackPositions[(size_t)idx + 1] - db.UnpackPositions[idx];
+        plan.Entries.push_back(entry);
+
+        plan.DecodeLimit = (std::max)(plan.DecodeLimit, entry.Offset + entry.Size);
+        _Stats.BytesNeeded += entry.Size;
+    }
+
+    _Stats.FilesPlanned = (UINT32)(sorted.size());
+    _Stats.BlocksTouched = (UINT32)_Folders.size();
+    for (const auto& plan : _Folders)
+        _Stats.BytesDecoded += plan.GetBytesToDecode();
+
+    SEVENZIPVIEW_LOG(L"ExtractPlan: %u files in %u blocks, %llu bytes needed, %llu bytes decoded",
+        _Stats.FilesPlanned, _Stats.BlocksTouched, _Stats.BytesNeeded, _Stats.BytesDecoded);
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,110 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Chunked Extraction Sinks Implementation
+*/
+
+#include "ExtractSink.h"
+#include "Archive.h"
+
+namespace SevenZipView {
+
+//==============================================================================
+// MemorySink
+//==============================================================================
+
+bool MemorySink::OnBegin(UINT32 index, UINT64 size) {
+    (void)index;
+    _Buffer.clear();
+    _Buffer.reserve((size_t)size);
+    return true;
+}
+
+bool MemorySink::OnChunk(const BYTE* data, size_t size) {
+    _Buffer.insert(_Buffer.end(), data, data + size);
+    return true;
+}
+
+//==============================================================================
+// FileSink
+//==============================================================================
+
+FileSink::FileSink(const Archive& archive, const std::wstring& destPath)
+    : _Archive(archive)
+    , _Path(destPath)
+    , _Index(0)
+    , _File(INVALID_HANDLE_VALUE)
+    , _WriteOk(false) {
+}
+
+FileSink::~FileSink() {
+    // Extraction stopped inside an entry
+    if (_File != INVALID_HANDLE_VALUE)
+        _Archive.FinishEntryFile(_Index, _Path, _File, false);
+}
+
+bool FileSink::OnBegin(UINT32 index, UINT64 size) {
+    if (_File != INVALID_HANDLE_VALUE)
+        _Archive.FinishEntryFile(_Index, _Path, _File, false);
+
+    _Index = index;
+    _File = _Archive.CreateEntryFile(_Path, size);
+    _WriteOk = (_File != INVALID_HANDLE_VALUE);
+    return _WriteOk;
+}
+
+bool FileSink::OnChunk(const BYTE* data, size_t size) {
+    // A failed write stops a single-file extraction; a wrapper that keeps
+    // going only gets the entry marked as failed in OnEnd
+    if (!_WriteOk) return false;
+
+    DWORD written = 0;
+    _WriteOk = WriteFile(_File, data, (DWORD)size, &written, nullptr) && written == size;
+    return _WriteOk;
+}
+
+bool FileSink::OnEnd(bool ok) {
+    if (_File == INVALID_HANDLE_VALUE) return false;
+
+    HANDLE hFile = _File;
+    _File = INVALID_HANDLE_VALUE;
+    return _Archive.FinishEntryFile(_Index, _Path, hFile, ok && _WriteOk);
+}
+
+//==============================================================================
+// HashSink
+//==============================================================================
+
+bool HashSink::OnBegin(UINT32 index, UINT64 size) {
+    (void)index;
+    (void)size;
+    _Crc = CRC_INIT_VAL;
+    _Size = 0;
+    return true;
+}
+
+bool HashSink::OnChunk(const BYTE* data, size_t size) {
+    _Crc = CrcUpdate(_Crc, data, size);
+    _Size += size;
+    return true;
+}
+
+//==============================================================================
+// TeeSink
+//==============================================================================
+
+bool TeeSink::OnBegin(UINT32 index, UINT64 size) {
+    return _First.OnBegin(index, size) && _Second.OnBegin(index, size);
+}
+
+bool TeeSink::OnChunk(const BYTE* data, size_t size) {
+    return _First.OnChunk(data, size) && _Second.OnChunk(data, size);
+}
+
+bool TeeSink::OnEnd(bool ok) {
+    // Both sinks finish the entry, whatever the first one reports
+    bool first = _First.OnEnd(ok);
+    bool second = _Second.OnEnd(ok);
+    return first && second;
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,238 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Pipelined File Writer Implementation
+*/
+
+#include "FileWriter.h"
+#include "Archive.h"
+#include <chrono>
+
+namespace SevenZipView {
+
+//==============================================================================
+// FileWriter
+//==============================================================================
+
+FileWriter::FileWriter(const Archive& archive, DoneFunc onDone, UINT32 threads, size_t maxQueued)
+    : _Archive(archive)
+    , _OnDone(std::move(onDone))
+    , _MaxQueued(maxQueued)
+    , _QueuedBytes(0)
+    , _InFlight(0)
+    , _Stopping(false)
+    , _FreeBytes(0) {
+    // File creation is mostly kernel time; more writers than cores only
+    // contend for the same directories
+    if (threads == 0) {
+        threads = (std::min)(FILE_WRITER_DEFAULT_THREADS, (UINT32)std::thread::hardware_concurrency());
+        threads = (std::max)(threads, (UINT32)1);
+    }
+    _Threads.reserve(threads);
+    for (UINT32 i = 0; i < threads; i++)
+        _Threads.emplace_back([this]() { WriterLoop(); });
+}
+
+FileWriter::~FileWriter() {
+    Finish();
+}
+
+std::vector<BYTE> FileWriter::AcquireBuffer(size_t size) {
+    std::vector<BYTE> buffer;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (!_FreeBuffers.empty()) {
+            buffer = std::move(_FreeBuffers.back());
+            _FreeBuffers.pop_back();
+            _FreeBytes -= buffer.capacity();
+        }
+    }
+    buffer.clear();
+    buffer.reserve(size);
+    return buffer;
+}
+
+void FileWriter::Recycle(std::vector<BYTE>&& buffer) {
+    // Keep no more spare capacity than the queue itself may hold
+    std::lock_guard<std::mutex> lock(_Mutex);
+    if (_FreeBytes + buffer.capacity() > _MaxQueued) return;
+    _FreeBytes += buffer.capacity();
+    _FreeBuffers.push_back(std::move(buffer));
+}
+
+void FileWriter::Submit(UINT32 index, const std::wstring& destPath, std::vector<BYTE>&& data) {
+    size_t size = data.size();
+
+    std::unique_lock<std::mutex> lock(_Mutex);
+    // A file larger than the whole queue still goes through once it is empty
+    auto hasRoom = [&]() {
+        return _Stopping || _Queue.empty() ||
+            (_QueuedBytes + size <= _MaxQueued && _Queue.size() < FILE_WRITER_MAX_QUEUED_FILES);
+    };
+    if (!hasRoom()) {
+        auto start = std::chrono::steady_clock::now();
+        _HasRoom.wait(lock, hasRoom);
+        _Stats.Stalls++;
+        _Stats.StallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    _QueuedBytes += size;
+    _Queue.push_back(Job{ index, destPath, std::move(data) });
+    lock.unlock();
+    _HasWork.notify_one();
+}
+
+void FileWriter::Report(UINT32 index, bool ok, UINT64 bytes) {
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (ok) {
+            _Stats.FilesWritten++;
+            _Stats.BytesWritten += bytes;
+        } else {
+            _Stats.FilesFailed++;
+        }
+    }
+    if (_OnDone) _OnDone(index, ok);
+}
+
+bool FileWriter::IsIdle() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Queue.empty() && _InFlight == 0;
+}
+
+void FileWriter::Cancel() {
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        dropped.swap(_Queue);
+        for (const auto& job : dropped)
+            _QueuedBytes -= job.Data.size();
+    }
+    _HasRoom.notify_all();
+
+    for (const auto& job : dropped)
+        Report(job.Index, false, 0);
+}
+
+void FileWriter::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        _Stopping = true;
+    }
+    _HasWork.notify_all();
+    _HasRoom.notify_all();
+
+    for (auto& thread : _Threads)
+        thread.join();
+    _Threads.clear();
+}
+
+FileWriterStats FileWriter::GetStats() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Stats;
+}
+
+void FileWriter::WriterLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(_Mutex);
+            _HasWork.wait(lock, [this]() { return _Stopping || !_Queue.empty(); });
+            // Stopping still drains the queue
+            if (_Queue.empty()) return;
+
+            job = std::move(_Queue.front());
+            _Queue.pop_front();
+            _InFlight++;
+        }
+
+        size_t size = job.Data.size();
+        bool ok = Write(job);
+        Recycle(std::move(job.Data));
+
+        {
+            std::lock_guard<std::mutex> lock(_Mutex);
+            _QueuedBytes -= size;
+            _InFlight--;
+        }
+        _HasRoom.notify_all();
+
+        Report(job.Index, ok, size);
+    }
+}
+
+bool FileWriter::Write(Job& job) {
+    HANDLE hFile = _Archive.CreateEntryFile(job.Path, job.Data.size());
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    // Queued files are at most FILE_WRITER_DIRECT_LIMIT bytes, so one write
+    // unless a caller submitted a larger one
+    bool ok = true;
+    const BYTE* data = job.Data.data();
+    size_t remaining = job.Data.size();
+    while (ok && remaining > 0) {
+        DWORD chunk = (DWORD)(std::min)(remaining, (size_t)FILE_WRITER_DIRECT_LIMIT);
+        DWORD written = 0;
+        ok = WriteFile(hFile, data, chunk, &written, nullptr) && written == chunk;
+        data += chunk;
+        remaining -= chunk;
+    }
+
+    return _Archive.FinishEntryFile(job.Index, job.Path, hFile, ok);
+}
+
+//==============================================================================
+// WriterSink
+//==============================================================================
+
+WriterSink::WriterSink(FileWriter& writer)
+    : _Writer(writer)
+    , _Direct(writer.GetArchive())
+    , _Index(0)
+    , _Size(0)
+    , _IsDirect(false) {
+}
+
+bool WriterSink::OnBegin(UINT32 index, UINT64 size) {
+    _Index = index;
+    _Size = size;
+    _IsDirect = size > FILE_WRITER_DIRECT_LIMIT;
+    if (_IsDirect) {
+        // A target that cannot be created fails in OnEnd, like a queued one
+        _Direct.SetPath(_Path);
+        _Direct.OnBegin(index, size);
+        return true;
+    }
+
+    _Buffer = _Writer.AcquireBuffer((size_t)size);
+    return true;
+}
+
+bool WriterSink::OnChunk(const BYTE* data, size_t size) {
+    if (_IsDirect) {
+        _Direct.OnChunk(data, size);
+        return true;
+    }
+
+    _Buffer.insert(_Buffer.end(), data, data + size);
+    return true;
+}
+
+bool WriterSink::OnEnd(bool ok) {
+    if (_IsDirect) {
+        bool done = _Direct.OnEnd(ok);
+        _Writer.Report(_Index, done, _Size);
+        return done;
+    }
+
+    if (!ok) {
+        _Buffer.clear();
+        _Writer.Report(_Index, false, 0);
+        return false;
+    }
+
+    _Writer.Submit(_Index, _Path, std::move(_Buffer));
+    _Buffer = std::vector<BYTE>();
+    return true;
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,754 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Bounded-Memory Streaming Folder Decoder Implementation
+*/
+
+#include "FolderDecoder.h"
+
+extern "C" {
+#include "Bra.h"
+#include "Delta.h"
+}
+
+namespace SevenZipView {
+
+// 7z coder method IDs (see 7zDec.c)
+static const UInt32 METHOD_COPY  = 0;
+static const UInt32 METHOD_DELTA = 3;
+static const UInt32 METHOD_ARM64 = 0xa;
+static const UInt32 METHOD_RISCV = 0xb;
+static const UInt32 METHOD_LZMA2 = 0x21;
+static const UInt32 METHOD_LZMA  = 0x30101;
+static const UInt32 METHOD_BCJ   = 0x3030103;
+static const UInt32 METHOD_BCJ2  = 0x303011B;
+static const UInt32 METHOD_PPC   = 0x3030205;
+static const UInt32 METHOD_IA64  = 0x3030401;
+static const UInt32 METHOD_ARM   = 0x3030501;
+static const UInt32 METHOD_ARMT  = 0x3030701;
+static const UInt32 METHOD_SPARC = 0x3030805;
+
+// Input look-ahead per decoder step, same as the SDK decoders
+static const size_t DECODE_LOOKAHEAD = (1 << 18);
+
+// Smallest output of one decoder step; reads asking for less (a preview
+// prefix) still stop well short of a full window
+static const size_t DECODE_MIN_STEP = (1 << 16);
+
+// Smallest dictionary buffer the LZMA decoder is given
+static const size_t MIN_DICTIONARY = (1 << 12);
+
+// Ciphertext decrypted per step of an encrypted folder, a multiple of the
+// AES block; the buffer also holds the AES state and alignment slack
+static const size_t AES_LOOKAHEAD = DECODE_LOOKAHEAD;
+static const size_t AES_STATE_SIZE = AES_NUM_IVMRK_WORDS * sizeof(UInt32);
+static const size_t AES_BUFFER_SIZE = AES_STATE_SIZE + AES_LOOKAHEAD + AES_BLOCK_SIZE;
+
+static UInt32 ReadUi32(const Byte* p) {
+    return (UInt32)p[0] | ((UInt32)p[1] << 8) | ((UInt32)p[2] << 16) | ((UInt32)p[3] << 24);
+}
+
+// Dictionary size declared by LZMA / LZMA2 coder properties
+static SRes GetDictionarySize(UInt32 method, const Byte* props, unsigned propsSize, UINT64* dictSize) {
+    if (method == METHOD_LZMA) {
+        if (propsSize < LZMA_PROPS_SIZE) return SZ_ERROR_UNSUPPORTED;
+        *dictSize = ReadUi32(props + 1);
+        return SZ_OK;
+    }
+    if (method == METHOD_LZMA2) {
+        if (propsSize != 1 || props[0] > 40) return SZ_ERROR_UNSUPPORTED;
+        unsigned p = props[0];
+        *dictSize = (p == 40) ? 0xFFFFFFFF : ((UINT64)(2 | (p & 1)) << (p / 2 + 11));
+        return SZ_OK;
+    }
+    *dictSize = 0;
+    return SZ_OK;
+}
+
+static size_t GetDictionaryBufferSize(UINT64 dictSize, UINT64 mainSize) {
+    UINT64 size = (std::min)(dictSize, mainSize);
+    return (size_t)(std::max)(size, (UINT64)MIN_DICTIONARY);
+}
+
+FolderDecoder::FolderDecoder(const CSzArEx& db, ILookInStreamPtr stream, ISzAllocPtr alloc, AesKeyCache* keys)
+    : _Db(db)
+    , _Stream(stream)
+    , _Alloc(alloc)
+    , _Keys(keys)
+    , _WindowSize(FOLDER_DECODER_DEFAULT_WINDOW)
+    , _IsOpen(false)
+    , _Folder((UInt32)-1)
+    , _Position(0)
+    , _UnpackSize(0)
+    , _Crc(CRC_INIT_VAL)
+    , _CrcValid(false)
+    , _Coder(Coder::Copy)
+    , _Props(nullptr)
+    , _PropsSize(0)
+    , _PackPos(0)
+    , _PackSize(0)
+    , _InputSize(0)
+    , _PackRemaining(0)
+    , _MainSize(0)
+    , _MainDecoded(0)
+    , _PendingSkip(0)
+    , _Dic(nullptr)
+    , _DicSize(0)
+    , _DicEmitPos(0)
+    , _Encrypted(false)
+    , _Aes()
+    , _AesBuffer(nullptr)
+    , _AesState(nullptr)
+    , _Plain(nullptr)
+    , _PlainPos(0)
+    , _PlainFill(0)
+    , _PlainLeft(0)
+    , _CipherLeft(0)
+    , _Whole(nullptr)
+    , _Filter(Filter::None)
+    , _FilterStartPc(0)
+    , _FilterPc(0)
+    , _X86State(Z7_BRANCH_CONV_ST_X86_STATE_INIT_VAL)
+    , _Delta(0)
+    , _Window(nullptr)
+    , _WindowFill(0)
+    , _WindowReady(0)
+    , _WindowEmitted(0) {
+
+    LzmaDec_CONSTRUCT(&_Lzma)
+    Lzma2Dec_CONSTRUCT(&_Lzma2)
+}
+
+FolderDecoder::~FolderDecoder() {
+    Close();
+}
+
+void FolderDecoder::SetWindowSize(size_t size) {
+    _WindowSize = (std::max)(size, FOLDER_DECODER_MIN_WINDOW);
+}
+
+bool FolderDecoder::CanStream(const CSzArEx& db, UInt32 folder) {
+    FolderDecoder probe(db, nullptr, nullptr);
+    return probe.ParseFolder(folder) == SZ_OK && probe._Coder != Coder::Whole;
+}
+
+bool FolderDecoder::IsEncrypted(const CSzArEx& db, UInt32 folder) {
+    if (folder >= db.db.NumFolders) return false;
+
+    CSzFolder f;
+    CSzData sd;
+    sd.Data = db.db.CodersData + db.db.FoCodersOffsets[folder];
+    sd.Size = db.db.FoCodersOffsets[(size_t)folder + 1] - db.db.FoCodersOffsets[folder];
+    if (SzGetNextFolderItem(&f, &sd) != SZ_OK) return false;
+
+    for (UInt32 i = 0; i < f.NumCoders; i++) {
+        if (f.Coders[i].MethodID == METHOD_7Z_AES) return true;
+    }
+    return false;
+}
+
+UINT64 FolderDecoder::EstimateMemory(const CSzArEx& db, UInt32 folder, size_t windowSize) {
+    FolderDecoder probe(db, nullptr, nullptr);
+    if (probe.ParseFolder(folder) != SZ_OK || probe._Coder == Coder::Whole)
+        return SzAr_GetFolderUnpackSize(&db.db, folder);
+
+    UINT64 total = 0;
+    if (probe._Coder != Coder::Copy) {
+        UINT64 dictSize = 0;
+        GetDictionarySize(probe._Coder == Coder::Lzma ? METHOD_LZMA : METHOD_LZMA2,
+            probe._Props, probe._PropsSize, &dictSize);
+        total += GetDictionaryBufferSize(dictSize, probe._MainSize);
+    }
+    if (probe._Filter != Filter::None)
+        total += (std::max)(windowSize, FOLDER_DECODER_MIN_WINDOW);
+    if (probe._Encrypted)
+        total += AES_BUFFER_SIZE;
+    return total;
+}
+
+SRes FolderDecoder::ParseFolder(UInt32 folder) {
+    if (folder >= _Db.db.NumFolders) return SZ_ERROR_PARAM;
+
+    CSzFolder f;
+    CSzData sd;
+    const Byte* coderData = _Db.db.CodersData + _Db.db.FoCodersOffsets[folder];
+    sd.Data = coderData;
+    sd.Size = _Db.db.FoCodersOffsets[(size_t)folder + 1] - _Db.db.FoCodersOffsets[folder];
+    RINOK(SzGetNextFolderItem(&f, &sd))
+    if (sd.Size != 0) return SZ_ERROR_UNSUPPORTED;
+
+    _UnpackSize = SzAr_GetFolderUnpackSize(&_Db.db, folder);
+    _Filter = Filter::None;
+    _Encrypted = false;
+
+    // BCJ2 needs all four streams at once; leave it to the SDK
+    if (f.NumCoders == 4 && f.Coders[3].MethodID == METHOD_BCJ2) {
+        _Coder = Coder::Whole;
+        return SZ_OK;
+    }
+
+    if (f.NumCoders < 1 || f.NumCoders > 3 || f.NumPackStreams != 1)
+        return SZ_ERROR_UNSUPPORTED;
+
+    // The coders must form one chain from the pack stream to the output:
+    // 7zAES if encrypted, the main coder, at most one filter. Each has a
+    // single input, so its input stream index is its coder index.
+    UInt32 chain[3];
+    UInt32 length = 0;
+    UInt32 coder = f.PackStreams[0];
+    for (;;) {
+        if (coder >= f.NumCoders || f.Coders[coder].NumStreams != 1 || length == f.NumCoders)
+            return SZ_ERROR_UNSUPPORTED;
+        chain[length++] = coder;
+
+        UInt32 bond = 0;
+        while (bond < f.NumBonds && f.Bonds[bond].OutIndex != coder) bond++;
+        if (bond == f.NumBonds) break;
+        coder = f.Bonds[bond].InIndex;
+    }
+    if (length != f.NumCoders) return SZ_ERROR_UNSUPPORTED;
+
+    const UInt64* unpackSizes = &_Db.db.CoderUnpackSizes[_Db.db.FoToCoderUnpackSizes[folder]];
+    UInt32 packIndex = _Db.db.FoStartPackStreamIndex[folder];
+    _PackPos = _Db.dataPos + _Db.db.PackPositions[packIndex];
+    _PackSize = _Db.db.PackPositions[packIndex + 1] - _Db.db.PackPositions[packIndex];
+    _InputSize = _PackSize;
+
+    UInt32 next = 0;
+    const CSzCoderInfo& first = f.Coders[chain[0]];
+    _Encrypted = (first.MethodID == METHOD_7Z_AES);
+    if (_Encrypted) {
+        RINOK(AesCoderProps::Parse(coderData + first.PropsOffset, first.PropsSize, _Aes))
+
+        // CBC works on whole blocks; the padding of the last is not output
+        _InputSize = unpackSizes[chain[0]];
+        if (_PackSize % AES_BLOCK_SIZE != 0 || _InputSize > _PackSize) return SZ_ERROR_DATA;
+        if (++next == length) return SZ_ERROR_UNSUPPORTED;
+    }
+
+    const CSzCoderInfo& main = f.Coders[chain[next]];
+    switch (main.MethodID) {
+    case METHOD_COPY:  _Coder = Coder::Copy; break;
+    case METHOD_LZMA:  _Coder = Coder::Lzma; break;
+    case METHOD_LZMA2: _Coder = Coder::Lzma2; break;
+    default:
+        return SZ_ERROR_UNSUPPORTED;
+    }
+
+    _Props = coderData + main.PropsOffset;
+    _PropsSize = main.PropsSize;
+    _MainSize = unpackSizes[chain[next]];
+
+    if (_Coder == Coder::Copy && _InputSize != _MainSize) return SZ_ERROR_DATA;
+
+    if (++next == length) return SZ_OK;
+
+    // The main coder feeds a single filter
+    if (next + 1 != length) return SZ_ERROR_UNSUPPORTED;
+    const CSzCoderInfo& filter = f.Coders[chain[next]];
+    const Byte* filterProps = coderData + filter.PropsOffset;
+    _FilterStartPc = 0;
+
+    switch (filter.MethodID) {
+    case METHOD_DELTA:
+        if (filter.PropsSize != 1) return SZ_ERROR_UNSUPPORTED;
+        _Filter = Filter::Delta;
+        _Delta = (unsigned)filterProps[0] + 1;
+        return SZ_OK;
+    case METHOD_ARM64:
+    case METHOD_RISCV:
+        if (filter.PropsSize == 4) {
+            _FilterStartPc = ReadUi32(filterProps);
+            if (_FilterStartPc & (filter.MethodID == METHOD_ARM64 ? 3 : 1)) return SZ_ERROR_UNSUPPORTED;
+        } else if (filter.PropsSize != 0) {
+            return SZ_ERROR_UNSUPPORTED;
+        }
+        _Filter = (filter.MethodID == METHOD_ARM64) ? Filter::ARM64 : Filter::RISCV;
+        return SZ_OK;
+    case METHOD_BCJ:   _Filter = Filter::X86; break;
+    case METHOD_PPC:   _Filter = Filter::PPC; break;
+    case METHOD_IA64:  _Filter = Filter::IA64; break;
+    case METHOD_ARM:   _Filter = Filter::ARM; break;
+    case METHOD_ARMT:  _Filter = Filter::ARMT; break;
+    case METHOD_SPARC: _Filter = Filter::SPARC; break;
+    default:
+        return SZ_ERROR_UNSUPPORTED;
+    }
+
+    return filter.PropsSize == 0 ? SZ_OK : SZ_ERROR_UNSUPPORTED;
+}
+
+SRes FolderDecoder::Open(UInt32 folder) {
+    Close();
+
+    RINOK(ParseFolder(folder))
+
+    _Folder = folder;
+    _Position = 0;
+    _Crc = CRC_INIT_VAL;
+    _CrcValid = true;
+
+    SRes res = SZ_OK;
+    if (_Coder == Coder::Whole) {
+        size_t size = (size_t)_UnpackSize;
+        if (size != _UnpackSize) return SZ_ERROR_MEM;
+        if (size != 0) {
+            _Whole = (Byte*)ISzAlloc_Alloc(_Alloc, size);
+            if (!_Whole) return SZ_ERROR_MEM;
+        }
+        // The SDK checks the folder CRC itself
+        res = SzAr_DecodeFolder(&_Db.db, folder, _Stream, _Db.dataPos, _Whole, size, _Alloc);
+        _CrcValid = false;
+    } else {
+        if (_Encrypted) res = OpenDecryption();
+        if (res == SZ_OK) res = OpenMain();
+        if (res == SZ_OK && _Filter != Filter::None && !_Window) {
+            _Window = (Byte*)ISzAlloc_Alloc(_Alloc, _WindowSize);
+            if (!_Window) res = SZ_ERROR_MEM;
+        }
+    }
+
+    if (res != SZ_OK) {
+        FreeBuffers();
+        return res;
+    }
+
+    _IsOpen = true;
+    return SZ_OK;
+}
+
+SRes FolderDecoder::OpenDecryption() {
+    if (!_Keys) return SZ_ERROR_PARAM;
+
+    if (!_AesBuffer) {
+        _AesBuffer = (Byte*)ISzAlloc_Alloc(_Alloc, AES_BUFFER_SIZE);
+        if (!_AesBuffer) return SZ_ERROR_MEM;
+        // The AES code wants its state and data 16-byte aligned
+        Byte* aligned = _AesBuffer + ((AES_BLOCK_SIZE - (size_t)_AesBuffer % AES_BLOCK_SIZE) % AES_BLOCK_SIZE);
+        _AesState = (UInt32*)aligned;
+        _Plain = aligned + AES_STATE_SIZE;
+    }
+
+    // One derivation per archive and salt; every other folder hits the cache
+    Byte key[AES_KEY_SIZE];
+    RINOK(_Keys->GetKey(_Aes, key))
+    Aes_SetKey_Dec(_AesState + 4, key, AES_KEY_SIZE);
+    memset(key, 0, sizeof(key));
+    return SZ_OK;
+}
+
+SRes FolderDecoder::OpenMain() {
+    _PackRemaining = _InputSize;
+    _MainDecoded = 0;
+    _PendingSkip = 0;
+    _DicEmitPos = 0;
+
+    _FilterPc = _FilterStartPc;
+    _X86State = Z7_BRANCH_CONV_ST_X86_STATE_INIT_VAL;
+    Delta_Init(_DeltaState);
+    _WindowFill = 0;
+    _WindowReady = 0;
+    _WindowEmitted = 0;
+
+    RINOK(LookInStream_SeekTo(_Stream, _PackPos))
+
+    if (_Encrypted) {
+        AesCbc_Init(_AesState, _Aes.Iv);
+        _PlainPos = 0;
+        _PlainFill = 0;
+        _PlainLeft = _InputSize;
+        _CipherLeft = _PackSize;
+    }
+
+    if (_Coder == Coder::Copy) return SZ_OK;
+
+    UINT64 dictSize = 0;
+    RINOK(GetDictionarySize(_Coder == Coder::Lzma ? METHOD_LZMA : METHOD_LZMA2, _Props, _PropsSize, &dictSize))
+
+    size_t dicSize = GetDictionaryBufferSize(dictSize, _MainSize);
+    if (_Dic && _DicSize != dicSize) {
+        ISzAlloc_Free(_Alloc, _Dic);
+        _Dic = nullptr;
+    }
+    if (!_Dic) {
+        _Dic = (Byte*)ISzAlloc_Alloc(_Alloc, dicSize);
+        if (!_Dic) return SZ_ERROR_MEM;
+        _DicSize = dicSize;
+    }
+
+    if (_Coder == Coder::Lzma) {
+        RINOK(LzmaDec_AllocateProbs(&_Lzma, _Props, _PropsSize, _Alloc))
+        _Lzma.dic = _Dic;
+        _Lzma.dicBufSize = _DicSize;
+        LzmaDec_Init(&_Lzma);
+    } else {
+        RINOK(Lzma2Dec_AllocateProbs(&_Lzma2, _Props[0], _Alloc))
+        _Lzma2.decoder.dic = _Dic;
+        _Lzma2.decoder.dicBufSize = _DicSize;
+        Lzma2Dec_Init(&_Lzma2);
+    }
+
+    return SZ_OK;
+}
+
+void FolderDecoder::FreeBuffers() {
+    if (!_Alloc) return;
+
+    LzmaDec_FreeProbs(&_Lzma, _Alloc);
+    Lzma2Dec_FreeProbs(&_Lzma2, _Alloc);
+
+    if (_Dic) {
+        ISzAlloc_Free(_Alloc, _Dic);
+        _Dic = nullptr;
+        _DicSize = 0;
+    }
+    if (_Whole) {
+        ISzAlloc_Free(_Alloc, _Whole);
+        _Whole = nullptr;
+    }
+    if (_Window) {
+        ISzAlloc_Free(_Alloc, _Window);
+        _Window = nullptr;
+    }
+    if (_AesBuffer) {
+        // Round keys go with the buffer back to the pool; clear them first
+        memset(_AesState, 0, AES_STATE_SIZE);
+        ISzAlloc_Free(_Alloc, _AesBuffer);
+        _AesBuffer = nullptr;
+        _AesState = nullptr;
+        _Plain = nullptr;
+    }
+}
+
+void FolderDecoder::Close() {
+    FreeBuffers();
+    _PendingSkip = 0;
+    _IsOpen = false;
+    _Folder = (UInt32)-1;
+    _Position = 0;
+    _UnpackSize = 0;
+}
+
+SRes FolderDecoder::DecodeStep(size_t maxSize) {
+    CLzmaDec* lzma = (_Coder == Coder::Lzma) ? &_Lzma : &_Lzma2.decoder;
+
+    // Wrap the dictionary once everything in it has been handed out
+    if (lzma->dicPos == _DicSize) {
+        lzma->dicPos = 0;
+        _DicEmitPos = 0;
+    }
+
+    UINT64 remaining = _MainSize - _MainDecoded;
+    size_t want = (std::min)(_DicSize - lzma->dicPos, _WindowSize);
+    if (want > (std::max)(maxSize, DECODE_MIN_STEP)) want = (std::max)(maxSize, DECODE_MIN_STEP);
+    if (want > remaining) want = (size_t)remaining;
+    SizeT dicLimit = lzma->dicPos + want;
+
+    while (lzma->dicPos < dicLimit) {
+        const void* inBuf = nullptr;
+        size_t lookahead = DECODE_LOOKAHEAD;
+        if (lookahead > _PackRemaining) lookahead = (size_t)_PackRemaining;
+        RINOK(LookInput(&inBuf, &lookahead))
+
+        SizeT inProcessed = (SizeT)lookahead;
+        SizeT dicPos = lzma->dicPos;
+        ELzmaStatus status;
+        SRes res;
+        if (_Coder == Coder::Lzma)
+            res = LzmaDec_DecodeToDic(&_Lzma, dicLimit, (const Byte*)inBuf, &inProcessed, LZMA_FINISH_ANY, &status);
+        else
+            res = Lzma2Dec_DecodeToDic(&_Lzma2, dicLimit, (const Byte*)inBuf, &inProcessed, LZMA_FINISH_ANY, &status);
+
+        _PackRemaining -= inProcessed;
+        _MainDecoded += lzma->dicPos - dicPos;
+        RINOK(res)
+        RINOK(SkipInput(inProcessed))
+
+        if (status == LZMA_STATUS_FINISHED_WITH_MARK) {
+            if (_MainDecoded != _MainSize) return SZ_ERROR_DATA;
+            break;
+        }
+
+        if (inProcessed == 0 && dicPos == lzma->dicPos) return SZ_ERROR_DATA;
+    }
+
+    return SZ_OK;
+}
+
+SRes FolderDecoder::ReadMain(const Byte** data, size_t* size, size_t maxSize) {
+    *size = 0;
+
+    if (_Coder == Coder::Copy) {
+        // Hand out the stream's look-ahead buffer directly
+        if (_PendingSkip) {
+            size_t skip = _PendingSkip;
+            _PendingSkip = 0;
+            RINOK(SkipInput(skip))
+        }
+
+        UINT64 remaining = _MainSize - _MainDecoded;
+        if (remaining == 0) return SZ_OK;
+
+        const void* inBuf = nullptr;
+        size_t curSize = (std::min)(maxSize, DECODE_LOOKAHEAD);
+        if (curSize > remaining) curSize = (size_t)remaining;
+        RINOK(LookInput(&inBuf, &curSize))
+        if (curSize == 0) return SZ_ERROR_INPUT_EOF;
+
+        *data = (const Byte*)inBuf;
+        *size = curSize;
+        _PendingSkip = curSize;
+        _MainDecoded += curSize;
+        return SZ_OK;
+    }
+
+    const CLzmaDec* lzma = (_Coder == Coder::Lzma) ? &_Lzma : &_Lzma2.decoder;
+    if (_DicEmitPos == lzma->dicPos) {
+        if (_MainDecoded == _MainSize) return SZ_OK;
+        RINOK(DecodeStep(maxSize))
+    }
+
+    size_t available = lzma->dicPos - _DicEmitPos;
+    *data = _Dic + _DicEmitPos;
+    *size = (std::min)(available, maxSize);
+    _DicEmitPos += *size;
+    return SZ_OK;
+}
+
+SRes FolderDecoder::LookInput(const void** buf, size_t* size) {
+    if (!_Encrypted) return ILookInStream_Look(_Stream, buf, size);
+
+    if (_PlainPos == _PlainFill) {
+        RINOK(Decrypt())
+    }
+    *buf = _Plain + _PlainPos;
+    *size = (std::min)(*size, _PlainFill - _PlainPos);
+    return SZ_OK;
+}
+
+SRes FolderDecoder::SkipInput(size_t size) {
+    if (!_Encrypted) return ILookInStream_Skip(_Stream, size);
+
+    if (size > _PlainFill - _PlainPos) return SZ_ERROR_PARAM;
+    _PlainPos += size;
+    return SZ_OK;
+}
+
+SRes FolderDecoder::Decrypt() {
+    _PlainPos = 0;
+    _PlainFill = 0;
+    if (_PlainLeft == 0) return SZ_OK;
+
+    // Both sizes are whole AES blocks
+    size_t want = (size_t)(std::min)((UINT64)AES_LOOKAHEAD, _CipherLeft);
+    size_t filled = 0;
+    while (filled < want) {
+        const void* inBuf = nullptr;
+        size_t size = want - filled;
+        RINOK(ILookInStream_Look(_Stream, &inBuf, &size))
+        if (size == 0) return SZ_ERROR_INPUT_EOF;
+        memcpy(_Plain + filled, inBuf, size);
+        RINOK(ILookInStream_Skip(_Stream, size))
+        filled += size;
+    }
+    _CipherLeft -= filled;
+
+    // AES-NI decrypts several CBC blocks at once (VAES two per register):
+    // unlike encryption, each block needs only the ciphertext before it
+    g_AesCbc_Decode(_AesState, _Plain, filled / AES_BLOCK_SIZE);
+
+    _PlainFill = (size_t)(std::min)((UINT64)filled, _PlainLeft);
+    _PlainLeft -= _PlainFill;
+    return SZ_OK;
+}
+
+size_t FolderDecoder::RunFilter(Byte* data, size_t size) {
+    Byte* end = data + size;
+
+    switch (_Filter) {
+    case Filter::Delta:
+        Delta_Decode(_DeltaState, _Delta, data, size);
+        return size;
+    case Filter::X86:   end = z7_BranchConvSt_X86_Dec(data, size, _FilterPc, &_X86State); break;
+    case Filter::PPC:   end = Z7_BRANCH_CONV_DEC(PPC)(data, size, _FilterPc); break;
+    case Filter::IA64:  end = Z7_BRANCH_CONV_DEC(IA64)(data, size, _FilterPc); break;
+    case Filter::ARM:   end = Z7_BRANCH_CONV_DEC(ARM)(data, size, _FilterPc); break;
+    case Filter::ARMT:  end = Z7_BRANCH_CONV_DEC(ARMT)(data, size, _FilterPc); break;
+    case Filter::SPARC: end = Z7_BRANCH_CONV_DEC(SPARC)(data, size, _FilterPc); break;
+    case Filter::ARM64: end = Z7_BRANCH_CONV_DEC(ARM64)(data, size, _FilterPc); break;
+    case Filter::RISCV: end = Z7_BRANCH_CONV_DEC(RISCV)(data, size, _FilterPc); break;
+    default:
+        return size;
+    }
+
+    size_t processed = (size_t)(end - data);
+    _FilterPc += (UInt32)processed;
+    return processed;
+}
+
+SRes FolderDecoder::Read(const Byte** data, size_t* size, size_t maxSize) {
+    *data = nullptr;
+    *size = 0;
+    if (!_IsOpen) return SZ_ERROR_FAIL;
+
+    UINT64 remaining = _UnpackSize - _Position;
+    if (remaining == 0 || maxSize == 0) return SZ_OK;
+    if (maxSize > remaining) maxSize = (size_t)remaining;
+
+    if (_Coder == Coder::Whole) {
+        *data = _Whole + _Position;
+        *size = maxSize;
+    } else if (_Filter == Filter::None) {
+        RINOK(ReadMain(data, size, maxSize))
+    } else {
+        // Filters work on a private window so the dictionary stays intact;
+        // the unconverted tail of one pass is carried into the next
+        while (_WindowEmitted == _WindowReady) {
+            size_t tail = _WindowFill - _WindowReady;
+            if (tail) memmove(_Window, _Window + _WindowReady, tail);
+            _WindowFill = tail;
+            _WindowReady = 0;
+            _WindowEmitted = 0;
+
+            bool mainDone = false;
+            while (_WindowFill < _WindowSize) {
+                const Byte* chunk = nullptr;
+                size_t chunkSize = 0;
+                RINOK(ReadMain(&chunk, &chunkSize, _WindowSize - _WindowFill))
+                if (chunkSize == 0) {
+                    mainDone = true;
+                    break;
+                }
+                memcpy(_Window + _WindowFill, chunk, chunkSize);
+                _WindowFill += chunkSize;
+            }
+
+            if (_WindowFill == 0) break;
+
+            _WindowReady = RunFilter(_Window, _WindowFill);
+            if (mainDone) _WindowReady = _WindowFill;
+        }
+
+        size_t available = _WindowReady - _WindowEmitted;
+        *data = _Window + _WindowEmitted;
+        *size = (std::min)(available, maxSize);
+        _WindowEmitted += *size;
+    }
+
+    if (*size == 0) return SZ_ERROR_INPUT_EOF;
+
+    _Position += *size;
+    if (_CrcValid) {
+        _Crc = CrcUpdate(_Crc, *data, *size);
+        if (_Position == _UnpackSize && SzBitWithVals_Check(&_Db.db.FolderCRCs, _Folder) &&
+            CRC_GET_DIGEST(_Crc) != _Db.db.FolderCRCs.Vals[_Folder]) {
+            return SZ_ERROR_CRC;
+        }
+    }
+    return SZ_OK;
+}
+
+SRes FolderDecoder::ReadInto(Byte* dest, size_t size) {
+    while (size > 0) {
+        const Byte* data = nullptr;
+        size_t got = 0;
+        RINOK(Read(&data, &got, size))
+        memcpy(dest, data, got);
+        dest += got;
+        size -= got;
+    }
+    return SZ_OK;
+}
+
+SRes FolderDecoder::Skip(UINT64 size) {
+    if (!_IsOpen) return SZ_ERROR_FAIL;
+    if (size > _UnpackSize - _Position) return SZ_ERROR_PARAM;
+
+    // Stored data and whole-folder buffers can jump directly
+    if (_Coder == Coder::Whole || (_Coder == Coder::Copy && _Filter == Filter::None && !_Encrypted)) {
+        _Position += size;
+        _CrcValid = false;
+        if (_Coder == Coder::Copy) {
+            _PendingSkip = 0;
+            _MainDecoded += size;
+            RINOK(LookInStream_SeekTo(_Stream, _PackPos + _MainDecoded))
+        }
+        return SZ_OK;
+    }
+
+    while (size > 0) {
+        const Byte* data = nullptr;
+        size_t got = 0;
+        size_t want = (size_t)(std::min)(size, (UINT64)_WindowSize);
+        RINOK(Read(&data, &got, want))
+        size -= got;
+    }
+    return SZ_OK;
+}
+
+SRes FolderDecoder::Seek(UINT64 offset) {
+    if (!_IsOpen) return SZ_ERROR_FAIL;
+    if (offset > _UnpackSize) return SZ_ERROR_PARAM;
+
+    if (offset < _Position) {
+        if (_Coder == Coder::Whole) {
+            _Position = offset;
+            return SZ_OK;
+        }
+
+        // Decoders only run forward: restart from the folder start
+        SRes res = OpenMain();
+        if (res != SZ_OK) {
+            Close();
+            return res;
+        }
+        _Position = 0;
+        _Crc = CRC_INIT_VAL;
+        _CrcValid = true;
+    }
+
+    return Skip(offset - _Position);
+}
+
+SRes FolderDecoder::SeekToFile(UINT32 fileIndex) {
+    if (fileIndex >= _Db.NumFiles) return SZ_ERROR_PARAM;
+
+    UInt32 folder = _Db.FileToFolder[fileIndex];
+    if (folder == (UInt32)-1) return SZ_ERROR_PARAM;
+
+    if (!_IsOpen || _Folder != folder) {
+        RINOK(Open(folder))
+    }
+
+    UINT64 offset = _Db.UnpackPositions[fileIndex] - _Db.UnpackPositions[_Db.FolderToFile[folder]];
+    return Seek(offset);
+}
+
+SRes FolderDecoder::ExtractFile(UINT32 fileIndex, const ChunkCallback& onChunk) {
+    return ExtractPrefix(fileIndex, ~(UINT64)0, onChunk);
+}
+
+SRes FolderDecoder::ExtractPrefix(UINT32 fileIndex, UINT64 maxBytes, const ChunkCallback& onChunk) {
+    RINOK(SeekToFile(fileIndex))
+
+    UINT64 size = _Db.UnpackPositions[(size_t)fileIndex + 1] - _Db.UnpackPositions[fileIndex];
+    UINT64 remaining = (std::min)(size, maxBytes);
+    UINT32 crc = CRC_INIT_VAL;
+
+    while (remaining > 0) {
+        const Byte* data = nullptr;
+        size_t got = 0;
+        size_t want = (size_t)(std::min)(remaining, (UINT64)_WindowSize);
+        RINOK(Read(&data, &got, want))
+        crc = CrcUpdate(crc, data, got);
+        remaining -= got;
+        if (!onChunk(data, got)) return SZ_ERROR_WRITE;
+    }
+
+    // A prefix has nothing to check against
+    if (maxBytes >= size && SzBitWithVals_Check(&_Db.CRCs, fileIndex) &&
+        CRC_GET_DIGEST(crc) != _Db.CRCs.Vals[fileIndex])
+        return SZ_ERROR_CRC;
+    return SZ_OK;
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,345 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Persistent Archive Index Cache Implementation
+*/
+
+#include "IndexCache.h"
+#include "PathIndex.h"
+#include "CpuArch.h"
+#include <shlobj.h>
+
+namespace SevenZipView {
+
+static const UINT32 INDEX_CACHE_MAGIC = 0x495A5653;    // "SVZI"
+static const UINT32 INDEX_CACHE_VERSION = 2;
+static const wchar_t INDEX_CACHE_EXTENSION[] = L".idx";
+
+// 7z signature header: signature, version, start header CRC, next header
+// offset, size and CRC
+static const Byte SIGNATURE_7Z[6] = { '7', 'z', 0xBC, 0xAF, 0x27, 0x1C };
+static const size_t SIGNATURE_HEADER_SIZE = 32;
+
+// Layout of a cache file: this header, the archive path (UTF-16, not
+// terminated), padding to 8 bytes, then the payload written by
+// EntryTable::Save and DirectoryIndex::Save
+struct IndexCacheHeader {
+    UINT32          Magic;
+    UINT32          Version;
+    UINT32          PointerSize;        // sizeof(size_t) of the writer
+    UINT32          PathLength;         // Characters
+    ArchiveIdentity Identity;
+    UINT64          PayloadOffset;
+    UINT64          PayloadSize;
+    UINT32          PayloadCRC;
+    UINT32          HeaderCRC;          // Over the fields above and the path
+};
+
+static UINT32 HeaderChecksum(const IndexCacheHeader& header, const wchar_t* path) {
+    UINT32 crc = CrcUpdate(CRC_INIT_VAL, &header, offsetof(IndexCacheHeader, HeaderCRC));
+    crc = CrcUpdate(crc, path, (size_t)header.PathLength * sizeof(wchar_t));
+    return CRC_GET_DIGEST(crc);
+}
+
+static bool WriteAll(HANDLE hFile, const void* data, size_t size) {
+    const BYTE* p = static_cast<const BYTE*>(data);
+    while (size > 0) {
+        DWORD chunk = (DWORD)(std::min)(size, (size_t)(1 << 30));
+        DWORD written = 0;
+        if (!WriteFile(hFile, p, chunk, &written, nullptr) || written != chunk) return false;
+        p += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+// Next header location and checksum from a 7z signature header
+static bool ReadSignatureHeader(const Byte* header, ArchiveIdentity& identity) {
+    if (memcmp(header, SIGNATURE_7Z, sizeof(SIGNATURE_7Z)) != 0) return false;
+
+    identity.NextHeaderOffset = GetUi64(header + 12);
+    identity.NextHeaderSize = GetUi64(header + 20);
+    identity.NextHeaderCRC = GetUi32(header + 28);
+    return true;
+}
+
+// ArchiveIdentity Implementation
+bool ArchiveIdentity::Read(const std::wstring& path, ArchiveIdentity& identity) {
+    ZeroMemory(&identity, sizeof(identity));
+
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info)) return false;
+    identity.Size = ((UINT64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    identity.ModifiedTime = ((UINT64)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    Byte header[SIGNATURE_HEADER_SIZE];
+    DWORD read = 0;
+    BOOL ok = ReadFile(hFile, header, (DWORD)sizeof(header), &read, nullptr);
+    CloseHandle(hFile);
+    return ok && read == sizeof(header) && ReadSignatureHeader(header, identity);
+}
+
+bool ArchiveIdentity::FromMemory(const Byte* data, UINT64 size, UINT64 modifiedTime, ArchiveIdentity& identity) {
+    ZeroMemory(&identity, sizeof(identity));
+    if (!data || size < SIGNATURE_HEADER_SIZE) return false;
+
+    identity.Size = size;
+    identity.ModifiedTime = modifiedTime;
+    return ReadSignatureHeader(data, identity);
+}
+
+// IndexCache Implementation
+IndexCache& IndexCache::Instance() {
+    static IndexCache instance;
+    return instance;
+}
+
+IndexCache::IndexCache()
+    : _Enabled(true)
+    , _Budget(INDEX_CACHE_DEFAULT_BUDGET)
+    , _MinEntries(INDEX_CACHE_DEFAULT_MIN_ENTRIES) {
+}
+
+void IndexCache::SetEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Enabled = enabled;
+}
+
+bool IndexCache::IsEnabled() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Enabled;
+}
+
+void IndexCache::SetDirectory(const std::wstring& directory) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Directory = directory;
+}
+
+void IndexCache::SetBudget(UINT64 bytes) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Budget = bytes;
+}
+
+void IndexCache::SetMinEntries(UINT32 count) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _MinEntries = count;
+}
+
+UINT32 IndexCache::GetMinEntries() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _MinEntries;
+}
+
+std::wstring IndexCache::GetDirectoryLocked() {
+    if (!_Directory.empty()) return _Directory;
+
+    PWSTR localAppData = nullptr;
+    if (FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) return L"";
+    std::wstring root = std::wstring(localAppData) + L"\\SevenZipView";
+    CoTaskMemFree(localAppData);
+
+    CreateDirectoryW(root.c_str(), nullptr);
+    _Directory = root + L"\\IndexCache";
+    CreateDirectoryW(_Directory.c_str(), nullptr);
+    return _Directory;
+}
+
+std::wstring IndexCache::GetEntryPath(const std::wstring& directory, const std::wstring& archivePath) const {
+    // FNV-1a 64 of the folded path; the path itself is checked on load
+    UINT64 hash = 14695981039346656037ull;
+    for (wchar_t c : archivePath)
+        hash = (hash ^ (UINT64)FoldPathChar(c)) * 1099511628211ull;
+
+    wchar_t name[32];
+    StringCchPrintfW(name, ARRAYSIZE(name), L"%016llx%s", hash, INDEX_CACHE_EXTENSION);
+    return directory + L"\\" + name;
+}
+
+std::shared_ptr<MappedFile> IndexCache::Load(const std::wstring& archivePath, const ArchiveIdentity& identity,
+                                             IndexReader& payload) {
+    std::wstring entryPath;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (!_Enabled) return nullptr;
+        std::wstring directory = GetDirectoryLocked();
+        if (directory.empty()) return nullptr;
+        entryPath = GetEntryPath(directory, archivePath);
+    }
+
+    if (GetFileAttributesW(entryPath.c_str()) == INVALID_FILE_ATTRIBUTES) return nullptr;
+
+    std::shared_ptr<MappedFile> file = MappedFile::Open(entryPath);
+    if (!file || file->GetSize() < sizeof(IndexCacheHeader)) return nullptr;
+
+    const Byte* data = file->GetData();
+    UINT64 size = file->GetSize();
+
+    IndexCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    const wchar_t* storedPath = reinterpret_cast<const wchar_t*>(data + sizeof(header));
+
+    if (header.Magic != INDEX_CACHE_MAGIC || header.Version != INDEX_CACHE_VERSION ||
+        header.PointerSize != sizeof(size_t) ||
+        sizeof(header) + (UINT64)header.PathLength * sizeof(wchar_t) > header.PayloadOffset ||
+        (header.PayloadOffset & 7) != 0 ||
+        header.PayloadOffset > size || header.PayloadSize > size - header.PayloadOffset ||
+        HeaderChecksum(header, storedPath) != header.HeaderCRC) {
+        SEVENZIPVIEW_LOG(L"IndexCache::Load: unusable entry for '%s'", archivePath.c_str());
+        return nullptr;
+    }
+
+    // Another archive with the same hash, or this one changed since
+    if (memcmp(&header.Identity, &identity, sizeof(identity)) != 0) return nullptr;
+    if (header.PathLength != archivePath.size()) return nullptr;
+    for (size_t i = 0; i < archivePath.size(); i++) {
+        if (FoldPathChar(storedPath[i]) != FoldPathChar(archivePath[i])) return nullptr;
+    }
+
+    const Byte* payloadData = data + header.PayloadOffset;
+    if (CrcCalc(payloadData, (size_t)header.PayloadSize) != header.PayloadCRC) {
+        SEVENZIPVIEW_LOG(L"IndexCache::Load: payload checksum mismatch for '%s'", archivePath.c_str());
+        return nullptr;
+    }
+
+    Touch(entryPath);
+    payload = IndexReader(payloadData, (size_t)header.PayloadSize);
+    return file;
+}
+
+bool IndexCache::Store(const std::wstring& archivePath, const ArchiveIdentity& identity, const IndexWriter& payload) {
+    std::wstring directory;
+    std::wstring entryPath;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (!_Enabled) return false;
+        directory = GetDirectoryLocked();
+        if (directory.empty()) return false;
+        entryPath = GetEntryPath(directory, archivePath);
+    }
+
+    const std::vector<BYTE>& data = payload.GetData();
+
+    IndexCacheHeader header;
+    ZeroMemory(&header, sizeof(header));
+    header.Magic = INDEX_CACHE_MAGIC;
+    header.Version = INDEX_CACHE_VERSION;
+    header.PointerSize = sizeof(size_t);
+    header.PathLength = (UINT32)archivePath.size();
+    header.Identity = identity;
+    header.PayloadOffset = (sizeof(header) + archivePath.size() * sizeof(wchar_t) + 7) & ~(UINT64)7;
+    header.PayloadSize = data.size();
+    header.PayloadCRC = CrcCalc(data.data(), data.size());
+    header.HeaderCRC = HeaderChecksum(header, archivePath.c_str());
+
+    // Write a private file and rename it over the entry, so readers in other
+    // processes see either the old entry or the complete new one
+    wchar_t suffix[32];
+    StringCchPrintfW(suffix, ARRAYSIZE(suffix), L".%lu.%lu.tmp", GetCurrentProcessId(), GetCurrentThreadId());
+    std::wstring tempPath = entryPath + suffix;
+
+    HANDLE hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        SEVENZIPVIEW_LOG(L"IndexCache::Store: cannot create '%s': error=%u", tempPath.c_str(), GetLastError());
+        return false;
+    }
+
+    static const BYTE padding[8] = {};
+    size_t pathBytes = archivePath.size() * sizeof(wchar_t);
+    bool ok = WriteAll(hFile, &header, sizeof(header)) &&
+        WriteAll(hFile, archivePath.c_str(), pathBytes) &&
+        WriteAll(hFile, padding, (size_t)header.PayloadOffset - sizeof(header) - pathBytes) &&
+        WriteAll(hFile, data.data(), data.size());
+    CloseHandle(hFile);
+
+    if (!ok || !MoveFileExW(tempPath.c_str(), entryPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        SEVENZIPVIEW_LOG(L"IndexCache::Store: failed for '%s': error=%u", archivePath.c_str(), GetLastError());
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+
+    Trim(directory);
+    return true;
+}
+
+void IndexCache::Touch(const std::wstring& entryPath) const {
+    // The last access time orders entries for eviction; NTFS may not keep
+    // it current by itself
+    HANDLE hFile = CreateFileW(entryPath.c_str(), FILE_WRITE_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(hFile, nullptr, &now, nullptr);
+    CloseHandle(hFile);
+}
+
+void IndexCache::Trim(const std::wstring& directory) {
+    UINT64 budget;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        budget = _Budget;
+    }
+
+    struct CacheFile {
+        std::wstring    Path;
+        UINT64          Size;
+        UINT64          LastAccess;
+    };
+
+    std::vector<CacheFile> files;
+    UINT64 total = 0;
+
+    WIN32_FIND_DATAW fd;
+    std::wstring pattern = directory + L"\\*" + INDEX_CACHE_EXTENSION;
+    HANDLE hFind = FindFirstFileW(pattern.c_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE) return;
+    do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        UINT64 size = ((UINT64)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+        UINT64 lastAccess = ((UINT64)fd.ftLastAccessTime.dwHighDateTime << 32) | fd.ftLastAccessTime.dwLowDateTime;
+        files.push_back({ directory + L"\\" + fd.cFileName, size, lastAccess });
+        total += size;
+    } while (FindNextFileW(hFind, &fd));
+    FindClose(hFind);
+
+    if (total <= budget) return;
+
+    std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) {
+        return a.LastAccess < b.LastAccess;
+    });
+
+    // Entries mapped by an open archive may refuse deletion; skip them
+    for (const CacheFile& file : files) {
+        if (total <= budget) break;
+        if (DeleteFileW(file.Path.c_str())) {
+            total -= file.Size;
+            SEVENZIPVIEW_LOG(L"IndexCache: evicted '%s' (%llu bytes)", file.Path.c_str(), file.Size);
+        }
+    }
+}
+
+void IndexCache::Clear() {
+    std::wstring directory;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        directory = GetDirectoryLocked();
+    }
+    if (directory.empty()) return;
+
+    WIN32_FIND_DATAW fd;
+    std::wstring pattern = directory + L"\\*" + INDEX_CACHE_EXTENSION;
+    HANDLE hFind = FindFirstFileW(pattern.c_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE) return;
+    do {
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            DeleteFileW((directory + L"\\" + fd.cFileName).c_str());
+    } while (FindNextFileW(hFind, &fd));
+    FindClose(hFind);
+}
+
+} // namespace SevenZipView
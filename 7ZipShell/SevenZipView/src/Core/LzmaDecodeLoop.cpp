@@ -0,0 +1,376 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Selectable LZMA Symbol Decoding Loop Implementation
+*/
+
+#include "LzmaDecodeLoop.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define LZMA_LOOP_INLINE __forceinline
+#else
+#define LZMA_LOOP_INLINE inline __attribute__((always_inline))
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define LZMA_LOOP_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define LZMA_LOOP_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define LZMA_LOOP_PREFETCH(address) ((void)(address))
+#endif
+
+namespace SevenZipView {
+
+// Range coder
+static const UInt32 TOP_VALUE = (UInt32)1 << 24;
+static const unsigned BIT_MODEL_TOTAL_BITS = 11;
+static const UInt32 BIT_MODEL_TOTAL = (UInt32)1 << BIT_MODEL_TOTAL_BITS;
+static const unsigned MOVE_BITS = 5;
+
+// LZMA model
+static const unsigned NUM_STATES = 12;
+static const unsigned NUM_LIT_STATES = 7;
+static const unsigned LEN_NUM_LOW_SYMBOLS = 8;
+static const unsigned START_POS_MODEL_INDEX = 4;
+static const unsigned END_POS_MODEL_INDEX = 14;
+static const unsigned NUM_POS_SLOT_BITS = 6;
+static const unsigned NUM_LEN_TO_POS_STATES = 4;
+static const unsigned NUM_ALIGN_BITS = 4;
+static const unsigned MATCH_MIN_LEN = 2;
+static const unsigned MATCH_SPEC_LEN_START = MATCH_MIN_LEN + LEN_NUM_LOW_SYMBOLS * 2 + 256;
+static const unsigned MATCH_SPEC_LEN_ERROR_DATA = 1 << 9;
+
+// CLzmaProb layout of LzmaDec.c, as offsets from CLzmaDec::probs_1664
+static const int PROBS_SPEC_POS = -1664;
+static const int PROBS_IS_REP0_LONG = PROBS_SPEC_POS + 128;
+static const int PROBS_REP_LEN_CODER = PROBS_IS_REP0_LONG + (16 << 4);
+static const int PROBS_LEN_CODER = PROBS_REP_LEN_CODER + 512;
+static const int PROBS_IS_MATCH = PROBS_LEN_CODER + 512;
+static const int PROBS_ALIGN = PROBS_IS_MATCH + (16 << 4);
+static const int PROBS_IS_REP = PROBS_ALIGN + 16;
+static const int PROBS_IS_REP_G0 = PROBS_IS_REP + NUM_STATES;
+static const int PROBS_IS_REP_G1 = PROBS_IS_REP_G0 + NUM_STATES;
+static const int PROBS_IS_REP_G2 = PROBS_IS_REP_G1 + NUM_STATES;
+static const int PROBS_POS_SLOT = PROBS_IS_REP_G2 + NUM_STATES;
+static const int PROBS_LITERAL = PROBS_POS_SLOT + (NUM_LEN_TO_POS_STATES << NUM_POS_SLOT_BITS);
+
+// Within a length coder
+static const unsigned LEN_CHOICE = 0;
+static const unsigned LEN_CHOICE2 = 8;
+static const unsigned LEN_LOW = 0;
+static const unsigned LEN_HIGH = 2 * (16 << 3);
+
+static_assert(PROBS_ALIGN == 0 && PROBS_LITERAL + 1664 == 1984, "LzmaDec.c probability layout");
+
+namespace {
+
+struct RangeDecoder {
+    const Byte* Buf;
+    UInt32      Range;
+    UInt32      Code;
+
+    LZMA_LOOP_INLINE void Normalize() {
+        if (Range < TOP_VALUE) {
+            Range <<= 8;
+            Code = (Code << 8) | *Buf++;
+        }
+    }
+
+    // Most bits: symbol kinds, matched literals (which mostly follow the
+    // match byte), lengths and distances, which the branch predictor learns
+    LZMA_LOOP_INLINE unsigned Bit(CLzmaProb* prob) {
+        unsigned ttt = *prob;
+        Normalize();
+        UInt32 bound = (Range >> BIT_MODEL_TOTAL_BITS) * (UInt32)ttt;
+        if (Code < bound) {
+            Range = bound;
+            *prob = (CLzmaProb)(ttt + ((BIT_MODEL_TOTAL - ttt) >> MOVE_BITS));
+            return 0;
+        }
+        Range -= bound;
+        Code -= bound;
+        *prob = (CLzmaProb)(ttt - (ttt >> MOVE_BITS));
+        return 1;
+    }
+
+    // Bits of literals after literals, close to random on poorly
+    // compressible data: selected with a mask instead of a branch
+    // mispredicted about half the time. The model update is the same: for
+    // bit 0, ttt + ((2048 - ttt) >> 5) equals ttt - ((ttt - 2048 + 31) >> 5)
+    // with an arithmetic shift.
+    LZMA_LOOP_INLINE unsigned MaskedBit(CLzmaProb* prob) {
+        unsigned ttt = *prob;
+        Normalize();
+        UInt32 bound = (Range >> BIT_MODEL_TOTAL_BITS) * (UInt32)ttt;
+        UInt32 mask = 0 - (UInt32)(Code >= bound);
+        Range = bound + ((Range - bound - bound) & mask);
+        Code -= bound & mask;
+        Int32 adjusted = (Int32)(ttt + (~mask & (UInt32)(31 - (Int32)BIT_MODEL_TOTAL)));
+        *prob = (CLzmaProb)((Int32)ttt - (adjusted >> MOVE_BITS));
+        return mask & 1;
+    }
+
+    // Bit tree of NumBits, returned with its leading 1
+    template <unsigned NumBits>
+    LZMA_LOOP_INLINE unsigned Tree(CLzmaProb* probs) {
+        unsigned symbol = 1;
+        for (unsigned i = 0; i < NumBits; i++)
+            symbol = (symbol << 1) + Bit(probs + symbol);
+        return symbol;
+    }
+};
+
+// Copy a match that does not wrap around the dictionary, with the result of
+// the SDK's forward byte loop when source and destination overlap
+LZMA_LOOP_INLINE void CopyMatch(Byte* dest, const Byte* src, size_t length) {
+    if (dest > src && dest - src == 1) {
+        memset(dest, *src, length);
+        return;
+    }
+    if (dest < src || dest - src >= 8) {
+        // Each chunk reads only bytes already final
+        while (length >= 8) {
+            UInt64 chunk;
+            memcpy(&chunk, src, 8);
+            memcpy(dest, &chunk, 8);
+            dest += 8;
+            src += 8;
+            length -= 8;
+        }
+    }
+    while (length--)
+        *dest++ = *src++;
+}
+
+// LZMA_DECODE_REAL of LzmaDec.c, symbol for symbol, with lc, lp and pb as
+// constants when LC, LP and PB are not -1
+template <int LC, int LP, int PB>
+int DecodeLoop(CLzmaDec* p, SizeT limit, const Byte* bufLimit) {
+    CLzmaProb* probs = p->probs_1664;
+    unsigned state = (unsigned)p->state;
+    UInt32 rep0 = p->reps[0], rep1 = p->reps[1], rep2 = p->reps[2], rep3 = p->reps[3];
+    const unsigned lc = (LC >= 0) ? (unsigned)LC : p->prop.lc;
+    const unsigned lp = (LP >= 0) ? (unsigned)LP : p->prop.lp;
+    const unsigned pb = (PB >= 0) ? (unsigned)PB : p->prop.pb;
+    const unsigned pbMask = (1u << pb) - 1;
+    const unsigned lpMask = (0x100u << lp) - (0x100u >> lc);
+
+    Byte* dic = p->dic;
+    SizeT dicBufSize = p->dicBufSize;
+    SizeT dicPos = p->dicPos;
+
+    UInt32 processedPos = p->processedPos;
+    UInt32 checkDicSize = p->checkDicSize;
+    unsigned len = 0;
+
+    RangeDecoder rc = { p->buf, p->range, p->code };
+
+    do {
+        unsigned posState = (processedPos & pbMask) << 4;
+        CLzmaProb* prob = probs + PROBS_IS_MATCH + posState + state;
+
+        if (!rc.Bit(prob)) {
+            prob = probs + PROBS_LITERAL;
+            if (processedPos != 0 || checkDicSize != 0)
+                prob += (UInt32)3 * ((((processedPos << 8) + dic[(dicPos == 0 ? dicBufSize : dicPos) - 1]) & lpMask) << lc);
+            processedPos++;
+
+            unsigned symbol = 1;
+            if (state < NUM_LIT_STATES) {
+                state -= (state < 4) ? state : 3;
+                for (unsigned i = 0; i < 8; i++)
+                    symbol = (symbol << 1) + rc.MaskedBit(prob + symbol);
+            }
+            else {
+                unsigned matchByte = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
+                unsigned offs = 0x100;
+                state -= (state < 10) ? 3 : 6;
+                for (unsigned i = 0; i < 8; i++) {
+                    matchByte += matchByte;
+                    unsigned bit = offs;
+                    offs &= matchByte;
+                    unsigned decoded = rc.Bit(prob + offs + bit + symbol);
+                    symbol = (symbol << 1) + decoded;
+                    // Still following the match byte while the bits agree
+                    offs ^= bit & (decoded - 1);
+                }
+            }
+
+            dic[dicPos++] = (Byte)symbol;
+            continue;
+        }
+
+        if (!rc.Bit(probs + PROBS_IS_REP + state)) {
+            state += NUM_STATES;
+            prob = probs + PROBS_LEN_CODER;
+        }
+        else {
+            if (!rc.Bit(probs + PROBS_IS_REP_G0 + state)) {
+                if (!rc.Bit(probs + PROBS_IS_REP0_LONG + posState + state)) {
+                    // Short rep; the caller rules out dicPos == limit here
+                    dic[dicPos] = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
+                    dicPos++;
+                    processedPos++;
+                    state = state < NUM_LIT_STATES ? 9 : 11;
+                    continue;
+                }
+            }
+            else {
+                UInt32 distance;
+                if (!rc.Bit(probs + PROBS_IS_REP_G1 + state)) {
+                    distance = rep1;
+                }
+                else {
+                    if (!rc.Bit(probs + PROBS_IS_REP_G2 + state)) {
+                        distance = rep2;
+                    }
+                    else {
+                        distance = rep3;
+                        rep3 = rep2;
+                    }
+                    rep2 = rep1;
+                }
+                rep1 = rep0;
+                rep0 = distance;
+            }
+            state = state < NUM_LIT_STATES ? 8 : 11;
+            prob = probs + PROBS_REP_LEN_CODER;
+        }
+
+        if (!rc.Bit(prob + LEN_CHOICE))
+            len = rc.Tree<3>(prob + LEN_LOW + posState) - 8;
+        else if (!rc.Bit(prob + LEN_CHOICE2))
+            len = rc.Tree<3>(prob + LEN_LOW + posState + 8);
+        else
+            len = rc.Tree<8>(prob + LEN_HIGH) - 0x100 + LEN_NUM_LOW_SYMBOLS * 2;
+
+        if (state >= NUM_STATES) {
+            prob = probs + PROBS_POS_SLOT +
+                ((len < NUM_LEN_TO_POS_STATES ? len : NUM_LEN_TO_POS_STATES - 1) << NUM_POS_SLOT_BITS);
+            UInt32 distance = rc.Tree<6>(prob) - 0x40;
+
+            if (distance >= START_POS_MODEL_INDEX) {
+                unsigned posSlot = (unsigned)distance;
+                unsigned numDirectBits = (unsigned)((distance >> 1) - 1);
+                distance = 2 | (distance & 1);
+                if (posSlot < END_POS_MODEL_INDEX) {
+                    distance <<= numDirectBits;
+                    prob = probs + PROBS_SPEC_POS;
+                    UInt32 m = 1;
+                    distance++;
+                    do {
+                        distance += m << rc.Bit(prob + distance);
+                        m += m;
+                    } while (--numDirectBits);
+                    distance -= m;
+                }
+                else {
+                    numDirectBits -= NUM_ALIGN_BITS;
+                    do {
+                        rc.Normalize();
+                        rc.Range >>= 1;
+                        rc.Code -= rc.Range;
+                        UInt32 t = 0 - (rc.Code >> 31);
+                        distance = (distance << 1) + (t + 1);
+                        rc.Code += rc.Range & t;
+                    } while (--numDirectBits);
+
+                    prob = probs + PROBS_ALIGN;
+                    distance <<= NUM_ALIGN_BITS;
+                    unsigned i = 1;
+                    i += 1u << rc.Bit(prob + i);
+                    i += 2u << rc.Bit(prob + i);
+                    i += 4u << rc.Bit(prob + i);
+                    i -= 8u & (rc.Bit(prob + i) - 1);
+                    distance |= i;
+                    if (distance == (UInt32)0xFFFFFFFF) {
+                        len = MATCH_SPEC_LEN_START;
+                        state -= NUM_STATES;
+                        break;
+                    }
+                }
+            }
+
+            // Start loading the source while the state is updated
+            if (distance < dicPos)
+                LZMA_LOOP_PREFETCH(dic + dicPos - distance - 1);
+
+            rep3 = rep2;
+            rep2 = rep1;
+            rep1 = rep0;
+            rep0 = distance + 1;
+            state = (state < NUM_STATES + NUM_LIT_STATES) ? NUM_LIT_STATES : NUM_LIT_STATES + 3;
+            if (distance >= (checkDicSize == 0 ? processedPos : checkDicSize)) {
+                len += MATCH_SPEC_LEN_ERROR_DATA + MATCH_MIN_LEN;
+                break;
+            }
+        }
+
+        len += MATCH_MIN_LEN;
+
+        SizeT rem = limit - dicPos;
+        if (rem == 0) break;
+
+        unsigned curLen = (rem < len) ? (unsigned)rem : len;
+        SizeT pos = dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0);
+
+        processedPos += (UInt32)curLen;
+        len -= curLen;
+        if (curLen <= dicBufSize - pos) {
+            CopyMatch(dic + dicPos, dic + pos, curLen);
+            dicPos += curLen;
+        }
+        else {
+            do {
+                dic[dicPos++] = dic[pos];
+                if (++pos == dicBufSize) pos = 0;
+            } while (--curLen != 0);
+        }
+    } while (dicPos < limit && rc.Buf < bufLimit);
+
+    rc.Normalize();
+
+    p->buf = rc.Buf;
+    p->range = rc.Range;
+    p->code = rc.Code;
+    p->remainLen = (UInt32)len;
+    p->dicPos = dicPos;
+    p->processedPos = processedPos;
+    p->reps[0] = rep0;
+    p->reps[1] = rep1;
+    p->reps[2] = rep2;
+    p->reps[3] = rep3;
+    p->state = (UInt32)state;
+    if (len >= MATCH_SPEC_LEN_ERROR_DATA) return SZ_ERROR_DATA;
+    return SZ_OK;
+}
+
+} // namespace
+
+static LzmaDecodeLoop g_LzmaDecodeLoop = LzmaDecodeLoop::Reference;
+
+int Z7_FASTCALL LzmaFastDecodeReal(CLzmaDec* p, SizeT limit, const Byte* bufLimit) {
+    // The defaults of 7-Zip, xz and liblzma
+    if (p->prop.lc == 3 && p->prop.lp == 0 && p->prop.pb == 2)
+        return DecodeLoop<3, 0, 2>(p, limit, bufLimit);
+    // 7-Zip's BCJ2 call and jump streams
+    if (p->prop.lc == 0 && p->prop.lp == 2 && p->prop.pb == 2)
+        return DecodeLoop<0, 2, 2>(p, limit, bufLimit);
+    return DecodeLoop<-1, -1, -1>(p, limit, bufLimit);
+}
+
+void SetLzmaDecodeLoop(LzmaDecodeLoop loop) {
+    LzmaDec_SetDecodeReal(loop == LzmaDecodeLoop::Fast ? LzmaFastDecodeReal : nullptr);
+    g_LzmaDecodeLoop = loop;
+}
+
+LzmaDecodeLoop GetLzmaDecodeLoop() {
+    return g_LzmaDecodeLoop;
+}
+
+const char* GetLzmaDecodeLoopName(LzmaDecodeLoop loop) {
+    return loop == LzmaDecodeLoop::Fast ? "fast" : "reference";
+}
+
+} // namespace SevenZipView
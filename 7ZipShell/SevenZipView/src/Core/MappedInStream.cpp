@@ -0,0 +1,129 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Memory-Mapped Archive Input Stream Implementation
+*/
+
+#include "MappedInStream.h"
+
+namespace SevenZipView {
+
+// MappedFile Implementation
+MappedFile::MappedFile()
+    : _File(INVALID_HANDLE_VALUE)
+    , _Mapping(nullptr)
+    , _View(nullptr)
+    , _Size(0) {
+}
+
+MappedFile::~MappedFile() {
+    if (_View && _Mapping) UnmapViewOfFile(_View);
+    if (_Mapping) CloseHandle(_Mapping);
+    if (_File != INVALID_HANDLE_VALUE) CloseHandle(_File);
+}
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::wstring& path) {
+    // A mapped view turns network read errors into access violations inside
+    // the decoder; remote files keep going through ReadFile
+    WCHAR root[MAX_PATH];
+    if (GetVolumePathNameW(path.c_str(), root, MAX_PATH) && GetDriveTypeW(root) == DRIVE_REMOTE) {
+        SEVENZIPVIEW_LOG(L"MappedFile::Open: remote volume, not mapping '%s'", path.c_str());
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+    file->_File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->_File == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->_File, &size) || size.QuadPart <= 0) return nullptr;
+    if ((UINT64)size.QuadPart > (UINT64)SIZE_MAX) return nullptr;
+    file->_Size = (UINT64)size.QuadPart;
+
+    file->_Mapping = CreateFileMappingW(file->_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file->_Mapping) {
+        SEVENZIPVIEW_LOG(L"MappedFile::Open: CreateFileMapping failed: error=%u", GetLastError());
+        return nullptr;
+    }
+
+    file->_View = (const Byte*)MapViewOfFile(file->_Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->_View) {
+        SEVENZIPVIEW_LOG(L"MappedFile::Open: MapViewOfFile failed: error=%u", GetLastError());
+        return nullptr;
+    }
+
+    return file;
+}
+
+std::shared_ptr<MappedFile> MappedFile::FromMemory(const Byte* data, UINT64 size, std::shared_ptr<const void> owner) {
+    if (!data || size == 0 || !owner) return nullptr;
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->_View = data;
+    file->_Size = size;
+    file->_Owner = std::move(owner);
+    return file;
+}
+
+// CMappedInStream Implementation
+#define GET_MappedInStream  Z7_CONTAINER_FROM_VTBL_TO_DECL_VAR_pp_vt_p(CMappedInStream)
+
+static SRes MappedInStream_Look(ILookInStreamPtr pp, const void** buf, size_t* size) {
+    GET_MappedInStream
+    UInt64 rem = p->size - p->pos;
+    if (*size > rem) *size = (size_t)rem;
+    *buf = p->data + p->pos;
+    return SZ_OK;
+}
+
+static SRes MappedInStream_Skip(ILookInStreamPtr pp, size_t offset) {
+    GET_MappedInStream
+    UInt64 rem = p->size - p->pos;
+    p->pos += (offset > rem) ? rem : offset;
+    return SZ_OK;
+}
+
+static SRes MappedInStream_Read(ILookInStreamPtr pp, void* buf, size_t* size) {
+    GET_MappedInStream
+    UInt64 rem = p->size - p->pos;
+    if (*size > rem) *size = (size_t)rem;
+    if (*size) memcpy(buf, p->data + p->pos, *size);
+    p->pos += *size;
+    return SZ_OK;
+}
+
+static SRes MappedInStream_Seek(ILookInStreamPtr pp, Int64* pos, ESzSeek origin) {
+    GET_MappedInStream
+    Int64 base;
+    switch (origin) {
+    case SZ_SEEK_SET: base = 0; break;
+    case SZ_SEEK_CUR: base = (Int64)p->pos; break;
+    case SZ_SEEK_END: base = (Int64)p->size; break;
+    default: return SZ_ERROR_PARAM;
+    }
+
+    Int64 target = base + *pos;
+    if (target < 0) return SZ_ERROR_PARAM;
+
+    // Positions past the end are clamped, reads there return no data
+    p->pos = (UInt64)target;
+    if (p->pos > p->size) p->pos = p->size;
+    *pos = (Int64)p->pos;
+    return SZ_OK;
+}
+
+void MappedInStream_CreateVTable(CMappedInStream* p) {
+    p->vt.Look = MappedInStream_Look;
+    p->vt.Skip = MappedInStream_Skip;
+    p->vt.Read = MappedInStream_Read;
+    p->vt.Seek = MappedInStream_Seek;
+}
+
+void MappedInStream_Init(CMappedInStream* p, const MappedFile* file) {
+    p->data = file ? file->GetData() : nullptr;
+    p->size = file ? file->GetSize() : 0;
+    p->pos = 0;
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,108 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Case-Insensitive Archive Path Index Implementation
+*/
+
+#include "PathIndex.h"
+
+namespace SevenZipView {
+
+// FNV-1a over folded UTF-16 code units
+static const UINT32 HASH_SEED = 2166136261u;
+static const UINT32 HASH_PRIME = 16777619u;
+
+static inline UINT32 HashStep(UINT32 hash, wchar_t c) {
+    return (hash ^ (UINT32)c) * HASH_PRIME;
+}
+
+static inline wchar_t NameChar(const Byte* names, size_t pos) {
+    return (wchar_t)(names[pos * 2] | ((wchar_t)names[pos * 2 + 1] << 8));
+}
+
+PathIndex::PathIndex()
+    : _Names(nullptr)
+    , _Offsets(nullptr)
+    , _Count(0)
+    , _Mask(0) {
+}
+
+void PathIndex::Clear() {
+    _Names = nullptr;
+    _Offsets = nullptr;
+    _Count = 0;
+    _Mask = 0;
+    _Slots.clear();
+    _Slots.shrink_to_fit();
+}
+
+void PathIndex::Build(const Byte* names, const size_t* offsets, UINT32 count) {
+    Clear();
+    if (!names || !offsets || count == 0) return;
+
+    _Names = names;
+    _Offsets = offsets;
+    _Count = count;
+
+    // Load factor <= 0.5 keeps linear probe chains short
+    size_t slotCount = 16;
+    while (slotCount < (size_t)count * 2) slotCount <<= 1;
+    _Slots.assign(slotCount, Slot{ 0, NOT_FOUND });
+    _Mask = (UINT32)(slotCount - 1);
+
+    // Inserting in index order keeps the lowest index first on a probe chain,
+    // so duplicate paths resolve to the first entry as the linear scan did
+    for (UINT32 i = 0; i < count; i++) {
+        size_t start = _Offsets[i];
+        size_t length = GetNameLength(i);
+
+        UINT32 hash = HASH_SEED;
+        for (size_t c = 0; c < length; c++)
+            hash = HashStep(hash, FoldPathChar(NameChar(_Names, start + c)));
+
+        UINT32 pos = hash & _Mask;
+        while (_Slots[pos].Index != NOT_FOUND)
+            pos = (pos + 1) & _Mask;
+        _Slots[pos] = Slot{ hash, i };
+    }
+}
+
+size_t PathIndex::GetNameLength(UINT32 index) const {
+    size_t start = _Offsets[index];
+    size_t end = _Offsets[(size_t)index + 1];
+    size_t length = (end > start) ? end - start - 1 : 0;    // Drop the terminator
+
+    while (length > 0 && IsPathSeparator(NameChar(_Names, start + length - 1)))
+        length--;
+    return length;
+}
+
+bool PathIndex::NameEquals(UINT32 index, const wchar_t* path, size_t length) const {
+    if (GetNameLength(index) != length) return false;
+
+    size_t start = _Offsets[index];
+    for (size_t c = 0; c < length; c++) {
+        if (FoldPathChar(NameChar(_Names, start + c)) != FoldPathChar(path[c]))
+            return false;
+    }
+    return true;
+}
+
+UINT32 PathIndex::Find(const wchar_t* path, size_t length) const {
+    if (_Slots.empty()) return NOT_FOUND;
+
+    while (length > 0 && IsPathSeparator(path[length - 1]))
+        length--;
+
+    UINT32 hash = HASH_SEED;
+    for (size_t c = 0; c < length; c++)
+        hash = HashStep(hash, FoldPathChar(path[c]));
+
+    for (UINT32 pos = hash & _Mask; _Slots[pos].Index != NOT_FOUND; pos = (pos + 1) & _Mask) {
+        const Slot& slot = _Slots[pos];
+        if (slot.Hash == hash && NameEquals(slot.Index, path, length))
+            return slot.Index;
+    }
+    return NOT_FOUND;
+}
+
+} // namespace SevenZipView
@@ -0,0 +1,264 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Allocators for the 7z SDK Implementation
+*/
+
+#include "SdkAlloc.h"
+
+namespace SevenZipView {
+
+// Prefix of every pool allocation: its class size, 0 for small requests
+// passed through to malloc. Two words keep the caller's memory aligned as
+// malloc's is.
+struct PoolHeader {
+    size_t  ClassSize;
+    size_t  Reserved;
+};
+
+//==============================================================================
+// Heap
+//==============================================================================
+
+static std::atomic<UINT64> g_HeapRequests(0);
+static std::atomic<UINT64> g_HeapBytes(0);
+
+static void* SdkHeapAlloc(ISzAllocPtr p, size_t size) {
+    (void)p;
+    g_HeapRequests.fetch_add(1, std::memory_order_relaxed);
+    g_HeapBytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+static void SdkHeapFree(ISzAllocPtr p, void* address) {
+    (void)p;
+    free(address);
+}
+
+static const ISzAlloc g_HeapAlloc = { SdkHeapAlloc, SdkHeapFree };
+
+ISzAllocPtr GetHeapAlloc() {
+    return &g_HeapAlloc;
+}
+
+SdkAllocStats GetHeapAllocStats() {
+    SdkAllocStats stats;
+    stats.Requests = g_HeapRequests.load(std::memory_order_relaxed);
+    stats.SystemAllocations = stats.Requests;
+    stats.BytesRequested = g_HeapBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+//==============================================================================
+// SdkArena
+//==============================================================================
+
+static std::atomic<UINT64> g_ArenaRequests(0);
+static std::atomic<UINT64> g_ArenaBlocks(0);
+static std::atomic<UINT64> g_ArenaBytes(0);
+
+SdkArena::SdkArena(size_t blockSize)
+    : _BlockSize(blockSize)
+    , _Next(nullptr)
+    , _Left(0) {
+    _Vt.vt.Alloc = AllocImpl;
+    _Vt.vt.Free = FreeImpl;
+    _Vt.Owner = this;
+}
+
+SdkArena::~SdkArena() {
+    Reset();
+}
+
+void* SdkArena::AllocImpl(ISzAllocPtr p, size_t size) {
+    return reinterpret_cast<const Vtable*>(p)->Owner->Allocate(size);
+}
+
+void SdkArena::FreeImpl(ISzAllocPtr p, void* address) {
+    // Released with the arena
+    (void)p;
+    (void)address;
+}
+
+void* SdkArena::Allocate(size_t size) {
+    _Stats.Requests++;
+    _Stats.BytesRequested += size;
+    g_ArenaRequests.fetch_add(1, std::memory_order_relaxed);
+    g_ArenaBytes.fetch_add(size, std::memory_order_relaxed);
+
+    size_t aligned = (size + 15) & ~(size_t)15;
+    if (aligned < size) return nullptr;
+
+    // A request larger than a quarter block would waste the rest of the
+    // current one; it gets its own
+    if (aligned > _BlockSize / 4) {
+        BYTE* block = static_cast<BYTE*>(malloc(aligned));
+        if (!block) return nullptr;
+        _Blocks.push_back(block);
+        _Stats.SystemAllocations++;
+        g_ArenaBlocks.fetch_add(1, std::memory_order_relaxed);
+        return block;
+    }
+
+    if (aligned > _Left) {
+        BYTE* block = static_cast<BYTE*>(malloc(_BlockSize));
+        if (!block) return nullptr;
+        _Blocks.push_back(block);
+        _Stats.SystemAllocations++;
+        g_ArenaBlocks.fetch_add(1, std::memory_order_relaxed);
+        _Next = block;
+        _Left = _BlockSize;
+    }
+
+    void* result = _Next;
+    _Next += aligned;
+    _Left -= aligned;
+    return result;
+}
+
+void SdkArena::Reset() {
+    for (BYTE* block : _Blocks)
+        free(block);
+    _Blocks.clear();
+    _Next = nullptr;
+    _Left = 0;
+}
+
+SdkAllocStats SdkArena::GetTotalStats() {
+    SdkAllocStats stats;
+    stats.Requests = g_ArenaRequests.load(std::memory_order_relaxed);
+    stats.SystemAllocations = g_ArenaBlocks.load(std::memory_order_relaxed);
+    stats.BytesRequested = g_ArenaBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+//==============================================================================
+// BufferPool
+//==============================================================================
+
+// Round a size up to its class: four classes per power of two
+static size_t GetClassSize(size_t size) {
+    // Largest power of two not above size
+    size_t power = BUFFER_POOL_MIN_SIZE;
+    while (power <= size / 2)
+        power *= 2;
+
+    size_t step = power / 4;
+    size_t rounded = (size + step - 1) & ~(step - 1);
+    return rounded < size ? size : rounded;
+}
+
+static void* PoolAllocImpl(ISzAllocPtr p, size_t size) {
+    (void)p;
+    return BufferPool::Instance().Allocate(size);
+}
+
+static void PoolFreeImpl(ISzAllocPtr p, void* address) {
+    (void)p;
+    BufferPool::Instance().Free(address);
+}
+
+static const ISzAlloc g_PoolAlloc = { PoolAllocImpl, PoolFreeImpl };
+
+BufferPool& BufferPool::Instance() {
+    // Never destroyed: other singletons (BlockCache, ArchivePool) free
+    // their buffers into it during static destruction
+    static BufferPool* instance = new BufferPool();
+    return *instance;
+}
+
+ISzAllocPtr BufferPool::GetAlloc() {
+    return &g_PoolAlloc;
+}
+
+BufferPool::BufferPool()
+    : _Budget(BUFFER_POOL_DEFAULT_BUDGET) {
+}
+
+void* BufferPool::Allocate(size_t size) {
+    size_t classSize = (size < BUFFER_POOL_MIN_SIZE) ? 0 : GetClassSize(size);
+    size_t total = (classSize ? classSize : size) + sizeof(PoolHeader);
+    if (total < size) return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        _Stats.Requests++;
+        _Stats.BytesRequested += size;
+
+        if (classSize) {
+            auto it = _Idle.find(classSize);
+            if (it != _Idle.end() && !it->second.empty()) {
+                void* block = it->second.back();
+                it->second.pop_back();
+                _Stats.IdleBytes -= classSize;
+                return static_cast<BYTE*>(block) + sizeof(PoolHeader);
+            }
+        }
+        _Stats.SystemAllocations++;
+    }
+
+    PoolHeader* header = static_cast<PoolHeader*>(malloc(total));
+    if (!header) return nullptr;
+    header->ClassSize = classSize;
+    header->Reserved = 0;
+    return header + 1;
+}
+
+void BufferPool::Free(void* address) {
+    if (!address) return;
+    PoolHeader* header = static_cast<PoolHeader*>(address) - 1;
+    size_t classSize = header->ClassSize;
+
+    if (classSize) {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (_Stats.IdleBytes + classSize <= _Budget) {
+            _Idle[classSize].push_back(header);
+            _Stats.IdleBytes += classSize;
+            return;
+        }
+    }
+    free(header);
+}
+
+void BufferPool::SetBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Budget = bytes;
+    TrimLocked();
+}
+
+size_t BufferPool::GetBudget() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Budget;
+}
+
+void BufferPool::Clear() {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    for (auto& idle : _Idle) {
+        for (void* block : idle.second)
+            free(block);
+    }
+    _Idle.clear();
+    _Stats.IdleBytes = 0;
+}
+
+SdkAllocStats BufferPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Stats;
+}
+
+void BufferPool::TrimLocked() {
+    // Largest classes first: they free the most for the fewest calls
+    while (_Stats.IdleBytes > _Budget) {
+        auto largest = _Idle.end();
+        for (auto it = _Idle.begin(); it != _Idle.end(); ++it) {
+            if (!it->second.empty() && (largest == _Idle.end() || it->first > largest->first))
+                largest = it;
+        }
+        if (largest == _Idle.end()) break;
+
+        free(largest->second.back());
+        largest->second.pop_back();
+        _Stats.IdleBytes -= largest->first;
+    }
+}
+
+} // namespace SevenZipView
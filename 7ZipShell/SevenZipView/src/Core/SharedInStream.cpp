@@ -0,0 +1,174 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Positional-Read Archive Input Stream Implementation
+*/
+
+#include "SharedInStream.h"
+
+namespace SevenZipView {
+
+// SharedFile Implementation
+SharedFile::SharedFile()
+    : _File(INVALID_HANDLE_VALUE)
+    , _Size(0) {
+}
+
+SharedFile::~SharedFile() {
+    if (_File != INVALID_HANDLE_VALUE) CloseHandle(_File);
+}
+
+std::shared_ptr<SharedFile> SharedFile::Open(const std::wstring& path) {
+    std::shared_ptr<SharedFile> file(new SharedFile());
+
+    // Overlapped, so reads on one handle are not serialized on its position
+    file->_File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+    if (file->_File == INVALID_HANDLE_VALUE) {
+        SEVENZIPVIEW_LOG(L"SharedFile::Open: CreateFile failed: error=%u", GetLastError());
+        return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->_File, &size)) return nullptr;
+    file->_Size = (UINT64)size.QuadPart;
+
+    return file;
+}
+
+bool SharedFile::Read(UINT64 offset, void* buffer, DWORD size, HANDLE event, DWORD& read) const {
+    read = 0;
+    if (offset >= _Size || size == 0) return true;
+    if (size > _Size - offset) size = (DWORD)(_Size - offset);
+
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    overlapped.hEvent = event;
+
+    if (!ReadFile(_File, buffer, size, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING)
+        return GetLastError() == ERROR_HANDLE_EOF;
+    if (!GetOverlappedResult(_File, &overlapped, &read, TRUE))
+        return GetLastError() == ERROR_HANDLE_EOF;
+    return true;
+}
+
+// CSharedInStream Implementation
+#define GET_SharedInStream  Z7_CONTAINER_FROM_VTBL_TO_DECL_VAR_pp_vt_p(CSharedInStream)
+
+static SRes SharedInStream_Look(ILookInStreamPtr pp, const void** buf, size_t* size) {
+    GET_SharedInStream
+    if (p->pos < p->bufStart || p->pos >= p->bufStart + p->bufFilled) {
+        DWORD read = 0;
+        if (!p->file->Read(p->pos, p->buf, (DWORD)p->bufSize, p->event, read)) {
+            p->bufFilled = 0;
+            *size = 0;
+            return SZ_ERROR_READ;
+        }
+        p->bufStart = p->pos;
+        p->bufFilled = read;
+    }
+
+    size_t avail = p->bufFilled - (size_t)(p->pos - p->bufStart);
+    if (*size > avail) *size = avail;
+    *buf = p->buf + (size_t)(p->pos - p->bufStart);
+    return SZ_OK;
+}
+
+static SRes SharedInStream_Skip(ILookInStreamPtr pp, size_t offset) {
+    GET_SharedInStream
+    UInt64 rem = p->file->GetSize() - p->pos;
+    p->pos += (offset > rem) ? rem : offset;
+    return SZ_OK;
+}
+
+static SRes SharedInStream_Read(ILookInStreamPtr pp, void* buf, size_t* size) {
+    GET_SharedInStream
+    if (*size == 0) return SZ_OK;
+
+    // Serve from the look-ahead buffer when it covers the position
+    if (p->pos >= p->bufStart && p->pos < p->bufStart + p->bufFilled) {
+        size_t avail = p->bufFilled - (size_t)(p->pos - p->bufStart);
+        if (*size > avail) *size = avail;
+        memcpy(buf, p->buf + (size_t)(p->pos - p->bufStart), *size);
+        p->pos += *size;
+        return SZ_OK;
+    }
+
+    // Otherwise read straight into the caller's buffer
+    DWORD chunk = (DWORD)((std::min)(*size, (size_t)(1 << 30)));
+    DWORD read = 0;
+    if (!p->file->Read(p->pos, buf, chunk, p->event, read)) {
+        *size = 0;
+        return SZ_ERROR_READ;
+    }
+    *size = read;
+    p->pos += read;
+    return SZ_OK;
+}
+
+static SRes SharedInStream_Seek(ILookInStreamPtr pp, Int64* pos, ESzSeek origin) {
+    GET_SharedInStream
+    UInt64 fileSize = p->file->GetSize();
+    Int64 base;
+    switch (origin) {
+    case SZ_SEEK_SET: base = 0; break;
+    case SZ_SEEK_CUR: base = (Int64)p->pos; break;
+    case SZ_SEEK_END: base = (Int64)fileSize; break;
+    default: return SZ_ERROR_PARAM;
+    }
+
+    Int64 target = base + *pos;
+    if (target < 0) return SZ_ERROR_PARAM;
+
+    // Positions past the end are clamped, reads there return no data. The
+    // buffer is kept: seeking back into it costs no read.
+    p->pos = (UInt64)target;
+    if (p->pos > fileSize) p->pos = fileSize;
+    *pos = (Int64)p->pos;
+    return SZ_OK;
+}
+
+void SharedInStream_Construct(CSharedInStream* p) {
+    p->vt.Look = SharedInStream_Look;
+    p->vt.Skip = SharedInStream_Skip;
+    p->vt.Read = SharedInStream_Read;
+    p->vt.Seek = SharedInStream_Seek;
+    p->file = nullptr;
+    p->event = nullptr;
+    p->buf = nullptr;
+    p->bufSize = 0;
+    p->bufStart = 0;
+    p->bufFilled = 0;
+    p->pos = 0;
+}
+
+bool SharedInStream_Init(CSharedInStream* p, const SharedFile* file, size_t bufSize) {
+    if (!p->event) {
+        p->event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!p->event) return false;
+    }
+    if (!p->buf || p->bufSize != bufSize) {
+        free(p->buf);
+        p->buf = (Byte*)malloc(bufSize);
+        p->bufSize = p->buf ? bufSize : 0;
+        if (!p->buf) return false;
+    }
+
+    p->file = file;
+    p->bufStart = 0;
+    p->bufFilled = 0;
+    p->pos = 0;
+    return true;
+}
+
+void SharedInStream_Free(CSharedInStream* p) {
+    if (p->event) CloseHandle(p->event);
+    free(p->buf);
+    p->event = nullptr;
+    p->buf = nullptr;
+    p->bufSize = 0;
+    p->bufFilled = 0;
+    p->file = nullptr;
+}
+
+} // namespace SevenZipView
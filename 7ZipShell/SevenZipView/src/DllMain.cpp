@@ -11,6 +11,7 @@
 #include "ContextMenu.h"
 #include "PropertyHandler.h"
 #include "IconHandler.h"
+#include "LzmaDecodeLoop.h"
 #include <cstdio>
 
 // Define CLSIDs
@@ -57,12 +58,16 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
         case DLL_PROCESS_ATTACH:
             g_hModule = hModule;
             DisableThreadLibraryCalls(hModule);
+            SevenZipView::SetLzmaDecodeLoop(SevenZipView::LzmaDecodeLoop::Fast);
             SEVENZIPVIEW_LOG(L"DLL_PROCESS_ATTACH - SevenZipView.dll loaded");
             break;
             
         case DLL_PROCESS_DETACH:
             SEVENZIPVIEW_LOG(L"DLL_PROCESS_DETACH - SevenZipView.dll unloading");
             SevenZipView::ArchivePool::Instance().Clear();
+            // The pool is never destroyed: with no budget, buffers freed
+            // from here on go straight back to the system
+            SevenZipView::BufferPool::Instance().SetBudget(0);
             break;
     }
     return TRUE;
@@ -70,7 +75,15 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
 
 // DllCanUnloadNow
 STDAPI DllCanUnloadNow() {
-    return (g_DllRefCount == 0) ? S_OK : S_FALSE;
+    // COM polls this while the process idles; a good moment to close
+    // archives the pool kept open past their idle timeout
+    SevenZipView::ArchivePool::Instance().Trim();
+    if (g_DllRefCount > 0) return S_FALSE;
+
+    // Nothing is browsing archives: decoder buffers kept for reuse would
+    // only sit in Explorer's heap
+    SevenZipView::BufferPool::Instance().Clear();
+    return S_OK;
 }
 
 // DllGetClassObject
@@ -7,13 +7,30 @@
 
 #include "ContextMenu.h"
 #include "Archive.h"
+#include "ExtractCache.h"
 #include "Extractor.h"
+#include "PasswordDialog.h"
 #include "ShellFolder.h"
 #include <strsafe.h>
 #include <shlobj.h>
+#include <unordered_set>
 
 namespace SevenZipView {
 
+// Ask for the password of an encrypted archive before the extractor reads
+// it; the extractor shares the pooled archive. False if the user cancelled.
+static bool UnlockArchive(const std::wstring& archivePath) {
+    auto archive = ArchivePool::Instance().GetArchive(archivePath);
+    if (!archive || !archive->IsOpen()) return true;   // Extractor reports it
+    return PasswordDialog::Unlock(nullptr, *archive);
+}
+
+// After a failed extraction, a wrong password is not offered again
+static void ForgetPassword(const std::wstring& archivePath, const std::vector<UINT32>& failedIndices) {
+    auto archive = ArchivePool::Instance().GetArchive(archivePath);
+    if (archive && archive->IsOpen()) PasswordDialog::ForgetIfRejected(*archive, failedIndices);
+}
+
 //==============================================================================
 // ArchiveContextMenuHandler - Context menu for .7z files
 //==============================================================================
@@ -180,10 +197,13 @@ bool ArchiveContextMenuHandler::ExtractHere() {
     opts.PreservePaths = true;
     opts.OverwriteExisting = false;
     
+    if (!UnlockArchive(_ArchivePath)) return false;
+    
     Extractor ext;
     ExtractResult result = ext.Extract(_ArchivePath, opts, nullptr);
     
     if (!result.Success) {
+        ForgetPassword(_ArchivePath, result.FailedIndices);
         MessageBoxW(nullptr, result.ErrorMessage.c_str(), L"Extraction Error", MB_OK | MB_ICONERROR);
         return false;
     }
@@ -216,10 +236,13 @@ bool ArchiveContextMenuHandler::ExtractToFolder() {
     opts.PreservePaths = true;
     opts.OverwriteExisting = false;
     
+    if (!UnlockArchive(_ArchivePath)) return false;
+    
     Extractor ext;
     ExtractResult result = ext.Extract(_ArchivePath, opts, nullptr);
     
     if (!result.Success) {
+        ForgetPassword(_ArchivePath, result.FailedIndices);
         MessageBoxW(nullptr, result.ErrorMessage.c_str(), L"Extraction Error", MB_OK | MB_ICONERROR);
         return false;
     }
@@ -229,16 +252,36 @@ bool ArchiveContextMenuHandler::ExtractToFolder() {
 
 bool ArchiveContextMenuHandler::TestArchive() {
     if (_ArchivePath.empty()) return false;
+    if (!UnlockArchive(_ArchivePath)) return false;
     
     Extractor ext;
-    bool ok = ext.TestArchive(_ArchivePath, nullptr);
+    TestResult result = ext.TestArchive(_ArchivePath, nullptr);
     
-    if (ok)
-        MessageBoxW(nullptr, L"Archive integrity test passed.", L"Test Archive", MB_OK | MB_ICONINFORMATION);
-    else
-        MessageBoxW(nullptr, L"Archive integrity test failed!", L"Test Archive", MB_OK | MB_ICONERROR);
+    wchar_t summary[256];
+    StringCchPrintfW(summary, ARRAYSIZE(summary), L"%u files, %.1f MB checked in %.2f s (%.1f MB/s, %u threads)",
+        result.FilesTested, result.BytesTested / (1024.0 * 1024.0), result.ElapsedSeconds,
+        result.GetThroughputMBps(), result.ThreadCount);
+    
+    if (result.Success) {
+        std::wstring message = L"Archive integrity test passed.\n\n";
+        message += summary;
+        MessageBoxW(nullptr, message.c_str(), L"Test Archive", MB_OK | MB_ICONINFORMATION);
+        return true;
+    }
     
-    return ok;
+    ForgetPassword(_ArchivePath, result.FailedIndices);
+    
+    // Name the failing entries, up to a screenful
+    const size_t maxListed = 20;
+    std::wstring message = L"Archive integrity test failed: " + result.ErrorMessage + L"\n\n";
+    for (size_t i = 0; i < result.FailedFiles.size() && i < maxListed; i++)
+        message += result.FailedFiles[i] + L"\n";
+    if (result.FailedFiles.size() > maxListed)
+        message += L"... and " + std::to_wstring(result.FailedFiles.size() - maxListed) + L" more\n";
+    message += L"\n";
+    message += summary;
+    MessageBoxW(nullptr, message.c_str(), L"Test Archive", MB_OK | MB_ICONERROR);
+    return false;
 }
 
 bool ArchiveContextMenuHandler::OpenWith7Zip() {
@@ -480,13 +523,18 @@ bool ItemContextMenuHandler::CopyItem(HWND hwnd) {
         SEVENZIPVIEW_LOG(L"CopyItem: FAIL - cannot open archive");
         return false;
     }
+    if (!PasswordDialog::Unlock(hwnd, *archive)) {
+        SEVENZIPVIEW_LOG(L"CopyItem: FAIL - password not given");
+        return false;
+    }
     
     // Get temp path with hash for stability
     std::wstring baseTempPath = GetTempCachePath();
     SEVENZIPVIEW_LOG(L"CopyItem: baseTempPath='%s'", baseTempPath.c_str());
     
-    Extractor ext;
     std::vector<std::wstring> extractedPaths;  // Files and folders to put on clipboard
+    std::vector<std::pair<UINT32, std::wstring>> targets;  // Every file to write
+    std::vector<std::wstring> copiedFiles;     // Selected files, written below
     
     // Get all entries from archive for folder expansion
     auto allEntries = archive->GetAllEntries();
@@ -531,8 +579,6 @@ bool ItemContextMenuHandler::CopyItem(HWND hwnd) {
             CreateDirectoryW(tempFolder.c_str(), nullptr);
             SEVENZIPVIEW_LOG(L"CopyItem: Created folder '%s'", tempFolder.c_str());
             
-            bool hasContent = false;
-            
             // Find and extract all files inside this folder
             for (const auto& entry : allEntries) {
                 // Check if this entry is inside the folder
@@ -556,21 +602,13 @@ bool ItemContextMenuHandler::CopyItem(HWND hwnd) {
                             CreateDirectoryW(parentDir.c_str(), nullptr);
                         }
                         
-                        // Extract the file
-                        if (ext.ExtractToFile(_ArchivePath, entry.ArchiveIndex, destPath)) {
-                            hasContent = true;
-                            SEVENZIPVIEW_LOG(L"CopyItem: Extracted '%s'", destPath.c_str());
-                        } else {
-                            SEVENZIPVIEW_LOG(L"CopyItem: FAILED to extract '%s'", destPath.c_str());
-                        }
+                        targets.push_back({ entry.ArchiveIndex, std::move(destPath) });
                     }
                 }
             }
             
             // Add folder to clipboard list (even if empty, to maintain folder structure)
-            if (hasContent || true) {
-                extractedPaths.push_back(tempFolder);
-            }
+            extractedPaths.push_back(tempFolder);
         } else {
             // For files: extract the individual file
             std::wstring safePath = SanitizePath(itemPath);
@@ -590,14 +628,26 @@ bool ItemContextMenuHandler::CopyItem(HWND hwnd) {
             
             SEVENZIPVIEW_LOG(L"CopyItem: FILE - extracting to '%s'", tempFile.c_str());
             
-            // Extract the file
-            if (ext.ExtractToFile(_ArchivePath, itemIndex, tempFile)) {
-                extractedPaths.push_back(tempFile);
-                SEVENZIPVIEW_LOG(L"CopyItem: FILE - extracted OK");
-            } else {
-                SEVENZIPVIEW_LOG(L"CopyItem: FILE - extraction FAILED");
-            }
+            targets.push_back({ itemIndex, tempFile });
+            copiedFiles.push_back(std::move(tempFile));
+        }
+    }
+    
+    // Files copied or opened before are linked from the extraction cache;
+    // the rest are decoded in one pass, into the cache first
+    ExtractCacheStats cacheStats;
+    ExtractResult result = ExtractCache::Instance().ExtractFiles(archive, targets, &cacheStats);
+    SEVENZIPVIEW_LOG(L"CopyItem: %u files extracted (%u cached, %u decoded), %u failed",
+        result.FilesExtracted, cacheStats.Hits, cacheStats.Extracted, result.FilesFailed);
+    if (result.FilesFailed > 0) PasswordDialog::ForgetIfRejected(*archive, result.FailedIndices);
+    
+    std::unordered_set<std::wstring> failed(result.FailedFiles.begin(), result.FailedFiles.end());
+    for (auto& tempFile : copiedFiles) {
+        if (failed.count(tempFile)) {
+            SEVENZIPVIEW_LOG(L"CopyItem: FILE - extraction FAILED - '%s'", tempFile.c_str());
+            continue;
         }
+        extractedPaths.push_back(std::move(tempFile));
     }
     
     SEVENZIPVIEW_LOG(L"CopyItem: extractedPaths count=%zu", extractedPaths.size());
@@ -648,6 +698,9 @@ bool ItemContextMenuHandler::CopyItem(HWND hwnd) {
 bool ItemContextMenuHandler::ExtractTo(HWND hwnd) {
     if (_ArchivePath.empty() || _Items.empty()) return false;
     
+    auto archive = ArchivePool::Instance().GetArchive(_ArchivePath);
+    if (archive && archive->IsOpen() && !PasswordDialog::Unlock(hwnd, *archive)) return false;
+    
     // Show folder picker
     IFileDialog* pfd = nullptr;
     HRESULT hr = CoCreateInstance(CLSID_FileOpenDialog, nullptr, CLSCTX_INPROC_SERVER,
@@ -665,6 +718,7 @@ bool ItemContextMenuHandler::ExtractTo(HWND hwnd) {
                 if (SUCCEEDED(psi->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
                     Extractor ext;
                     bool allOk = true;
+                    std::vector<UINT32> failedIndices;
                     
                     for (const auto& item : _Items) {
                         UINT32 itemIndex = item.first;
@@ -680,9 +734,13 @@ bool ItemContextMenuHandler::ExtractTo(HWND hwnd) {
                         std::wstring destPath = std::wstring(pszPath) + L"\\" + fileName;
                         if (!ext.ExtractToFile(_ArchivePath, itemIndex, destPath)) {
                             allOk = false;
+                            failedIndices.push_back(itemIndex);
                         }
                     }
                     
+                    if (!allOk && archive && archive->IsOpen())
+                        PasswordDialog::ForgetIfRejected(*archive, failedIndices);
+                    
                     CoTaskMemFree(pszPath);
                     psi->Release();
                     pfd->Release();
@@ -809,32 +867,21 @@ bool ItemContextMenuHandler::NavigateToFolder(HWND /*hwnd*/, const std::wstring&
     
     SEVENZIPVIEW_LOG(L"NavigateToFolder: folderName='%s'", folderName.c_str());
     
-    // Allocate PIDL with ItemData structure (same as ShellFolder::CreateItemID)
-    size_t itemSize = sizeof(ItemData);
-    size_t totalSize = itemSize + sizeof(USHORT); // Terminator
+    // Item ID of a folder child of the current folder; its path is
+    // rebuilt from the folder's path and this name
+    ItemIdFields fields;
+    fields.Type = ItemType::Folder;
+    fields.ArchiveIndex = ArchiveEntry::SYNTHETIC_FOLDER_INDEX;
+    fields.Attributes = FILE_ATTRIBUTE_DIRECTORY;
+    GetSystemTimeAsFileTime(&fields.ModifiedTime);
+    fields.Name = folderName;
     
-    PITEMID_CHILD itemPidl = static_cast<PITEMID_CHILD>(CoTaskMemAlloc(totalSize));
+    PITEMID_CHILD itemPidl = ShellFolder::CreateItemID(fields);
     if (!itemPidl) {
         SEVENZIPVIEW_LOG(L"NavigateToFolder: FAIL - CoTaskMemAlloc failed");
         return false;
     }
     
-    ZeroMemory(itemPidl, totalSize);
-    
-    ItemData* data = reinterpret_cast<ItemData*>(&itemPidl->mkid);
-    data->cb = static_cast<USHORT>(itemSize);
-    data->signature = ItemData::SIGNATURE;
-    data->type = ItemType::Folder;
-    data->archiveIndex = ArchiveEntry::SYNTHETIC_FOLDER_INDEX;
-    data->size = 0;
-    data->compressedSize = 0;
-    data->crc = 0;
-    data->attributes = FILE_ATTRIBUTE_DIRECTORY;
-    GetSystemTimeAsFileTime(&data->modifiedTime);
-    
-    StringCchCopyW(data->name, ARRAYSIZE(data->name), folderName.c_str());
-    StringCchCopyW(data->path, ARRAYSIZE(data->path), folderPath.c_str());
-    
     // Method 1: Use IShellBrowser::BrowseObject for in-place navigation (preferred)
     if (_Site) {
         IShellBrowser* pShellBrowser = nullptr;
@@ -904,11 +951,14 @@ bool ItemContextMenuHandler::OpenItem(HWND hwnd) {
         SEVENZIPVIEW_LOG(L"OpenItem: FAIL - cannot open archive");
         return false;
     }
+    if (!PasswordDialog::Unlock(hwnd, *archive)) {
+        SEVENZIPVIEW_LOG(L"OpenItem: FAIL - password not given");
+        return false;
+    }
     
     std::wstring cachePath = GetTempCachePath();
     SEVENZIPVIEW_LOG(L"OpenItem: cachePath='%s'", cachePath.c_str());
     
-    Extractor ext;
     bool allOk = true;
     
     for (const auto& item : _Items) {
@@ -970,13 +1020,19 @@ bool ItemContextMenuHandler::OpenItem(HWND hwnd) {
         }
         
         if (needExtract) {
+            // A file opened or dragged before is linked from the extraction
+            // cache instead of being decoded again
             SEVENZIPVIEW_LOG(L"OpenItem: Extracting file...");
-            if (!ext.ExtractToFile(_ArchivePath, itemIndex, tempFile)) {
+            ExtractCacheStats cacheStats;
+            ExtractResult result = ExtractCache::Instance().ExtractFiles(archive, { { itemIndex, tempFile } },
+                                                                         &cacheStats);
+            if (result.FilesExtracted != 1) {
                 SEVENZIPVIEW_LOG(L"OpenItem: Extraction FAILED");
+                PasswordDialog::ForgetIfRejected(*archive, { itemIndex });
                 allOk = false;
                 continue;
             }
-            SEVENZIPVIEW_LOG(L"OpenItem: Extraction OK");
+            SEVENZIPVIEW_LOG(L"OpenItem: Extraction OK (%s)", cacheStats.Hits ? L"cached" : L"decoded");
         }
         
         // Open the file with ShellExecute
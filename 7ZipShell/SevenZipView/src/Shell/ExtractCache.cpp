@@ -0,0 +1,383 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Persistent Extraction Cache Implementation
+*/
+
+#include "ExtractCache.h"
+#include "Archive.h"
+#include <chrono>
+#include <shlobj.h>
+
+namespace SevenZipView {
+
+static const wchar_t EXTRACT_CACHE_EXTENSION[] = L".dat";
+
+// Read size for checking the CRC of a cached file
+static const DWORD EXTRACT_CACHE_VERIFY_CHUNK = 1024 * 1024;
+
+// Delete a cached file or link, which may carry its entry's read-only bit
+static bool RemoveCachedFile(const std::wstring& path) {
+    if (DeleteFileW(path.c_str())) return true;
+    SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+    return DeleteFileW(path.c_str()) != FALSE;
+}
+
+ExtractCache& ExtractCache::Instance() {
+    static ExtractCache instance;
+    return instance;
+}
+
+ExtractCache::ExtractCache()
+    : _Enabled(true)
+    , _Budget(EXTRACT_CACHE_DEFAULT_BUDGET)
+    , _VerifyLimit(EXTRACT_CACHE_DEFAULT_VERIFY_LIMIT) {
+}
+
+void ExtractCache::SetEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Enabled = enabled;
+}
+
+bool ExtractCache::IsEnabled() const {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    return _Enabled;
+}
+
+void ExtractCache::SetDirectory(const std::wstring& directory) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Directory = directory;
+}
+
+void ExtractCache::SetBudget(UINT64 bytes) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Budget = bytes;
+}
+
+void ExtractCache::SetVerifyLimit(UINT64 bytes) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _VerifyLimit = bytes;
+}
+
+std::wstring ExtractCache::GetDirectoryLocked() {
+    if (!_Directory.empty()) return _Directory;
+
+    PWSTR localAppData = nullptr;
+    if (FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) return L"";
+    std::wstring root = std::wstring(localAppData) + L"\\SevenZipView";
+    CoTaskMemFree(localAppData);
+
+    CreateDirectoryW(root.c_str(), nullptr);
+    _Directory = root + L"\\ExtractCache";
+    CreateDirectoryW(_Directory.c_str(), nullptr);
+    return _Directory;
+}
+
+std::wstring ExtractCache::GetEntryPath(const std::wstring& directory, const ArchiveIdentity& identity,
+                                        UINT32 index, UINT32 crc, UINT64 size) const {
+    // FNV-1a 64 of the key. A collision only costs an extraction: the file
+    // is checked against the entry before use.
+    UINT64 hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t length) {
+        const BYTE* p = static_cast<const BYTE*>(data);
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ p[i]) * 1099511628211ull;
+    };
+    mix(&identity, sizeof(identity));
+    mix(&index, sizeof(index));
+    mix(&crc, sizeof(crc));
+    mix(&size, sizeof(size));
+
+    wchar_t name[32];
+    StringCchPrintfW(name, ARRAYSIZE(name), L"%016llx%s", hash, EXTRACT_CACHE_EXTENSION);
+    return directory + L"\\" + name;
+}
+
+bool ExtractCache::Verify(const std::wstring& path, UINT64 size, UINT32 crc, const FILETIME& modifiedTime,
+                          ExtractCacheStats& stats) const {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info)) return false;
+
+    UINT64 verifyLimit;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        verifyLimit = _VerifyLimit;
+    }
+
+    // Entries without a time keep the time they were written at. An edit
+    // through any hard link moves the write time of the cached file.
+    UINT64 fileSize = ((UINT64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    bool hasTime = modifiedTime.dwLowDateTime != 0 || modifiedTime.dwHighDateTime != 0;
+    bool ok = fileSize == size && (!hasTime || CompareFileTime(&info.ftLastWriteTime, &modifiedTime) == 0);
+
+    // A zero CRC is what the table holds for entries without one
+    if (ok && crc != 0 && size <= verifyLimit) {
+        HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE) return false;
+
+        std::vector<BYTE> buffer((size_t)(std::min)(size, (UINT64)EXTRACT_CACHE_VERIFY_CHUNK));
+        UINT32 value = CRC_INIT_VAL;
+        UINT64 remaining = size;
+        while (ok && remaining > 0) {
+            DWORD chunk = (DWORD)(std::min)(remaining, (UINT64)buffer.size());
+            DWORD read = 0;
+            ok = ReadFile(hFile, buffer.data(), chunk, &read, nullptr) && read == chunk;
+            if (ok) value = CrcUpdate(value, buffer.data(), read);
+            remaining -= chunk;
+        }
+        CloseHandle(hFile);
+
+        stats.BytesVerified += size - remaining;
+        ok = ok && CRC_GET_DIGEST(value) == crc;
+    }
+
+    if (!ok) {
+        stats.Damaged++;
+        SEVENZIPVIEW_LOG(L"ExtractCache: '%s' does not match its entry", path.c_str());
+    }
+    return ok;
+}
+
+bool ExtractCache::Materialize(std::shared_ptr<Archive> archive, const std::vector<UINT32>& indices,
+                               std::vector<std::wstring>& files, ExtractCacheStats* stats) {
+    files.assign(indices.size(), std::wstring());
+    ExtractCacheStats ownStats;
+    ExtractCacheStats& counts = stats ? *stats : ownStats;
+
+    ArchiveIdentity identity;
+    if (!archive || !archive->IsOpen() || !archive->GetIdentity(identity)) return false;
+
+    std::wstring directory;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        if (!_Enabled) return false;
+        directory = GetDirectoryLocked();
+        if (directory.empty()) return false;
+    }
+
+    // Misses are written under private names and renamed into place, so
+    // other processes never see a partial file
+    wchar_t suffix[32];
+    StringCchPrintfW(suffix, ARRAYSIZE(suffix), L".%lu.%lu.tmp", GetCurrentProcessId(), GetCurrentThreadId());
+
+    const EntryTable& table = archive->GetEntryTable();
+    std::vector<std::pair<UINT32, std::wstring>> targets;
+    std::vector<size_t> targetSlots;                    // Position in indices of each target
+    std::unordered_map<std::wstring, size_t> planned;   // Cached path -> its target
+    std::vector<std::pair<size_t, size_t>> repeats;     // Slot, target of a repeated entry
+    std::unordered_set<std::wstring> used;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        UINT32 index = indices[i];
+        if (index >= table.GetCount() || table.IsDirectory(index)) continue;
+
+        // Decrypted data is not left on disk beyond the session, and a
+        // wrong password's output may pass a missing CRC
+        if (table.IsEncrypted(index)) continue;
+
+        UINT64 size = table.GetSize(index);
+        UINT32 crc = table.GetCRC(index);
+        std::wstring path = GetEntryPath(directory, identity, index, crc, size);
+
+        auto it = planned.find(path);
+        if (it != planned.end()) {
+            repeats.push_back({ i, it->second });
+            continue;
+        }
+
+        if (used.count(path) || Verify(path, size, crc, table.GetModifiedTime(index), counts)) {
+            if (used.insert(path).second) {
+                Touch(path);
+                counts.Hits++;
+            }
+            files[i] = std::move(path);
+            continue;
+        }
+
+        planned[path] = targets.size();
+        targetSlots.push_back(i);
+        used.insert(path);
+        targets.push_back({ index, path + suffix });
+    }
+
+    if (targets.empty()) return true;
+
+    ExtractOptions options;
+    options.OverwriteExisting = true;
+    Extractor extractor;
+    ExtractResult result = extractor.ExtractFiles(archive, targets, options);
+    std::unordered_set<std::wstring> failed(result.FailedFiles.begin(), result.FailedFiles.end());
+
+    std::vector<bool> placed(targets.size(), false);
+    for (size_t t = 0; t < targets.size(); t++) {
+        const std::wstring& tempPath = targets[t].second;
+        std::wstring path = tempPath.substr(0, tempPath.size() - wcslen(suffix));
+
+        // A damaged file being replaced may be read-only like its entry;
+        // one held open without delete sharing cannot be replaced
+        bool ok = !failed.count(tempPath);
+        if (ok) {
+            SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+            ok = MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+        }
+        if (!ok) {
+            SEVENZIPVIEW_LOG(L"ExtractCache: could not cache entry %u of '%s' (error=%u)",
+                targets[t].first, archive->GetPath().c_str(), GetLastError());
+            RemoveCachedFile(tempPath);
+            counts.Failed++;
+            continue;
+        }
+
+        counts.Extracted++;
+        counts.BytesExtracted += table.GetSize(targets[t].first);
+        files[targetSlots[t]] = std::move(path);
+        placed[t] = true;
+    }
+
+    for (const auto& repeat : repeats) {
+        if (placed[repeat.second]) files[repeat.first] = files[targetSlots[repeat.second]];
+    }
+
+    // Files handed out by this call are not evicted before the caller has
+    // linked them
+    Trim(directory, used);
+    return true;
+}
+
+bool ExtractCache::LinkFile(const std::wstring& cachedFile, const std::wstring& destPath) {
+    // A name left by an earlier drop is replaced, like an overwritten file
+    RemoveCachedFile(destPath);
+
+    if (CreateHardLinkW(destPath.c_str(), cachedFile.c_str(), nullptr)) return true;
+
+    // Parent folders are created on demand, as extraction does
+    size_t slash = destPath.find_last_of(L"\\/");
+    if (slash != std::wstring::npos && slash > 0) {
+        SHCreateDirectoryExW(nullptr, destPath.substr(0, slash).c_str(), nullptr);
+        if (CreateHardLinkW(destPath.c_str(), cachedFile.c_str(), nullptr)) return true;
+    }
+    return CopyFileW(cachedFile.c_str(), destPath.c_str(), FALSE) != FALSE;
+}
+
+ExtractResult ExtractCache::ExtractFiles(std::shared_ptr<Archive> archive,
+                                         const std::vector<std::pair<UINT32, std::wstring>>& targets,
+                                         ExtractCacheStats* stats) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<UINT32> indices;
+    indices.reserve(targets.size());
+    for (const auto& target : targets)
+        indices.push_back(target.first);
+
+    std::vector<std::wstring> cached;
+    Materialize(archive, indices, cached, stats);
+
+    // Whatever the cache could not provide is extracted in place
+    std::vector<std::pair<UINT32, std::wstring>> direct;
+    UINT32 linked = 0;
+    UINT64 linkedBytes = 0;
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (!cached[i].empty() && LinkFile(cached[i], targets[i].second)) {
+            linked++;
+            linkedBytes += archive->GetEntryTable().GetSize(targets[i].first);
+            continue;
+        }
+        direct.push_back(targets[i]);
+    }
+
+    ExtractResult result;
+    result.Success = true;
+    if (!direct.empty()) {
+        ExtractOptions options;
+        options.OverwriteExisting = true;
+        Extractor extractor;
+        result = extractor.ExtractFiles(archive, direct, options);
+    }
+
+    result.FilesExtracted += linked;
+    result.BytesExtracted += linkedBytes;
+    result.ElapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return result;
+}
+
+void ExtractCache::Touch(const std::wstring& path) const {
+    // The last access time orders files for eviction; NTFS may not keep it
+    // current by itself
+    HANDLE hFile = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return;
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(hFile, nullptr, &now, nullptr);
+    CloseHandle(hFile);
+}
+
+void ExtractCache::Trim(const std::wstring& directory, const std::unordered_set<std::wstring>& keep) {
+    UINT64 budget;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        budget = _Budget;
+    }
+
+    struct CacheFile {
+        std::wstring    Path;
+        UINT64          Size;
+        UINT64          LastAccess;
+    };
+
+    std::vector<CacheFile> files;
+    UINT64 total = 0;
+
+    WIN32_FIND_DATAW fd;
+    std::wstring pattern = directory + L"\\*" + EXTRACT_CACHE_EXTENSION;
+    HANDLE hFind = FindFirstFileW(pattern.c_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE) return;
+    do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        UINT64 size = ((UINT64)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+        UINT64 lastAccess = ((UINT64)fd.ftLastAccessTime.dwHighDateTime << 32) | fd.ftLastAccessTime.dwLowDateTime;
+        files.push_back({ directory + L"\\" + fd.cFileName, size, lastAccess });
+        total += size;
+    } while (FindNextFileW(hFind, &fd));
+    FindClose(hFind);
+
+    if (total <= budget) return;
+
+    std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) {
+        return a.LastAccess < b.LastAccess;
+    });
+
+    // Files open in an application refuse deletion; skip them. Links in
+    // drop folders keep their data until they are deleted too.
+    for (const CacheFile& file : files) {
+        if (total <= budget) break;
+        if (keep.count(file.Path)) continue;
+        if (RemoveCachedFile(file.Path)) {
+            total -= file.Size;
+            SEVENZIPVIEW_LOG(L"ExtractCache: evicted '%s' (%llu bytes)", file.Path.c_str(), file.Size);
+        }
+    }
+}
+
+void ExtractCache::Clear() {
+    std::wstring directory;
+    {
+        std::lock_guard<std::mutex> lock(_Mutex);
+        directory = GetDirectoryLocked();
+    }
+    if (directory.empty()) return;
+
+    // Private files of interrupted extractions go too
+    WIN32_FIND_DATAW fd;
+    std::wstring pattern = directory + L"\\*";
+    HANDLE hFind = FindFirstFileW(pattern.c_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE) return;
+    do {
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            RemoveCachedFile(directory + L"\\" + fd.cFileName);
+    } while (FindNextFileW(hFind, &fd));
+    FindClose(hFind);
+}
+
+} // namespace SevenZipView
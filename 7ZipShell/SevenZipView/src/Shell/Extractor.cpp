@@ -6,7 +6,11 @@
 */
 
 #include "Extractor.h"
+#include "ArchiveReader.h"
 #include <strsafe.h>
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
 
 namespace SevenZipView {
 
@@ -14,6 +18,9 @@ namespace SevenZipView {
 // Helper functions
 //==============================================================================
 
+// Upper bound for decoder memory held at once when ThreadCount is auto
+static const UINT64 AUTO_DECODE_MEMORY_BUDGET = 1024ull * 1024 * 1024;
+
 static bool CreateDirectoryRecursive(const std::wstring& path) {
     if (path.empty()) return true;
     
@@ -32,16 +39,50 @@ static bool CreateDirectoryRecursive(const std::wstring& path) {
     return CreateDirectoryW(path.c_str(), nullptr) || GetLastError() == ERROR_ALREADY_EXISTS;
 }
 
-static void SetFileModifiedTime(const std::wstring& path, const FILETIME& ft) {
-    if (ft.dwLowDateTime == 0 && ft.dwHighDateTime == 0) return;
+// Sink of one worker thread: counts decoded bytes, stops once cancelled is
+// set and forwards each entry to an optional output sink. onBegin and onEnd
+// bracket every entry; onEnd gets whether the output completed it (or, with
+// no output, whether it decoded and matched its CRC).
+class WorkerSink : public IExtractSink {
+public:
+    typedef std::function<void(UINT32 index)> BeginFunc;
+    typedef std::function<void(UINT32 index, bool done)> EndFunc;
+    
+    WorkerSink(const std::atomic<bool>& cancelled, std::atomic<UINT64>& bytesDone, IExtractSink* output,
+               BeginFunc onBegin, EndFunc onEnd)
+        : _Cancelled(cancelled), _BytesDone(bytesDone), _Output(output)
+        , _OnBegin(std::move(onBegin)), _OnEnd(std::move(onEnd)), _Index(0) {}
+    
+    bool OnBegin(UINT32 index, UINT64 size) override {
+        if (_Cancelled.load()) return false;
+        _Index = index;
+        if (_OnBegin) _OnBegin(index);
+        // A target that cannot be created only fails this entry
+        if (_Output) _Output->OnBegin(index, size);
+        return true;
+    }
     
-    HANDLE hFile = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES, 0, nullptr,
-        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (hFile != INVALID_HANDLE_VALUE) {
-        SetFileTime(hFile, nullptr, nullptr, &ft);
-        CloseHandle(hFile);
+    bool OnChunk(const BYTE* data, size_t size) override {
+        if (_Cancelled.load()) return false;
+        _BytesDone += size;
+        if (_Output) _Output->OnChunk(data, size);
+        return true;
     }
-}
+    
+    bool OnEnd(bool ok) override {
+        bool done = _Output ? _Output->OnEnd(ok) : ok;
+        if (_OnEnd) _OnEnd(_Index, done);
+        return done;
+    }
+    
+private:
+    const std::atomic<bool>&    _Cancelled;
+    std::atomic<UINT64>&        _BytesDone;
+    IExtractSink*               _Output;
+    BeginFunc                   _OnBegin;
+    EndFunc                     _OnEnd;
+    UINT32                      _Index;
+};
 
 //==============================================================================
 // Extractor
@@ -59,6 +100,7 @@ ExtractResult Extractor::Extract(
     IExtractProgress* progress) {
     
     ExtractResult result;
+    auto startTime = std::chrono::steady_clock::now();
     
     auto archive = ArchivePool::Instance().GetArchive(archivePath);
     if (!archive || !archive->IsOpen()) {
@@ -66,6 +108,12 @@ ExtractResult Extractor::Extract(
         return result;
     }
     
+    // An archive listed from the index cache parses its header here
+    if (!archive->EnsureDatabase()) {
+        result.ErrorMessage = L"Failed to read archive header";
+        return result;
+    }
+    
     // Get entries to extract
     std::vector<ArchiveEntry> entries;
     if (options.ItemIndices.empty()) {
@@ -99,16 +147,11 @@ ExtractResult Extractor::Extract(
         return result;
     }
     
-    // Extract files
-    UINT64 bytesExtracted = 0;
-    UINT32 filesExtracted = 0;
+    // Resolve destination paths and create directory entries up front
+    std::vector<PlannedFile> files;
+    files.reserve(totalFiles);
     
     for (const auto& entry : entries) {
-        if (progress && progress->IsCancelled()) {
-            result.ErrorMessage = L"Cancelled by user";
-            break;
-        }
-        
         std::wstring destPath = options.DestinationPath;
         if (!destPath.empty() && destPath.back() != L'\\' && destPath.back() != L'/')
             destPath += L'\\';
@@ -123,6 +166,152 @@ ExtractResult Extractor::Extract(
             continue;
         }
         
+        files.push_back({ entry, std::move(destPath) });
+    }
+    
+    ExtractResolved(archive, files, options, totalSize, progress, result);
+    result.ElapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    
+    if (progress)
+        progress->OnComplete(result.Success, result.ErrorMessage);
+    
+    return result;
+}
+
+ExtractResult Extractor::ExtractFiles(
+    std::shared_ptr<Archive> archive,
+    const std::vector<std::pair<UINT32, std::wstring>>& targets,
+    const ExtractOptions& options,
+    IExtractProgress* progress) {
+    
+    ExtractResult result;
+    auto startTime = std::chrono::steady_clock::now();
+    
+    if (!archive || !archive->IsOpen() || !archive->EnsureDatabase()) {
+        result.ErrorMessage = L"Failed to read archive header";
+        return result;
+    }
+    
+    std::vector<PlannedFile> files;
+    files.reserve(targets.size());
+    UINT64 totalSize = 0;
+    
+    for (const auto& target : targets) {
+        PlannedFile file;
+        if (!archive->GetEntry(target.first, file.Entry) || file.Entry.IsDirectory())
+            continue;
+        file.DestPath = target.second;
+        totalSize += file.Entry.Size;
+        files.push_back(std::move(file));
+    }
+    
+    if (progress)
+        progress->OnStart((UINT32)files.size(), totalSize);
+    
+    ExtractResolved(archive, files, options, totalSize, progress, result);
+    result.ElapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    
+    if (progress)
+        progress->OnComplete(result.Success, result.ErrorMessage);
+    
+    return result;
+}
+
+void Extractor::ExtractResolved(
+    std::shared_ptr<Archive> archive,
+    const std::vector<PlannedFile>& files,
+    const ExtractOptions& options,
+    UINT64 totalSize,
+    IExtractProgress* progress,
+    ExtractResult& result) {
+    
+    // The password stays with the archive, so later reads through the
+    // pool decrypt with it too, and its derived key is reused
+    if (!options.Password.empty())
+        archive->SetPassword(options.Password);
+    
+    std::vector<UINT32> indices;
+    indices.reserve(files.size());
+    for (const auto& file : files)
+        indices.push_back(file.Entry.ArchiveIndex);
+    
+    size_t windowSize = options.DecodeWindowSize ? options.DecodeWindowSize : FOLDER_DECODER_DEFAULT_WINDOW;
+    UINT32 threadCount = ResolveThreadCount(archive->GetDatabase(), indices, options.ThreadCount, windowSize);
+    
+    ExtractPlanned(archive, files, options.OverwriteExisting, threadCount, windowSize, options.WriterThreads,
+                   totalSize, progress, result);
+    
+    result.Success = (result.FilesFailed == 0);
+    if (!result.Success && result.ErrorMessage.empty() && archive->HasEncryptedEntries())
+        result.ErrorMessage = archive->HasPassword() ? L"Wrong password, or the archive is damaged"
+                                                     : L"The archive is encrypted: a password is required";
+    
+    SEVENZIPVIEW_LOG(L"Extract plan: %u blocks, %llu bytes needed, %llu bytes decoded",
+        result.Plan.BlocksTouched, result.Plan.BytesNeeded, result.Plan.BytesDecoded);
+    SEVENZIPVIEW_LOG(L"Extract writer: %u files, %llu bytes, %u failed, decoders waited %u times (%.3fs)",
+        result.Writer.FilesWritten, result.Writer.BytesWritten, result.Writer.FilesFailed,
+        result.Writer.Stalls, result.Writer.StallSeconds);
+#if SEVENZIPVIEW_ENABLE_LOG
+    for (const auto& stats : result.WorkerStats) {
+        SEVENZIPVIEW_LOG(L"Extract worker %u: %u folders, %u files, %llu bytes, %.3fs, %.1f MB/s",
+            stats.WorkerId, stats.FoldersDecoded, stats.FilesExtracted,
+            stats.BytesExtracted, stats.Seconds, stats.GetThroughputMBps());
+    }
+#endif
+}
+
+UINT32 Extractor::ResolveThreadCount(
+    const CSzArEx& db,
+    const std::vector<UINT32>& indices,
+    UINT32 requested,
+    size_t windowSize) {
+    
+    // Independent solid blocks are the unit of parallelism
+    std::vector<bool> seen(db.db.NumFolders, false);
+    UINT32 folderCount = 0;
+    UINT64 largestDecoder = 0;
+    
+    for (UINT32 index : indices) {
+        UInt32 folder = db.FileToFolder[index];
+        if (folder == (UInt32)-1 || seen[folder]) continue;
+        seen[folder] = true;
+        folderCount++;
+        largestDecoder = (std::max)(largestDecoder, FolderDecoder::EstimateMemory(db, folder, windowSize));
+    }
+    
+    UINT32 threadCount = requested;
+    if (threadCount == 0) {
+        threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+        
+        // Every worker holds a dictionary and window, keep the total bounded
+        while (threadCount > 1 && (UINT64)threadCount * largestDecoder > AUTO_DECODE_MEMORY_BUDGET)
+            threadCount--;
+    }
+    
+    return (std::max)(1u, (std::min)(threadCount, folderCount));
+}
+
+void Extractor::ExtractSerial(
+    std::shared_ptr<Archive> archive,
+    const std::vector<PlannedFile>& files,
+    bool overwriteExisting,
+    UINT64 totalSize,
+    IExtractProgress* progress,
+    ExtractResult& result) {
+    
+    auto startTime = std::chrono::steady_clock::now();
+    UINT64 bytesExtracted = 0;
+    UINT32 filesExtracted = 0;
+    
+    for (const auto& file : files) {
+        const ArchiveEntry& entry = file.Entry;
+        const std::wstring& destPath = file.DestPath;
+        
+        if (progress && progress->IsCancelled()) {
+            result.ErrorMessage = L"Cancelled by user";
+            break;
+        }
+        
         if (progress)
             progress->OnProgress(entry.Name, filesExtracted, bytesExtracted, totalSize);
         
@@ -132,31 +321,241 @@ ExtractResult Extractor::Extract(
             CreateDirectoryRecursive(destPath.substr(0, lastSlash));
         
         // Check if file exists
-        if (!options.OverwriteExisting && GetFileAttributesW(destPath.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        if (!overwriteExisting && GetFileAttributesW(destPath.c_str()) != INVALID_FILE_ATTRIBUTES) {
             result.FilesFailed++;
             result.FailedFiles.push_back(destPath);
+            result.FailedIndices.push_back(entry.ArchiveIndex);
             continue;
         }
         
         // Extract the file
         if (archive->ExtractToFile(entry.ArchiveIndex, destPath)) {
-            SetFileModifiedTime(destPath, entry.ModifiedTime);
             bytesExtracted += entry.Size;
             filesExtracted++;
         } else {
             result.FilesFailed++;
             result.FailedFiles.push_back(destPath);
+            result.FailedIndices.push_back(entry.ArchiveIndex);
         }
     }
     
-    result.Success = (result.FilesFailed == 0);
     result.FilesExtracted = filesExtracted;
     result.BytesExtracted = bytesExtracted;
+    result.ThreadCount = 1;
     
-    if (progress)
-        progress->OnComplete(result.Success, result.ErrorMessage);
+    ExtractWorkerStats stats;
+    stats.FilesExtracted = filesExtracted;
+    stats.BytesExtracted = bytesExtracted;
+    stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.WorkerStats.push_back(stats);
+}
+
+void Extractor::ExtractPlanned(
+    std::shared_ptr<Archive> archive,
+    const std::vector<PlannedFile>& files,
+    bool overwriteExisting,
+    UINT32 threadCount,
+    size_t decodeWindowSize,
+    UINT32 writerThreads,
+    UINT64 totalSize,
+    IExtractProgress* progress,
+    ExtractResult& result) {
+    
+    // Give every worker its own stream and block cache before touching the disk
+    std::vector<std::unique_ptr<ArchiveReader>> readers;
+    for (UINT32 i = 0; i < threadCount; i++) {
+        auto reader = std::make_unique<ArchiveReader>(archive);
+        if (!reader->Open()) break;
+        reader->SetDecodeWindowSize(decodeWindowSize);
+        readers.push_back(std::move(reader));
+    }
     
-    return result;
+    if (readers.empty()) {
+        SEVENZIPVIEW_LOG(L"Extractor: could not open a reader stream, extracting serially");
+        ExtractSerial(archive, files, overwriteExisting, totalSize, progress, result);
+        return;
+    }
+    
+    enum class FileState : BYTE { Pending, Done, Failed, Deferred };
+    std::vector<FileState> states(files.size(), FileState::Pending);
+    
+    const CSzArEx& db = archive->GetDatabase();
+    std::unordered_map<UINT32, size_t> fileByIndex;
+    std::unordered_map<std::wstring, size_t> plannedPaths;
+    std::unordered_set<std::wstring> createdDirs;
+    std::vector<UINT32> indices;
+    
+    // Same checks as the serial path, done once here so workers never race
+    // on them. Files share few directories; each is created only once.
+    for (size_t i = 0; i < files.size(); i++) {
+        const std::wstring& destPath = files[i].DestPath;
+        
+        size_t lastSlash = destPath.find_last_of(L"\\/");
+        if (lastSlash != std::wstring::npos) {
+            std::wstring dir = destPath.substr(0, lastSlash);
+            if (createdDirs.insert(dir).second)
+                CreateDirectoryRecursive(dir);
+        }
+        
+        std::wstring key = destPath;
+        for (auto& c : key) {
+            c = towlower(c);
+            if (c == L'/') c = L'\\';
+        }
+        bool alreadyPlanned = plannedPaths.find(key) != plannedPaths.end();
+        
+        if (!overwriteExisting &&
+            (alreadyPlanned || GetFileAttributesW(destPath.c_str()) != INVALID_FILE_ATTRIBUTES)) {
+            states[i] = FileState::Failed;
+            continue;
+        }
+        plannedPaths[key] = i;
+        
+        // Empty files have no folder; repeated targets must keep their order,
+        // and an entry wanted at several paths is decoded for the first
+        UINT32 index = files[i].Entry.ArchiveIndex;
+        if (alreadyPlanned || db.FileToFolder[index] == (UInt32)-1 || fileByIndex.count(index)) {
+            states[i] = FileState::Deferred;
+            continue;
+        }
+        
+        fileByIndex[index] = i;
+        indices.push_back(index);
+    }
+    
+    // Every folder is decoded once, front to back, and only as far as needed
+    ExtractPlan plan;
+    plan.Build(db, indices);
+    result.Plan = plan.GetStats();
+    
+    // Largest blocks go first so workers finish together
+    std::vector<const FolderPlan*> jobs;
+    jobs.reserve(plan.GetFolders().size());
+    for (const auto& folder : plan.GetFolders())
+        jobs.push_back(&folder);
+    std::sort(jobs.begin(), jobs.end(), [](const FolderPlan* a, const FolderPlan* b) {
+        return a->GetBytesToDecode() > b->GetBytesToDecode();
+    });
+    
+    if (readers.size() > jobs.size())
+        readers.resize((std::max)((size_t)1, jobs.size()));
+    
+    std::atomic<size_t> nextJob(0);
+    std::atomic<bool> cancelled(false);
+    std::atomic<UINT32> filesDone(0);
+    std::atomic<UINT64> bytesDone(0);
+    std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    size_t activeWorkers = readers.size();
+    std::wstring currentName;
+    
+    // Writers report each file, on their own threads or on a decoder's
+    FileWriter writer(*archive, [&](UINT32 index, bool ok) {
+        size_t fileIndex = fileByIndex.at(index);
+        states[fileIndex] = ok ? FileState::Done : FileState::Failed;
+        filesDone++;
+    }, writerThreads);
+    
+    std::vector<ExtractWorkerStats> workerStats(readers.size());
+    std::vector<std::thread> workers;
+    workers.reserve(readers.size());
+    
+    for (size_t w = 0; w < readers.size(); w++) {
+        workers.emplace_back([&, w]() {
+            ArchiveReader& reader = *readers[w];
+            ExtractWorkerStats& stats = workerStats[w];
+            stats.WorkerId = (UINT32)w;
+            auto workerStart = std::chrono::steady_clock::now();
+            WriterSink output(writer);
+            
+            for (;;) {
+                size_t jobIndex = nextJob.fetch_add(1);
+                if (jobIndex >= jobs.size() || cancelled.load()) break;
+                
+                stats.FoldersDecoded++;
+                
+                // Entries are queued for the writers as they decode
+                WorkerSink sink(cancelled, bytesDone, &output,
+                    [&](UINT32 index) {
+                        const PlannedFile& file = files[fileByIndex.at(index)];
+                        output.SetPath(file.DestPath);
+                        std::lock_guard<std::mutex> lock(stateMutex);
+                        currentName = file.Entry.Name;
+                    },
+                    [&](UINT32 index, bool done) {
+                        if (!done) return;
+                        stats.FilesExtracted++;
+                        stats.BytesExtracted += files[fileByIndex.at(index)].Entry.Size;
+                    });
+                reader.ExtractFolder(*jobs[jobIndex], sink);
+            }
+            
+            // Release the reader's buffers as soon as this worker is done
+            reader.Close();
+            stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - workerStart).count();
+            
+            std::lock_guard<std::mutex> lock(stateMutex);
+            activeWorkers--;
+            stateChanged.notify_all();
+        });
+    }
+    
+    // Progress and cancellation stay on the calling thread
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        while (activeWorkers > 0) {
+            stateChanged.wait_for(lock, std::chrono::milliseconds(100));
+            if (!progress) continue;
+            
+            std::wstring name = currentName;
+            lock.unlock();
+            if (progress->IsCancelled()) {
+                cancelled = true;
+                writer.Cancel();
+            }
+            progress->OnProgress(name, filesDone.load(), bytesDone.load(), totalSize);
+            lock.lock();
+        }
+    }
+    
+    for (auto& worker : workers)
+        worker.join();
+    
+    // What is still queued is at most FILE_WRITER_DEFAULT_QUEUE bytes
+    if (cancelled.load())
+        writer.Cancel();
+    writer.Finish();
+    result.Writer = writer.GetStats();
+    
+    // Empty files and repeated destinations run last, in request order
+    for (size_t i = 0; i < files.size() && !cancelled.load(); i++) {
+        if (states[i] != FileState::Deferred) continue;
+        
+        const PlannedFile& file = files[i];
+        if (archive->ExtractToFile(file.Entry.ArchiveIndex, file.DestPath)) {
+            states[i] = FileState::Done;
+        } else {
+            states[i] = FileState::Failed;
+        }
+    }
+    
+    if (cancelled.load())
+        result.ErrorMessage = L"Cancelled by user";
+    
+    // Tally in request order so FailedFiles matches the serial path
+    for (size_t i = 0; i < files.size(); i++) {
+        if (states[i] == FileState::Done) {
+            result.FilesExtracted++;
+            result.BytesExtracted += files[i].Entry.Size;
+        } else if (states[i] == FileState::Failed) {
+            result.FilesFailed++;
+            result.FailedFiles.push_back(files[i].DestPath);
+            result.FailedIndices.push_back(files[i].Entry.ArchiveIndex);
+        }
+    }
+    
+    result.ThreadCount = (UINT32)workers.size();
+    result.WorkerStats = std::move(workerStats);
 }
 
 bool Extractor::ExtractToBuffer(
@@ -194,50 +593,172 @@ bool Extractor::ExtractToFile(
     return result;
 }
 
-bool Extractor::TestArchive(
+TestResult Extractor::TestArchive(
     const std::wstring& archivePath,
-    IExtractProgress* progress) {
+    IExtractProgress* progress,
+    UINT32 threadCount) {
+    
+    TestResult result;
+    auto startTime = std::chrono::steady_clock::now();
     
     auto archive = ArchivePool::Instance().GetArchive(archivePath);
-    if (!archive || !archive->IsOpen())
-        return false;
+    if (!archive || !archive->IsOpen()) {
+        result.ErrorMessage = L"Failed to open archive";
+        return result;
+    }
+    if (!archive->EnsureDatabase()) {
+        result.ErrorMessage = L"Failed to read archive header";
+        return result;
+    }
+    
+    const CSzArEx& db = archive->GetDatabase();
+    const EntryTable& entries = archive->GetEntryTable();
+    
+    // Files with data go to the plan; empty ones have nothing to check
+    std::vector<UINT32> indices;
+    UINT32 totalFiles = 0;
+    for (UINT32 i = 0; i < entries.GetCount(); i++) {
+        if (entries.IsDirectory(i)) continue;
+        totalFiles++;
+        if (db.FileToFolder[i] != (UInt32)-1)
+            indices.push_back(i);
+    }
     
-    UINT32 count = archive->GetItemCount();
+    UINT64 totalSize = entries.GetTotalSize();
     if (progress)
-        progress->OnStart(count, archive->GetTotalUncompressedSize());
+        progress->OnStart(totalFiles, totalSize);
     
-    std::vector<BYTE> buffer;
-    UINT64 bytesProcessed = 0;
+    ExtractPlan plan;
+    plan.Build(db, indices);
+    
+    std::vector<const FolderPlan*> jobs;
+    jobs.reserve(plan.GetFolders().size());
+    for (const auto& folder : plan.GetFolders())
+        jobs.push_back(&folder);
+    std::sort(jobs.begin(), jobs.end(), [](const FolderPlan* a, const FolderPlan* b) {
+        return a->GetBytesToDecode() > b->GetBytesToDecode();
+    });
+    
+    threadCount = ResolveThreadCount(db, indices, threadCount, FOLDER_DECODER_DEFAULT_WINDOW);
+    std::vector<std::unique_ptr<ArchiveReader>> readers;
+    for (UINT32 i = 0; i < threadCount; i++) {
+        auto reader = std::make_unique<ArchiveReader>(archive);
+        if (!reader->Open()) break;
+        readers.push_back(std::move(reader));
+    }
+    if (readers.empty() && !jobs.empty()) {
+        result.ErrorMessage = L"Failed to open the archive for reading";
+        if (progress)
+            progress->OnComplete(false, result.ErrorMessage);
+        return result;
+    }
     
-    for (UINT32 i = 0; i < count; i++) {
-        if (progress && progress->IsCancelled())
-            return false;
-        
-        ArchiveEntry entry;
-        if (!archive->GetEntry(i, entry))
-            continue;
-        
-        if (entry.IsDirectory())
-            continue;
+    enum class FileState : BYTE { Untested, Passed, Failed };
+    std::vector<FileState> states(entries.GetCount(), FileState::Untested);
+    
+    std::atomic<size_t> nextJob(0);
+    std::atomic<bool> cancelled(false);
+    std::atomic<UINT32> filesDone(0);
+    std::atomic<UINT64> bytesDone(0);
+    std::mutex stateMutex;
+    std::condition_variable stateChanged;
+    size_t activeWorkers = readers.size();
+    UINT32 currentIndex = (UINT32)-1;
+    
+    std::vector<std::thread> workers;
+    workers.reserve(readers.size());
+    
+    for (size_t w = 0; w < readers.size(); w++) {
+        workers.emplace_back([&, w]() {
+            ArchiveReader& reader = *readers[w];
+            
+            for (;;) {
+                size_t jobIndex = nextJob.fetch_add(1);
+                if (jobIndex >= jobs.size() || cancelled.load()) break;
+                
+                // The decoder CRCs every chunk as it streams; data is not kept
+                WorkerSink sink(cancelled, bytesDone, nullptr, nullptr,
+                    [&](UINT32 index, bool ok) {
+                        states[index] = ok ? FileState::Passed : FileState::Failed;
+                        filesDone++;
+                        std::lock_guard<std::mutex> lock(stateMutex);
+                        currentIndex = index;
+                    });
+                reader.ExtractFolder(*jobs[jobIndex], sink);
+            }
+            
+            reader.Close();
+            
+            std::lock_guard<std::mutex> lock(stateMutex);
+            activeWorkers--;
+            stateChanged.notify_all();
+        });
+    }
+    
+    // Progress and cancellation stay on the calling thread
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        while (activeWorkers > 0) {
+            stateChanged.wait_for(lock, std::chrono::milliseconds(100));
+            if (!progress) continue;
+            
+            std::wstring name = (currentIndex != (UInt32)-1) ? std::wstring(entries.GetPath(currentIndex)) : std::wstring();
+            lock.unlock();
+            if (progress->IsCancelled())
+                cancelled = true;
+            progress->OnProgress(name, filesDone.load(), bytesDone.load(), totalSize);
+            lock.lock();
+        }
+    }
+    
+    for (auto& worker : workers)
+        worker.join();
+    
+    // Tally in archive order
+    for (UINT32 i = 0; i < entries.GetCount(); i++) {
+        if (entries.IsDirectory(i)) continue;
         
-        if (progress)
-            progress->OnProgress(entry.Name, i, bytesProcessed, archive->GetTotalUncompressedSize());
+        FileState state = states[i];
+        if (db.FileToFolder[i] == (UInt32)-1)
+            state = FileState::Passed;
         
-        buffer.clear();
-        if (!archive->ExtractToBuffer(i, buffer)) {
-            if (progress)
-                progress->OnComplete(false, L"Failed to extract: " + entry.Name);
-            return false;
+        if (state == FileState::Passed) {
+            result.FilesTested++;
+            result.BytesTested += entries.GetSize(i);
+        } else if (state == FileState::Failed) {
+            result.FilesTested++;
+            result.FilesFailed++;
+            result.FailedFiles.push_back(std::wstring(entries.GetPath(i)));
+            result.FailedIndices.push_back(i);
         }
-        
-        // TODO: Verify CRC if needed
-        bytesProcessed += entry.Size;
     }
     
+    result.ThreadCount = (UINT32)workers.size();
+    result.ElapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.Success = !cancelled.load() && result.FilesFailed == 0 && result.FilesTested == totalFiles;
+    
+    if (cancelled.load()) {
+        result.ErrorMessage = L"Cancelled by user";
+    } else if (result.FilesFailed > 0 && archive->HasEncryptedEntries() && !archive->HasPassword()) {
+        result.ErrorMessage = L"The archive is encrypted: a password is required";
+    } else if (result.FilesFailed > 0) {
+        result.ErrorMessage = std::to_wstring(result.FilesFailed) + L" file(s) failed the CRC check";
+    } else if (result.FilesTested != totalFiles) {
+        result.ErrorMessage = L"Not every file could be tested";
+    }
+    
+    SEVENZIPVIEW_LOG(L"TestArchive: %u files, %u failed, %llu bytes in %.3fs = %.1f MB/s on %u threads",
+        result.FilesTested, result.FilesFailed, result.BytesTested, result.ElapsedSeconds,
+        result.GetThroughputMBps(), result.ThreadCount);
+#if SEVENZIPVIEW_ENABLE_LOG
+    for (const auto& name : result.FailedFiles)
+        SEVENZIPVIEW_LOG(L"TestArchive: FAILED %s", name.c_str());
+#endif
+    
     if (progress)
-        progress->OnComplete(true, L"");
+        progress->OnComplete(result.Success, result.ErrorMessage);
     
-    return true;
+    return result;
 }
 
 bool Extractor::EnsureDirectoryExists(const std::wstring& path) {
@@ -252,163 +773,4 @@ std::wstring Extractor::MakeValidPath(const std::wstring& basePath, const std::w
     return result;
 }
 
-//==============================================================================
-// ProgressDialog
-//==============================================================================
-
-ProgressDialog::ProgressDialog(HWND parent)
-    : _ParentHwnd(parent)
-    , _DialogHwnd(nullptr)
-    , _ProgressBar(nullptr)
-    , _StatusText(nullptr)
-    , _FileText(nullptr)
-    , _Cancelled(false)
-    , _TotalItems(0)
-    , _TotalSize(0) {
-}
-
-ProgressDialog::~ProgressDialog() {
-    Hide();
-}
-
-void ProgressDialog::Show() {
-    if (_DialogHwnd) return;
-    CreateDialogWindow();
-}
-
-void ProgressDialog::Hide() {
-    if (_DialogHwnd) {
-        DestroyWindow(_DialogHwnd);
-        _DialogHwnd = nullptr;
-    }
-}
-
-void ProgressDialog::OnStart(UINT32 totalItems, UINT64 totalSize) {
-    _TotalItems = totalItems;
-    _TotalSize = totalSize;
-    _Cancelled = false;
-    
-    if (_ProgressBar)
-        SendMessageW(_ProgressBar, PBM_SETRANGE32, 0, 100);
-}
-
-void ProgressDialog::OnProgress(
-    const std::wstring& currentFile,
-    UINT32 currentItem,
-    UINT64 bytesProcessed,
-    UINT64 totalBytes) {
-    
-    UpdateProgress(currentItem, _TotalItems, bytesProcessed, totalBytes);
-    SetCurrentFile(currentFile);
-    
-    // Process messages to keep UI responsive
-    MSG msg;
-    while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
-        TranslateMessage(&msg);
-        DispatchMessageW(&msg);
-    }
-}
-
-void ProgressDialog::OnComplete(bool success, const std::wstring& errorMessage) {
-    Hide();
-}
-
-bool ProgressDialog::IsCancelled() const {
-    return _Cancelled;
-}
-
-void ProgressDialog::CreateDialogWindow() {
-    // Register window class
-    WNDCLASSEXW wc = { sizeof(wc) };
-    wc.lpfnWndProc = DialogProc;
-    wc.hInstance = g_hModule;
-    wc.hCursor = LoadCursorW(nullptr, IDC_ARROW);
-    wc.hbrBackground = reinterpret_cast<HBRUSH>(COLOR_WINDOW + 1);
-    wc.lpszClassName = L"SevenZipViewProgress";
-    RegisterClassExW(&wc);
-    
-    // Create dialog window
-    _DialogHwnd = CreateWindowExW(
-        WS_EX_DLGMODALFRAME,
-        L"SevenZipViewProgress",
-        L"Extracting...",
-        WS_POPUP | WS_CAPTION | WS_SYSMENU,
-        CW_USEDEFAULT, CW_USEDEFAULT, 400, 150,
-        _ParentHwnd, nullptr, g_hModule, this);
-    
-    if (!_DialogHwnd) return;
-    
-    // Create progress bar
-    _ProgressBar = CreateWindowExW(0, PROGRESS_CLASSW, nullptr,
-        WS_CHILD | WS_VISIBLE | PBS_SMOOTH,
-        20, 50, 360, 25,
-        _DialogHwnd, nullptr, g_hModule, nullptr);
-    
-    // Create status text
-    _StatusText = CreateWindowExW(0, L"STATIC", L"Preparing...",
-        WS_CHILD | WS_VISIBLE | SS_LEFT,
-        20, 20, 360, 20,
-        _DialogHwnd, nullptr, g_hModule, nullptr);
-    
-    // Create file text
-    _FileText = CreateWindowExW(0, L"STATIC", L"",
-        WS_CHILD | WS_VISIBLE | SS_LEFT | SS_PATHELLIPSIS,
-        20, 85, 360, 20,
-        _DialogHwnd, nullptr, g_hModule, nullptr);
-    
-    // Center and show
-    RECT rc;
-    GetWindowRect(_DialogHwnd, &rc);
-    int x = (GetSystemMetrics(SM_CXSCREEN) - (rc.right - rc.left)) / 2;
-    int y = (GetSystemMetrics(SM_CYSCREEN) - (rc.bottom - rc.top)) / 2;
-    SetWindowPos(_DialogHwnd, nullptr, x, y, 0, 0, SWP_NOSIZE | SWP_NOZORDER);
-    
-    ShowWindow(_DialogHwnd, SW_SHOW);
-    UpdateWindow(_DialogHwnd);
-}
-
-void ProgressDialog::UpdateProgress(UINT32 current, UINT32 total, UINT64 bytes, UINT64 totalBytes) {
-    if (!_ProgressBar) return;
-    
-    int percent = 0;
-    if (totalBytes > 0)
-        percent = static_cast<int>((bytes * 100) / totalBytes);
-    
-    SendMessageW(_ProgressBar, PBM_SETPOS, percent, 0);
-    
-    if (_StatusText) {
-        WCHAR text[256];
-        StringCchPrintfW(text, 256, L"Extracting %u of %u files (%d%%)", current + 1, total, percent);
-        SetWindowTextW(_StatusText, text);
-    }
-}
-
-void ProgressDialog::SetCurrentFile(const std::wstring& file) {
-    if (_FileText)
-        SetWindowTextW(_FileText, file.c_str());
-}
-
-INT_PTR CALLBACK ProgressDialog::DialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-    ProgressDialog* pThis = reinterpret_cast<ProgressDialog*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
-    
-    switch (msg) {
-    case WM_CREATE:
-        {
-            CREATESTRUCTW* cs = reinterpret_cast<CREATESTRUCTW*>(lParam);
-            SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(cs->lpCreateParams));
-        }
-        return 0;
-        
-    case WM_CLOSE:
-        if (pThis)
-            pThis->_Cancelled = true;
-        return 0;
-        
-    case WM_DESTROY:
-        return 0;
-    }
-    
-    return DefWindowProcW(hwnd, msg, wParam, lParam);
-}
-
 } // namespace SevenZipView
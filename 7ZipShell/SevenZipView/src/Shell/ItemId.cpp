@@ -0,0 +1,116 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension
+** Shell Item ID Encoding Implementation
+*/
+
+#include "ItemId.h"
+#include "ArchiveEntry.h"
+
+namespace SevenZipView {
+
+size_t ItemId::GetSize(size_t nameLength) {
+    nameLength = (std::min)(nameLength, ITEM_ID_MAX_NAME_LENGTH);
+    return sizeof(ItemIdHeader) + (nameLength + 1) * sizeof(WCHAR);
+}
+
+void ItemId::Write(BYTE* dest, const ItemIdFields& fields) {
+    size_t nameLength = (std::min)(fields.Name.size(), ITEM_ID_MAX_NAME_LENGTH);
+
+    // IDs sit at any byte offset of an ID list, so fields are copied in
+    ItemIdHeader header;
+    header.cb = (USHORT)GetSize(nameLength);
+    header.signature = ItemIdHeader::SIGNATURE;
+    header.version = ItemIdHeader::VERSION;
+    header.type = fields.Type;
+    header.archiveIndex = fields.ArchiveIndex;
+    header.size = fields.Size;
+    header.compressedSize = fields.CompressedSize;
+    header.attributes = fields.Attributes;
+    header.modifiedTime = fields.ModifiedTime;
+    header.nameLength = (USHORT)nameLength;
+    memcpy(dest, &header, sizeof(header));
+
+    BYTE* name = dest + sizeof(header);
+    memcpy(name, fields.Name.data(), nameLength * sizeof(WCHAR));
+    memset(name + nameLength * sizeof(WCHAR), 0, sizeof(WCHAR));
+}
+
+bool ItemId::Read(const BYTE* id, ItemIdFields& fields) {
+    if (!id) return false;
+
+    USHORT cb, signature;
+    memcpy(&cb, id, sizeof(cb));
+    memcpy(&signature, id + sizeof(cb), sizeof(signature));
+
+    if (signature == ItemIdHeader::SIGNATURE && cb >= sizeof(ItemIdHeader)) {
+        ItemIdHeader header;
+        memcpy(&header, id, sizeof(header));
+
+        // A later version may append fields after the name, but one that
+        // changes this layout gets a new version
+        if (header.version != ItemIdHeader::VERSION) return false;
+        if (cb < GetSize(header.nameLength)) return false;
+
+        const WCHAR* name = reinterpret_cast<const WCHAR*>(id + sizeof(header));
+        if (name[header.nameLength] != L'\0') return false;
+
+        fields.Type = header.type;
+        fields.ArchiveIndex = header.archiveIndex;
+        fields.Size = header.size;
+        fields.CompressedSize = header.compressedSize;
+        fields.Attributes = header.attributes;
+        fields.ModifiedTime = header.modifiedTime;
+        fields.Name = std::wstring_view(name, header.nameLength);
+        fields.Path = nullptr;
+        fields.Version = header.version;
+        return true;
+    }
+
+    if (signature == LegacyItemData::SIGNATURE && cb >= sizeof(LegacyItemData)) {
+        const LegacyItemData* item = reinterpret_cast<const LegacyItemData*>(id);
+
+        size_t nameLength = wcsnlen(item->name, ARRAYSIZE(item->name));
+        if (nameLength == ARRAYSIZE(item->name)) return false;
+        if (wcsnlen(item->path, ARRAYSIZE(item->path)) == ARRAYSIZE(item->path)) return false;
+
+        fields.Type = item->type;
+        fields.ArchiveIndex = item->archiveIndex;
+        fields.Size = item->size;
+        fields.CompressedSize = item->compressedSize;
+        fields.Attributes = item->attributes;
+        fields.ModifiedTime = item->modifiedTime;
+        fields.Name = std::wstring_view(item->name, nameLength);
+        fields.Path = item->path;
+        fields.Version = 1;
+        return true;
+    }
+
+    return false;
+}
+
+bool ItemId::FromNode(const DirectoryIndex& directory, const EntryTable& table,
+                      UINT32 node, ItemIdFields& fields) {
+    if (node >= directory.GetNodeCount()) return false;
+
+    fields = ItemIdFields();
+    fields.Name = directory.GetName(node);
+    fields.ArchiveIndex = directory.GetEntryIndex(node);
+
+    if (fields.ArchiveIndex == ArchiveEntry::SYNTHETIC_FOLDER_INDEX) {
+        fields.Type = (node == DirectoryIndex::ROOT) ? ItemType::Root : ItemType::Folder;
+        fields.Attributes = FILE_ATTRIBUTE_DIRECTORY;
+        return true;
+    }
+
+    UINT32 index = fields.ArchiveIndex;
+    if (index >= table.GetCount()) return false;
+
+    fields.Type = table.IsDirectory(index) ? ItemType::Folder : ItemType::File;
+    fields.Size = table.GetSize(index);
+    fields.CompressedSize = table.GetCompressedSize(index);
+    fields.Attributes = table.GetAttributes(index);
+    fields.ModifiedTime = table.GetModifiedTime(index);
+    return true;
+}
+
+} // namespace SevenZipView
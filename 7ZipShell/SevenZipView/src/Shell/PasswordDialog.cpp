@@ -5,6 +5,7 @@
 */
 
 #include "PasswordDialog.h"
+#include "ExtractSink.h"
 #include <windowsx.h>
 #include <commctrl.h>
 
@@ -88,16 +89,73 @@ PasswordResult PasswordDialog::Prompt(HWND parent, const std::wstring& archivePa
         archiveName = archivePath.substr(pos + 1);
     }
     
-    // NOTE: Password caching is disabled - file path is not a reliable key
-    // because the same path can have different files with different passwords.
-    // The LZMA C SDK doesn't support decryption anyway, so caching is not needed.
-    
     PasswordDialog dialog;
-    PasswordResult result = dialog.Show(parent, archiveName);
+    return dialog.Show(parent, archiveName);
+}
+
+bool PasswordDialog::Unlock(HWND parent, Archive& archive) {
+    if (!archive.HasEncryptedEntries() || archive.HasPassword()) return true;
+    
+    // The pooled archive keeps the password while it stays open; one the
+    // user asked to remember also survives its reopening, keyed by path
+    const std::wstring& path = archive.GetPath();
+    PasswordCache& cache = PasswordCache::Instance();
+    if (cache.Has(path)) {
+        archive.SetPassword(cache.Get(path));
+        return true;
+    }
+    
+    PasswordResult result = Prompt(parent, path);
+    if (!result.Success) return false;
+    
+    archive.SetPassword(result.Password);
+    if (result.Remember) cache.Store(path, result.Password);
+    SecureZeroMemory(&result.Password[0], result.Password.size() * sizeof(wchar_t));
+    return true;
+}
+
+void PasswordDialog::Forget(Archive& archive) {
+    if (!archive.HasEncryptedEntries()) return;
     
-    // NOTE: Not caching password - see comment above
+    archive.ClearPassword();
+    PasswordCache::Instance().Remove(archive.GetPath());
+}
+
+// Smallest encrypted file with a CRC outside the given file's block, or
+// PathIndex::NOT_FOUND if every such file shares that block
+static UINT32 FindWitnessEntry(Archive& archive, UINT32 index) {
+    if (!archive.EnsureDatabase()) return PathIndex::NOT_FOUND;
     
-    return result;
+    const CSzArEx& db = archive.GetDatabase();
+    const EntryTable& table = archive.GetEntryTable();
+    UINT32 witness = PathIndex::NOT_FOUND;
+    for (UINT32 i = 0; i < table.GetCount(); i++) {
+        if (!table.IsEncrypted(i) || table.IsDirectory(i) || !SzBitWithVals_Check(&db.CRCs, i)) continue;
+        if (db.FileToFolder[i] == (UInt32)-1 || db.FileToFolder[i] == db.FileToFolder[index]) continue;
+        if (witness == PathIndex::NOT_FOUND || table.GetSize(i) < table.GetSize(witness)) witness = i;
+    }
+    return witness;
+}
+
+void PasswordDialog::ForgetIfRejected(Archive& archive, const std::vector<UINT32>& failedIndices) {
+    if (!archive.HasEncryptedEntries() || !archive.HasPassword()) return;
+    
+    // A wrong password fails every encrypted entry, so one decides; its
+    // data is decoded and checked without being written anywhere
+    const EntryTable& table = archive.GetEntryTable();
+    for (UINT32 index : failedIndices) {
+        if (index >= table.GetCount() || !table.IsEncrypted(index)) continue;
+        
+        HashSink sink;
+        if (archive.ExtractToSink(index, sink)) return;
+        
+        // A damaged entry fails under the right password too; an encrypted
+        // file of another block that decodes tells the two apart
+        UINT32 witness = FindWitnessEntry(archive, index);
+        HashSink witnessSink;
+        if (witness == PathIndex::NOT_FOUND || !archive.ExtractToSink(witness, witnessSink)) Forget(archive);
+        return;
+    }
 }
 
 INT_PTR CALLBACK PasswordDialog::DialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -0,0 +1,172 @@
+/*
+** SevenZipView - Windows Explorer Shell Extension for 7z Archives
+** Copyright (c) 1999-2026 Tootega Pesquisa e Inovacao. MIT License.
+**
+** Extraction Progress Dialog Implementation
+*/
+
+#include "Extractor.h"
+#include <strsafe.h>
+
+namespace SevenZipView {
+
+//==============================================================================
+// ProgressDialog
+//==============================================================================
+
+ProgressDialog::ProgressDialog(HWND parent)
+    : _ParentHwnd(parent)
+    , _DialogHwnd(nullptr)
+    , _ProgressBar(nullptr)
+    , _StatusText(nullptr)
+    , _FileText(nullptr)
+    , _Cancelled(false)
+    , _TotalItems(0)
+    , _TotalSize(0) {
+}
+
+ProgressDialog::~ProgressDialog() {
+    Hide();
+}
+
+void ProgressDialog::Show() {
+    if (_DialogHwnd) return;
+    CreateDialogWindow();
+}
+
+void ProgressDialog::Hide() {
+    if (_DialogHwnd) {
+        DestroyWindow(_DialogHwnd);
+        _DialogHwnd = nullptr;
+    }
+}
+
+void ProgressDialog::OnStart(UINT32 totalItems, UINT64 totalSize) {
+    _TotalItems = totalItems;
+    _TotalSize = totalSize;
+    _Cancelled = false;
+    
+    if (_ProgressBar)
+        SendMessageW(_ProgressBar, PBM_SETRANGE32, 0, 100);
+}
+
+void ProgressDialog::OnProgress(
+    const std::wstring& currentFile,
+    UINT32 currentItem,
+    UINT64 bytesProcessed,
+    UINT64 totalBytes) {
+    
+    UpdateProgress(currentItem, _TotalItems, bytesProcessed, totalBytes);
+    SetCurrentFile(currentFile);
+    
+    // Process messages to keep UI responsive
+    MSG msg;
+    while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+}
+
+void ProgressDialog::OnComplete(bool success, const std::wstring& errorMessage) {
+    Hide();
+}
+
+bool ProgressDialog::IsCancelled() const {
+    return _Cancelled;
+}
+
+void ProgressDialog::CreateDialogWindow() {
+    // Register window class
+    WNDCLASSEXW wc = { sizeof(wc) };
+    wc.lpfnWndProc = DialogProc;
+    wc.hInstance = g_hModule;
+    wc.hCursor = LoadCursorW(nullptr, IDC_ARROW);
+    wc.hbrBackground = reinterpret_cast<HBRUSH>(COLOR_WINDOW + 1);
+    wc.lpszClassName = L"SevenZipViewProgress";
+    RegisterClassExW(&wc);
+    
+    // Create dialog window
+    _DialogHwnd = CreateWindowExW(
+        WS_EX_DLGMODALFRAME,
+        L"SevenZipViewProgress",
+        L"Extracting...",
+        WS_POPUP | WS_CAPTION | WS_SYSMENU,
+        CW_USEDEFAULT, CW_USEDEFAULT, 400, 150,
+        _ParentHwnd, nullptr, g_hModule, this);
+    
+    if (!_DialogHwnd) return;
+    
+    // Create progress bar
+    _ProgressBar = CreateWindowExW(0, PROGRESS_CLASSW, nullptr,
+        WS_CHILD | WS_VISIBLE | PBS_SMOOTH,
+        20, 50, 360, 25,
+        _DialogHwnd, nullptr, g_hModule, nullptr);
+    
+    // Create status text
+    _StatusText = CreateWindowExW(0, L"STATIC", L"Preparing...",
+        WS_CHILD | WS_VISIBLE | SS_LEFT,
+        20, 20, 360, 20,
+        _DialogHwnd, nullptr, g_hModule, nullptr);
+    
+    // Create file text
+    _FileText = CreateWindowExW(0, L"STATIC", L"",
+        WS_CHILD | WS_VISIBLE | SS_LEFT | SS_PATHELLIPSIS,
+        20, 85, 360, 20,
+        _DialogHwnd, nullptr, g_hModule, nullptr);
+    
+    // Center and show
+    RECT rc;
+    GetWindowRect(_DialogHwnd, &rc);
+    int x = (GetSystemMetrics(SM_CXSCREEN) - (rc.right - rc.left)) / 2;
+    int y = (GetSystemMetrics(SM_CYSCREEN) - (rc.bottom - rc.top)) / 2;
+    SetWindowPos(_DialogHwnd, nullptr, x, y, 0, 0, SWP_NOSIZE | SWP_NOZORDER);
+    
+    ShowWindow(_DialogHwnd, SW_SHOW);
+    UpdateWindow(_DialogHwnd);
+}
+
+void ProgressDialog::UpdateProgress(UINT32 current, UINT32 total, UINT64 bytes, UINT64 totalBytes) {
+    if (!_ProgressBar) return;
+    
+    int percent = 0;
+    if (totalBytes > 0)
+        percent = static_cast<int>((bytes * 100) / totalBytes);
+    
+    SendMessageW(_ProgressBar, PBM_SETPOS, percent, 0);
+    
+    if (_StatusText) {
+        WCHAR text[256];
+        StringCchPrintfW(text, 256, L"Extracting %u of %u files (%d%%)", current + 1, total, percent);
+        SetWindowTextW(_StatusText, text);
+    }
+}
+
+void ProgressDialog::SetCurrentFile(const std::wstring& file) {
+    if (_FileText)
+        SetWindowTextW(_FileText, file.c_str());
+}
+
+INT_PTR CALLBACK ProgressDialog::DialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    ProgressDialog* pThis = reinterpret_cast<ProgressDialog*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    
+    switch (msg) {
+    case WM_CREATE:
+        {
+            CREATESTRUCTW* cs = reinterpret_cast<CREATESTRUCTW*>(lParam);
+            SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(cs->lpCreateParams));
+        }
+        return 0;
+        
+    case WM_CLOSE:
+        if (pThis)
+            pThis->_Cancelled = true;
+        return 0;
+        
+    case WM_DESTROY:
+        return 0;
+    }
+    
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+} // namespace SevenZipView
@@ -78,6 +78,7 @@ STDMETHODIMP PropertyHandler::Initialize(LPCWSTR pszFilePath, DWORD grfMode) {
         _FolderCount = _Archive->GetFolderCount();
         _TotalSize = _Archive->GetTotalUncompressedSize();
         _CompressedSize = _Archive->GetTotalCompressedSize();
+        _IsEncrypted = _Archive->HasEncryptedEntries();
         _Loaded = true;
     }
     
@@ -8,8 +8,12 @@
 #include "ContextMenu.h"
 #include "PropertyHandler.h"
 #include "IconHandler.h"
+#include "ExtractCache.h"
+#include "Extractor.h"
+#include "PasswordDialog.h"
 #include <algorithm>
 #include <cstdio>
+#include <unordered_set>
 
 // Shell definitions that may be missing
 #ifndef PID_STG_NAME
@@ -44,6 +48,43 @@ static HRESULT SetStrRet(STRRET* psr, const WCHAR* psz) {
     return SHStrDupW(psz, &psr->pOleStr);
 }
 
+// Files browsed as nested archives: opened from memory through the pool
+static bool IsArchiveName(std::wstring_view name) {
+    return name.size() > 3 && _wcsnicmp(name.data() + name.size() - 3, L".7z", 3) == 0;
+}
+
+// Relative path inside the temp folder for an archive path: '\' separators,
+// no "..\" or leading separators, and characters Windows rejects replaced
+static std::wstring SanitizeRelativePath(std::wstring path) {
+    for (auto& c : path) {
+        if (c == L'/') c = L'\\';
+    }
+    
+    size_t pos;
+    while ((pos = path.find(L"..\\")) != std::wstring::npos) {
+        path.erase(pos, 3);
+    }
+    
+    while (!path.empty() && path[0] == L'\\') {
+        path.erase(0, 1);
+    }
+    
+    for (auto& c : path) {
+        if (c == L':' || c == L'*' || c == L'?' || c == L'"' || c == L'<' || c == L'>' || c == L'|') {
+            c = L'_';
+        }
+    }
+    return path;
+}
+
+// Path of a child inside the archive from its folder's path and its name
+static std::wstring JoinArchivePath(const std::wstring& folder, std::wstring_view name) {
+    std::wstring path(folder);
+    if (!path.empty()) path += L'\\';
+    path.append(name);
+    return path;
+}
+
 namespace SevenZipView {
 
 // ============================================================================
@@ -239,27 +280,37 @@ STDMETHODIMP ShellFolder::Initialize(PCIDLIST_ABSOLUTE pidl) {
         SEVENZIPVIEW_LOG(L"ShellFolder::Initialize path=%s", path);
     }
 
-    // Check for subfolder item in PIDL
+    // Check for subfolder items in PIDL. Current item IDs do not store
+    // their path, so it is rebuilt from the folder names along the list.
     if (pidl) {
         PCUIDLIST_RELATIVE child = pidl;
         int itemCount = 0;
+        std::wstring folder;
+        bool foundFolder = false;
         
         while (child && child->mkid.cb > 0) {
             itemCount++;
             
-            if (child->mkid.cb >= sizeof(ItemData)) {
-                const ItemData* item = reinterpret_cast<const ItemData*>(&child->mkid);
-                if (item->signature == ItemData::SIGNATURE) {
-                    if (item->type == ItemType::Folder) {
-                        _CurrentFolder = item->path;
-                        SEVENZIPVIEW_LOG(L"ShellFolder::Initialize found folder: '%s'", _CurrentFolder.c_str());
-                    }
+            // A file along the list is a nested archive; the folders after
+            // it are its own
+            ItemIdFields item;
+            if (GetItemData(child, item)) {
+                if (item.Type == ItemType::Folder) {
+                    folder = item.Path ? std::wstring(item.Path) : JoinArchivePath(folder, item.Name);
+                    foundFolder = true;
+                } else {
+                    folder.clear();
                 }
             }
             
             child = reinterpret_cast<PCUIDLIST_RELATIVE>(
                 reinterpret_cast<const BYTE*>(child) + child->mkid.cb);
         }
+        
+        if (foundFolder) {
+            _CurrentFolder = folder;
+            SEVENZIPVIEW_LOG(L"ShellFolder::Initialize found folder: '%s'", _CurrentFolder.c_str());
+        }
     }
 
     return S_OK;
@@ -358,22 +409,24 @@ STDMETHODIMP ShellFolder::ParseDisplayName(HWND hwnd, IBindCtx* pbc, LPWSTR pszD
     
     if (!OpenArchive()) return E_FAIL;
 
-    auto entries = _Archive->GetEntriesInFolder(_CurrentFolder);
-    for (const auto& entry : entries) {
-        if (_wcsicmp(entry.Name.c_str(), pszDisplayName) == 0) {
-            *ppidl = CreateItemID(entry);
-            if (pchEaten) *pchEaten = (ULONG)wcslen(pszDisplayName);
-            if (pdwAttributes) {
-                if (entry.Type == ItemType::Folder)
-                    *pdwAttributes &= SFGAO_FOLDER | SFGAO_BROWSABLE | SFGAO_HASSUBFOLDER;
-                else
-                    *pdwAttributes &= SFGAO_STREAM | SFGAO_CANCOPY;
-            }
-            return S_OK;
-        }
+    const DirectoryIndex& directory = _Archive->GetDirectoryIndex();
+    UINT32 node = directory.FindChild(directory.FindFolder(_CurrentFolder), pszDisplayName, wcslen(pszDisplayName));
+    
+    ArchiveEntry entry;
+    if (node == DirectoryIndex::NOT_FOUND || !directory.GetEntry(node, entry))
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+    *ppidl = CreateItemID(entry);
+    if (pchEaten) *pchEaten = (ULONG)wcslen(pszDisplayName);
+    if (pdwAttributes) {
+        if (entry.Type == ItemType::Folder)
+            *pdwAttributes &= SFGAO_FOLDER | SFGAO_BROWSABLE | SFGAO_HASSUBFOLDER;
+        else if (IsArchiveName(entry.Name))
+            *pdwAttributes &= SFGAO_FOLDER | SFGAO_BROWSABLE | SFGAO_STREAM | SFGAO_CANCOPY;
+        else
+            *pdwAttributes &= SFGAO_STREAM | SFGAO_CANCOPY;
     }
-
-    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    return S_OK;
 }
 
 STDMETHODIMP ShellFolder::EnumObjects(HWND hwnd, SHCONTF grfFlags, IEnumIDList** ppenumIDList) {
@@ -394,25 +447,48 @@ STDMETHODIMP ShellFolder::BindToObject(PCUIDLIST_RELATIVE pidl, IBindCtx* pbc, R
     if (!ppv) return E_POINTER;
     *ppv = nullptr;
     
-    const ItemData* item = GetItemData(pidl);
-    if (!item) return E_INVALIDARG;
+    ItemIdFields item;
+    if (!GetItemData(pidl, item)) return E_INVALIDARG;
     
     wchar_t guidStr[64];
     StringFromGUID2(riid, guidStr, 64);
-    SEVENZIPVIEW_LOG(L"BindToObject: item='%s' type=%d IID=%s", item->name, (int)item->type, guidStr);
+    SEVENZIPVIEW_LOG(L"BindToObject: item='%s' type=%d IID=%s", item.Name.data(), (int)item.Type, guidStr);
     
-    // Folders are navigable
-    if (item->type == ItemType::Folder) {
+    // Folders are navigable, and so are archives inside the archive: those
+    // are read from memory, named by this archive's path plus their own
+    bool nested = item.Type == ItemType::File && IsArchiveName(item.Name);
+    if (item.Type == ItemType::Folder || nested) {
         if (IsEqualIID(riid, IID_IShellFolder) || IsEqualIID(riid, IID_IShellFolder2)) {
+            std::wstring nestedPath;
+            std::shared_ptr<Archive> nestedArchive;
+            if (nested) {
+                if (!OpenArchive()) return E_FAIL;
+                nestedPath = _ArchivePath + L"\\" + GetItemPath(item);
+                for (auto& c : nestedPath) {
+                    if (c == L'/') c = L'\\';
+                }
+                nestedArchive = ArchivePool::Instance().GetArchive(nestedPath);
+                if (!nestedArchive) {
+                    SEVENZIPVIEW_LOG(L"BindToObject: Cannot open nested archive '%s'", nestedPath.c_str());
+                    return E_FAIL;
+                }
+            }
+            
             ShellFolder* subfolder = new (std::nothrow) ShellFolder();
             if (!subfolder) return E_OUTOFMEMORY;
             
-            subfolder->SetArchivePath(_ArchivePath);
-            subfolder->SetCurrentFolder(item->path);
-            
-            // Share archive instance for performance
-            if (_Archive) {
-                subfolder->SetArchive(_Archive);
+            std::wstring itemPath = GetItemPath(item);
+            if (nested) {
+                subfolder->SetArchivePath(nestedPath);
+                subfolder->SetArchive(nestedArchive);
+            } else {
+                subfolder->SetArchivePath(_ArchivePath);
+                subfolder->SetCurrentFolder(itemPath);
+                
+                // Share archive instance for performance
+                if (_Archive) {
+                    subfolder->SetArchive(_Archive);
+                }
             }
             
             // Create the combined PIDL for this subfolder
@@ -424,7 +500,7 @@ STDMETHODIMP ShellFolder::BindToObject(PCUIDLIST_RELATIVE pidl, IBindCtx* pbc, R
                 }
             }
             
-            SEVENZIPVIEW_LOG(L"BindToObject: Creating subfolder for '%s'", item->path);
+            SEVENZIPVIEW_LOG(L"BindToObject: Creating subfolder for '%s'", itemPath.c_str());
             
             HRESULT hr = subfolder->QueryInterface(riid, ppv);
             subfolder->Release();
@@ -443,18 +519,18 @@ STDMETHODIMP ShellFolder::BindToStorage(PCUIDLIST_RELATIVE pidl, IBindCtx* pbc,
     StringFromGUID2(riid, guidStr, 64);
     SEVENZIPVIEW_LOG(L"BindToStorage: IID=%s", guidStr);
     
-    const ItemData* item = GetItemData(pidl);
-    if (!item) return E_INVALIDARG;
+    ItemIdFields item;
+    if (!GetItemData(pidl, item)) return E_INVALIDARG;
     
     // For folders, delegate to BindToObject
-    if (item->type == ItemType::Folder) {
+    if (item.Type == ItemType::Folder) {
         return BindToObject(pidl, pbc, riid, ppv);
     }
     
     // For files, return an IStream if requested
     if (IsEqualIID(riid, IID_IStream)) {
         // Don't try to extract synthetic folders
-        if (item->archiveIndex == ArchiveEntry::SYNTHETIC_FOLDER_INDEX) {
+        if (item.ArchiveIndex == ArchiveEntry::SYNTHETIC_FOLDER_INDEX) {
             return E_NOTIMPL;
         }
         
@@ -464,21 +540,18 @@ STDMETHODIMP ShellFolder::BindToStorage(PCUIDLIST_RELATIVE pidl, IBindCtx* pbc,
             return E_FAIL;
         }
         
-        // Extract file to buffer
-        std::vector<BYTE> buffer;
-        if (!_Archive->ExtractToBuffer(item->archiveIndex, buffer)) {
-            SEVENZIPVIEW_LOG(L"BindToStorage: Failed to extract file index %u", item->archiveIndex);
-            return E_FAIL;
-        }
+        UINT32 index = GetItemIndex(item);
+        if (index == ArchiveEntry::SYNTHETIC_FOLDER_INDEX) return STG_E_FILENOTFOUND;
         
-        // Create memory stream from buffer
-        IStream* pStream = SHCreateMemStream(buffer.data(), static_cast<UINT>(buffer.size()));
-        if (!pStream) {
-            SEVENZIPVIEW_LOG(L"BindToStorage: Failed to create memory stream");
-            return E_OUTOFMEMORY;
+        // Decoded as the caller reads, not extracted up front
+        IStream* pStream = nullptr;
+        HRESULT hr = ArchiveEntryStream::Create(_Archive, index, &pStream);
+        if (FAILED(hr)) {
+            SEVENZIPVIEW_LOG(L"BindToStorage: Failed to open file index %u", index);
+            return hr;
         }
         
-        SEVENZIPVIEW_LOG(L"BindToStorage: Created IStream for '%s' (%zu bytes)", item->name, buffer.size());
+        SEVENZIPVIEW_LOG(L"BindToStorage: Created IStream for '%s'", item.Name.data());
         *ppv = pStream;
         return S_OK;
     }
@@ -487,31 +560,29 @@ STDMETHODIMP ShellFolder::BindToStorage(PCUIDLIST_RELATIVE pidl, IBindCtx* pbc,
 }
 
 STDMETHODIMP ShellFolder::CompareIDs(LPARAM lParam, PCUIDLIST_RELATIVE pidl1, PCUIDLIST_RELATIVE pidl2) {
-    const ItemData* item1 = GetItemData(pidl1);
-    const ItemData* item2 = GetItemData(pidl2);
-
-    if (!item1 || !item2) return E_INVALIDARG;
+    ItemIdFields item1, item2;
+    if (!GetItemData(pidl1, item1) || !GetItemData(pidl2, item2)) return E_INVALIDARG;
 
     int column = LOWORD(lParam);
     int result = 0;
 
     switch (column) {
         case 0: // Name
-            result = _wcsicmp(item1->name, item2->name);
+            result = _wcsicmp(item1.Name.data(), item2.Name.data());
             break;
         case 1: // Type
-            result = static_cast<int>(item1->type) - static_cast<int>(item2->type);
+            result = static_cast<int>(item1.Type) - static_cast<int>(item2.Type);
             break;
         case 2: // Size
-            if (item1->size < item2->size) result = -1;
-            else if (item1->size > item2->size) result = 1;
+            if (item1.Size < item2.Size) result = -1;
+            else if (item1.Size > item2.Size) result = 1;
             break;
         case 3: // Compressed size
-            if (item1->compressedSize < item2->compressedSize) result = -1;
-            else if (item1->compressedSize > item2->compressedSize) result = 1;
+            if (item1.CompressedSize < item2.CompressedSize) result = -1;
+            else if (item1.CompressedSize > item2.CompressedSize) result = 1;
             break;
         default:
-            result = _wcsicmp(item1->name, item2->name);
+            result = _wcsicmp(item1.Name.data(), item2.Name.data());
             break;
     }
 
@@ -549,11 +620,11 @@ STDMETHODIMP ShellFolder::GetAttributesOf(UINT cidl, PCUITEMID_CHILD_ARRAY apidl
     SFGAOF attrs = *rgfInOut;
 
     for (UINT i = 0; i < cidl; i++) {
-        const ItemData* item = GetItemData(apidl[i]);
-        if (item) {
+        ItemIdFields item;
+        if (GetItemData(apidl[i], item)) {
             SFGAOF itemAttrs = 0;
             
-            if (item->type == ItemType::Folder) {
+            if (item.Type == ItemType::Folder) {
                 // Folders are navigable and can be copied
                 // SFGAO_FOLDER - it's a folder
                 // SFGAO_BROWSABLE - can be navigated into
@@ -564,6 +635,10 @@ STDMETHODIMP ShellFolder::GetAttributesOf(UINT cidl, PCUITEMID_CHILD_ARRAY apidl
             else {
                 // Files can be copied and we provide IStream via BindToStorage
                 itemAttrs = SFGAO_STREAM | SFGAO_CANCOPY;
+                
+                // Archives inside the archive can also be browsed, like a
+                // .zip in a normal folder
+                if (IsArchiveName(item.Name)) itemAttrs |= SFGAO_FOLDER | SFGAO_BROWSABLE;
             }
             
             attrs &= itemAttrs;
@@ -599,9 +674,9 @@ STDMETHODIMP ShellFolder::GetUIObjectOf(HWND hwndOwner, UINT cidl, PCUITEMID_CHI
         // Build list of items to extract
         std::vector<std::pair<UINT32, std::wstring>> items;
         for (UINT i = 0; i < cidl; i++) {
-            const ItemData* item = GetItemData(apidl[i]);
-            if (item) {
-                items.push_back({item->archiveIndex, item->path});
+            ItemIdFields item;
+            if (GetItemData(apidl[i], item)) {
+                items.push_back({GetItemIndex(item), GetItemPath(item)});
             }
         }
         
@@ -630,9 +705,9 @@ STDMETHODIMP ShellFolder::GetUIObjectOf(HWND hwndOwner, UINT cidl, PCUITEMID_CHI
         // Build list of items
         std::vector<std::pair<UINT32, std::wstring>> items;
         for (UINT i = 0; i < cidl; i++) {
-            const ItemData* item = GetItemData(apidl[i]);
-            if (item) {
-                items.push_back({item->archiveIndex, item->path});
+            ItemIdFields item;
+            if (GetItemData(apidl[i], item)) {
+                items.push_back({GetItemIndex(item), GetItemPath(item)});
             }
         }
         
@@ -662,17 +737,17 @@ STDMETHODIMP ShellFolder::GetUIObjectOf(HWND hwndOwner, UINT cidl, PCUITEMID_CHI
     // For single item operations only
     if (cidl != 1) return E_INVALIDARG;
 
-    const ItemData* item = GetItemData(apidl[0]);
-    if (!item) return E_INVALIDARG;
+    ItemIdFields item;
+    if (!GetItemData(apidl[0], item)) return E_INVALIDARG;
 
-    SEVENZIPVIEW_LOG(L"GetUIObjectOf: single item='%s'", item->name);
+    SEVENZIPVIEW_LOG(L"GetUIObjectOf: single item='%s'", item.Name.data());
     
     // Icon
     if (IsEqualIID(riid, IID_IExtractIconW)) {
         ItemIconExtractor* icon = new (std::nothrow) ItemIconExtractor();
         if (!icon) return E_OUTOFMEMORY;
         
-        icon->SetItemInfo(item->name, item->type);
+        icon->SetItemInfo(item.Name.data(), item.Type);
         
         HRESULT hr = icon->QueryInterface(riid, ppv);
         icon->Release();
@@ -685,24 +760,24 @@ STDMETHODIMP ShellFolder::GetUIObjectOf(HWND hwndOwner, UINT cidl, PCUITEMID_CHI
 STDMETHODIMP ShellFolder::GetDisplayNameOf(PCUITEMID_CHILD pidl, SHGDNF uFlags, STRRET* pName) {
     if (!pidl || !pName) return E_POINTER;
 
-    const ItemData* item = GetItemData(pidl);
-    if (!item) return E_INVALIDARG;
+    ItemIdFields item;
+    if (!GetItemData(pidl, item)) return E_INVALIDARG;
 
-    SEVENZIPVIEW_LOG(L"GetDisplayNameOf: name='%s' flags=0x%08X", item->name, uFlags);
+    SEVENZIPVIEW_LOG(L"GetDisplayNameOf: name='%s' flags=0x%08X", item.Name.data(), uFlags);
 
     if (uFlags & SHGDN_FORPARSING) {
         // For parsing, return full path
         if (uFlags & SHGDN_INFOLDER) {
-            return SetStrRet(pName, item->name);
+            return SetStrRet(pName, item.Name.data());
         } else {
             // Return full path including archive
-            std::wstring fullPath = _ArchivePath + L"\\" + item->path;
+            std::wstring fullPath = _ArchivePath + L"\\" + GetItemPath(item);
             return SetStrRet(pName, fullPath.c_str());
         }
     }
 
     // Display name
-    return SetStrRet(pName, item->name);
+    return SetStrRet(pName, item.Name.data());
 }
 
 STDMETHODIMP ShellFolder::SetNameOf(HWND hwnd, PCUITEMID_CHILD pidl, LPCWSTR pszName,
@@ -742,8 +817,8 @@ STDMETHODIMP ShellFolder::GetDefaultColumnState(UINT iColumn, SHCOLSTATEF* pcsFl
 STDMETHODIMP ShellFolder::GetDetailsEx(PCUITEMID_CHILD pidl, const SHCOLUMNID* pscid, VARIANT* pv) {
     if (!pscid || !pv) return E_POINTER;
     
-    const ItemData* item = GetItemData(pidl);
-    if (!item) return E_INVALIDARG;
+    ItemIdFields item;
+    if (!GetItemData(pidl, item)) return E_INVALIDARG;
 
     VariantInit(pv);
 
@@ -752,11 +827,11 @@ STDMETHODIMP ShellFolder::GetDetailsEx(PCUITEMID_CHILD pidl, const SHCOLUMNID* p
         switch (pscid->pid) {
             case PID_STG_NAME:
                 pv->vt = VT_BSTR;
-                pv->bstrVal = SysAllocString(item->name);
+                pv->bstrVal = SysAllocString(item.Name.data());
                 return S_OK;
             case PID_STG_SIZE:
                 pv->vt = VT_UI8;
-                pv->ullVal = item->size;
+                pv->ullVal = item.Size;
                 return S_OK;
         }
     }
@@ -796,19 +871,19 @@ STDMETHODIMP ShellFolder::GetDetailsOf(PCUITEMID_CHILD pidl, UINT iColumn, SHELL
     }
 
     // Item data
-    const ItemData* item = GetItemData(pidl);
-    if (!item) return E_INVALIDARG;
+    ItemIdFields item;
+    if (!GetItemData(pidl, item)) return E_INVALIDARG;
 
     switch (iColumn) {
         case 0: // Name
-            return SetStrRet(&psd->str, item->name);
+            return SetStrRet(&psd->str, item.Name.data());
         
         case 1: // Type
-            if (item->type == ItemType::Folder) {
+            if (item.Type == ItemType::Folder) {
                 return SetStrRet(&psd->str, L"Folder");
             } else {
                 // Get extension
-                const wchar_t* ext = wcsrchr(item->name, L'.');
+                const wchar_t* ext = wcsrchr(item.Name.data(), L'.');
                 if (ext) {
                     std::wstring type(ext + 1);
                     type += L" File";
@@ -819,22 +894,22 @@ STDMETHODIMP ShellFolder::GetDetailsOf(PCUITEMID_CHILD pidl, UINT iColumn, SHELL
         
         case 2: // Size
             psd->fmt = LVCFMT_RIGHT;
-            if (item->type == ItemType::Folder) {
+            if (item.Type == ItemType::Folder) {
                 return SetStrRet(&psd->str, L"");
             }
-            return SetStrRet(&psd->str, FormatFileSize(item->size).c_str());
+            return SetStrRet(&psd->str, FormatFileSize(item.Size).c_str());
         
         case 3: // Compressed
             psd->fmt = LVCFMT_RIGHT;
-            if (item->type == ItemType::Folder || item->compressedSize == 0) {
+            if (item.Type == ItemType::Folder || item.CompressedSize == 0) {
                 return SetStrRet(&psd->str, L"");
             }
-            return SetStrRet(&psd->str, FormatFileSize(item->compressedSize).c_str());
+            return SetStrRet(&psd->str, FormatFileSize(item.CompressedSize).c_str());
         
         case 4: // Modified
-            if (item->modifiedTime.dwHighDateTime != 0 || item->modifiedTime.dwLowDateTime != 0) {
+            if (item.ModifiedTime.dwHighDateTime != 0 || item.ModifiedTime.dwLowDateTime != 0) {
                 SYSTEMTIME st;
-                FileTimeToSystemTime(&item->modifiedTime, &st);
+                FileTimeToSystemTime(&item.ModifiedTime, &st);
                 wchar_t buffer[64];
                 GetDateFormatW(LOCALE_USER_DEFAULT, DATE_SHORTDATE, &st, nullptr, buffer, 32);
                 wcscat_s(buffer, L" ");
@@ -896,58 +971,62 @@ STDMETHODIMP ShellFolder::GetSite(REFIID riid, void** ppvSite) {
 }
 
 // Internal methods
-const ItemData* ShellFolder::GetItemData(PCUITEMID_CHILD pidl) {
-    if (!pidl || pidl->mkid.cb < sizeof(ItemData)) return nullptr;
+bool ShellFolder::GetItemData(PCUIDLIST_RELATIVE pidl, ItemIdFields& item) {
+    if (!pidl || pidl->mkid.cb < sizeof(USHORT) * 2) return false;
+    return ItemId::Read(reinterpret_cast<const BYTE*>(&pidl->mkid), item);
+}
+
+UINT32 ShellFolder::GetItemIndex(const ItemIdFields& item) const {
+    if (item.ArchiveIndex == ArchiveEntry::SYNTHETIC_FOLDER_INDEX || !_Archive || !_Archive->IsOpen())
+        return item.ArchiveIndex;
     
-    const ItemData* item = reinterpret_cast<const ItemData*>(&pidl->mkid);
-    if (item->signature != ItemData::SIGNATURE) return nullptr;
+    if (item.ArchiveIndex < _Archive->GetItemCount() &&
+        _Archive->GetEntryTable().GetName(item.ArchiveIndex) == item.Name)
+        return item.ArchiveIndex;
     
-    return item;
+    std::wstring path = item.Path ? std::wstring(item.Path) : JoinArchivePath(_CurrentFolder, item.Name);
+    UINT32 index = _Archive->FindEntry(path);
+    SEVENZIPVIEW_LOG(L"GetItemIndex: index %u is not '%s', found %u by path", item.ArchiveIndex,
+        std::wstring(item.Name).c_str(), index);
+    return index == PathIndex::NOT_FOUND ? ArchiveEntry::SYNTHETIC_FOLDER_INDEX : index;
 }
 
-PITEMID_CHILD ShellFolder::CreateItemID(const ArchiveEntry& entry) {
-    return CreateItemID(
-        entry.Name,
-        entry.Type,
-        entry.FullPath,
-        entry.Size,
-        entry.CompressedSize,
-        entry.ArchiveIndex,
-        entry.CRC,
-        entry.Attributes,
-        entry.ModifiedTime
-    );
-}
-
-PITEMID_CHILD ShellFolder::CreateItemID(const std::wstring& name, ItemType type,
-                                         const std::wstring& path, UINT64 size,
-                                         UINT64 compressedSize, UINT32 index,
-                                         UINT32 crc, UINT32 attrs, FILETIME mtime) {
-    
-    size_t itemSize = sizeof(ItemData);
+std::wstring ShellFolder::GetItemPath(const ItemIdFields& item) const {
+    if (item.Path) return item.Path;
+    
+    UINT32 index = GetItemIndex(item);
+    if (index != ArchiveEntry::SYNTHETIC_FOLDER_INDEX && index < _Archive->GetItemCount())
+        return std::wstring(_Archive->GetEntryTable().GetPath(index));
+    
+    return JoinArchivePath(_CurrentFolder, item.Name);
+}
+
+PITEMID_CHILD ShellFolder::CreateItemID(const ItemIdFields& fields) {
+    size_t itemSize = ItemId::GetSize(fields.Name.size());
     size_t totalSize = itemSize + sizeof(USHORT); // Terminator
     
     PITEMID_CHILD pidl = (PITEMID_CHILD)CoTaskMemAlloc(totalSize);
     if (!pidl) return nullptr;
     
-    ZeroMemory(pidl, totalSize);
-    
-    ItemData* item = reinterpret_cast<ItemData*>(&pidl->mkid);
-    item->cb = (USHORT)itemSize;
-    item->signature = ItemData::SIGNATURE;
-    item->type = type;
-    StringCchCopyW(item->name, ARRAYSIZE(item->name), name.c_str());
-    StringCchCopyW(item->path, ARRAYSIZE(item->path), path.c_str());
-    item->size = size;
-    item->compressedSize = compressedSize;
-    item->archiveIndex = index;
-    item->crc = crc;
-    item->attributes = attrs;
-    item->modifiedTime = mtime;
+    BYTE* data = reinterpret_cast<BYTE*>(pidl);
+    ItemId::Write(data, fields);
+    ZeroMemory(data + itemSize, sizeof(USHORT));
     
     return pidl;
 }
 
+PITEMID_CHILD ShellFolder::CreateItemID(const ArchiveEntry& entry) {
+    ItemIdFields fields;
+    fields.Type = entry.Type;
+    fields.ArchiveIndex = entry.ArchiveIndex;
+    fields.Size = entry.Size;
+    fields.CompressedSize = entry.CompressedSize;
+    fields.Attributes = entry.Attributes;
+    fields.ModifiedTime = entry.ModifiedTime;
+    fields.Name = entry.Name;
+    return CreateItemID(fields);
+}
+
 // ============================================================================
 // EnumIDList Implementation
 // ============================================================================
@@ -956,16 +1035,13 @@ EnumIDList::EnumIDList(ShellFolder* folder, SHCONTF flags)
     : _RefCount(1)
     , _Folder(folder)
     , _Flags(flags)
-    , _CurrentIndex(0)
+    , _Position(0)
     , _Initialized(false) {
     
     if (_Folder) _Folder->AddRef();
 }
 
 EnumIDList::~EnumIDList() {
-    for (auto pidl : _Items) {
-        CoTaskMemFree(pidl);
-    }
     if (_Folder) _Folder->Release();
 }
 
@@ -998,27 +1074,22 @@ void EnumIDList::Initialize() {
 
     if (!_Folder || !_Folder->OpenArchive()) return;
 
-    bool includeFolders = (_Flags & SHCONTF_FOLDERS) != 0;
-    bool includeFiles = (_Flags & SHCONTF_NONFOLDERS) != 0;
-
-    SEVENZIPVIEW_LOG(L"EnumIDList::Initialize folders=%d files=%d currentFolder='%s'",
-        includeFolders, includeFiles, _Folder->GetCurrentFolder().c_str());
+    // Only the child range is taken here; item IDs are built as Next asks
+    auto view = std::make_shared<FolderView>();
+    view->Source = _Folder->_Archive;
+    view->Directory = &view->Source->GetDirectoryIndex();
+    view->Table = &view->Source->GetEntryTable();
+    view->Children = view->Source->GetEntriesInFolder(_Folder->GetCurrentFolder());
+    _View = view;
 
-    auto entries = _Folder->_Archive->GetEntriesInFolder(_Folder->GetCurrentFolder());
-    
-    for (const auto& entry : entries) {
-        bool isFolder = (entry.Type == ItemType::Folder);
-        
-        if ((isFolder && includeFolders) || (!isFolder && includeFiles)) {
-            PITEMID_CHILD pidl = _Folder->CreateItemID(entry);
-            if (pidl) {
-                _Items.push_back(pidl);
-                SEVENZIPVIEW_LOG(L"  Added item: '%s' type=%d", entry.Name.c_str(), (int)entry.Type);
-            }
-        }
-    }
+    SEVENZIPVIEW_LOG(L"EnumIDList::Initialize folders=%d files=%d currentFolder='%s' children=%zu",
+        (_Flags & SHCONTF_FOLDERS) != 0, (_Flags & SHCONTF_NONFOLDERS) != 0,
+        _Folder->GetCurrentFolder().c_str(), _View->Children.size());
+}
 
-    SEVENZIPVIEW_LOG(L"EnumIDList::Initialize found %zu items", _Items.size());
+bool EnumIDList::IsIncluded(UINT32 node) const {
+    return _View->Directory->IsFolder(node) ?
+        (_Flags & SHCONTF_FOLDERS) != 0 : (_Flags & SHCONTF_NONFOLDERS) != 0;
 }
 
 STDMETHODIMP EnumIDList::Next(ULONG celt, PITEMID_CHILD* rgelt, ULONG* pceltFetched) {
@@ -1027,11 +1098,19 @@ STDMETHODIMP EnumIDList::Next(ULONG celt, PITEMID_CHILD* rgelt, ULONG* pceltFetc
     Initialize();
 
     ULONG fetched = 0;
-    while (fetched < celt && _CurrentIndex < _Items.size()) {
-        rgelt[fetched] = ILCloneChild(_Items[_CurrentIndex]);
-        if (!rgelt[fetched]) break;
-        fetched++;
-        _CurrentIndex++;
+    ItemIdFields fields;
+    while (_View && fetched < celt && _Position < _View->Children.size()) {
+        UINT32 node = _View->Children[_Position];
+        if (!IsIncluded(node) || !ItemId::FromNode(*_View->Directory, *_View->Table, node, fields)) {
+            _Position++;
+            continue;
+        }
+        
+        // On failure the position stays, so the next call retries this child
+        PITEMID_CHILD pidl = ShellFolder::CreateItemID(fields);
+        if (!pidl) break;
+        rgelt[fetched++] = pidl;
+        _Position++;
     }
 
     if (pceltFetched) *pceltFetched = fetched;
@@ -1040,12 +1119,17 @@ STDMETHODIMP EnumIDList::Next(ULONG celt, PITEMID_CHILD* rgelt, ULONG* pceltFetc
 
 STDMETHODIMP EnumIDList::Skip(ULONG celt) {
     Initialize();
-    _CurrentIndex += celt;
-    return (_CurrentIndex <= _Items.size()) ? S_OK : S_FALSE;
+
+    ULONG skipped = 0;
+    while (_View && skipped < celt && _Position < _View->Children.size()) {
+        if (IsIncluded(_View->Children[_Position])) skipped++;
+        _Position++;
+    }
+    return (skipped == celt) ? S_OK : S_FALSE;
 }
 
 STDMETHODIMP EnumIDList::Reset() {
-    _CurrentIndex = 0;
+    _Position = 0;
     return S_OK;
 }
 
@@ -1055,8 +1139,9 @@ STDMETHODIMP EnumIDList::Clone(IEnumIDList** ppenum) {
     EnumIDList* clone = new (std::nothrow) EnumIDList(_Folder, _Flags);
     if (!clone) return E_OUTOFMEMORY;
     
-    clone->Initialize();
-    clone->_CurrentIndex = _CurrentIndex;
+    clone->_View = _View;
+    clone->_Position = _Position;
+    clone->_Initialized = _Initialized;
     
     *ppenum = clone;
     return S_OK;
@@ -1066,8 +1151,27 @@ STDMETHODIMP EnumIDList::Clone(IEnumIDList** ppenum) {
 // ArchiveDataObject Implementation - For drag-drop and clipboard
 // ============================================================================
 
+// Attributes a virtual file may carry over from the archive
+static const DWORD DESCRIPTOR_FILE_ATTRIBUTES = FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN |
+    FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE;
+
+// Formats of virtual files, registered once per process
+static CLIPFORMAT GetFileDescriptorFormat() {
+    static const CLIPFORMAT format = (CLIPFORMAT)RegisterClipboardFormatW(CFSTR_FILEDESCRIPTORW);
+    return format;
+}
+
+static CLIPFORMAT GetFileContentsFormat() {
+    static const CLIPFORMAT format = (CLIPFORMAT)RegisterClipboardFormatW(CFSTR_FILECONTENTS);
+    return format;
+}
+
 ArchiveDataObject::ArchiveDataObject()
     : _RefCount(1)
+    , _Described(false)
+    , _DescriptorsFit(true)
+    , _UnlockAsked(false)
+    , _Unlocked(false)
     , _Extracted(false) {
     SEVENZIPVIEW_LOG(L"ArchiveDataObject created");
 }
@@ -1113,9 +1217,134 @@ void ArchiveDataObject::SetArchive(const std::wstring& archivePath, std::shared_
     _Items = std::move(items);
     SEVENZIPVIEW_LOG(L"ArchiveDataObject::SetArchive: %zu items from '%s'", _Items.size(), archivePath.c_str());
     
-    // Extract files immediately so they're ready for drag-drop
-    // This is important because drop targets may call QueryGetData or GetData at any time
-    ExtractToTemp();
+    // Nothing is decoded here: the target pulls each file's stream as it
+    // copies, and only the CF_HDROP fallback extracts to the temp folder
+}
+
+bool ArchiveDataObject::Unlock() {
+    if (!_UnlockAsked) {
+        _UnlockAsked = true;
+        _Unlocked = _Archive && PasswordDialog::Unlock(nullptr, *_Archive);
+    }
+    return _Unlocked;
+}
+
+void ArchiveDataObject::DescribeFiles() {
+    if (_Described) return;
+    _Described = true;
+    if (!_Archive) return;
+    
+    // Same expansion as ExtractToTemp: dragged items by name, folder
+    // contents from the directory index, folders before what they hold
+    const DirectoryIndex& directory = _Archive->GetDirectoryIndex();
+    std::vector<UINT32> subtree;
+    
+    for (const auto& item : _Items) {
+        UINT32 index = item.first;
+        const std::wstring& path = item.second;
+        
+        std::wstring name = path;
+        size_t pos = path.find_last_of(L"\\/");
+        if (pos != std::wstring::npos) name = path.substr(pos + 1);
+        name = SanitizeRelativePath(name);
+        
+        bool isFolder = (index == ArchiveEntry::SYNTHETIC_FOLDER_INDEX) ||
+            (index < _Archive->GetItemCount() && _Archive->GetEntryTable().IsDirectory(index));
+        _Files.push_back({ index, name, isFolder });
+        if (!isFolder) continue;
+        
+        UINT32 folderNode = directory.FindFolder(path);
+        if (folderNode == DirectoryIndex::NOT_FOUND) continue;
+        
+        size_t prefixLength = directory.GetPath(folderNode).size() + 1;
+        subtree.clear();
+        directory.GetDescendants(folderNode, subtree);
+        for (UINT32 node : subtree) {
+            std::wstring_view nodePath = directory.GetPath(node);
+            if (nodePath.size() <= prefixLength) continue;
+            
+            std::wstring relative = name + L"\\" + SanitizeRelativePath(std::wstring(nodePath.substr(prefixLength)));
+            _Files.push_back({ directory.GetEntryIndex(node), std::move(relative), directory.IsFolder(node) });
+        }
+    }
+    
+    // cFileName holds MAX_PATH characters with the terminator; a longer
+    // path would be cut short and land under the wrong name
+    for (const auto& file : _Files) {
+        if (file.Path.size() >= MAX_PATH) {
+            _DescriptorsFit = false;
+            break;
+        }
+    }
+    
+    SEVENZIPVIEW_LOG(L"ArchiveDataObject::DescribeFiles: %zu virtual files, fit=%d", _Files.size(), _DescriptorsFit ? 1 : 0);
+}
+
+bool ArchiveDataObject::OffersVirtualFiles() {
+    DescribeFiles();
+    return _DescriptorsFit;
+}
+
+HGLOBAL ArchiveDataObject::CreateFileDescriptors() {
+    if (!OffersVirtualFiles() || _Files.empty()) return nullptr;
+    
+    size_t totalSize = sizeof(FILEGROUPDESCRIPTORW) + (_Files.size() - 1) * sizeof(FILEDESCRIPTORW);
+    HGLOBAL hGlobal = GlobalAlloc(GHND, totalSize);
+    if (!hGlobal) return nullptr;
+    
+    FILEGROUPDESCRIPTORW* group = (FILEGROUPDESCRIPTORW*)GlobalLock(hGlobal);
+    if (!group) {
+        GlobalFree(hGlobal);
+        return nullptr;
+    }
+    
+    // Descriptor i is the file CFSTR_FILECONTENTS serves for lindex i
+    group->cItems = (UINT)_Files.size();
+    const EntryTable& entries = _Archive->GetEntryTable();
+    for (size_t i = 0; i < _Files.size(); i++) {
+        const VirtualFile& file = _Files[i];
+        FILEDESCRIPTORW& fd = group->fgd[i];
+        fd.dwFlags = FD_ATTRIBUTES | FD_PROGRESSUI;
+        if (FAILED(StringCchCopyW(fd.cFileName, MAX_PATH, file.Path.c_str()))) {
+            GlobalUnlock(hGlobal);
+            GlobalFree(hGlobal);
+            return nullptr;
+        }
+        
+        if (file.IsFolder) {
+            fd.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+            continue;
+        }
+        
+        UINT64 size = entries.GetSize(file.Index);
+        fd.dwFlags |= FD_FILESIZE;
+        fd.nFileSizeLow = (DWORD)size;
+        fd.nFileSizeHigh = (DWORD)(size >> 32);
+        
+        DWORD attributes = entries.GetAttributes(file.Index) & DESCRIPTOR_FILE_ATTRIBUTES;
+        fd.dwFileAttributes = attributes ? attributes : FILE_ATTRIBUTE_NORMAL;
+        
+        FILETIME modified = entries.GetModifiedTime(file.Index);
+        if (modified.dwLowDateTime || modified.dwHighDateTime) {
+            fd.dwFlags |= FD_WRITESTIME;
+            fd.ftLastWriteTime = modified;
+        }
+    }
+    
+    GlobalUnlock(hGlobal);
+    return hGlobal;
+}
+
+HRESULT ArchiveDataObject::CreateFileContents(LONG index, IStream** stream) {
+    *stream = nullptr;
+    if (!OffersVirtualFiles()) return DV_E_FORMATETC;
+    if (index < 0 || (size_t)index >= _Files.size() || _Files[index].IsFolder) return DV_E_LINDEX;
+    
+    if (!Unlock()) {
+        SEVENZIPVIEW_LOG(L"ArchiveDataObject::CreateFileContents: password not given");
+        return E_ABORT;
+    }
+    return ArchiveEntryStream::Create(_Archive, _Files[index].Index, stream);
 }
 
 bool ArchiveDataObject::ExtractToTemp() {
@@ -1128,6 +1357,12 @@ bool ArchiveDataObject::ExtractToTemp() {
         SEVENZIPVIEW_LOG(L"ExtractToTemp: FAIL - no archive or items");
         return false;
     }
+    
+    // Asked once per drag: the data object remembers the outcome
+    if (!Unlock()) {
+        SEVENZIPVIEW_LOG(L"ExtractToTemp: FAIL - password not given");
+        return false;
+    }
 
     // Create temp folder with hash of archive path for cache stability
     wchar_t tempPath[MAX_PATH];
@@ -1149,9 +1384,13 @@ bool ArchiveDataObject::ExtractToTemp() {
 
     SEVENZIPVIEW_LOG(L"ExtractToTemp: extracting to '%s'", tempFolder);
 
-    // Get all entries for folder expansion
-    auto allEntries = _Archive->GetAllEntries();
-    SEVENZIPVIEW_LOG(L"ExtractToTemp: allEntries count=%zu", allEntries.size());
+    // Every file to write, dragged ones and those below dragged folders.
+    // Folder contents come from the directory index, so expanding a folder
+    // costs its own size, not a scan of the archive.
+    const DirectoryIndex& directory = _Archive->GetDirectoryIndex();
+    std::vector<std::pair<UINT32, std::wstring>> targets;
+    std::vector<std::wstring> droppedFiles;     // Dragged files, in drag order
+    std::vector<UINT32> subtree;
 
     for (const auto& item : _Items) {
         UINT32 index = item.first;
@@ -1159,33 +1398,11 @@ bool ArchiveDataObject::ExtractToTemp() {
         
         SEVENZIPVIEW_LOG(L"ExtractToTemp: Processing index=%u path='%s'", index, path.c_str());
 
-        // Check if this is a folder (synthetic or real)
-        bool isFolder = false;
-        if (index == ArchiveEntry::SYNTHETIC_FOLDER_INDEX) {
-            isFolder = true;
-            SEVENZIPVIEW_LOG(L"ExtractToTemp: SYNTHETIC folder");
-        } else {
-            ArchiveEntry entry;
-            if (_Archive->GetEntry(index, entry)) {
-                isFolder = entry.IsDirectory();
-                SEVENZIPVIEW_LOG(L"ExtractToTemp: IsDirectory=%d", isFolder ? 1 : 0);
-            }
-        }
+        // Synthetic folders have no entry; real folders are directory entries
+        bool isFolder = (index == ArchiveEntry::SYNTHETIC_FOLDER_INDEX) ||
+            (index < _Archive->GetItemCount() && _Archive->GetEntryTable().IsDirectory(index));
 
         if (isFolder) {
-            // For folders: extract all files inside this folder
-            std::wstring folderPrefix = path;
-            if (!folderPrefix.empty() && folderPrefix.back() != L'\\' && folderPrefix.back() != L'/') {
-                folderPrefix += L"\\";
-            }
-            
-            // Normalize prefix
-            for (auto& c : folderPrefix) {
-                if (c == L'/') c = L'\\';
-            }
-            
-            SEVENZIPVIEW_LOG(L"ExtractToTemp: Folder prefix='%s'", folderPrefix.c_str());
-            
             // Get just the folder name
             std::wstring folderName = path;
             size_t pos = path.find_last_of(L"\\/");
@@ -1194,113 +1411,62 @@ bool ArchiveDataObject::ExtractToTemp() {
             }
             
             // Create the folder in temp
-            std::wstring tempFolderPath = _TempFolder + L"\\" + folderName;
+            std::wstring tempFolderPath = _TempFolder + L"\\" + SanitizeRelativePath(folderName);
             CreateDirectoryW(tempFolderPath.c_str(), nullptr);
+            _ExtractedFiles.push_back(tempFolderPath);
             SEVENZIPVIEW_LOG(L"ExtractToTemp: Created folder '%s'", tempFolderPath.c_str());
             
-            // Find and extract all files inside this folder
-            for (const auto& entry : allEntries) {
-                std::wstring entryPath = entry.FullPath;
-                // Normalize path for comparison
-                for (auto& c : entryPath) {
-                    if (c == L'/') c = L'\\';
-                }
+            UINT32 folderNode = directory.FindFolder(path);
+            if (folderNode == DirectoryIndex::NOT_FOUND) continue;
+            
+            // Descendant paths start with the folder's own, whatever their
+            // case or separators; folders come before their contents
+            size_t prefixLength = directory.GetPath(folderNode).size() + 1;
+            subtree.clear();
+            directory.GetDescendants(folderNode, subtree);
+            
+            for (UINT32 node : subtree) {
+                std::wstring_view nodePath = directory.GetPath(node);
+                if (nodePath.size() <= prefixLength) continue;
                 
-                // Check if this entry is inside the folder
-                if (entryPath.length() > folderPrefix.length() &&
-                    _wcsnicmp(entryPath.c_str(), folderPrefix.c_str(), folderPrefix.length()) == 0) {
-                    
-                    if (!entry.IsDirectory() && entry.ArchiveIndex != ArchiveEntry::SYNTHETIC_FOLDER_INDEX) {
-                        // Calculate relative path from the folder
-                        std::wstring relativePath = entryPath.substr(folderPrefix.length());
-                        
-                        // Sanitize the relative path
-                        for (auto& c : relativePath) {
-                            if (c == L':' || c == L'*' || c == L'?' || c == L'"' || c == L'<' || c == L'>' || c == L'|') {
-                                c = L'_';
-                            }
-                        }
-                        
-                        std::wstring destPath = tempFolderPath + L"\\" + relativePath;
-                        
-                        // Create parent directories
-                        size_t lastSlash = destPath.find_last_of(L'\\');
-                        if (lastSlash != std::wstring::npos) {
-                            std::wstring parentDir = destPath.substr(0, lastSlash);
-                            for (size_t i = tempFolderPath.length() + 1; i < parentDir.length(); i++) {
-                                if (parentDir[i] == L'\\') {
-                                    CreateDirectoryW(parentDir.substr(0, i).c_str(), nullptr);
-                                }
-                            }
-                            CreateDirectoryW(parentDir.c_str(), nullptr);
-                        }
-                        
-                        // Extract the file
-                        if (_Archive->ExtractToFile(entry.ArchiveIndex, destPath)) {
-                            // Only add files, not folders (folders are created automatically)
-                            SEVENZIPVIEW_LOG(L"  Extracted: '%s'", destPath.c_str());
-                        }
-                    }
+                std::wstring destPath = tempFolderPath + L"\\" +
+                    SanitizeRelativePath(std::wstring(nodePath.substr(prefixLength)));
+                if (directory.IsFolder(node)) {
+                    CreateDirectoryW(destPath.c_str(), nullptr);
+                } else {
+                    targets.push_back({ directory.GetEntryIndex(node), std::move(destPath) });
                 }
             }
             
-            // Add folder to the list
-            _ExtractedFiles.push_back(tempFolderPath);
-            SEVENZIPVIEW_LOG(L"  Added folder: '%s'", tempFolderPath.c_str());
+            SEVENZIPVIEW_LOG(L"ExtractToTemp: Folder '%s' holds %zu nodes", path.c_str(), subtree.size());
         } else {
-            // For files: extract the individual file
-            SEVENZIPVIEW_LOG(L"ExtractToTemp: Processing FILE index=%u", index);
-            
-            std::wstring safePath = path;
-            
-            // Normalize separators
-            for (auto& c : safePath) {
-                if (c == L'/') c = L'\\';
-            }
-            
-            // Remove dangerous path traversal sequences
-            size_t pos;
-            while ((pos = safePath.find(L"..\\")) != std::wstring::npos) {
-                safePath.erase(pos, 3);
-            }
-            
-            // Remove leading backslashes
-            while (!safePath.empty() && safePath[0] == L'\\') {
-                safePath.erase(0, 1);
-            }
-            
-            // Replace invalid characters
-            for (auto& c : safePath) {
-                if (c == L':' || c == L'*' || c == L'?' || c == L'"' || c == L'<' || c == L'>' || c == L'|') {
-                    c = L'_';
-                }
-            }
-
-            std::wstring destPath = _TempFolder + L"\\" + safePath;
+            std::wstring destPath = _TempFolder + L"\\" + SanitizeRelativePath(path);
             SEVENZIPVIEW_LOG(L"ExtractToTemp: FILE destPath='%s'", destPath.c_str());
             
-            // Create parent directories if needed
-            size_t lastSlash = destPath.find_last_of(L'\\');
-            if (lastSlash != std::wstring::npos) {
-                std::wstring parentDir = destPath.substr(0, lastSlash);
-                // Create all parent directories recursively
-                for (size_t i = _TempFolder.length() + 1; i < parentDir.length(); i++) {
-                    if (parentDir[i] == L'\\') {
-                        CreateDirectoryW(parentDir.substr(0, i).c_str(), nullptr);
-                    }
-                }
-                CreateDirectoryW(parentDir.c_str(), nullptr);
-            }
-            
-            if (_Archive->ExtractToFile(index, destPath)) {
-                _ExtractedFiles.push_back(destPath);
-                SEVENZIPVIEW_LOG(L"ExtractToTemp: FILE extracted OK - '%s'", destPath.c_str());
-            } else {
-                SEVENZIPVIEW_LOG(L"ExtractToTemp: FILE extraction FAILED - index=%u to '%s'", index, destPath.c_str());
-            }
+            droppedFiles.push_back(destPath);
+            targets.push_back({ index, std::move(destPath) });
         }
     }
 
+    // Files an earlier drag, copy or open decoded are linked from the
+    // extraction cache; the rest are decoded block by block on parallel
+    // readers, into the cache first
+    ExtractCacheStats cacheStats;
+    ExtractResult result = ExtractCache::Instance().ExtractFiles(_Archive, targets, &cacheStats);
+    SEVENZIPVIEW_LOG(L"ExtractToTemp: %u files extracted (%u cached, %u decoded), %u failed, %.3fs",
+        result.FilesExtracted, cacheStats.Hits, cacheStats.Extracted, result.FilesFailed, result.ElapsedSeconds);
+    if (result.FilesFailed > 0) PasswordDialog::ForgetIfRejected(*_Archive, result.FailedIndices);
+
+    // Only dragged files that were written are dropped
+    std::unordered_set<std::wstring> failed(result.FailedFiles.begin(), result.FailedFiles.end());
+    for (auto& destPath : droppedFiles) {
+        if (failed.count(destPath)) {
+            SEVENZIPVIEW_LOG(L"ExtractToTemp: FILE extraction FAILED - '%s'", destPath.c_str());
+            continue;
+        }
+        _ExtractedFiles.push_back(std::move(destPath));
+    }
+
     SEVENZIPVIEW_LOG(L"ExtractToTemp: END - extractedFiles=%zu", _ExtractedFiles.size());
     return !_ExtractedFiles.empty();
 }
@@ -1350,9 +1516,35 @@ STDMETHODIMP ArchiveDataObject::GetData(FORMATETC* pformatetcIn, STGMEDIUM* pmed
 
     ZeroMemory(pmedium, sizeof(*pmedium));
 
-    // CF_HDROP - file list for drag-drop
+    // Virtual files: what to create, then a stream per file as it is copied
+    if (pformatetcIn->cfFormat == GetFileDescriptorFormat() &&
+        (pformatetcIn->tymed & TYMED_HGLOBAL) && OffersVirtualFiles()) {
+        
+        HGLOBAL hGroup = CreateFileDescriptors();
+        if (!hGroup) return E_FAIL;
+        
+        pmedium->tymed = TYMED_HGLOBAL;
+        pmedium->hGlobal = hGroup;
+        pmedium->pUnkForRelease = nullptr;
+        return S_OK;
+    }
+    
+    if (pformatetcIn->cfFormat == GetFileContentsFormat() &&
+        (pformatetcIn->tymed & TYMED_ISTREAM)) {
+        
+        IStream* stream = nullptr;
+        HRESULT hr = CreateFileContents(pformatetcIn->lindex, &stream);
+        if (FAILED(hr)) return hr;
+        
+        pmedium->tymed = TYMED_ISTREAM;
+        pmedium->pstm = stream;
+        pmedium->pUnkForRelease = nullptr;
+        return S_OK;
+    }
+    
+    // CF_HDROP - extracted file list, only when virtual files can't carry the drop
     if (pformatetcIn->cfFormat == CF_HDROP &&
-        (pformatetcIn->tymed & TYMED_HGLOBAL)) {
+        (pformatetcIn->tymed & TYMED_HGLOBAL) && !OffersVirtualFiles()) {
         
         HGLOBAL hDrop = CreateHDrop();
         if (!hDrop) {
@@ -1381,14 +1573,20 @@ STDMETHODIMP ArchiveDataObject::QueryGetData(FORMATETC* pformatetc) {
     SEVENZIPVIEW_LOG(L"ArchiveDataObject::QueryGetData: cfFormat=%u tymed=0x%X", 
         pformatetc->cfFormat, pformatetc->tymed);
 
-    // We support CF_HDROP for drag-drop
+    // One or the other: a target given CF_HDROP alongside virtual files
+    // prefers it and extracts the whole drop to the temp folder
+    if (OffersVirtualFiles()) {
+        if (pformatetc->cfFormat == GetFileDescriptorFormat())
+            return (pformatetc->tymed & TYMED_HGLOBAL) ? S_OK : DV_E_TYMED;
+        if (pformatetc->cfFormat == GetFileContentsFormat())
+            return (pformatetc->tymed & TYMED_ISTREAM) ? S_OK : DV_E_TYMED;
+        return DV_E_FORMATETC;
+    }
+    
+    // CF_HDROP is rendered when asked for, extracting everything first
     if (pformatetc->cfFormat == CF_HDROP &&
         (pformatetc->tymed & TYMED_HGLOBAL)) {
-        // Make sure files are extracted
-        if (_ExtractedFiles.empty() && !_Extracted) {
-            return S_FALSE;  // Not ready yet
-        }
-        return _ExtractedFiles.empty() ? DV_E_FORMATETC : S_OK;
+        return (_Extracted && _ExtractedFiles.empty()) ? DV_E_FORMATETC : S_OK;
     }
 
     return DV_E_FORMATETC;
@@ -1409,9 +1607,17 @@ STDMETHODIMP ArchiveDataObject::EnumFormatEtc(DWORD dwDirection, IEnumFORMATETC*
     
     if (dwDirection != DATADIR_GET) return E_NOTIMPL;
 
-    // Create a simple enumerator for CF_HDROP
-    FORMATETC fmt = { CF_HDROP, nullptr, DVASPECT_CONTENT, -1, TYMED_HGLOBAL };
-    return SHCreateStdEnumFmtEtc(1, &fmt, ppenumFormatEtc);
+    // Same choice as QueryGetData
+    if (OffersVirtualFiles()) {
+        FORMATETC formats[] = {
+            { GetFileDescriptorFormat(), nullptr, DVASPECT_CONTENT, -1, TYMED_HGLOBAL },
+            { GetFileContentsFormat(), nullptr, DVASPECT_CONTENT, -1, TYMED_ISTREAM },
+        };
+        return SHCreateStdEnumFmtEtc(ARRAYSIZE(formats), formats, ppenumFormatEtc);
+    }
+    
+    FORMATETC hdrop = { CF_HDROP, nullptr, DVASPECT_CONTENT, -1, TYMED_HGLOBAL };
+    return SHCreateStdEnumFmtEtc(1, &hdrop, ppenumFormatEtc);
 }
 
 STDMETHODIMP ArchiveDataObject::DAdvise(FORMATETC* pformatetc, DWORD advf, IAdviseSink* pAdvSink, DWORD* pdwConnection) {
@@ -1426,4 +1632,183 @@ STDMETHODIMP ArchiveDataObject::EnumDAdvise(IEnumSTATDATA** ppenumAdvise) {
     return OLE_E_ADVISENOTSUPPORTED;
 }
 
+// ============================================================================
+// ArchiveEntryStream Implementation - Archive files decoded as they are read
+// ============================================================================
+
+ArchiveEntryStream::ArchiveEntryStream(std::shared_ptr<Archive> archive, UINT32 index)
+    : _RefCount(1)
+    , _Archive(archive)
+    , _Entry(std::move(archive), index) {
+}
+
+HRESULT ArchiveEntryStream::Create(std::shared_ptr<Archive> archive, UINT32 index, IStream** stream) {
+    if (!stream) return E_POINTER;
+    *stream = nullptr;
+    if (!archive) return E_INVALIDARG;
+    
+    ArchiveEntryStream* entryStream = new (std::nothrow) ArchiveEntryStream(std::move(archive), index);
+    if (!entryStream) return E_OUTOFMEMORY;
+    
+    if (!entryStream->_Entry.Open()) {
+        SEVENZIPVIEW_LOG(L"ArchiveEntryStream::Create: cannot open index %u", index);
+        entryStream->Release();
+        return E_FAIL;
+    }
+    
+    *stream = entryStream;
+    return S_OK;
+}
+
+STDMETHODIMP ArchiveEntryStream::QueryInterface(REFIID riid, void** ppv) {
+    if (!ppv) return E_POINTER;
+    
+    if (IsEqualIID(riid, IID_IUnknown) || IsEqualIID(riid, IID_ISequentialStream) ||
+        IsEqualIID(riid, IID_IStream)) {
+        *ppv = static_cast<IStream*>(this);
+        AddRef();
+        return S_OK;
+    }
+    
+    *ppv = nullptr;
+    return E_NOINTERFACE;
+}
+
+STDMETHODIMP_(ULONG) ArchiveEntryStream::AddRef() {
+    return InterlockedIncrement(&_RefCount);
+}
+
+STDMETHODIMP_(ULONG) ArchiveEntryStream::Release() {
+    LONG count = InterlockedDecrement(&_RefCount);
+    if (count == 0) delete this;
+    return count;
+}
+
+STDMETHODIMP ArchiveEntryStream::Read(void* pv, ULONG cb, ULONG* pcbRead) {
+    if (!pv) return STG_E_INVALIDPOINTER;
+    if (pcbRead) *pcbRead = 0;
+    
+    std::lock_guard<std::mutex> lock(_Mutex);
+    size_t read = 0;
+    SRes res = _Entry.Read(pv, cb, &read);
+    if (pcbRead) *pcbRead = (ULONG)read;
+    if (res != SZ_OK) {
+        SEVENZIPVIEW_LOG(L"ArchiveEntryStream::Read: index %u failed (error=%d)", _Entry.GetIndex(), res);
+        
+        // A wrong password shows up as bad data; it is asked for again only
+        // if the entry also fails on its own, as for extraction
+        if (res == SZ_ERROR_DATA || res == SZ_ERROR_CRC)
+            PasswordDialog::ForgetIfRejected(*_Archive, { _Entry.GetIndex() });
+        return HRESULT_FROM_WIN32(res == SZ_ERROR_CRC ? ERROR_CRC : ERROR_INVALID_DATA);
+    }
+    return read < cb ? S_FALSE : S_OK;
+}
+
+STDMETHODIMP ArchiveEntryStream::Write(const void* pv, ULONG cb, ULONG* pcbWritten) {
+    return STG_E_ACCESSDENIED;
+}
+
+STDMETHODIMP ArchiveEntryStream::Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER* plibNewPosition) {
+    std::lock_guard<std::mutex> lock(_Mutex);
+    
+    LONGLONG base = 0;
+    switch (dwOrigin) {
+        case STREAM_SEEK_SET: base = 0; break;
+        case STREAM_SEEK_CUR: base = (LONGLONG)_Entry.GetPosition(); break;
+        case STREAM_SEEK_END: base = (LONGLONG)_Entry.GetSize(); break;
+        default: return STG_E_INVALIDFUNCTION;
+    }
+    
+    LONGLONG position = base + dlibMove.QuadPart;
+    if (position < 0) return STG_E_INVALIDFUNCTION;
+    if (_Entry.Seek((UINT64)position) != SZ_OK) return E_FAIL;
+    
+    if (plibNewPosition) plibNewPosition->QuadPart = (ULONGLONG)position;
+    return S_OK;
+}
+
+STDMETHODIMP ArchiveEntryStream::SetSize(ULARGE_INTEGER libNewSize) {
+    return STG_E_ACCESSDENIED;
+}
+
+STDMETHODIMP ArchiveEntryStream::CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead,
+                                        ULARGE_INTEGER* pcbWritten) {
+    if (!pstm) return STG_E_INVALIDPOINTER;
+    
+    // In window-sized pieces, each written as soon as it is decoded
+    std::vector<BYTE> buffer(ENTRY_STREAM_DEFAULT_WINDOW);
+    ULONGLONG totalRead = 0;
+    ULONGLONG totalWritten = 0;
+    HRESULT hr = S_OK;
+    while (totalRead < cb.QuadPart) {
+        ULONG want = (ULONG)(std::min)((ULONGLONG)buffer.size(), cb.QuadPart - totalRead);
+        ULONG read = 0;
+        hr = Read(buffer.data(), want, &read);
+        if (FAILED(hr) || read == 0) break;
+        totalRead += read;
+        
+        ULONG written = 0;
+        hr = pstm->Write(buffer.data(), read, &written);
+        totalWritten += written;
+        if (FAILED(hr)) break;
+        if (written != read) {
+            hr = STG_E_MEDIUMFULL;
+            break;
+        }
+    }
+    
+    if (pcbRead) pcbRead->QuadPart = totalRead;
+    if (pcbWritten) pcbWritten->QuadPart = totalWritten;
+    return FAILED(hr) ? hr : S_OK;
+}
+
+STDMETHODIMP ArchiveEntryStream::Commit(DWORD grfCommitFlags) {
+    return S_OK;
+}
+
+STDMETHODIMP ArchiveEntryStream::Revert() {
+    return S_OK;
+}
+
+STDMETHODIMP ArchiveEntryStream::LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) {
+    return STG_E_INVALIDFUNCTION;
+}
+
+STDMETHODIMP ArchiveEntryStream::UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType) {
+    return STG_E_INVALIDFUNCTION;
+}
+
+STDMETHODIMP ArchiveEntryStream::Stat(STATSTG* pstatstg, DWORD grfStatFlag) {
+    if (!pstatstg) return STG_E_INVALIDPOINTER;
+    ZeroMemory(pstatstg, sizeof(*pstatstg));
+    
+    const EntryTable& entries = _Archive->GetEntryTable();
+    UINT32 index = _Entry.GetIndex();
+    if (!(grfStatFlag & STATFLAG_NONAME)) {
+        std::wstring name(entries.GetName(index));
+        HRESULT hr = SHStrDupW(name.c_str(), &pstatstg->pwcsName);
+        if (FAILED(hr)) return hr;
+    }
+    
+    pstatstg->type = STGTY_STREAM;
+    pstatstg->cbSize.QuadPart = _Entry.GetSize();
+    pstatstg->mtime = entries.GetModifiedTime(index);
+    pstatstg->ctime = entries.GetCreatedTime(index);
+    pstatstg->grfMode = STGM_READ | STGM_SHARE_DENY_WRITE;
+    return S_OK;
+}
+
+STDMETHODIMP ArchiveEntryStream::Clone(IStream** ppstm) {
+    if (!ppstm) return STG_E_INVALIDPOINTER;
+    
+    std::lock_guard<std::mutex> lock(_Mutex);
+    HRESULT hr = Create(_Archive, _Entry.GetIndex(), ppstm);
+    if (SUCCEEDED(hr)) {
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)_Entry.GetPosition();
+        hr = (*ppstm)->Seek(position, STREAM_SEEK_SET, nullptr);
+    }
+    return hr;
+}
+
 } // namespace SevenZipView